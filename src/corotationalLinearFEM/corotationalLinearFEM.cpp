@@ -34,8 +34,16 @@
 #include "include/matrixMultiplyMacros.h"
 #include "minivector/mat3d.h"
 #include "volumetricMesh/volumetricMeshENuMaterial.h"
+#include "volumetricMesh/volumetricMeshThreads.h"
+#include "volumetricMesh/generateStiffnessMatrixTopology.h"
 
-CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_) : tetMesh(tetMesh_) 
+struct CorotationalLinearFEM::PrecomputationData
+{
+  CorotationalLinearFEM * corotationalLinearFEM;
+  SparseMatrix * sparseMatrix;
+};
+
+CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_, VolumetricMeshCache * cache_, int numThreads) : tetMesh(tetMesh_), cache(cache_)
 {
   numVertices = tetMesh->getNumVertices();
 
@@ -67,8 +75,113 @@ CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_) : tetMesh(tetMe
     muLame[el] = eNuMaterial->getMu();
   }
 
+  // element rotations, used as the initial guesses for the next call
+  warmStartRotations = true;
+  rotations = (double*) malloc (sizeof(double) * 9 * numElements);
+  ResetRotations();
+
+  // MInverse and KElementUndeformed are stored in one block (16 + 144 doubles per element), 
+  // which is loaded from the cache if possible
+  size_t precomputedBlockSize = sizeof(double) * 160 * numElements;
+  precomputedBlock = NULL;
+  precomputedBlockFromCache = false;
+  if (cache != NULL)
+  {
+    precomputedBlock = (double*) cache->LoadWithSize("CorotationalLinearFEM", precomputedBlockSize);
+    precomputedBlockFromCache = (precomputedBlock != NULL);
+  }
+  if (precomputedBlock == NULL)
+    precomputedBlock = (double*) malloc (precomputedBlockSize);
+
   MInverse = (double**) malloc (sizeof(double*) * numElements);
+  KElementUndeformed = (double**) malloc (sizeof(double*) * numElements);
   for(int el = 0; el < numElements; el++)
+  {
+    MInverse[el] = &precomputedBlock[16 * el];
+    KElementUndeformed[el] = &precomputedBlock[16 * numElements + 144 * el];
+  }
+
+  // build acceleration indices for fast writing to the global stiffness matrix
+  SparseMatrix * sparseMatrix;
+  GetStiffnessMatrixTopology(&sparseMatrix);
+
+  // the per-element precomputation (MInverse, KElementUndeformed, acceleration indices) is performed in parallel
+  rowIndices = (int**) malloc (sizeof(int*) * numElements);
+  columnIndices = (int**) malloc (sizeof(int*) * numElements);
+  struct PrecomputationData data = { this, sparseMatrix };
+  VolumetricMeshThreads::RunOnElements(numElements, numThreads, PrecomputeElementRange, &data);
+  delete(sparseMatrix);
+
+  if ((!precomputedBlockFromCache) && (cache != NULL))
+    cache->Save("CorotationalLinearFEM", precomputedBlock, precomputedBlockSize);
+}
+
+CorotationalLinearFEM::~CorotationalLinearFEM()
+{
+  free(undeformedPositions);
+  free(KElementUndeformed);
+  free(MInverse);
+  if (precomputedBlockFromCache)
+    VolumetricMeshCache::Release(precomputedBlock);
+  else
+    free(precomputedBlock);
+
+  ClearRowColumnIndices();
+
+  free(lambdaLame);
+  free(muLame);
+  free(rotations);
+}
+
+void CorotationalLinearFEM::ResetRotations()
+{
+  int numElements = tetMesh->getNumElements();
+  for(int el=0; el<numElements; el++)
+  {
+    double * R = &rotations[9 * el];
+    for(int i=0; i<9; i++)
+      R[i] = 0.0;
+    R[0] = R[4] = R[8] = 1.0;
+  }
+}
+
+size_t CorotationalLinearFEM::GetStateSize()
+{
+  return sizeof(double) * 9 * tetMesh->getNumElements();
+}
+
+void CorotationalLinearFEM::SaveState(char * data)
+{
+  memcpy(data, rotations, GetStateSize());
+}
+
+int CorotationalLinearFEM::LoadState(const char * data, size_t size)
+{
+  if (size != GetStateSize())
+  {
+    printf("Error: corotational linear FEM state has wrong size (%d bytes, expected %d).\n", (int)size, (int)GetStateSize());
+    return 1;
+  }
+  memcpy(rotations, data, size);
+  return 0;
+}
+
+void CorotationalLinearFEM::PrecomputeElementRange(void * data_, int startElement, int endElement)
+{
+  struct PrecomputationData * data = (struct PrecomputationData*) data_;
+  CorotationalLinearFEM * fem = data->corotationalLinearFEM;
+
+  if (!fem->precomputedBlockFromCache)
+  {
+    fem->ComputeMInverse(startElement, endElement);
+    fem->ComputeKElementUndeformed(startElement, endElement);
+  }
+  fem->BuildRowColumnIndices(data->sparseMatrix, startElement, endElement);
+}
+
+void CorotationalLinearFEM::ComputeMInverse(int startElement, int endElement)
+{
+  for(int el = startElement; el < endElement; el++)
   {
     // get the integer indices of the tet vertices
     int vtxIndex[4];
@@ -86,19 +199,14 @@ CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_) : tetMesh(tetMe
     M[12] = M[13] = M[14] = M[15] = 1.0;
 
     // invert M and cache inverse (see [Mueller 2004])
-    MInverse[el] = (double*) malloc (sizeof(double) * 16);
     inverse4x4(M, MInverse[el]);
   }
+}
 
-  // build acceleration indices for fast writing to the global stiffness matrix
-  SparseMatrix * sparseMatrix;
-  GetStiffnessMatrixTopology(&sparseMatrix);
-  BuildRowColumnIndices(sparseMatrix);
-  delete(sparseMatrix);
-
-  // compute stiffness matrices for all the elements in the undeformed configuration
-  KElementUndeformed = (double**) malloc (sizeof(double*) * numElements);
-  for (int el = 0; el < numElements; el++)
+// compute stiffness matrices for the elements in the undeformed configuration
+void CorotationalLinearFEM::ComputeKElementUndeformed(int startElement, int endElement)
+{
+  for (int el = startElement; el < endElement; el++)
   {
     double * MInv = MInverse[el];
 
@@ -133,7 +241,7 @@ CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_) : tetMesh(tetMe
 	  EB[12 * i + j] += E[6 * i + k] * B[12 * k + j];
  
     // KElementUndeformed[el] = B^T * EB
-    KElementUndeformed[el] = (double*) calloc (144, sizeof(double)); // element stiffness matrix
+    memset(KElementUndeformed[el], 0, sizeof(double) * 144); // element stiffness matrix
     for (int i=0; i<12; i++)
       for (int j=0; j<12; j++)
 	for (int k=0; k<6; k++)
@@ -146,46 +254,19 @@ CorotationalLinearFEM::CorotationalLinearFEM(TetMesh * tetMesh_) : tetMesh(tetMe
   }
 }
 
-CorotationalLinearFEM::~CorotationalLinearFEM()
-{
-  free(undeformedPositions);
-  for(int el=0; el < tetMesh->getNumElements(); el++)
-  {
-    free(KElementUndeformed[el]);
-    free(MInverse[el]);
-  }
-  free(KElementUndeformed);
-  free(MInverse);
-
-  ClearRowColumnIndices();
-
-  free(lambdaLame);
-  free(muLame);
-}
-
 void CorotationalLinearFEM::GetStiffnessMatrixTopology(SparseMatrix ** stiffnessMatrixTopology)
 {
-  SparseMatrixOutline * emptyMatrix = new SparseMatrixOutline(3 * numVertices);
-
-  int numElements = tetMesh->getNumElements();
-  for (int el=0; el < numElements; el++)
+  if (cache != NULL)
   {
-    int vtxIndex[4];
-    for(int vtx=0; vtx<4; vtx++)
-      vtxIndex[vtx] = tetMesh->getVertexIndex(el, vtx);
-
-    for (int i=0; i<4; i++)
-      for (int j=0; j<4; j++)
-      {
-        // add 3x3 block corresponding to pair of vertices (i,j)
-        for(int k=0; k<3; k++)
-          for(int l=0; l<3; l++)
-            emptyMatrix->AddEntry(3 * vtxIndex[i] + k, 3 * vtxIndex[j] + l, 0.0);
-      }
+    *stiffnessMatrixTopology = cache->LoadSparseMatrixTopology("stiffnessMatrixTopology");
+    if (*stiffnessMatrixTopology != NULL)
+      return;
   }
 
-  *stiffnessMatrixTopology = new SparseMatrix(emptyMatrix);
-  delete(emptyMatrix);
+  *stiffnessMatrixTopology = GenerateStiffnessMatrixTopology::Generate(tetMesh);
+
+  if (cache != NULL)
+    cache->SaveSparseMatrixTopology("stiffnessMatrixTopology", *stiffnessMatrixTopology);
 }
 
 // compute RK = R * K and RKRT = R * K * R^T (block-wise)
@@ -212,6 +293,68 @@ void CorotationalLinearFEM::WarpMatrix(double * K, double * R, double * RK, doub
     }
 }
 
+void CorotationalLinearFEM::ComputeDeformationGradient(double * u, int el, double * P, double * F)
+{
+  /*
+     P = [ v0   v1   v2   v3 ]
+         [  1    1    1    1 ]
+  */
+  // rows 1,2,3
+  for(int i=0; i<3; i++)
+    for(int j=0; j<4; j++)
+    {
+      int vtxIndex = tetMesh->getVertexIndex(el, j);
+      P[4 * i + j] = undeformedPositions[3 * vtxIndex + i] + u[3 * vtxIndex + i];
+    }
+  // row 4
+  for(int j=0; j<4; j++)
+    P[12 + j] = 1;
+
+  // F = P * Inverse(M)
+  for(int i=0; i<3; i++) 
+    for(int j=0; j<3; j++) 
+    {
+      F[3 * i + j] = 0;
+      for(int k=0; k<4; k++)
+        F[3 * i + j] += P[4 * i + k] * MInverse[el][4 * k + j];
+    }
+}
+
+void CorotationalLinearFEM::ComputeRotationsWarmStarted(double * u, int startElement, int endElement, double * R, double * S)
+{
+  int numBatchElements = endElement - startElement;
+  if (numBatchElements <= 0)
+    return;
+  double F[9 * rotationBatchSize];
+  int failed[rotationBatchSize];
+  for(int i=0; i<numBatchElements; i++)
+  {
+    double P[16];
+    ComputeDeformationGradient(u, startElement + i, P, &F[9 * i]);
+  }
+
+  // initial guesses are the rotations of the previous call
+  memcpy(R, &rotations[9 * startElement], sizeof(double) * 9 * numBatchElements);
+  PolarDecomposition::ComputeWarmStarted(numBatchElements, F, R, S, failed, 1E-6);
+
+  for(int i=0; i<numBatchElements; i++)
+  {
+    if (failed[i])
+    {
+      // compute from scratch
+      double det = PolarDecomposition::Compute(&F[9 * i], &R[9 * i], &S[9 * i], 1E-6);
+      if (det < 0)
+      {
+        // flip R so that it becomes orthogonal
+        for(int j=0; j<9; j++)
+          R[9 * i + j] *= -1.0;
+      }
+    }
+  }
+
+  memcpy(&rotations[9 * startElement], R, sizeof(double) * 9 * numBatchElements);
+}
+
 void CorotationalLinearFEM::ComputeForceAndStiffnessMatrix(double * u, double * f, SparseMatrix * stiffnessMatrix, int warp)
 {
   ComputeForceAndStiffnessMatrixOfSubmesh(u, f, stiffnessMatrix, warp, 0, tetMesh->getNumElements());
@@ -227,6 +370,10 @@ void CorotationalLinearFEM::ComputeForceAndStiffnessMatrixOfSubmesh(double * u,
   if (stiffnessMatrix != NULL)
     stiffnessMatrix->ResetToZero();
 
+  // rotations of the current batch of elements (warmStartRotations only)
+  double batchR[9 * rotationBatchSize];
+  double batchS[9 * rotationBatchSize];
+
   for (int el=elementLo; el < elementHi; el++)
   {
     int vtxIndex[4];
@@ -238,36 +385,68 @@ void CorotationalLinearFEM::ComputeForceAndStiffnessMatrixOfSubmesh(double * u,
     if (warp > 0)
     {
       double P[16]; // the current world-coordinate positions (row-major)
-      /*
-         P = [ v0   v1   v2   v3 ]
-             [  1    1    1    1 ]
-      */
-      // rows 1,2,3
-      for(int i=0; i<3; i++)
-        for(int j=0; j<4; j++)
-          P[4 * i + j] = undeformedPositions[3 * vtxIndex[j] + i] + u[3 * vtxIndex[j] + i];
-      // row 4
-      for(int j=0; j<4; j++)
-        P[12 + j] = 1;
-
-      // F = P * Inverse(M)
-      double F[9]; // upper-left 3x3 block
-      for(int i=0; i<3; i++) 
-        for(int j=0; j<3; j++) 
-        {
-          F[3 * i + j] = 0;
-          for(int k=0; k<4; k++)
-            F[3 * i + j] += P[4 * i + k] * MInverse[el][4 * k + j];
-	}
+      double F[9]; // deformation gradient
+      ComputeDeformationGradient(u, el, P, F);
 
       double R[9]; // rotation (row-major)
       double S[9]; // symmetric (row-major)
-      double det = PolarDecomposition::Compute(F, R, S, 1E-6);
-      if (det < 0)
+      if (warmStartRotations)
       {
-        // flip R so that it becomes orthogonal
-        for(int i=0; i<9; i++)
-          R[i] *= -1.0;
+        // the rotations are computed for a batch of elements at a time
+        int batchElement = (el - elementLo) % rotationBatchSize;
+        if (batchElement == 0)
+        {
+          int batchEnd = (el + rotationBatchSize < elementHi) ? el + rotationBatchSize : elementHi;
+          ComputeRotationsWarmStarted(u, el, batchEnd, batchR, batchS);
+        }
+        memcpy(R, &batchR[9 * batchElement], sizeof(double) * 9);
+        memcpy(S, &batchS[9 * batchElement], sizeof(double) * 9);
+      }
+      else
+      {
+        double det = PolarDecomposition::Compute(F, R, S, 1E-6);
+        if (det < 0)
+        {
+          // flip R so that it becomes orthogonal
+          for(int i=0; i<9; i++)
+            R[i] *= -1.0;
+        }
+      }
+
+      if (stiffnessMatrix == NULL)
+      {
+        // only the forces are needed: f = R K (R^T x - x0), which is much cheaper than forming R K R^T
+        double tempVec[12]; // R^T x - x0
+        for(int vtx=0; vtx<4; vtx++)
+        {
+          double pos[3];
+          for(int i=0; i<3; i++)
+            pos[i] = P[4 * i + vtx];
+          MATRIX_VECTOR_MULTIPLY3X3T(R, pos, &tempVec[3 * vtx]);
+          for(int i=0; i<3; i++)
+            tempVec[3 * vtx + i] -= undeformedPositions[3 * vtxIndex[vtx] + i];
+        }
+
+        double a[12]; // a = K * tempVec
+        for (int i=0; i<12; i++)
+        {
+          a[i] = 0.0;
+          for (int j=0; j<12; j++)
+            a[i] += KElementUndeformed[el][12 * i + j] * tempVec[j];
+        }
+
+        // add R * a into the global f
+        if (f != NULL)
+        {
+          for(int vtx=0; vtx<4; vtx++)
+          {
+            double fVertex[3];
+            MATRIX_VECTOR_MULTIPLY3X3(R, &a[3 * vtx], fVertex);
+            for(int i=0; i<3; i++)
+              f[3 * vtxIndex[vtx] + i] += fVertex[i];
+          }
+        }
+        continue;
       }
 
       // RK = R * K
@@ -495,14 +674,10 @@ void CorotationalLinearFEM::ClearRowColumnIndices()
   free(columnIndices);
 }
 
-void CorotationalLinearFEM::BuildRowColumnIndices(SparseMatrix * sparseMatrix)
+// rowIndices and columnIndices must be allocated (numElements pointers each)
+void CorotationalLinearFEM::BuildRowColumnIndices(SparseMatrix * sparseMatrix, int startElement, int endElement)
 {
-  int numElements = tetMesh->getNumElements();
-
-  rowIndices = (int**) malloc (sizeof(int*) * numElements);
-  columnIndices = (int**) malloc (sizeof(int*) * numElements);
-
-  for (int el=0; el < numElements; el++)
+  for (int el=startElement; el < endElement; el++)
   {
     // the 4 rows corresponding to the 4 vertices
     rowIndices[el] = (int*) malloc (sizeof(int) * 4);
@@ -48,6 +48,7 @@
 
 #include "volumetricMesh/tetMesh.h"
 #include "sparseMatrix/sparseMatrix.h"
+#include "volumetricMesh/volumetricMeshCache.h"
 
 class CorotationalLinearFEM
 {
@@ -55,7 +56,9 @@ public:
 
   // initializes corotational linear FEM
   // input: tetMesh
-  CorotationalLinearFEM(TetMesh * tetMesh);
+  // cache: if not NULL, the precomputed element data (MInverse, KElementUndeformed) and the stiffness matrix topology are loaded from the cache if available, and otherwise computed and stored into the cache (see volumetricMesh/volumetricMeshCache.h)
+  // numThreads: number of threads used for the precomputation in the constructor
+  CorotationalLinearFEM(TetMesh * tetMesh, VolumetricMeshCache * cache=NULL, int numThreads=1);
   virtual ~CorotationalLinearFEM();
 
   void GetStiffnessMatrixTopology(SparseMatrix ** stiffnessMatrixTopology); // returns a zero matrix containing the locations of non-zero elements in the stiffness matrix
@@ -75,12 +78,29 @@ public:
 
   inline TetMesh * GetTetMesh() { return tetMesh; }
 
+  // if enabled (default), the element rotations (warp > 0) are computed using a Newton iteration that starts from the element rotations of the previous call
+  // (see PolarDecomposition::ComputeWarmStarted), in batches of rotationBatchSize elements; this is much faster than computing them from scratch,
+  // because the rotations change little between consecutive calls; elements where this fails (e.g., inverted elements) are computed from scratch
+  void SetWarmStartRotations(bool warmStartRotations) { this->warmStartRotations = warmStartRotations; }
+  // resets the stored element rotations to identity (e.g., when the simulation is restarted from a different deformation)
+  void ResetRotations();
+  // checkpointing of the stored element rotations (see ForceModel::SaveState), so that a restored simulation continues with the same warm starts
+  size_t GetStateSize();
+  void SaveState(char * data);
+  // returns 0 on success, and non-zero if the size does not match
+  int LoadState(const char * data, size_t size);
+
 protected:
   int numVertices;
   TetMesh * tetMesh;
   double * undeformedPositions;
   double ** MInverse;
   double ** KElementUndeformed;
+  VolumetricMeshCache * cache;
+  double * precomputedBlock; // MInverse and KElementUndeformed of all the elements; malloc-ed, or loaded from the cache
+  bool precomputedBlockFromCache;
+  void ComputeMInverse(int startElement, int endElement);
+  void ComputeKElementUndeformed(int startElement, int endElement);
 
   void WarpMatrix(double * K, double * R, double * RK, double * RKRT);
   void inverse3x3(double * A, double * AInv); // inverse of a row-major 3x3 matrix
@@ -90,10 +110,25 @@ protected:
   int ** rowIndices;
   int ** columnIndices;
   void ClearRowColumnIndices();
-  void BuildRowColumnIndices(SparseMatrix * sparseMatrix);
+  void BuildRowColumnIndices(SparseMatrix * sparseMatrix, int startElement, int endElement);
+
+  // performs all the per-element precomputation for the elements startElement <= el < endElement (see VolumetricMeshThreads)
+  struct PrecomputationData;
+  static void PrecomputeElementRange(void * data, int startElement, int endElement);
 
   double * lambdaLame;
   double * muLame;
+
+  // F = P * MInverse, where P contains the current positions of the element vertices (see the implementation)
+  void ComputeDeformationGradient(double * u, int el, double * P, double * F);
+
+  // element rotations of the last call (9 doubles per element, row-major)
+  bool warmStartRotations;
+  double * rotations;
+  static const int rotationBatchSize = 32;
+  // computes the rotations R and symmetric factors S (9 doubles each, per element) of the polar decompositions of the deformation gradients
+  // of the elements startElement <= el < endElement (at most rotationBatchSize elements), and stores the rotations into "rotations"
+  void ComputeRotationsWarmStarted(double * u, int startElement, int endElement, double * R, double * S);
 };
 
 #endif
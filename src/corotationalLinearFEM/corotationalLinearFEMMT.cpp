@@ -37,7 +37,7 @@
 #include "corotationalLinearFEM/corotationalLinearFEMMT.h"
 using namespace std;
 
-CorotationalLinearFEMMT::CorotationalLinearFEMMT(TetMesh * tetMesh, int numThreads_) : CorotationalLinearFEM(tetMesh), numThreads(numThreads_)
+CorotationalLinearFEMMT::CorotationalLinearFEMMT(TetMesh * tetMesh, int numThreads_, VolumetricMeshCache * cache) : CorotationalLinearFEM(tetMesh, cache, numThreads_), numThreads(numThreads_)
 {
   Initialize();
 }
@@ -41,7 +41,7 @@ class CorotationalLinearFEMMT : public CorotationalLinearFEM
 {
 public:
 
-  CorotationalLinearFEMMT(TetMesh * tetMesh, int numThreads=1);
+  CorotationalLinearFEMMT(TetMesh * tetMesh, int numThreads=1, VolumetricMeshCache * cache=NULL);
   virtual ~CorotationalLinearFEMMT();
 
   virtual void ComputeForceAndStiffnessMatrix(double * vertexDisplacements, double * internalForces, SparseMatrix * stiffnessMatrix, int warp=1);
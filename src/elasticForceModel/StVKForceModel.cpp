@@ -60,3 +60,13 @@ void StVKForceModel::GetTangentStiffnessMatrix(double * u, SparseMatrix * tangen
   stVKStiffnessMatrix->ComputeStiffnessMatrix(u, tangentStiffnessMatrix);
 } 
 
+void StVKForceModel::GetForceAndMatrix(double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix)
+{
+  stVKStiffnessMatrix->ComputeForceAndStiffnessMatrix(u, internalForces, tangentStiffnessMatrix);
+}
+
+int StVKForceModel::GetElasticEnergy(double * u, double * energy)
+{
+  *energy = stVKInternalForces->ComputeEnergy(u);
+  return 0;
+}
@@ -46,6 +46,9 @@ public:
   virtual void GetInternalForce(double * u, double * internalForces);
   virtual void GetTangentStiffnessMatrixTopology(SparseMatrix ** tangentStiffnessMatrix);
   virtual void GetTangentStiffnessMatrix(double * u, SparseMatrix * tangentStiffnessMatrix); 
+  // computes the internal forces and the tangent stiffness matrix in a single pass over the elements
+  virtual void GetForceAndMatrix(double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix);
+  virtual int GetElasticEnergy(double * u, double * energy);
 
 protected:
   StVKInternalForces * stVKInternalForces;
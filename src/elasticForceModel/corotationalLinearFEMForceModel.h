@@ -50,6 +50,11 @@ public:
 
   inline void SetWarp(int warp) { this->warp = warp; }
 
+  // the element rotations used to warm-start the next evaluation (see CorotationalLinearFEM::SetWarmStartRotations)
+  virtual size_t GetStateSize() { return corotationalLinearFEM->GetStateSize(); }
+  virtual void SaveState(char * data) { corotationalLinearFEM->SaveState(data); }
+  virtual int LoadState(const char * data, size_t size) { return corotationalLinearFEM->LoadState(data, size); }
+
 protected:
   CorotationalLinearFEM * corotationalLinearFEM;
   int warp;
@@ -55,3 +55,23 @@ void IsotropicHyperelasticFEMForceModel::GetForceAndMatrix(double * u, double *
   isotropicHyperelasticFEM->GetForceAndTangentStiffnessMatrix(u, internalForces, tangentStiffnessMatrix);
 }
 
+void IsotropicHyperelasticFEMForceModel::GetForceAndLinearization(double * u, double * internalForces)
+{
+  isotropicHyperelasticFEM->ComputeForcesAndLinearization(u, internalForces);
+}
+
+int IsotropicHyperelasticFEMForceModel::MultiplyTangentStiffnessMatrix(double * v, double * Kv)
+{
+  return isotropicHyperelasticFEM->MultiplyTangentStiffnessMatrix(v, Kv);
+}
+
+int IsotropicHyperelasticFEMForceModel::GetTangentStiffnessMatrixDiagonal(double * diagonal)
+{
+  return isotropicHyperelasticFEM->GetTangentStiffnessMatrixDiagonal(diagonal);
+}
+
+int IsotropicHyperelasticFEMForceModel::GetElasticEnergy(double * u, double * energy)
+{
+  *energy = isotropicHyperelasticFEM->ComputeEnergy(u);
+  return 0;
+}
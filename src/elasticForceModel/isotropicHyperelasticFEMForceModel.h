@@ -48,6 +48,13 @@ public:
 
   virtual void GetForceAndMatrix(double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix);
 
+  // matrix-free interface (exact element-by-element products; see isotropicHyperelasticFEM.h)
+  virtual void GetForceAndLinearization(double * u, double * internalForces);
+  virtual int MultiplyTangentStiffnessMatrix(double * v, double * Kv);
+  virtual int GetTangentStiffnessMatrixDiagonal(double * diagonal);
+
+  virtual int GetElasticEnergy(double * u, double * energy);
+
 protected:
   IsotropicHyperelasticFEM * isotropicHyperelasticFEM;
 };
@@ -59,3 +59,8 @@ void LinearFEMForceModel::GetTangentStiffnessMatrix(double * u, SparseMatrix * t
   *tangentStiffnessMatrix = *K;
 } 
 
+int LinearFEMForceModel::GetElasticEnergy(double * u, double * energy)
+{
+  *energy = 0.5 * K->QuadraticForm(u);
+  return 0;
+}
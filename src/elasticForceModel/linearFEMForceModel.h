@@ -47,6 +47,7 @@ public:
   virtual void GetInternalForce(double * u, double * internalForces);
   virtual void GetTangentStiffnessMatrixTopology(SparseMatrix ** tangentStiffnessMatrix);
   virtual void GetTangentStiffnessMatrix(double * u, SparseMatrix * tangentStiffnessMatrix); 
+  virtual int GetElasticEnergy(double * u, double * energy); // 0.5 * u^T K u
 
 protected:
   SparseMatrix * K;
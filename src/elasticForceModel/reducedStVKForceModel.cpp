@@ -0,0 +1,60 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "forceModel" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include "reducedStVKForceModel.h"
+
+ReducedStVKForceModel::ReducedStVKForceModel(StVKReducedInternalForces * stVKReducedInternalForces_): stVKReducedInternalForces(stVKReducedInternalForces_)
+{
+  r = stVKReducedInternalForces->Getr();
+}
+
+ReducedStVKForceModel::~ReducedStVKForceModel()
+{
+}
+
+void ReducedStVKForceModel::GetInternalForce(double * q, double * internalForces)
+{
+  stVKReducedInternalForces->ComputeForces(q, internalForces);
+}
+
+void ReducedStVKForceModel::GetTangentStiffnessMatrix(double * q, double * tangentStiffnessMatrix)
+{
+  stVKReducedInternalForces->ComputeStiffnessMatrix(q, tangentStiffnessMatrix);
+} 
+
+void ReducedStVKForceModel::GetForceAndMatrix(double * q, double * internalForces, double * tangentStiffnessMatrix)
+{
+  stVKReducedInternalForces->ComputeForceAndStiffnessMatrix(q, internalForces, tangentStiffnessMatrix);
+}
+
+int ReducedStVKForceModel::GetElasticEnergy(double * q, double * energy)
+{
+  *energy = stVKReducedInternalForces->ComputeEnergy(q);
+  return 0;
+}
+
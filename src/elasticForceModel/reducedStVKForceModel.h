@@ -0,0 +1,57 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "forceModel" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Reduced force model corresponding to the StVK material: the cubic polynomial
+  reduced internal forces and stiffness matrices of StVKReducedInternalForces.
+  Use it with a dense integrator (e.g., ImplicitNewmarkDense).
+*/
+
+#ifndef _REDUCEDSTVKFORCEMODEL_H_
+#define _REDUCEDSTVKFORCEMODEL_H_
+
+#include "stvk/StVKReducedInternalForces.h"
+#include "forceModel/reducedForceModel.h"
+
+class ReducedStVKForceModel : public ReducedForceModel
+{
+public:
+  ReducedStVKForceModel(StVKReducedInternalForces * stVKReducedInternalForces);
+  virtual ~ReducedStVKForceModel(); 
+
+  virtual void GetInternalForce(double * q, double * internalForces);
+  virtual void GetTangentStiffnessMatrix(double * q, double * tangentStiffnessMatrix); 
+  virtual void GetForceAndMatrix(double * q, double * internalForces, double * tangentStiffnessMatrix); 
+  virtual int GetElasticEnergy(double * q, double * energy);
+
+protected:
+  StVKReducedInternalForces * stVKReducedInternalForces;
+};
+
+#endif
+
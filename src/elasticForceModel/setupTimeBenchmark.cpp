@@ -0,0 +1,258 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "forceModel" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Setup-time benchmark of the force models whose constructors run their per-element precomputation 
+  in parallel (see volumetricMesh/volumetricMeshThreads.h):
+    StVKTetHighMemoryABCD, StVKStiffnessMatrix, IsotropicHyperelasticFEM, CorotationalLinearFEM, 
+    and GenerateStiffnessMatrixTopology.
+  For each number of threads (1, 2, 4, ..., maxNumThreads), it prints the construction times, and checks that
+  the internal forces and stiffness matrices (at a random deformation) are identical to those with one thread.
+
+  Usage: setupTimeBenchmark [maxNumThreads] [mesh.veg]
+  Without a mesh file, a beam of 32 x 16 x 16 cubes (49152 tets) is used.
+  Returns 0 on success, and 1 if the results depend on the number of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "volumetricMesh/tetMesh.h"
+#include "volumetricMesh/generateStiffnessMatrixTopology.h"
+#include "stvk/StVKTetHighMemoryABCD.h"
+#include "stvk/StVKInternalForces.h"
+#include "stvk/StVKStiffnessMatrix.h"
+#include "isotropicHyperelasticFEM/isotropicHyperelasticFEM.h"
+#include "isotropicHyperelasticFEM/neoHookeanIsotropicMaterial.h"
+#include "corotationalLinearFEM/corotationalLinearFEM.h"
+#include "performanceCounter/performanceCounter.h"
+
+// a beam of nx x ny x nz cubes (of size 0.1), each split into 6 tets
+static TetMesh * CreateBeam(int nx, int ny, int nz)
+{
+  double h = 0.1;
+  int numVertices = (nx + 1) * (ny + 1) * (nz + 1);
+  double * vertices = (double*) malloc (sizeof(double) * 3 * numVertices);
+  for(int i=0; i<=nx; i++)
+    for(int j=0; j<=ny; j++)
+      for(int k=0; k<=nz; k++)
+      {
+        int index = (i * (ny + 1) + j) * (nz + 1) + k;
+        vertices[3 * index + 0] = i * h;
+        vertices[3 * index + 1] = j * h;
+        vertices[3 * index + 2] = k * h;
+      }
+
+  // the six tets of a cube share the diagonal 0-7; all are positively oriented
+  int cubeTets[6][4] = { {0,3,1,7}, {0,1,5,7}, {0,2,3,7}, {0,6,2,7}, {0,5,4,7}, {0,4,6,7} };
+  int numElements = 6 * nx * ny * nz;
+  int * elements = (int*) malloc (sizeof(int) * 4 * numElements);
+  int el = 0;
+  for(int i=0; i<nx; i++)
+    for(int j=0; j<ny; j++)
+      for(int k=0; k<nz; k++)
+      {
+        int corners[8];
+        for(int corner=0; corner<8; corner++)
+          corners[corner] = ((i + ((corner >> 2) & 1)) * (ny + 1) + j + ((corner >> 1) & 1)) * (nz + 1) + k + (corner & 1);
+        for(int tet=0; tet<6; tet++, el++)
+          for(int vtx=0; vtx<4; vtx++)
+            elements[4 * el + vtx] = corners[cubeTets[tet][vtx]];
+      }
+
+  TetMesh * tetMesh = new TetMesh(numVertices, vertices, numElements, elements, 1E6, 0.45, 1000);
+  free(elements);
+  free(vertices);
+  return tetMesh;
+}
+
+#define NUM_MODELS 3
+static const char * modelName[NUM_MODELS] = { "StVK", "IsotropicHyperelasticFEM", "CorotationalLinearFEM" };
+
+// the internal forces and the stiffness matrix of each model, at some deformation
+struct SetupTimeBenchmark_results
+{
+  double * forces[NUM_MODELS];
+  SparseMatrix * stiffnessMatrix[NUM_MODELS];
+  SparseMatrix * topology;
+};
+
+// constructs all the models with numThreads threads, and prints the construction times
+static void Run(TetMesh * tetMesh, int numThreads, double * u, SetupTimeBenchmark_results * results)
+{
+  int r = 3 * tetMesh->getNumVertices();
+  PerformanceCounter counter;
+
+  counter.StartCounter();
+  StVKTetHighMemoryABCD * precomputedIntegrals = new StVKTetHighMemoryABCD(tetMesh, false, NULL, numThreads);
+  counter.StopCounter();
+  double timeABCD = counter.GetElapsedTime();
+
+  StVKInternalForces * stVKInternalForces = new StVKInternalForces(tetMesh, precomputedIntegrals);
+  counter.StartCounter();
+  StVKStiffnessMatrix * stVKStiffnessMatrix = new StVKStiffnessMatrix(stVKInternalForces, NULL, numThreads);
+  counter.StopCounter();
+  double timeStVKStiffnessMatrix = counter.GetElapsedTime();
+
+  NeoHookeanIsotropicMaterial * material = new NeoHookeanIsotropicMaterial(tetMesh);
+  counter.StartCounter();
+  IsotropicHyperelasticFEM * isotropicHyperelasticFEM = new IsotropicHyperelasticFEM(tetMesh, material, -DBL_MAX, false, 9.81, NULL, numThreads);
+  counter.StopCounter();
+  double timeIsotropicHyperelasticFEM = counter.GetElapsedTime();
+
+  counter.StartCounter();
+  CorotationalLinearFEM * corotationalLinearFEM = new CorotationalLinearFEM(tetMesh, NULL, numThreads);
+  counter.StopCounter();
+  double timeCorotationalLinearFEM = counter.GetElapsedTime();
+
+  counter.StartCounter();
+  results->topology = GenerateStiffnessMatrixTopology::Generate(tetMesh, numThreads);
+  counter.StopCounter();
+  double timeTopology = counter.GetElapsedTime();
+
+  printf("%7d %12.3f %12.3f %12.3f %12.3f %12.3f\n", numThreads, timeABCD, timeStVKStiffnessMatrix, 
+    timeIsotropicHyperelasticFEM, timeCorotationalLinearFEM, timeTopology);
+
+  for(int model=0; model<NUM_MODELS; model++)
+    results->forces[model] = (double*) malloc (sizeof(double) * r);
+
+  stVKStiffnessMatrix->GetStiffnessMatrixTopology(&results->stiffnessMatrix[0]);
+  stVKStiffnessMatrix->ComputeForceAndStiffnessMatrix(u, results->forces[0], results->stiffnessMatrix[0]);
+
+  isotropicHyperelasticFEM->GetStiffnessMatrixTopology(&results->stiffnessMatrix[1]);
+  isotropicHyperelasticFEM->GetForceAndTangentStiffnessMatrix(u, results->forces[1], results->stiffnessMatrix[1]);
+
+  corotationalLinearFEM->GetStiffnessMatrixTopology(&results->stiffnessMatrix[2]);
+  corotationalLinearFEM->ComputeForceAndStiffnessMatrix(u, results->forces[2], results->stiffnessMatrix[2]);
+
+  delete(corotationalLinearFEM);
+  delete(isotropicHyperelasticFEM);
+  delete(material);
+  delete(stVKStiffnessMatrix);
+  delete(stVKInternalForces);
+  delete(precomputedIntegrals);
+}
+
+static void FreeResults(SetupTimeBenchmark_results * results)
+{
+  for(int model=0; model<NUM_MODELS; model++)
+  {
+    free(results->forces[model]);
+    delete(results->stiffnessMatrix[model]);
+  }
+  delete(results->topology);
+}
+
+static bool SameTopology(SparseMatrix * A, SparseMatrix * B)
+{
+  if (A->GetNumRows() != B->GetNumRows())
+    return false;
+  for(int i=0; i<A->GetNumRows(); i++)
+  {
+    if (A->GetRowLength(i) != B->GetRowLength(i))
+      return false;
+    if (memcmp(A->GetColumnIndices()[i], B->GetColumnIndices()[i], sizeof(int) * A->GetRowLength(i)) != 0)
+      return false;
+  }
+  return true;
+}
+
+// checks that the results are bitwise identical to the reference results
+static int CompareResults(int r, SetupTimeBenchmark_results * reference, SetupTimeBenchmark_results * results, int numThreads)
+{
+  int code = 0;
+  for(int model=0; model<NUM_MODELS; model++)
+  {
+    bool identical = (memcmp(reference->forces[model], results->forces[model], sizeof(double) * r) == 0);
+    SparseMatrix * A = reference->stiffnessMatrix[model];
+    SparseMatrix * B = results->stiffnessMatrix[model];
+    identical = identical && SameTopology(A, B);
+    for(int i=0; identical && (i<A->GetNumRows()); i++)
+      identical = (memcmp(A->GetEntries()[i], B->GetEntries()[i], sizeof(double) * A->GetRowLength(i)) == 0);
+    if (!identical)
+    {
+      printf("Error: the %s forces or stiffness matrix with %d threads differ from those with one thread.\n", modelName[model], numThreads);
+      code = 1;
+    }
+  }
+
+  if (!SameTopology(reference->topology, results->topology))
+  {
+    printf("Error: the stiffness matrix topology with %d threads differs from that with one thread.\n", numThreads);
+    code = 1;
+  }
+
+  return code;
+}
+
+int main(int argc, char ** argv)
+{
+  int maxNumThreads = 4;
+  if (argc > 1)
+    maxNumThreads = atoi(argv[1]);
+
+  TetMesh * tetMesh;
+  if (argc > 2)
+    tetMesh = new TetMesh(argv[2]);
+  else
+    tetMesh = CreateBeam(32, 16, 16);
+  printf("Num vertices: %d, num elements: %d\n", tetMesh->getNumVertices(), tetMesh->getNumElements());
+
+  // a random deformation
+  int r = 3 * tetMesh->getNumVertices();
+  double * u = (double*) malloc (sizeof(double) * r);
+  srand(1);
+  for(int i=0; i<r; i++)
+    u[i] = 0.001 * (2.0 * rand() / RAND_MAX - 1.0);
+
+  printf("Construction times (sec):\n");
+  printf("%7s %12s %12s %12s %12s %12s\n", "threads", "StVK ABCD", "StVK K", "IsoHyperFEM", "CorotLinFEM", "topology");
+
+  SetupTimeBenchmark_results reference;
+  Run(tetMesh, 1, u, &reference);
+
+  int exitCode = 0;
+  for(int numThreads=2; numThreads<=maxNumThreads; numThreads*=2)
+  {
+    SetupTimeBenchmark_results results;
+    Run(tetMesh, numThreads, u, &results);
+    if (CompareResults(r, &reference, &results, numThreads) != 0)
+      exitCode = 1;
+    FreeResults(&results);
+  }
+
+  if (exitCode == 0)
+    printf("The results are identical for all the numbers of threads.\n");
+
+  FreeResults(&reference);
+  free(u);
+  delete(tetMesh);
+
+  return exitCode;
+}
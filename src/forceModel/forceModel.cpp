@@ -30,10 +30,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include "forceModel.h"
 
+ForceModel::ForceModel()
+{
+  linearizationU = NULL;
+  linearizationForces = NULL;
+  linearizationBuffer = NULL;
+}
+
 ForceModel::~ForceModel()
 {
+  free(linearizationU);
+  free(linearizationForces);
+  free(linearizationBuffer);
 }
 
 void ForceModel::GetForceAndMatrix(double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix)
@@ -42,6 +53,58 @@ void ForceModel::GetForceAndMatrix(double * u, double * internalForces, SparseMa
   GetTangentStiffnessMatrix(u, tangentStiffnessMatrix);
 }
 
+void ForceModel::GetForceAndLinearization(double * u, double * internalForces)
+{
+  if (linearizationU == NULL)
+  {
+    linearizationU = (double*) malloc (sizeof(double) * r);
+    linearizationForces = (double*) malloc (sizeof(double) * r);
+    linearizationBuffer = (double*) malloc (sizeof(double) * r);
+  }
+
+  GetInternalForce(u, internalForces);
+  memcpy(linearizationU, u, sizeof(double) * r);
+  memcpy(linearizationForces, internalForces, sizeof(double) * r);
+}
+
+// K(u) * v ~ (f(u + eps * v) - f(u)) / eps
+int ForceModel::MultiplyTangentStiffnessMatrix(double * v, double * Kv)
+{
+  if (linearizationU == NULL)
+  {
+    printf("Error: MultiplyTangentStiffnessMatrix called before GetForceAndLinearization.\n");
+    memset(Kv, 0, sizeof(double) * r);
+    return 1;
+  }
+
+  double uNorm2 = 0.0;
+  double vNorm2 = 0.0;
+  for(int i=0; i<r; i++)
+  {
+    uNorm2 += linearizationU[i] * linearizationU[i];
+    vNorm2 += v[i] * v[i];
+  }
+
+  if (vNorm2 == 0.0)
+  {
+    memset(Kv, 0, sizeof(double) * r);
+    return 0;
+  }
+
+  // balance the truncation and the round-off error
+  double eps = sqrt(DBL_EPSILON) * (1.0 + sqrt(uNorm2)) / sqrt(vNorm2);
+
+  for(int i=0; i<r; i++)
+    linearizationBuffer[i] = linearizationU[i] + eps * v[i];
+
+  GetInternalForce(linearizationBuffer, Kv);
+
+  for(int i=0; i<r; i++)
+    Kv[i] = (Kv[i] - linearizationForces[i]) / eps;
+
+  return 0;
+}
+
 void ForceModel::TestStiffnessMatrix(double * q, double * dq)
 {
   double * q1 = (double*) malloc (sizeof(double) * r);
@@ -40,6 +40,7 @@
 class ForceModel
 {
 public:
+  ForceModel();
   virtual ~ForceModel();
 
   inline int Getr() { return r; }
@@ -50,11 +51,38 @@ public:
 
   // sometimes computation time can be saved if we know that we will need both internal forces and tangent stiffness matrices:
   virtual void GetForceAndMatrix (double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix); 
+  // note: in the lagged-Jacobian mode, the implicit sparse integrators call GetForceAndMatrix only when the matrix is certain to be needed (the first Newton iteration of a timestep);
+  // in the subsequent iterations, they call GetInternalForce, and then (only if the iteration did not converge) GetTangentStiffnessMatrix at the same u
+
+  // matrix-free interface (used by integrators that never assemble the tangent stiffness matrix):
+  // computes the internal forces at u, and linearizes the internal forces at u
+  virtual void GetForceAndLinearization(double * u, double * internalForces);
+  // computes Kv = K(u) * v, where u is the configuration given to the last GetForceAndLinearization call
+  // the default implementation uses a forward finite difference of the internal forces (one internal force evaluation per product);
+  // force models can override it with an exact (and faster) product
+  // returns 0 on success, and non-zero on failure (e.g., GetForceAndLinearization was not called); Kv is then set to zero
+  virtual int MultiplyTangentStiffnessMatrix(double * v, double * Kv);
+  // computes the diagonal of K(u) (e.g., for preconditioning), u is as above
+  // returns 0 on success, and non-zero if the force model does not support this (default)
+  virtual int GetTangentStiffnessMatrixDiagonal(double *) { return 1; }
+
+  // computes the elastic (strain) energy at u (e.g., for line searches in energy-based integrators)
+  // returns 0 on success, and non-zero if the force model does not support this (default)
+  virtual int GetElasticEnergy(double *, double *) { return 1; }
 
   // reset routines
   virtual void ResetToZero() {}
   virtual void Reset(double * q) {}
 
+  // checkpointing of the internal (history-dependent) state of the force model, e.g., plastic strains, or rotations used to warm-start the next evaluation
+  // (see integrator/integratorCheckpoint.h); the default force model has no such state
+  // size of the state in bytes
+  virtual size_t GetStateSize() { return 0; }
+  // writes the state (GetStateSize() bytes) into the given buffer
+  virtual void SaveState(char *) {}
+  // restores the state from a buffer of "size" bytes; returns 0 on success, and non-zero if the data does not match this force model
+  virtual int LoadState(const char *, size_t size) { return (size == GetStateSize()) ? 0 : 1; }
+
   // test the stiffness matrix, using finite differences
   // q is the configuration to test, dq is a small delta
   // if the stiffness matrix is correct, f(q) - f(q + eps * dq) - eps * K(q) * dq should be O(eps^2)
@@ -62,6 +90,11 @@ public:
 
 protected:
   int r;
+
+  // buffers for the default (finite-difference) matrix-free product; allocated on demand
+  double * linearizationU;
+  double * linearizationForces;
+  double * linearizationBuffer;
 };
 
 #endif
@@ -0,0 +1,62 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "forceModelBase" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Abstract class for f in M q'' + D q' + f = f_ext, for dense reduced systems 
+  (e.g., model reduction, where q are the r reduced coordinates).
+  The dense counterpart of ForceModel; the tangent stiffness matrix is a dense r x r matrix, stored column-major.
+*/
+
+#ifndef _REDUCEDFORCEMODEL_H_
+#define _REDUCEDFORCEMODEL_H_
+
+#include <stdlib.h>
+
+class ReducedForceModel
+{
+public:
+  virtual ~ReducedForceModel();
+
+  inline int Getr() { return r; }
+
+  virtual void GetInternalForce(double * q, double * internalForces) = 0;
+  virtual void GetTangentStiffnessMatrix(double * q, double * tangentStiffnessMatrix) = 0; 
+
+  // sometimes computation time can be saved if we know that we will need both internal forces and tangent stiffness matrices:
+  virtual void GetForceAndMatrix(double * q, double * internalForces, double * tangentStiffnessMatrix); 
+
+  // computes the elastic (strain) energy at q
+  // returns 0 on success, and non-zero if the force model does not support this (default)
+  virtual int GetElasticEnergy(double *, double *) { return 1; }
+
+protected:
+  int r;
+};
+
+#endif
+
@@ -0,0 +1,238 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adaptiveTimestepController.h"
+
+AdaptiveTimestepController::AdaptiveTimestepController(ImplicitNewmarkSparse * integrator_, double relativeTolerance_, double absoluteTolerance_, double minTimestep_, double maxTimestep_) : integrator(integrator_), relativeTolerance(relativeTolerance_), absoluteTolerance(absoluteTolerance_), minTimestep(minTimestep_), maxTimestep(maxTimestep_)
+{
+  r = integrator->Getr();
+
+  safety = 0.9;
+  minShrink = 0.2;
+  maxGrowth = 2.0;
+  timestepChangeThreshold = 0.2;
+
+  qPrevious = (double*) malloc (sizeof(double) * r);
+  qvelPrevious = (double*) malloc (sizeof(double) * r);
+  qaccelPrevious = (double*) malloc (sizeof(double) * r);
+  error = (double*) malloc (sizeof(double) * r);
+
+  nextTimestep = integrator->GetTimeStep();
+  numAcceptedTimesteps = 0;
+  numRejectedTimesteps = 0;
+  ResetTime(0.0);
+}
+
+AdaptiveTimestepController::~AdaptiveTimestepController()
+{
+  free(qPrevious);
+  free(qvelPrevious);
+  free(qaccelPrevious);
+  free(error);
+}
+
+void AdaptiveTimestepController::SetTolerances(double relativeTolerance_, double absoluteTolerance_)
+{
+  relativeTolerance = relativeTolerance_;
+  absoluteTolerance = absoluteTolerance_;
+}
+
+void AdaptiveTimestepController::SetTimestepBounds(double minTimestep_, double maxTimestep_)
+{
+  minTimestep = minTimestep_;
+  maxTimestep = maxTimestep_;
+}
+
+void AdaptiveTimestepController::SetControllerParameters(double safety_, double minShrink_, double maxGrowth_, double timestepChangeThreshold_)
+{
+  safety = safety_;
+  minShrink = minShrink_;
+  maxGrowth = maxGrowth_;
+  timestepChangeThreshold = timestepChangeThreshold_;
+}
+
+void AdaptiveTimestepController::ResetTime(double time_)
+{
+  time = time_;
+  previousTime = time_;
+  lastError = 0.0;
+  integrator->GetqState(qPrevious, qvelPrevious, qaccelPrevious);
+}
+
+double AdaptiveTimestepController::ComputeError()
+{
+  integrator->GetLocalErrorEstimate(error);
+  double * q = integrator->Getq();
+
+  double sum = 0.0;
+  for(int i=0; i<r; i++)
+  {
+    double scale = absoluteTolerance + relativeTolerance * fmax(fabs(qPrevious[i]), fabs(q[i]));
+    double ratio = error[i] / scale;
+    sum += ratio * ratio;
+  }
+
+  return sqrt(sum / r);
+}
+
+int AdaptiveTimestepController::DoTimestep()
+{
+  // exponent of the error in the timestep update
+  double exponent = -1.0 / (integrator->GetErrorOrder() + 1);
+
+  // the state at the beginning of the timestep (restored if the timestep is rejected)
+  integrator->GetqState(qPrevious, qvelPrevious, qaccelPrevious);
+
+  while (1)
+  {
+    double timestep = nextTimestep;
+    if ((maxTimestep > 0) && (timestep > maxTimestep))
+      timestep = maxTimestep;
+    if (timestep < minTimestep)
+      timestep = minTimestep;
+
+    // small increases are not applied, to keep the (lagged) system matrix valid
+    double currentTimestep = integrator->GetTimeStep();
+    if ((timestep < currentTimestep) || (timestep > (1.0 + timestepChangeThreshold) * currentTimestep))
+      integrator->SetTimestep(timestep);
+    else
+      timestep = currentTimestep;
+
+    int code = integrator->DoTimestep();
+
+    double err = 0.0;
+    double factor;
+    if (code != 0)
+      factor = 0.5;
+    else
+    {
+      err = ComputeError();
+      factor = (err > 0) ? safety * pow(err, exponent) : maxGrowth;
+      if (factor > maxGrowth)
+        factor = maxGrowth;
+      if (factor < minShrink)
+        factor = minShrink;
+    }
+
+    if ((code == 0) && (err <= 1.0))
+    {
+      // accept the timestep
+      previousTime = time;
+      time += timestep;
+      lastError = err;
+      numAcceptedTimesteps++;
+
+      nextTimestep = timestep * factor;
+      return 0;
+    }
+
+    // reject the timestep
+    numRejectedTimesteps++;
+    integrator->SetqState(qPrevious, qvelPrevious, qaccelPrevious);
+
+    if (timestep <= minTimestep)
+    {
+      if (code != 0)
+        printf("Error: timestep failed at the minimum timestep %G (time %G).\n", timestep, time);
+      else
+        printf("Error: local error %G exceeds the tolerance at the minimum timestep %G (time %G).\n", err, timestep, time);
+      previousTime = time;
+      return 1;
+    }
+
+    nextTimestep = timestep * factor;
+  }
+}
+
+void AdaptiveTimestepController::Interpolate(double t, double * qOutput, double * qvelOutput)
+{
+  double * q = integrator->Getq();
+  double * qvel = integrator->Getqvel();
+
+  double h = time - previousTime;
+  if (h <= 0)
+  {
+    if (qOutput != NULL)
+      memcpy(qOutput, q, sizeof(double) * r);
+    if (qvelOutput != NULL)
+      memcpy(qvelOutput, qvel, sizeof(double) * r);
+    return;
+  }
+
+  double s = (t - previousTime) / h;
+  if (s < 0.0)
+    s = 0.0;
+  if (s > 1.0)
+    s = 1.0;
+
+  // cubic Hermite basis functions, and their derivatives
+  double s2 = s * s;
+  double s3 = s2 * s;
+  double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+  double h10 = s3 - 2.0 * s2 + s;
+  double h01 = -2.0 * s3 + 3.0 * s2;
+  double h11 = s3 - s2;
+
+  if (qOutput != NULL)
+  {
+    for(int i=0; i<r; i++)
+      qOutput[i] = h00 * qPrevious[i] + h * h10 * qvelPrevious[i] + h01 * q[i] + h * h11 * qvel[i];
+  }
+
+  if (qvelOutput != NULL)
+  {
+    double d00 = (6.0 * s2 - 6.0 * s) / h;
+    double d10 = 3.0 * s2 - 4.0 * s + 1.0;
+    double d11 = 3.0 * s2 - 2.0 * s;
+    for(int i=0; i<r; i++)
+      qvelOutput[i] = d00 * (qPrevious[i] - q[i]) + d10 * qvelPrevious[i] + d11 * qvel[i];
+  }
+}
+
+int AdaptiveTimestepController::AdvanceTo(double t, double * qOutput, double * qvelOutput)
+{
+  if (t < previousTime)
+    printf("Warning: requested time %G precedes the last timestep (time %G). Returning the earliest available state.\n", t, previousTime);
+
+  // timestep until the requested time falls inside the last timestep
+  while (t - time > 1E-9 * nextTimestep)
+  {
+    if (DoTimestep() != 0)
+    {
+      Interpolate(time, qOutput, qvelOutput);
+      return 1;
+    }
+  }
+
+  Interpolate(t, qOutput, qvelOutput);
+  return 0;
+}
+
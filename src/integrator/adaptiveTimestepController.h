@@ -0,0 +1,122 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Adaptive timestepping for ImplicitNewmarkSparse and ImplicitBackwardEulerSparse.
+
+  The controller advances the integrator with a variable timestep. After each timestep, 
+  the local error in q is estimated by the integrator (see GetLocalErrorEstimate), and 
+  measured in the weighted RMS norm
+
+    err = sqrt( 1/r sum_i ( e_i / (absoluteTolerance + relativeTolerance * max(|q_n,i|, |q_n+1,i|)) )^2 ).
+
+  The timestep is accepted if err <= 1, and rejected (the state is restored, and the 
+  timestep repeated with a smaller timestep) otherwise. In both cases, the next timestep is
+
+    timestep * min(maxGrowth, max(minShrink, safety * err^{-1/(p+1)})),
+
+  where p is the order of the integrator. A timestep is also rejected (and the timestep halved)
+  if the integrator fails (e.g., the linear solver does not converge, or the system matrix
+  is not positive-definite with the positive-definite solver).
+
+  Output at fixed frame times is obtained by interpolation: the timesteps are not shortened 
+  to land on the frame times; instead, the state at a frame time is computed with cubic 
+  Hermite interpolation (of q and qvel) inside the timestep that contains the frame time.
+  Consequently, the integrator's own state may be slightly ahead of the last requested frame time.
+
+  External forces and constraints are set on the integrator in between the calls to AdvanceTo;
+  they are held constant during the timesteps performed in AdvanceTo.
+  Note: changing the timestep invalidates the lagged Jacobian (if used); the timestep is 
+  therefore only increased when the relative increase exceeds "timestepChangeThreshold" (decreases are always applied).
+*/
+
+#ifndef _ADAPTIVETIMESTEPCONTROLLER_H_
+#define _ADAPTIVETIMESTEPCONTROLLER_H_
+
+#include "implicitNewmarkSparse.h"
+
+class AdaptiveTimestepController
+{
+public:
+  // the integrator's current timestep is used as the initial timestep
+  // minTimestep: if a timestep fails at the minimum timestep, AdvanceTo returns failure
+  // maxTimestep: upper bound on the timestep (maxTimestep <= 0 means no bound)
+  // the integrator is not deleted in the destructor
+  AdaptiveTimestepController(ImplicitNewmarkSparse * integrator, double relativeTolerance=1E-3, double absoluteTolerance=1E-6, double minTimestep=1E-8, double maxTimestep=0.0);
+  virtual ~AdaptiveTimestepController();
+
+  // advances the simulation to time t (which must be >= the time of the previous call)
+  // the state at time t is written into qOutput and qvelOutput (vectors of length r; either may be NULL)
+  // returns 0 on success, and 1 if a timestep failed at the minimum timestep (the integrator is then left at the last accepted state)
+  int AdvanceTo(double t, double * qOutput, double * qvelOutput=NULL);
+
+  // performs one accepted timestep (repeating it with smaller timesteps, if necessary)
+  // returns 0 on success, and 1 on failure
+  int DoTimestep();
+
+  // the time of the integrator's state
+  inline double GetTime() { return time; }
+  // the timestep that will be attempted next
+  inline double GetTimestep() { return nextTimestep; }
+  inline void SetTimestep(double timestep) { nextTimestep = timestep; }
+  // the weighted error (see above) of the last accepted timestep
+  inline double GetLastError() { return lastError; }
+
+  inline int GetNumAcceptedTimesteps() { return numAcceptedTimesteps; }
+  inline int GetNumRejectedTimesteps() { return numRejectedTimesteps; }
+
+  void SetTolerances(double relativeTolerance, double absoluteTolerance);
+  void SetTimestepBounds(double minTimestep, double maxTimestep);
+  // defaults: safety=0.9, minShrink=0.2, maxGrowth=2.0, timestepChangeThreshold=0.2 
+  void SetControllerParameters(double safety, double minShrink, double maxGrowth, double timestepChangeThreshold);
+
+  // call this after changing the integrator's state externally (e.g., SetState or ResetToRest); resets the time to "time" 
+  void ResetTime(double time=0.0);
+
+protected:
+  ImplicitNewmarkSparse * integrator;
+  int r;
+  double relativeTolerance, absoluteTolerance;
+  double minTimestep, maxTimestep;
+  double safety, minShrink, maxGrowth, timestepChangeThreshold;
+
+  double time, previousTime;
+  double nextTimestep;
+  double lastError;
+  int numAcceptedTimesteps, numRejectedTimesteps;
+
+  // state at the beginning of the last accepted timestep (at previousTime)
+  double * qPrevious, * qvelPrevious, * qaccelPrevious;
+  double * error;
+
+  double ComputeError();
+  void Interpolate(double t, double * qOutput, double * qvelOutput);
+};
+
+#endif
+
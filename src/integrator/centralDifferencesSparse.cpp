@@ -40,6 +40,37 @@ CentralDifferencesSparse::CentralDifferencesSparse(int numDOFs, double timestep,
   rhs = (double*) malloc (sizeof(double) * r);
   rhsConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
 
+  // with a diagonal mass matrix and no stiffness damping, the system matrix is diagonal, and no solver is needed
+  inverseLumpedMass = NULL;
+  if (massMatrix->IsDiagonal() && (dampingStiffnessCoef == 0.0))
+  {
+    printf("Central differences: the mass matrix is diagonal. Using the lumped-mass update (no linear system solves).\n");
+    inverseLumpedMass = (double*) malloc (sizeof(double) * r);
+    massMatrix->GetDiagonal(inverseLumpedMass);
+    for(int i=0; i<r; i++)
+      inverseLumpedMass[i] = (inverseLumpedMass[i] > 0) ? 1.0 / inverseLumpedMass[i] : 0.0;
+    for(int i=0; i<numConstrainedDOFs; i++)
+      inverseLumpedMass[constrainedDOFs[i]] = 0.0;
+
+    tangentStiffnessMatrix = NULL;
+    rayleighDampingMatrix = NULL;
+    systemMatrix = NULL;
+
+    #ifdef PARDISO
+      pardisoSolver = NULL;
+    #endif
+
+    #ifdef SPOOLES
+      spoolesSolver = NULL;
+    #endif
+
+    #ifdef PCG
+      jacobiPreconditionedCGSolver = NULL;
+    #endif
+
+    return;
+  }
+
   forceModel->GetTangentStiffnessMatrixTopology(&tangentStiffnessMatrix);
   rayleighDampingMatrix = new SparseMatrix(*tangentStiffnessMatrix);
   rayleighDampingMatrix->BuildSubMatrixIndices(*massMatrix);
@@ -93,13 +124,18 @@ CentralDifferencesSparse::~CentralDifferencesSparse()
   delete(rayleighDampingMatrix);
   free(rhs);
   free(rhsConstrained);
+  free(inverseLumpedMass);
 }
 
 void CentralDifferencesSparse::DecomposeSystemMatrix()
 {
+  if (inverseLumpedMass != NULL)
+    return;
+
   //printf("*** Central differences: decomposing the system matrix.\n");
   // construct damping matrix
   // rayleigh damping matrix = dampingMasscoef * massMatrix + dampingStiffnessCoef * stiffness matrix
+  PerformanceCounter counterSystemMatrixTime;
   forceModel->GetTangentStiffnessMatrix(q, tangentStiffnessMatrix);
   tangentStiffnessMatrix->ScalarMultiply(internalForceScalingFactor);
 
@@ -109,10 +145,19 @@ void CentralDifferencesSparse::DecomposeSystemMatrix()
   // system matrix = mass matrix + 0.5 * timestep * damping matrix (and remove constrained rows and columns)
   rayleighDampingMatrix->ScalarMultiply(0.5 * timestep, tangentStiffnessMatrix);
   tangentStiffnessMatrix->AddSubMatrix(1.0, *massMatrix);
+  counterSystemMatrixTime.StopCounter();
+  statistics.systemMatrixTime += counterSystemMatrixTime.GetElapsedTime();
+
+  FactorSystemMatrix();
+}
+
+void CentralDifferencesSparse::FactorSystemMatrix()
+{
   systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
 
   //systemMatrix->SaveToMatlabFormat("system.mat");
   
+  PerformanceCounter counterFactorizationTime;
   #ifdef PARDISO
     int info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
     if (info != 0)
@@ -130,17 +175,43 @@ void CentralDifferencesSparse::DecomposeSystemMatrix()
       spoolesSolver = new SPOOLESSolverMT(systemMatrix, numSolverThreads);
     else
       spoolesSolver = new SPOOLESSolver(systemMatrix);
+    statistics.numAllocations++;
+  #endif
+
+  #ifdef PCG
+    // keep the Jacobi preconditioner in sync with the system matrix (this also makes it part of the checkpointed state)
+    systemMatrix->GetDiagonal(rhsConstrained);
+    jacobiPreconditionedCGSolver->SetDiagonal(rhsConstrained);
+  #endif
+  counterFactorizationTime.StopCounter();
+
+  #if defined(PARDISO) || defined(SPOOLES)
+    statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+    statistics.numFactorizations++;
   #endif
 }
 
 int CentralDifferencesSparse::DoTimestep()
 {
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
     PerformanceCounter counterForceAssemblyTime;
     forceModel->GetInternalForce(q, internalForces);
     for (int i=0; i<r; i++)
       internalForces[i] *= internalForceScalingFactor;
   counterForceAssemblyTime.StopCounter();
   forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+  statistics.forceAssemblyTime += forceAssemblyTime;
+
+  if (inverseLumpedMass != NULL)
+  {
+    LumpedMassUpdate();
+    timestepIndex++;
+    counterTimestep.StopCounter();
+    statistics.EndTimestep(counterTimestep.GetElapsedTime());
+    return 0;
+  }
 
   if (tangentialDampingMode > 0)
     if (timestepIndex % tangentialDampingMode == 0)
@@ -193,6 +264,8 @@ int CentralDifferencesSparse::DoTimestep()
   
   #ifdef PCG
     int info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, rhsConstrained, 1e-6, 10000);
+    statistics.numSolverIterations = abs(info);
+    statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
     if (info > 0)
       info = 0;
     char solverString[16] = "PCG";
@@ -202,10 +275,15 @@ int CentralDifferencesSparse::DoTimestep()
 
   counterSystemSolveTime.StopCounter();
   systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+  statistics.solveTime += systemSolveTime;
+  statistics.numNewtonIterations = 1;
+  statistics.systemMatrixNNZ = systemMatrix->GetNumEntries();
 
   if (info != 0)
   {
     printf("Error: %s sparse solver returned non-zero exit status %d.\n", solverString, (int)info);
+    counterTimestep.StopCounter();
+    statistics.EndTimestep(counterTimestep.GetElapsedTime());
     return 1;
   }
 
@@ -223,9 +301,36 @@ int CentralDifferencesSparse::DoTimestep()
 
   timestepIndex++;
 
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
   return 0;
 }
 
+void CentralDifferencesSparse::LumpedMassUpdate()
+{
+  // the update equation of DoTimestep, with M diagonal and C = dampingMassCoef * M:
+  // (1 + dt / 2 * dampingMassCoef) * (q(t+1) - q(t)) = (1 - dt / 2 * dampingMassCoef) * (q(t) - q(t-1)) + (dt)^2 * M^{-1} * (fext(t) - fint(q(t)))
+  double timestep2 = timestep * timestep;
+  double previousDeltaFactor = 1.0 - 0.5 * timestep * dampingMassCoef;
+  double systemFactor = 1.0 / (1.0 + 0.5 * timestep * dampingMassCoef);
+  double inverseTimestep = 1.0 / timestep;
+
+  for (int i=0; i<r; i++)
+  {
+    double delta = systemFactor * (previousDeltaFactor * (q[i] - q_1[i]) + timestep2 * inverseLumpedMass[i] * (externalForces[i] - internalForces[i]));
+    q_1[i] = q[i];
+    qvel[i] = delta * inverseTimestep;
+    qaccel[i] = (qvel[i] - qvel_1[i]) * inverseTimestep;
+    qvel_1[i] = qvel[i];
+    qaccel_1[i] = qaccel[i];
+    q[i] += delta;
+  }
+
+  statistics.numNewtonIterations = 1;
+  statistics.systemMatrixNNZ = 0;
+}
+
 // sets the state based on given q, qvel
 // automatically computes acceleration assuming zero external force
 int CentralDifferencesSparse::SetState(double * q_, double * qvel_)
@@ -250,6 +355,56 @@ void CentralDifferencesSparse::SetInternalForceScalingFactor(double internalForc
   DecomposeSystemMatrix();
 }
 
+// state layout: IntegratorBaseSparse state, timestepIndex, and (unless in the lumped mode) the entries of
+// tangentStiffnessMatrix (which holds the system matrix M + dt / 2 * D) and rayleighDampingMatrix
+size_t CentralDifferencesSparse::GetStateSize()
+{
+  size_t size = IntegratorBaseSparse::GetStateSize() + sizeof(int);
+  if (inverseLumpedMass == NULL)
+    size += GetMatrixStateSize(tangentStiffnessMatrix) + GetMatrixStateSize(rayleighDampingMatrix);
+  return size;
+}
+
+void CentralDifferencesSparse::SaveState(char * data)
+{
+  IntegratorBaseSparse::SaveState(data);
+  data += IntegratorBaseSparse::GetStateSize();
+
+  data = SaveData(data, &timestepIndex, sizeof(int));
+  if (inverseLumpedMass == NULL)
+  {
+    data = SaveMatrixEntries(data, tangentStiffnessMatrix);
+    data = SaveMatrixEntries(data, rayleighDampingMatrix);
+  }
+}
+
+int CentralDifferencesSparse::LoadState(const char * data, size_t size)
+{
+  if (size < CentralDifferencesSparse::GetStateSize())
+  {
+    printf("Error: integrator state is too short (%d bytes).\n", (int)size);
+    return 1;
+  }
+
+  if (IntegratorBaseSparse::LoadState(data, size) != 0)
+    return 1;
+  data += IntegratorBaseSparse::GetStateSize();
+
+  data = LoadData(data, &timestepIndex, sizeof(int));
+  if (inverseLumpedMass == NULL)
+  {
+    // restore the system matrix from the time of its last decomposition (with tangential damping, it depends on an earlier q), and refactor it
+    data = LoadMatrixEntries(data, tangentStiffnessMatrix);
+    if (data != NULL)
+      data = LoadMatrixEntries(data, rayleighDampingMatrix);
+    if (data == NULL)
+      return 1;
+    FactorSystemMatrix();
+  }
+
+  return 0;
+}
+
 void CentralDifferencesSparse::ResetToRest()
 {
   IntegratorBaseSparse::ResetToRest();
@@ -56,6 +56,13 @@ In order to use this class, you need to set the timestep very small, or
 else the explicit integrator will go unstable. Roughly speaking, the timestep 
 must resolve the highest frequency present in your simulation. 
 
+Lumped mass: if the mass matrix is diagonal (e.g., GenerateMassMatrix::computeMassMatrix
+with lumped=true, or a mass-spring system mass matrix) and dampingStiffnessCoef is zero, 
+the system matrix (M + dt / 2 * dampingMassCoef * M) is diagonal, and the timestep is performed 
+as a single per-DOF update, without any matrix assembly or linear system solve. This makes
+many small timesteps (substeps) per frame cheap. In this mode, dampingStiffnessCoef and 
+tangentialDampingMode are ignored (stiffness damping would make the system matrix non-diagonal).
+
 See also integratorBase.h .
 
 */
@@ -102,6 +109,14 @@ public:
 
   virtual void ResetToRest();
 
+  // returns 1 if the lumped-mass (solver-free) update is in use, and 0 otherwise
+  inline int UsesLumpedMass() { return (inverseLumpedMass != NULL); }
+
+  // checkpointing (see integratorBase.h); the state also includes the timestep counter of the tangential damping updates, and the system matrix
+  virtual size_t GetStateSize();
+  virtual void SaveState(char * data);
+  virtual int LoadState(const char * data, size_t size);
+
 protected:
   double * rhs;
   double * rhsConstrained;
@@ -111,8 +126,11 @@ protected:
   int tangentialDampingMode;
   int numSolverThreads;
   int timestepIndex;
+  double * inverseLumpedMass; // inverse of the diagonal of the mass matrix (lumped mode only; NULL otherwise)
 
   void DecomposeSystemMatrix();
+  void FactorSystemMatrix(); // copies tangentStiffnessMatrix (the system matrix) into systemMatrix, and factors it
+  void LumpedMassUpdate(); // the timestep update in the lumped mode
 
   #ifdef PARDISO
     PardisoSolver * pardisoSolver;
@@ -36,6 +36,31 @@
 
 EulerSparse::EulerSparse(int r, double timestep, SparseMatrix * massMatrix_, ForceModel * forceModel_, int symplectic_, int numConstrainedDOFs_, int * constrainedDOFs_, double dampingMassCoef): IntegratorBaseSparse(r, timestep, massMatrix_, forceModel_, numConstrainedDOFs_, constrainedDOFs_, dampingMassCoef, 0.0), symplectic(symplectic_)
 {
+  // with a diagonal mass matrix, no solver is needed
+  inverseLumpedMass = NULL;
+  if (massMatrix->IsDiagonal())
+  {
+    printf("Euler: the mass matrix is diagonal. Using the lumped-mass update (no linear system solves).\n");
+    inverseLumpedMass = (double*) malloc (sizeof(double) * r);
+    massMatrix->GetDiagonal(inverseLumpedMass);
+    for(int i=0; i<r; i++)
+      inverseLumpedMass[i] = (inverseLumpedMass[i] > 0) ? 1.0 / inverseLumpedMass[i] : 0.0;
+
+    #ifdef PARDISO
+      pardisoSolver = NULL;
+    #endif
+
+    #ifdef SPOOLES
+      spoolesSolver = NULL;
+    #endif
+
+    #ifdef PCG
+      jacobiPreconditionedCGSolver = NULL;
+    #endif
+
+    return;
+  }
+
   #ifdef PARDISO
     printf("Creating Pardiso solver for M.\n");
     int positiveDefiniteSolver = 1;
@@ -75,6 +100,8 @@ EulerSparse::~EulerSparse()
   #ifdef PCG
     delete(jacobiPreconditionedCGSolver);
   #endif
+
+  free(inverseLumpedMass);
 }
 
 // sets the state based on given q, qvel
@@ -94,6 +121,9 @@ int EulerSparse::DoTimestep()
   // v_{n+1} = v_n + h * (F_n / m)
   // x_{n+1} = x_n + h * v_{n+1}
 
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
   // store current state
   for(int i=0; i<r; i++)
   {
@@ -106,6 +136,15 @@ int EulerSparse::DoTimestep()
   forceModel->GetInternalForce(q, internalForces);
   counterForceAssemblyTime.StopCounter();
   forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+  statistics.forceAssemblyTime += forceAssemblyTime;
+
+  if (inverseLumpedMass != NULL)
+  {
+    LumpedMassUpdate();
+    counterTimestep.StopCounter();
+    statistics.EndTimestep(counterTimestep.GetElapsedTime());
+    return 0;
+  }
 
   // scale internal forces
   for(int i=0; i<r; i++)
@@ -146,6 +185,8 @@ int EulerSparse::DoTimestep()
 
   #ifdef PCG
     int info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(qdelta, qresidual, 1e-6, 10000);
+    statistics.numSolverIterations = abs(info);
+    statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
     if (info > 0)
       info = 0;
     char solverString[16] = "PCG";
@@ -154,11 +195,16 @@ int EulerSparse::DoTimestep()
   if (info != 0)
   {
     printf("Error: %s sparse solver returned non-zero exit status %d.\n", solverString, (int)info);
+    counterTimestep.StopCounter();
+    statistics.EndTimestep(counterTimestep.GetElapsedTime());
     return 1;
   }
 
   counterSystemSolveTime.StopCounter();
   systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+  statistics.solveTime += systemSolveTime;
+  statistics.numNewtonIterations = 1;
+  statistics.systemMatrixNNZ = massMatrix->GetNumEntries();
 
   // update state
   if (symplectic)
@@ -185,6 +231,39 @@ int EulerSparse::DoTimestep()
   for(int i=0; i<numConstrainedDOFs; i++)
     q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
 
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
   return 0;
 }
 
+void EulerSparse::LumpedMassUpdate()
+{
+  // damping forces (other than the mass damping, which is diagonal)
+  double * dampingForces = buffer;
+  dampingMatrix->MultiplyVector(qvel, dampingForces);
+
+  for(int i=0; i<r; i++)
+  {
+    // qaccel = F_n / m (the mass damping force dampingMassCoef * m * qvel contributes dampingMassCoef * qvel)
+    qaccel[i] = inverseLumpedMass[i] * (externalForces[i] - internalForceScalingFactor * internalForces[i] - dampingForces[i]) - dampingMassCoef * qvel[i];
+
+    if (symplectic)
+    {
+      qvel[i] += timestep * qaccel[i];
+      q[i] += timestep * qvel[i];
+    }
+    else
+    {
+      q[i] += timestep * qvel[i];
+      qvel[i] += timestep * qaccel[i];
+    }
+  }
+
+  // constrain fixed DOFs
+  for(int i=0; i<numConstrainedDOFs; i++)
+    q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+  statistics.numNewtonIterations = 1;
+  statistics.systemMatrixNNZ = 0;
+}
@@ -36,6 +36,10 @@
   symplectic Euler
   v_{n+1} = v_n + h * (F_n / m)
   x_{n+1} = x_n + h * v_{n+1}
+
+  If the mass matrix is diagonal (e.g., GenerateMassMatrix::computeMassMatrix with lumped=true, 
+  or a mass-spring system mass matrix), F_n / m is computed directly, and the timestep requires 
+  no linear system solve (no solver is created).
 */
 
 #ifndef _EULERSPARSE_H_
@@ -72,8 +76,13 @@ public:
 
   virtual int DoTimestep(); 
 
+  // returns 1 if the lumped-mass (solver-free) update is in use, and 0 otherwise
+  inline int UsesLumpedMass() { return (inverseLumpedMass != NULL); }
+
 protected:
   int symplectic;
+  double * inverseLumpedMass; // inverse of the diagonal of the mass matrix (lumped mode only; NULL otherwise)
+  void LumpedMassUpdate(); // the timestep update in the lumped mode
   
   #ifdef PARDISO
     PardisoSolver * pardisoSolver;
@@ -0,0 +1,312 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "performanceCounter/performanceCounter.h"
+#include "insertRows/insertRows.h"
+#include "integrator/implicitBackwardEulerMatrixFree.h"
+
+ImplicitBackwardEulerMatrixFree::ImplicitBackwardEulerMatrixFree(int r, double timestep, SparseMatrix * massMatrix_, ForceModel * forceModel_, int numConstrainedDOFs_, int * constrainedDOFs_, double dampingMassCoef, double dampingStiffnessCoef, int maxIterations_, double epsilon_, double solverEpsilon_, int solverMaxIterations_): IntegratorBaseSparse(r, timestep, massMatrix_, forceModel_, numConstrainedDOFs_, constrainedDOFs_, dampingMassCoef, dampingStiffnessCoef), epsilon(epsilon_), maxIterations(maxIterations_), solverEpsilon(solverEpsilon_), solverMaxIterations(solverMaxIterations_)
+{
+  useStaticSolver = false;
+  numSolverIterations = 0;
+  productError = 0;
+
+  bufferConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
+  productBuffer = (double*) malloc (sizeof(double) * r);
+  productBufferConstrained = (double*) malloc (sizeof(double) * r);
+  systemMatrixDiagonal = (double*) malloc (sizeof(double) * r);
+
+  massMatrixDiagonal = (double*) calloc (r, sizeof(double));
+  massMatrix->GetDiagonal(massMatrixDiagonal);
+  dampingMatrixDiagonal = (double*) calloc (r, sizeof(double)); // the default damping matrix is empty
+
+  cgSolver = new CGSolver(r - numConstrainedDOFs, ImplicitBackwardEulerMatrixFree::SystemMatrixProduct, (void*)this);
+}
+
+ImplicitBackwardEulerMatrixFree::~ImplicitBackwardEulerMatrixFree()
+{
+  delete(cgSolver);
+  free(bufferConstrained);
+  free(productBuffer);
+  free(productBufferConstrained);
+  free(massMatrixDiagonal);
+  free(dampingMatrixDiagonal);
+  free(systemMatrixDiagonal);
+}
+
+void ImplicitBackwardEulerMatrixFree::SetDampingMatrix(SparseMatrix * dampingMatrix)
+{
+  IntegratorBaseSparse::SetDampingMatrix(dampingMatrix);
+  memset(dampingMatrixDiagonal, 0, sizeof(double) * r);
+  dampingMatrix->GetDiagonal(dampingMatrixDiagonal);
+}
+
+void ImplicitBackwardEulerMatrixFree::UseStaticSolver(bool useStaticSolver_)
+{ 
+  useStaticSolver = useStaticSolver_;
+
+  if (!useStaticSolver) 
+  {
+    memset(qvel, 0, sizeof(double) * r);
+    memset(qaccel, 0, sizeof(double) * r);
+    memset(qvel_1, 0, sizeof(double) * r);
+    memset(qaccel_1, 0, sizeof(double) * r);
+    memcpy(q_1, q, sizeof(double) * r);
+  }
+}
+
+// sets the state based on given q, qvel
+int ImplicitBackwardEulerMatrixFree::SetState(double * q_, double * qvel_)
+{
+  memcpy(q, q_, sizeof(double)*r);
+
+  if (qvel_ != NULL)
+    memcpy(qvel, qvel_, sizeof(double)*r);
+
+  return 0;
+}
+
+void ImplicitBackwardEulerMatrixFree::SystemMatrixProduct(const void * data, const double * x, double * Ax)
+{
+  ImplicitBackwardEulerMatrixFree * integrator = (ImplicitBackwardEulerMatrixFree*) data;
+  integrator->MultiplySystemMatrix(x, Ax);
+}
+
+// Ax = (systemMassCoef * M + systemStiffnessCoef * K + systemDampingCoef * D) * x, restricted to the unconstrained DOFs
+void ImplicitBackwardEulerMatrixFree::MultiplySystemMatrix(const double * x, double * Ax)
+{
+  InsertRows(r, (double*)x, productBuffer, numConstrainedDOFs, constrainedDOFs);
+
+  if (forceModel->MultiplyTangentStiffnessMatrix(productBuffer, productBufferConstrained) != 0)
+    productError = 1;
+  for(int i=0; i<r; i++)
+    productBufferConstrained[i] *= systemStiffnessCoef;
+
+  if (systemMassCoef != 0.0)
+  {
+    massMatrix->MultiplyVector(productBuffer, buffer);
+    for(int i=0; i<r; i++)
+      productBufferConstrained[i] += systemMassCoef * buffer[i];
+  }
+
+  if (systemDampingCoef != 0.0)
+  {
+    dampingMatrix->MultiplyVector(productBuffer, buffer);
+    for(int i=0; i<r; i++)
+      productBufferConstrained[i] += systemDampingCoef * buffer[i];
+  }
+
+  RemoveRows(r, Ax, productBufferConstrained, numConstrainedDOFs, constrainedDOFs);
+}
+
+int ImplicitBackwardEulerMatrixFree::DoTimestep()
+{
+  int numIter = 0;
+  numSolverIterations = 0;
+
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
+  double error0 = 0; // error after the first step
+  double errorQuotient;
+
+  // store current amplitudes and set initial guesses for qaccel, qvel
+  for(int i=0; i<r; i++)
+  {
+    qaccel_1[i] = qaccel[i] = 0;
+    q_1[i] = q[i]; 
+    qvel_1[i] = qvel[i];
+  }
+
+  do
+  {
+    int i;
+
+    PerformanceCounter counterForceAssemblyTime;
+    forceModel->GetForceAndLinearization(q, internalForces);
+    counterForceAssemblyTime.StopCounter();
+    forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+    statistics.forceAssemblyTime += forceAssemblyTime;
+
+    // scale internal forces
+    for(i=0; i<r; i++)
+      internalForces[i] *= internalForceScalingFactor;
+
+    if (useStaticSolver)
+    {
+      // fint + K * qdelta = fext
+      systemMassCoef = 0.0;
+      systemStiffnessCoef = internalForceScalingFactor;
+      systemDampingCoef = 0.0;
+
+      for(i=0; i<r; i++)
+      {
+        qresidual[i] = externalForces[i] - internalForces[i];
+        qdelta[i] = qresidual[i];
+      }
+    }
+    else
+    {
+      // effective stiffness: 
+      // Keff = M + h * (dampingMassCoef * M + dampingStiffnessCoef * K + D) + h^2 * K
+      systemMassCoef = 1.0 + timestep * dampingMassCoef;
+      systemStiffnessCoef = (timestep * timestep + timestep * dampingStiffnessCoef) * internalForceScalingFactor;
+      systemDampingCoef = timestep;
+
+      // force residual:
+      // qresidual = h * (-D qdot - fint + fext - h * K * qdot))
+      // where D is the total damping, and K * qdot is computed matrix-free
+      if (forceModel->MultiplyTangentStiffnessMatrix(qvel, qresidual) != 0)
+      {
+        printf("Error: the force model failed to multiply with the tangent stiffness matrix.\n");
+        counterTimestep.StopCounter();
+        statistics.EndTimestep(counterTimestep.GetElapsedTime());
+        return 1;
+      }
+      massMatrix->MultiplyVector(qvel, buffer);
+      for(i=0; i<r; i++)
+        qresidual[i] = (timestep + dampingStiffnessCoef) * internalForceScalingFactor * qresidual[i] + dampingMassCoef * buffer[i];
+      dampingMatrix->MultiplyVectorAdd(qvel, qresidual);
+
+      for(i=0; i<r; i++)
+      {
+        qresidual[i] += internalForces[i] - externalForces[i];
+        qresidual[i] *= -timestep;
+        qdelta[i] = qresidual[i];
+      }
+    }
+
+    double error = 0;
+    for(i=0; i<r; i++)
+      error += qresidual[i] * qresidual[i];
+    statistics.AddResidualNorm(sqrt(error));
+
+    // on the first iteration, compute initial error
+    if (numIter == 0) 
+    {
+      error0 = error;
+      errorQuotient = 1.0;
+    }
+    else
+    {
+      // error divided by the initial error, before performing this iteration
+      errorQuotient = error / error0; 
+    }
+
+    if (errorQuotient < epsilon * epsilon)
+      break;
+
+    RemoveRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
+
+    // Jacobi preconditioner (only if the force model provides the diagonal of K)
+    bool useJacobiPreconditioner = (forceModel->GetTangentStiffnessMatrixDiagonal(productBuffer) == 0);
+    if (useJacobiPreconditioner)
+    {
+      for(i=0; i<r; i++)
+        productBuffer[i] = systemStiffnessCoef * productBuffer[i] + systemMassCoef * massMatrixDiagonal[i] + systemDampingCoef * dampingMatrixDiagonal[i];
+      RemoveRows(r, systemMatrixDiagonal, productBuffer, numConstrainedDOFs, constrainedDOFs);
+      cgSolver->SetDiagonal(systemMatrixDiagonal);
+    }
+
+    // solve: systemMatrix * qdelta = bufferConstrained
+    // (the product routine uses "buffer" as scratch space; therefore, the solution is stored into qdelta)
+
+    PerformanceCounter counterSystemSolveTime;
+    memset(qdelta, 0, sizeof(double) * r);
+
+    int info;
+    productError = 0;
+    if (useJacobiPreconditioner)
+      info = cgSolver->SolveLinearSystemWithJacobiPreconditioner(qdelta, bufferConstrained, solverEpsilon, solverMaxIterations);
+    else
+      info = cgSolver->SolveLinearSystemWithoutPreconditioner(qdelta, bufferConstrained, solverEpsilon, solverMaxIterations);
+    numSolverIterations += abs(info);
+    statistics.numSolverIterations = numSolverIterations;
+    statistics.solverResidualError = cgSolver->GetResidualError();
+    if (info > 0)
+      info = 0;
+
+    if (productError)
+    {
+      printf("Error: the force model failed to multiply with the tangent stiffness matrix during the CG solve.\n");
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
+      return 1;
+    }
+
+    if (info != 0)
+    {
+      printf("Error: matrix-free CG solver did not converge in %d iterations.\n", solverMaxIterations);
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
+      return 1;
+    }
+
+    counterSystemSolveTime.StopCounter();
+    systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+    statistics.solveTime += systemSolveTime;
+    statistics.numNewtonIterations++;
+
+    memcpy(bufferConstrained, qdelta, sizeof(double) * (r - numConstrainedDOFs));
+    InsertRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
+
+    // update state
+    if (useStaticSolver)
+    {
+      for(i=0; i<r; i++)
+      {
+        q[i] += qdelta[i];
+        qvel[i] = (q[i] - q_1[i]) / timestep;
+      }
+    }
+    else
+    {
+      for(i=0; i<r; i++)
+      {
+        qvel[i] += qdelta[i];
+        q[i] += timestep * qvel[i];
+      }
+    }
+
+    for(int i=0; i<numConstrainedDOFs; i++)
+      q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+    numIter++;
+  }
+  while (numIter < maxIterations);
+
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
+  return 0;
+}
+
@@ -0,0 +1,108 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  A class to timestep large sparse dynamics using implicit backward Euler,
+  in a matrix-free (Newton-Krylov) fashion.
+
+  The tangent stiffness matrix is never assembled. Each Newton iteration
+  is solved with the conjugate gradient method, using the products K(q) * v
+  supplied by the force model (see ForceModel::MultiplyTangentStiffnessMatrix).
+  This saves the memory of the tangent stiffness and system matrices, and the
+  time to assemble them. Force models that do not provide an exact product fall 
+  back to a finite-difference product (one internal force evaluation per CG iteration), 
+  which is typically only worthwhile for force models whose stiffness matrix is expensive.
+
+  The system matrix M + h * D + h^2 * K must be symmetric positive-definite.
+  If the force model provides the diagonal of K, CG uses the Jacobi preconditioner.
+
+  See also implicitBackwardEulerSparse.h .
+*/
+
+#ifndef _IMPLICITBACKWARDEULERMATRIXFREE_H_
+#define _IMPLICITBACKWARDEULERMATRIXFREE_H_
+
+#include "sparseSolver/CGSolver.h"
+#include "integratorBaseSparse.h"
+
+class ImplicitBackwardEulerMatrixFree : public IntegratorBaseSparse
+{
+public:
+
+  // constrainedDOFs is an integer array of degrees of freedom that are to be fixed to zero (e.g., to permanently fix a vertex in a deformable simulation)
+  // constrainedDOFs are 0-indexed (separate DOFs for x,y,z), and must be pre-sorted (ascending)
+  // solverEpsilon and solverMaxIterations are the convergence criterium and the maximum number of iterations of the CG solver
+  ImplicitBackwardEulerMatrixFree(int r, double timestep, SparseMatrix * massMatrix, ForceModel * forceModel, int numConstrainedDOFs=0, int * constrainedDOFs=NULL, double dampingMassCoef=0.0, double dampingStiffnessCoef=0.0, int maxIterations = 1, double epsilon = 1E-6, double solverEpsilon = 1E-6, int solverMaxIterations = 10000); 
+
+  virtual ~ImplicitBackwardEulerMatrixFree();
+
+  // damping matrix provides damping in addition to mass and stiffness damping (it does not replace it)
+  virtual void SetDampingMatrix(SparseMatrix * dampingMatrix);
+
+  // sets q, and (optionally) qvel 
+  // returns 0 
+  virtual int SetState(double * q, double * qvel=NULL);
+  virtual int DoTimestep(); 
+
+  // dynamic solver is default (i.e. useStaticSolver=false)
+  virtual void UseStaticSolver(bool useStaticSolver);
+
+  inline void SetSolverParameters(double solverEpsilon, int solverMaxIterations) { this->solverEpsilon = solverEpsilon; this->solverMaxIterations = solverMaxIterations; }
+  // total number of CG iterations in the last timestep
+  inline int GetNumSolverIterations() { return numSolverIterations; }
+
+protected:
+  double * bufferConstrained;
+  double * productBuffer;
+  double * productBufferConstrained;
+  double * massMatrixDiagonal;
+  double * dampingMatrixDiagonal;
+  double * systemMatrixDiagonal;
+
+  double epsilon; 
+  int maxIterations;
+  bool useStaticSolver;
+
+  double solverEpsilon;
+  int solverMaxIterations;
+  int numSolverIterations;
+
+  // the system matrix is systemMassCoef * M + systemStiffnessCoef * K + systemDampingCoef * D
+  double systemMassCoef, systemStiffnessCoef, systemDampingCoef;
+
+  CGSolver * cgSolver;
+
+  // computes the product of the (constrained) system matrix with the (constrained) vector x
+  // (the CG product callback cannot return an error: a failed stiffness matrix product sets productError)
+  void MultiplySystemMatrix(const double * x, double * Ax);
+  int productError;
+  static void SystemMatrixProduct(const void * data, const double * x, double * Ax);
+};
+
+#endif
+
@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "matrix/matrixIO.h"
 #include "performanceCounter/performanceCounter.h"
 #include "insertRows/insertRows.h"
@@ -41,10 +42,17 @@
 
 ImplicitBackwardEulerSparse::ImplicitBackwardEulerSparse(int r, double timestep, SparseMatrix * massMatrix_, ForceModel * forceModel_, int positiveDefiniteSolver_, int numConstrainedDOFs_, int * constrainedDOFs_, double dampingMassCoef, double dampingStiffnessCoef, int maxIterations, double epsilon, int numSolverThreads_): ImplicitNewmarkSparse(r, timestep, massMatrix_, forceModel_, positiveDefiniteSolver_, numConstrainedDOFs_, constrainedDOFs_, dampingMassCoef, dampingStiffnessCoef, maxIterations, epsilon, 0.25, 0.5, numSolverThreads_)
 {
+  useEnergyLineSearch = false;
+  regularizeHessian = true;
+  armijoCoef = 1E-4;
+  maxLineSearchSteps = 20;
+  numLineSearchSteps = 0;
+  qLineSearch = NULL;
 }
 
 ImplicitBackwardEulerSparse::~ImplicitBackwardEulerSparse()
 {
+  free(qLineSearch);
 }
 
 // sets the state based on given q, qvel
@@ -59,10 +67,87 @@ int ImplicitBackwardEulerSparse::SetState(double * q_, double * qvel_)
   return 0;
 }
 
+void ImplicitBackwardEulerSparse::BuildResidual(bool newStiffnessMatrix)
+{
+  memset(qresidual, 0, sizeof(double) * r);
+
+  if (useStaticSolver)
+  {
+    // fint + K * qdelta = fext
+
+    // add externalForces, internalForces
+    for(int i=0; i<r; i++)
+    {
+      qresidual[i] = externalForces[i] - internalForces[i];
+      qdelta[i] = qresidual[i];
+    }
+    return;
+  }
+
+  if (newStiffnessMatrix)
+  {
+    tangentStiffnessMatrix->ScalarMultiply(dampingStiffnessCoef, rayleighDampingMatrix);
+    rayleighDampingMatrix->AddSubMatrix(dampingMassCoef, *massMatrix);
+
+    // build effective stiffness: 
+    // Keff = M + h D + h^2 * K
+    // compute force residual, store it into aux variable qresidual
+    // qresidual = h * (-D qdot - fint + fext - h * K * qdot))
+
+    //add mass matrix and damping matrix to tangentStiffnessMatrix
+    *tangentStiffnessMatrix *= timestep;
+
+    *tangentStiffnessMatrix += *rayleighDampingMatrix;
+    tangentStiffnessMatrix->AddSubMatrix(1.0, *dampingMatrix, 1); // at this point, tangentStiffnessMatrix = h * K + D
+    tangentStiffnessMatrix->MultiplyVector(qvel, qresidual);
+    *tangentStiffnessMatrix *= timestep;
+    tangentStiffnessMatrix->AddSubMatrix(1.0, *massMatrix);
+  }
+  else
+  {
+    // tangentStiffnessMatrix still holds Keff = M + h * (h * K + D) from the last assembly (lagged Jacobian, or the previous Newton iteration)
+    // recover (h * K + D) * qdot = (Keff * qdot - M * qdot) / h, without re-assembling K
+    tangentStiffnessMatrix->MultiplyVector(qvel, qresidual);
+    massMatrix->MultiplyVector(qvel, buffer);
+    for(int i=0; i<r; i++)
+      qresidual[i] = (qresidual[i] - buffer[i]) / timestep;
+  }
+
+  // add externalForces, internalForces
+  for(int i=0; i<r; i++)
+  {
+    qresidual[i] += internalForces[i] - externalForces[i];
+    qresidual[i] *= -timestep;
+    qdelta[i] = qresidual[i];
+  }
+}
+
+// the backward Euler equations for the velocity, in residual form:
+// qresidual = -(M (qvel - qvel_1) + h * (fint(q) + D qvel - fext)), with q = q_1 + h * qvel
+// unlike BuildResidual, this does not require the stiffness matrix at q (D is taken from the last assembly) 
+void ImplicitBackwardEulerSparse::BuildNonlinearResidual()
+{
+  for(int i=0; i<r; i++)
+    buffer[i] = qvel[i] - qvel_1[i];
+  massMatrix->MultiplyVector(buffer, qresidual);
+
+  rayleighDampingMatrix->MultiplyVector(qvel, buffer);
+  dampingMatrix->MultiplyVectorAdd(qvel, buffer);
+
+  for(int i=0; i<r; i++)
+    qresidual[i] = -(qresidual[i] + timestep * (buffer[i] + internalForces[i] - externalForces[i]));
+}
+
 int ImplicitBackwardEulerSparse::DoTimestep()
 {
+  if (useEnergyLineSearch && !useStaticSolver)
+    return DoEnergyLineSearchTimestep();
+
   int numIter = 0;
 
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
   double error0 = 0; // error after the first step
   double errorQuotient;
 
@@ -74,10 +159,25 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     qvel_1[i] = qvel[i];
   }
 
+  // lagged Jacobian: refactor once the factorization has been reused for laggedJacobianMaxAge timesteps
+  if ((laggedJacobianMaxAge > 0) && (laggedJacobianAge >= laggedJacobianMaxAge))
+    laggedJacobianIsValid = false;
+  laggedJacobianAge++;
+  double errorPrevious = 0; // error at the previous iteration
+
   do
   {
     int i;
 
+    // with the lagged Jacobian, the stiffness matrix is only assembled when the factorization is refreshed
+    bool refreshJacobian = !useLaggedJacobian || !laggedJacobianIsValid;
+
+    // the constraints changed: rebuild the reduced system matrix before it is refactored, 
+    // unless few DOFs changed, in which case each factorization is corrected by constraintUpdateSolver
+    if (refreshJacobian && systemMatrixConstraintsChanged && !useInPlaceConstraints && !UseConstraintUpdate())
+      RebuildSystemMatrix();
+    bool fullSizeSolve = useInPlaceConstraints || UseConstraintUpdate(); // solve with full-size vectors (no RemoveRows / InsertRows)
+
 /*
     printf("q:\n");
     for(int i=0; i<r; i++)
@@ -90,10 +190,20 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     printf("\n");
 */
 
+    // force-first: after the first iteration, the forces and the residual are evaluated before the stiffness matrix, 
+    // which is only assembled if the residual shows that another solve is needed
+    // (the convergence test uses the residual of the backward Euler equations, see BuildNonlinearResidual, which does not involve K)
+    bool assembleStiffness = refreshJacobian && (numIter == 0);
+
     PerformanceCounter counterForceAssemblyTime;
-    forceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    if (assembleStiffness)
+      forceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    else
+      forceModel->GetInternalForce(q, internalForces);
     counterForceAssemblyTime.StopCounter();
     forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+    statistics.forceAssemblyTime += forceAssemblyTime;
+    PerformanceCounter counterSystemMatrixTime;
 
     //tangentStiffnessMatrix->Print();
     //tangentStiffnessMatrix->Save("K");
@@ -102,47 +212,22 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     for(i=0; i<r; i++)
       internalForces[i] *= internalForceScalingFactor;
 
-    *tangentStiffnessMatrix *= internalForceScalingFactor;
-
-    memset(qresidual, 0, sizeof(double) * r);
+    if (assembleStiffness)
+      *tangentStiffnessMatrix *= internalForceScalingFactor;
 
     if (useStaticSolver)
+      BuildResidual(assembleStiffness);
+    else if (numIter == 0)
     {
-      // fint + K * qdelta = fext
-
-      // add externalForces, internalForces
-      for(i=0; i<r; i++)
-      {
-        qresidual[i] = externalForces[i] - internalForces[i];
-        qdelta[i] = qresidual[i];
-      }
+      // the first iteration linearizes around qvel_1: the right-hand side is h * (fext - fint - D qvel_1 - h * K qvel_1) (in qdelta)
+      BuildResidual(assembleStiffness);
+      // the convergence test measures the nonlinear residual (qvel = qvel_1, so this is h * (fext - fint - D qvel_1))
+      BuildNonlinearResidual();
     }
     else
     {
-      tangentStiffnessMatrix->ScalarMultiply(dampingStiffnessCoef, rayleighDampingMatrix);
-      rayleighDampingMatrix->AddSubMatrix(dampingMassCoef, *massMatrix);
-
-      // build effective stiffness: 
-      // Keff = M + h D + h^2 * K
-      // compute force residual, store it into aux variable qresidual
-      // qresidual = h * (-D qdot - fint + fext - h * K * qdot))
-
-      //add mass matrix and damping matrix to tangentStiffnessMatrix
-      *tangentStiffnessMatrix *= timestep;
-
-      *tangentStiffnessMatrix += *rayleighDampingMatrix;
-      tangentStiffnessMatrix->AddSubMatrix(1.0, *dampingMatrix, 1); // at this point, tangentStiffnessMatrix = h * K + D
-      tangentStiffnessMatrix->MultiplyVector(qvel, qresidual);
-      *tangentStiffnessMatrix *= timestep;
-      tangentStiffnessMatrix->AddSubMatrix(1.0, *massMatrix);
-      
-      // add externalForces, internalForces
-      for(i=0; i<r; i++)
-      {
-        qresidual[i] += internalForces[i] - externalForces[i];
-        qresidual[i] *= -timestep;
-        qdelta[i] = qresidual[i];
-      }
+      BuildNonlinearResidual();
+      memcpy(qdelta, qresidual, sizeof(double) * r);
     }
 
 /*
@@ -162,15 +247,25 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     printf("\n");
 */
 
+    // the constrained DOFs carry the reaction forces, which do not vanish at convergence
+    for(i=0; i<numConstrainedDOFs; i++)
+      qresidual[constrainedDOFs[i]] = 0.0;
     double error = 0;
     for(i=0; i<r; i++)
       error += qresidual[i] * qresidual[i];
+    statistics.AddResidualNorm(sqrt(error));
 
     // on the first iteration, compute initial error
     if (numIter == 0) 
     {
       error0 = error;
       errorQuotient = 1.0;
+
+      // lagged Jacobian: if the residual at the start of the timestep grew too much since the previous timestep, refresh the matrix in the next iteration
+      // (with maxIterations = 1, the contraction within a timestep below is never measured)
+      if (!refreshJacobian && (laggedJacobianStartError > 0) && (laggedJacobianContractionThreshold * laggedJacobianContractionThreshold * error > laggedJacobianStartError))
+        laggedJacobianIsValid = false;
+      laggedJacobianStartError = error;
     }
     else
     {
@@ -181,9 +276,42 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     if (errorQuotient < epsilon * epsilon)
       break;
 
+    // lagged Jacobian: if the residual did not contract fast enough with the old factorization, refresh it in the next iteration
+    if (!refreshJacobian && (numIter > 0) && (error > laggedJacobianContractionThreshold * laggedJacobianContractionThreshold * errorPrevious))
+      laggedJacobianIsValid = false;
+    errorPrevious = error;
+
+    double stiffnessAssemblyTime = 0.0;
+    if (refreshJacobian && !assembleStiffness)
+    {
+      // another solve is needed: assemble the stiffness matrix now, and rebuild the effective stiffness matrix and the residual with it
+      PerformanceCounter counterStiffnessAssemblyTime;
+      forceModel->GetTangentStiffnessMatrix(q, tangentStiffnessMatrix);
+      counterStiffnessAssemblyTime.StopCounter();
+      stiffnessAssemblyTime = counterStiffnessAssemblyTime.GetElapsedTime();
+      forceAssemblyTime += stiffnessAssemblyTime;
+      statistics.forceAssemblyTime += stiffnessAssemblyTime;
+
+      *tangentStiffnessMatrix *= internalForceScalingFactor;
+      BuildResidual(true);
+      if (!useStaticSolver)
+      {
+        // Newton step on the backward Euler equations: Keff * qdelta = qresidual
+        BuildNonlinearResidual();
+        memcpy(qdelta, qresidual, sizeof(double) * r);
+      }
+    }
+    if (refreshJacobian)
+      statistics.numStiffnessAssemblies++;
+
     //tangentStiffnessMatrix->Save("Keff");
-    RemoveRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
-    systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+    if (!fullSizeSolve)
+      RemoveRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
+    if (refreshJacobian && !useInPlaceConstraints)
+      systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+
+    counterSystemMatrixTime.StopCounter();
+    statistics.systemMatrixTime += counterSystemMatrixTime.GetElapsedTime() - stiffnessAssemblyTime;
 
     // solve: systemMatrix * buffer = bufferConstrained
 
@@ -191,31 +319,87 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     memset(buffer, 0, sizeof(double) * r);
 
     #ifdef SPOOLES
-      int info;
-      if (numSolverThreads > 1)
+      if (refreshJacobian)
       {
-        SPOOLESSolverMT * solver = new SPOOLESSolverMT(systemMatrix, numSolverThreads);
-        info = solver->SolveLinearSystem(buffer, bufferConstrained);
-        delete(solver);
+        PerformanceCounter counterFactorizationTime;
+        delete(spoolesSolver);
+        if (numSolverThreads > 1)
+          spoolesSolver = new SPOOLESSolverMT(systemMatrix, numSolverThreads);
+        else
+          spoolesSolver = new SPOOLESSolver(systemMatrix);
+        counterFactorizationTime.StopCounter();
+        statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+        statistics.numFactorizations++;
+        statistics.numAllocations++;
       }
-      else
+      int info = 0;
+      if (UseConstraintUpdate() && (refreshJacobian || (constraintUpdateSolver == NULL)))
+        info = BuildConstraintUpdateSolver();
+      PerformanceCounter counterSolveTime;
+      if (info == 0)
+      {
+        if (constraintUpdateSolver != NULL)
+          info = constraintUpdateSolver->SolveLinearSystem(buffer, qdelta);
+        else
+          info = spoolesSolver->SolveLinearSystem(buffer, bufferConstrained);
+      }
+      counterSolveTime.StopCounter();
+      statistics.solveTime += counterSolveTime.GetElapsedTime();
+      if (!useLaggedJacobian)
       {
-        SPOOLESSolver * solver = new SPOOLESSolver(systemMatrix);
-        info = solver->SolveLinearSystem(buffer, bufferConstrained);
-        delete(solver);
+        delete(constraintUpdateSolver);
+        constraintUpdateSolver = NULL;
+        delete(spoolesSolver);
+        spoolesSolver = NULL;
       }
       char solverString[16] = "SPOOLES";
     #endif
 
     #ifdef PARDISO
-      int info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+      int info = 0;
+      if (refreshJacobian)
+      {
+        PerformanceCounter counterFactorizationTime;
+        info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+        counterFactorizationTime.StopCounter();
+        statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+        statistics.numFactorizations++;
+      }
+      if ((info == 0) && UseConstraintUpdate() && (refreshJacobian || (constraintUpdateSolver == NULL)))
+        info = BuildConstraintUpdateSolver();
       if (info == 0)
-        info = pardisoSolver->SolveLinearSystem(buffer, bufferConstrained);
+      {
+        PerformanceCounter counterSolveTime;
+        if (constraintUpdateSolver != NULL)
+          info = constraintUpdateSolver->SolveLinearSystem(buffer, qdelta);
+        else
+          info = pardisoSolver->SolveLinearSystem(buffer, bufferConstrained);
+        counterSolveTime.StopCounter();
+        statistics.solveTime += counterSolveTime.GetElapsedTime();
+        #ifdef PARDISO_MIXED_PRECISION
+          statistics.numSolverIterations += pardisoSolver->GetNumRefinementIterations();
+          statistics.solverResidualError = pardisoSolver->GetResidualError();
+        #endif
+      }
       char solverString[16] = "PARDISO";
     #endif
 
     #ifdef PCG
-      int info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, bufferConstrained, 1e-6, 10000);
+      PerformanceCounter counterSolveTime;
+      int info;
+      if (useInPlaceConstraints)
+      {
+        info = SolveWithInPlaceConstraints(buffer, qdelta);
+        statistics.solverResidualError = projectedCGSolver->GetResidualError();
+      }
+      else
+      {
+        info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, bufferConstrained, 1e-6, 10000);
+        statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
+      }
+      counterSolveTime.StopCounter();
+      statistics.solveTime += counterSolveTime.GetElapsedTime();
+      statistics.numSolverIterations += abs(info);
       if (info > 0)
         info = 0;
       char solverString[16] = "PCG";
@@ -225,14 +409,28 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     if (info != 0)
     {
       printf("Error: %s sparse solver returned non-zero exit status %d.\n", solverString, (int)info);
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
       exit(-1);
       return 1;
     }
 
     counterSystemSolveTime.StopCounter();
     systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+    statistics.numNewtonIterations++;
+    statistics.systemMatrixNNZ = useInPlaceConstraints ? tangentStiffnessMatrix->GetNumEntries() : systemMatrix->GetNumEntries();
 
-    InsertRows(r, buffer, qdelta, numConstrainedDOFs, constrainedDOFs);
+    if (refreshJacobian)
+    {
+      numFactorizations++;
+      laggedJacobianIsValid = true;
+      laggedJacobianAge = 0;
+    }
+
+    if (fullSizeSolve)
+      memcpy(qdelta, buffer, sizeof(double) * r);
+    else
+      InsertRows(r, buffer, qdelta, numConstrainedDOFs, constrainedDOFs);
 
 /*
     printf("qdelta:\n");
@@ -255,7 +453,7 @@ int ImplicitBackwardEulerSparse::DoTimestep()
       for(i=0; i<r; i++)
       {
         qvel[i] += qdelta[i];
-        q[i] += timestep * qvel[i];
+        q[i] = q_1[i] + timestep * qvel[i];
       }
     }
 
@@ -284,6 +482,308 @@ int ImplicitBackwardEulerSparse::DoTimestep()
     //printf("Warning: method did not converge in max number of iterations.\n");
   //}
 
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
   return 0;
 }
 
+
+void ImplicitBackwardEulerSparse::GetLocalErrorEstimate(double * error)
+{
+  double factor = 0.5 * timestep;
+  for(int i=0; i<r; i++)
+    error[i] = factor * (qvel[i] - qvel_1[i]);
+}
+
+void ImplicitBackwardEulerSparse::UseEnergyLineSearch(bool useEnergyLineSearch_, bool regularizeHessian_, double armijoCoef_, int maxLineSearchSteps_)
+{
+  useEnergyLineSearch = useEnergyLineSearch_;
+  regularizeHessian = regularizeHessian_;
+  armijoCoef = armijoCoef_;
+  maxLineSearchSteps = maxLineSearchSteps_;
+
+  if (!useEnergyLineSearch)
+    return;
+
+  double energy;
+  if (forceModel->GetElasticEnergy(q, &energy) != 0)
+  {
+    printf("Error: the force model does not provide the elastic energy. Energy line search is disabled.\n");
+    useEnergyLineSearch = false;
+    return;
+  }
+
+  if (qLineSearch == NULL)
+    qLineSearch = (double*) malloc (sizeof(double) * r);
+}
+
+// the incremental potential E(x) of the current timestep (see UseEnergyLineSearch)
+// uses "buffer"; rayleighDampingMatrix must hold dampingMassCoef * M + dampingStiffnessCoef * K(q_n)
+double ImplicitBackwardEulerSparse::IncrementalPotential(double * x)
+{
+  double elasticEnergy = 0.0;
+  forceModel->GetElasticEnergy(x, &elasticEnergy);
+
+  // inertia
+  for(int i=0; i<r; i++)
+    buffer[i] = x[i] - q_1[i] - timestep * qvel_1[i];
+  double energy = 0.5 / (timestep * timestep) * massMatrix->QuadraticForm(buffer);
+
+  // damping
+  for(int i=0; i<r; i++)
+    buffer[i] = x[i] - q_1[i];
+  energy += 0.5 / timestep * (rayleighDampingMatrix->QuadraticForm(buffer) + dampingMatrix->QuadraticForm(buffer));
+
+  energy += internalForceScalingFactor * elasticEnergy;
+  for(int i=0; i<r; i++)
+    energy -= externalForces[i] * x[i];
+
+  return energy;
+}
+
+int ImplicitBackwardEulerSparse::SolveEffectiveSystem(double * x, double * rhs)
+{
+  bool constraintUpdate = UseConstraintUpdate();
+  if (!useInPlaceConstraints)
+  {
+    if (!constraintUpdate)
+      RemoveRows(r, bufferConstrained, rhs, numConstrainedDOFs, constrainedDOFs);
+    systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+  }
+
+  memset(buffer, 0, sizeof(double) * r);
+
+  PerformanceCounter counterFactorizationTime;
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+    if (numSolverThreads > 1)
+      spoolesSolver = new SPOOLESSolverMT(systemMatrix, numSolverThreads);
+    else
+      spoolesSolver = new SPOOLESSolver(systemMatrix);
+    statistics.numAllocations++;
+    int info = 0;
+  #endif
+
+  #ifdef PARDISO
+    int info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+  #endif
+
+  #if defined(SPOOLES) || defined(PARDISO)
+    counterFactorizationTime.StopCounter();
+    statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+    statistics.numFactorizations++;
+  #endif
+  numFactorizations++;
+
+  #if defined(SPOOLES) || defined(PARDISO)
+    if ((info == 0) && constraintUpdate)
+      info = BuildConstraintUpdateSolver();
+  #endif
+
+  PerformanceCounter counterSolveTime;
+  #ifdef SPOOLES
+    if (info == 0)
+    {
+      if (constraintUpdate)
+        info = constraintUpdateSolver->SolveLinearSystem(buffer, rhs);
+      else
+        info = spoolesSolver->SolveLinearSystem(buffer, bufferConstrained);
+    }
+    delete(constraintUpdateSolver);
+    constraintUpdateSolver = NULL;
+    delete(spoolesSolver);
+    spoolesSolver = NULL;
+  #endif
+
+  #ifdef PARDISO
+    if (info == 0)
+    {
+      if (constraintUpdate)
+        info = constraintUpdateSolver->SolveLinearSystem(buffer, rhs);
+      else
+        info = pardisoSolver->SolveLinearSystem(buffer, bufferConstrained);
+    }
+  #endif
+
+  #ifdef PCG
+    int info;
+    if (useInPlaceConstraints)
+    {
+      info = SolveWithInPlaceConstraints(buffer, rhs);
+      statistics.solverResidualError = projectedCGSolver->GetResidualError();
+    }
+    else
+    {
+      info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, bufferConstrained, 1e-6, 10000);
+      statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
+    }
+    statistics.numSolverIterations += abs(info);
+    if (info > 0)
+      info = 0;
+  #endif
+  counterSolveTime.StopCounter();
+  statistics.solveTime += counterSolveTime.GetElapsedTime();
+
+  if (useInPlaceConstraints || constraintUpdate)
+    memcpy(x, buffer, sizeof(double) * r);
+  else
+    InsertRows(r, buffer, x, numConstrainedDOFs, constrainedDOFs);
+
+  return info;
+}
+
+int ImplicitBackwardEulerSparse::DoEnergyLineSearchTimestep()
+{
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
+  for(int i=0; i<r; i++)
+  {
+    qaccel_1[i] = qaccel[i];
+    q_1[i] = q[i]; 
+    qvel_1[i] = qvel[i];
+  }
+
+  // the factorization is refreshed in every iteration (and corrected for changed constraints, unless too many DOFs changed)
+  if (!useInPlaceConstraints && systemMatrixConstraintsChanged && !UseConstraintUpdate())
+    RebuildSystemMatrix();
+  laggedJacobianIsValid = false;
+
+  double h2 = timestep * timestep;
+  double gradientNorm0 = 0.0;
+  double energy = 0.0;
+  numLineSearchSteps = 0;
+
+  for(int numIter=0; numIter<maxIterations; numIter++)
+  {
+    PerformanceCounter counterForceAssemblyTime;
+    forceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    counterForceAssemblyTime.StopCounter();
+    forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+    statistics.forceAssemblyTime += forceAssemblyTime;
+
+    PerformanceCounter counterSystemMatrixTime;
+    for(int i=0; i<r; i++)
+      internalForces[i] *= internalForceScalingFactor;
+    *tangentStiffnessMatrix *= internalForceScalingFactor;
+
+    if (numIter == 0)
+    {
+      // the damping matrix D is fixed during the timestep (stiffness at q_n), so that E is a potential
+      tangentStiffnessMatrix->ScalarMultiply(dampingStiffnessCoef, rayleighDampingMatrix);
+      rayleighDampingMatrix->AddSubMatrix(dampingMassCoef, *massMatrix);
+      energy = IncrementalPotential(q);
+    }
+
+    // gradient of E (stored in qresidual):
+    // M (q - q_n - h qvel_n) / h^2 + D (q - q_n) / h + fint(q) - fext
+    for(int i=0; i<r; i++)
+      buffer[i] = q[i] - q_1[i] - timestep * qvel_1[i];
+    massMatrix->MultiplyVector(buffer, qresidual);
+    for(int i=0; i<r; i++)
+      buffer[i] = q[i] - q_1[i];
+    rayleighDampingMatrix->MultiplyVector(buffer, qdelta);
+    dampingMatrix->MultiplyVectorAdd(buffer, qdelta);
+    for(int i=0; i<r; i++)
+      qresidual[i] = qresidual[i] / h2 + qdelta[i] / timestep + internalForces[i] - externalForces[i];
+    for(int i=0; i<numConstrainedDOFs; i++)
+      qresidual[constrainedDOFs[i]] = 0.0;
+
+    double gradientNorm = 0.0;
+    for(int i=0; i<r; i++)
+      gradientNorm += qresidual[i] * qresidual[i];
+    gradientNorm = sqrt(gradientNorm);
+    statistics.AddResidualNorm(gradientNorm);
+
+    if (numIter == 0)
+      gradientNorm0 = gradientNorm;
+    if (gradientNorm <= epsilon * gradientNorm0)
+      break;
+
+    // Hessian (times h^2): Keff = M + h D + h^2 K
+    *tangentStiffnessMatrix *= timestep;
+    *tangentStiffnessMatrix += *rayleighDampingMatrix;
+    tangentStiffnessMatrix->AddSubMatrix(1.0, *dampingMatrix, 1);
+    *tangentStiffnessMatrix *= timestep;
+    tangentStiffnessMatrix->AddSubMatrix(1.0, *massMatrix);
+    counterSystemMatrixTime.StopCounter();
+    statistics.systemMatrixTime += counterSystemMatrixTime.GetElapsedTime();
+
+    // Newton direction: Keff * qdelta = -h^2 * gradient
+    // if Keff is not positive-definite, regularize it with tau * M until qdelta is a descent direction
+    double slope = 0.0;
+    double tau = 0.0;
+    int info;
+    do
+    {
+      for(int i=0; i<r; i++)
+        qLineSearch[i] = -h2 * qresidual[i];
+      info = SolveEffectiveSystem(qdelta, qLineSearch);
+      statistics.numNewtonIterations++;
+
+      slope = 0.0;
+      for(int i=0; i<r; i++)
+        slope += qresidual[i] * qdelta[i];
+
+      if (!regularizeHessian || ((info == 0) && (slope < 0)))
+        break;
+
+      double newTau = (tau == 0.0) ? 1.0 : 10.0 * tau;
+      if (newTau > 1E8)
+        break;
+      tangentStiffnessMatrix->AddSubMatrix(newTau - tau, *massMatrix);
+      tau = newTau;
+    }
+    while (1);
+
+    if (info != 0)
+    {
+      printf("Error: sparse solver returned non-zero exit status %d.\n", (int)info);
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
+      return 1;
+    }
+
+    if (slope >= 0)
+      break; // no descent direction: q is at a (numerical) minimum
+
+    // backtracking line search (Armijo condition)
+    double alpha = 1.0;
+    bool accepted = false;
+    for(int step=0; step<maxLineSearchSteps; step++)
+    {
+      for(int i=0; i<r; i++)
+        qLineSearch[i] = q[i] + alpha * qdelta[i];
+      double trialEnergy = IncrementalPotential(qLineSearch);
+      numLineSearchSteps++;
+      if (trialEnergy <= energy + armijoCoef * alpha * slope)
+      {
+        memcpy(q, qLineSearch, sizeof(double) * r);
+        energy = trialEnergy;
+        accepted = true;
+        break;
+      }
+      alpha *= 0.5;
+    }
+
+    if (!accepted)
+      break; // the energy can no longer be decreased (to numerical precision)
+  }
+
+  for(int i=0; i<r; i++)
+  {
+    qvel[i] = (q[i] - q_1[i]) / timestep;
+    qaccel[i] = (qvel[i] - qvel_1[i]) / timestep;
+  }
+
+  for(int i=0; i<numConstrainedDOFs; i++)
+    q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+  statistics.systemMatrixNNZ = useInPlaceConstraints ? tangentStiffnessMatrix->GetNumEntries() : systemMatrix->GetNumEntries();
+
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
+  return 0;
+}
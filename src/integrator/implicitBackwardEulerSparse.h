@@ -49,9 +49,44 @@ public:
   // sets q, and (optionally) qvel 
   // returns 0 
   virtual int SetState(double * q, double * qvel=NULL);
+  // with maxIterations > 1, the iterations are Newton iterations on M (qvel - qvel_n) = h * (fext - fint(q_n + h * qvel) - D qvel);
+  // the convergence test evaluates the internal forces only, and the stiffness matrix is assembled only if another solve follows
   virtual int DoTimestep(); 
 
+  // backward Euler: timestep / 2 * (qvel_{n+1} - qvel_n) (the local error is O(timestep^2))
+  virtual void GetLocalErrorEstimate(double * error);
+  virtual int GetErrorOrder() { return 1; }
+
+  // energy-based (incremental potential) mode; default: disabled
+  // each timestep minimizes the incremental potential
+  //   E(q) = 1 / (2 h^2) (q - q_n - h qvel_n)^T M (q - q_n - h qvel_n) + 1 / (2 h) (q - q_n)^T D (q - q_n) + V(q) - fext^T q,
+  // where h is the timestep, V(q) is the elastic energy (the force model must support ForceModel::GetElasticEnergy), and 
+  // D = dampingMassCoef * M + dampingStiffnessCoef * K(q_n) + dampingMatrix is fixed during the timestep,
+  // using Newton's method with a backtracking (Armijo) line search on E; each iteration assembles the forces and the tangent stiffness matrix once, 
+  // and evaluates the energy once per line search trial; the iteration stops when ||grad E|| < epsilon * ||grad E(q_n)||, or after maxIterations iterations
+  // regularizeHessian: if the factorization fails, or the Newton direction is not a descent direction (the Hessian is indefinite, e.g., under large compression),
+  // tau * M / h^2 is added to the Hessian, with tau = 1, 10, 100, ..., until a descent direction is obtained
+  // the lagged Jacobian is not used in this mode; the static solver mode is not supported
+  void UseEnergyLineSearch(bool useEnergyLineSearch, bool regularizeHessian=true, double armijoCoef=1E-4, int maxLineSearchSteps=20);
+  // number of line search trials (energy evaluations) in the last timestep
+  inline int GetNumLineSearchSteps() { return numLineSearchSteps; }
+
 protected:
+  virtual void BuildResidual(bool newStiffnessMatrix);
+  // residual of the backward Euler equations at the current qvel (uses internalForces; does not require the stiffness matrix)
+  void BuildNonlinearResidual();
+
+  bool useEnergyLineSearch;
+  bool regularizeHessian;
+  double armijoCoef;
+  int maxLineSearchSteps;
+  int numLineSearchSteps;
+  double * qLineSearch;
+
+  int DoEnergyLineSearchTimestep();
+  double IncrementalPotential(double * q);
+  // solves tangentStiffnessMatrix * x = rhs (x, rhs are full vectors; rhs is modified), after factoring the (reduced) matrix 
+  int SolveEffectiveSystem(double * x, double * rhs);
 };
 
 #endif
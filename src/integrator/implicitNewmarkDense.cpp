@@ -0,0 +1,209 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "performanceCounter/performanceCounter.h"
+#include "integrator/implicitNewmarkDense.h"
+
+ImplicitNewmarkDense::ImplicitNewmarkDense(int r, double timestep, double * massMatrix_, ReducedForceModel * reducedForceModel_, double dampingMassCoef, double dampingStiffnessCoef, int maxIterations_, double epsilon_, double NewmarkBeta_, double NewmarkGamma_): IntegratorBaseDense(r, timestep, massMatrix_, reducedForceModel_, dampingMassCoef, dampingStiffnessCoef)
+{
+  this->maxIterations = maxIterations_; // maxIterations = 1 for semi-implicit
+  this->epsilon = epsilon_; 
+  this->NewmarkBeta = NewmarkBeta_;
+  this->NewmarkGamma = NewmarkGamma_;
+
+  useStaticSolver = false;
+
+  UpdateAlphas();
+
+  tangentStiffnessMatrix = (double*) malloc (sizeof(double) * r * r);
+  rayleighDampingMatrix = (double*) malloc (sizeof(double) * r * r);
+  systemMatrix = (double*) malloc (sizeof(double) * r * r);
+  pivots = (int*) malloc (sizeof(int) * r);
+}
+
+ImplicitNewmarkDense::~ImplicitNewmarkDense()
+{
+  free(tangentStiffnessMatrix);
+  free(rayleighDampingMatrix);
+  free(systemMatrix);
+  free(pivots);
+}
+
+void ImplicitNewmarkDense::UpdateAlphas()
+{
+  alpha1 = 1.0 / (NewmarkBeta * timestep * timestep);
+  alpha2 = 1.0 / (NewmarkBeta * timestep);
+  alpha3 = (1.0 - 2.0 * NewmarkBeta) / (2.0 * NewmarkBeta);
+  alpha4 = NewmarkGamma / (NewmarkBeta * timestep);
+  alpha5 = 1 - NewmarkGamma/NewmarkBeta;
+  alpha6 = (1.0 - NewmarkGamma / (2.0 * NewmarkBeta)) * timestep;
+}
+
+// sets the state based on given q, qvel
+// automatically computes acceleration assuming zero external force
+int ImplicitNewmarkDense::SetState(double * q_, double * qvel_)
+{
+  memcpy(q, q_, sizeof(double)*r);
+
+  if (qvel_ != NULL)
+    memcpy(qvel, qvel_, sizeof(double)*r);
+  else
+    memset(qvel, 0, sizeof(double)*r);
+
+  // M * qaccel + C * qvel + R(q) = P_0 
+  // R(q) = P_0 = 0
+  // i.e. M * qaccel = - C * qvel - R(q)
+
+  reducedForceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+
+  // qaccel = - C * qvel - R(q), C = dampingMassCoef * M + dampingStiffnessCoef * K
+  for(int i=0; i<r; i++)
+    qaccel[i] = -internalForces[i];
+  for(int j=0; j<r; j++)
+    for(int i=0; i<r; i++)
+      qaccel[i] -= (dampingMassCoef * massMatrix[r * j + i] + dampingStiffnessCoef * tangentStiffnessMatrix[r * j + i]) * qvel[j];
+
+  memcpy(systemMatrix, massMatrix, sizeof(double) * r * r);
+  if (SolveLinearSystem(r, systemMatrix, pivots, qaccel) != 0)
+  {
+    printf("Error: the reduced mass matrix is singular.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ImplicitNewmarkDense::DoTimestep()
+{
+  int numIter = 0;
+
+  double error0 = 0; // error after the first step
+  double errorQuotient;
+
+  // store current amplitudes and set initial guesses for qaccel, qvel
+  for(int i=0; i<r; i++)
+  {
+    q_1[i] = q[i]; 
+    qvel_1[i] = qvel[i];
+    qaccel_1[i] = qaccel[i];
+
+    qaccel[i] = alpha1 * (q[i] - q_1[i]) - alpha2 * qvel_1[i] - alpha3 * qaccel_1[i];
+    qvel[i] = alpha4 * (q[i] - q_1[i]) + alpha5 * qvel_1[i] + alpha6 * qaccel_1[i];
+  }
+
+  do
+  {
+    int i;
+
+    PerformanceCounter counterForceAssemblyTime;
+    reducedForceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    counterForceAssemblyTime.StopCounter();
+    forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+
+    // scale internal forces
+    for(i=0; i<r; i++)
+      internalForces[i] *= internalForceScalingFactor;
+    for(i=0; i<r*r; i++)
+      tangentStiffnessMatrix[i] *= internalForceScalingFactor;
+
+    // compute force residual, store it into aux variable qresidual
+    // qresidual = - (M * qaccel + C * qvel - externalForces + internalForces)
+    for(i=0; i<r; i++)
+      qresidual[i] = externalForces[i] - internalForces[i];
+
+    if (useStaticSolver)
+    {
+      // system matrix: K
+      memcpy(systemMatrix, tangentStiffnessMatrix, sizeof(double) * r * r);
+    }
+    else
+    {
+      // C = dampingMassCoef * M + dampingStiffnessCoef * K
+      // system matrix: alpha1 * M + alpha4 * C + K
+      for(i=0; i<r*r; i++)
+      {
+        rayleighDampingMatrix[i] = dampingMassCoef * massMatrix[i] + dampingStiffnessCoef * tangentStiffnessMatrix[i];
+        systemMatrix[i] = alpha1 * massMatrix[i] + alpha4 * rayleighDampingMatrix[i] + tangentStiffnessMatrix[i];
+      }
+
+      for(int j=0; j<r; j++)
+        for(i=0; i<r; i++)
+          qresidual[i] -= massMatrix[r * j + i] * qaccel[j] + rayleighDampingMatrix[r * j + i] * qvel[j];
+    }
+
+    double error = 0;
+    for(i=0; i<r; i++)
+      error += qresidual[i] * qresidual[i];
+
+    // on the first iteration, compute initial error
+    if (numIter == 0) 
+    {
+      error0 = error;
+      errorQuotient = 1.0;
+    }
+    else
+    {
+      // error divided by the initial error, before performing this iteration
+      errorQuotient = error / error0; 
+    }
+
+    if (errorQuotient < epsilon * epsilon)
+      break;
+
+    // solve: systemMatrix * qdelta = qresidual
+    PerformanceCounter counterSystemSolveTime;
+    memcpy(qdelta, qresidual, sizeof(double) * r);
+    int info = SolveLinearSystem(r, systemMatrix, pivots, qdelta);
+    counterSystemSolveTime.StopCounter();
+    systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+
+    if (info != 0)
+    {
+      printf("Error: the reduced system matrix is singular.\n");
+      return 1;
+    }
+
+    // update state
+    for(i=0; i<r; i++)
+    {
+      q[i] += qdelta[i];
+      qaccel[i] = alpha1 * (q[i] - q_1[i]) - alpha2 * qvel_1[i] - alpha3 * qaccel_1[i];
+      qvel[i] = alpha4 * (q[i] - q_1[i]) + alpha5 * qvel_1[i] + alpha6 * qaccel_1[i];
+    }
+
+    numIter++;
+  }
+  while (numIter < maxIterations);
+
+  return 0;
+}
+
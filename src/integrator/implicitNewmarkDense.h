@@ -0,0 +1,89 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  A class to timestep dense (reduced) dynamics using implicit Newmark.
+  E.g., reduced nonlinear StVK deformable dynamics (see [1] in integratorBase.h), 
+  where the cost of a timestep is independent of the size of the simulation mesh.
+
+  The r x r linear systems are solved with Gaussian elimination (partial pivoting),
+  so no BLAS or LAPACK library is required. The reduced system does not have
+  constrained DOFs (constraints are built into the basis).
+
+  See also integratorBase.h and implicitNewmarkSparse.h .
+*/
+
+#ifndef _IMPLICITNEWMARKDENSE_H_
+#define _IMPLICITNEWMARKDENSE_H_
+
+#include "integrator/integratorBaseDense.h"
+
+class ImplicitNewmarkDense : public IntegratorBaseDense
+{
+public:
+
+  // massMatrix is the r x r reduced mass matrix (column-major); it is copied
+  ImplicitNewmarkDense(int r, double timestep, double * massMatrix, ReducedForceModel * reducedForceModel, double dampingMassCoef=0.0, double dampingStiffnessCoef=0.0, int maxIterations = 1, double epsilon = 1E-6, double NewmarkBeta=0.25, double NewmarkGamma=0.5); 
+
+  virtual ~ImplicitNewmarkDense();
+
+  inline virtual void SetTimestep(double timestep) { this->timestep = timestep; UpdateAlphas(); }
+
+  // sets q, qvel 
+  // automatically computes acceleration assuming zero external force
+  // returns 0 on succes, 1 if the mass matrix is singular
+  virtual int SetState(double * q, double * qvel=NULL);
+
+  // performs one step of simulation (returns 0 on sucess, and 1 on failure)
+  // failure can occur if the system matrix is singular
+  virtual int DoTimestep(); 
+
+  inline void SetNewmarkBeta(double NewmarkBeta) { this->NewmarkBeta = NewmarkBeta; UpdateAlphas(); }
+  inline void SetNewmarkGamma(double NewmarkGamma) { this->NewmarkGamma = NewmarkGamma; UpdateAlphas(); }
+
+  // dynamic solver is default (i.e. useStaticSolver=false)
+  inline void UseStaticSolver(bool useStaticSolver) { this->useStaticSolver = useStaticSolver; }
+
+protected:
+  double * tangentStiffnessMatrix;
+  double * rayleighDampingMatrix;
+  double * systemMatrix;
+  int * pivots;
+
+  // parameters for implicit Newmark
+  double NewmarkBeta,NewmarkGamma;
+  double alpha1, alpha2, alpha3, alpha4, alpha5, alpha6;
+  double epsilon; 
+  int maxIterations;
+
+  void UpdateAlphas();
+  bool useStaticSolver;
+};
+
+#endif
+
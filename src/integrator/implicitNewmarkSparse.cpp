@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "matrix/matrixIO.h"
 #include "performanceCounter/performanceCounter.h"
 #include "insertRows/insertRows.h"
@@ -43,6 +44,24 @@ ImplicitNewmarkSparse::ImplicitNewmarkSparse(int r, double timestep, SparseMatri
 
   useStaticSolver = false;
 
+  useLaggedJacobian = false;
+  laggedJacobianIsValid = false;
+  laggedJacobianContractionThreshold = 0.5;
+  laggedJacobianMaxAge = 10;
+  laggedJacobianAge = 0;
+  laggedJacobianStartError = 0.0;
+  numFactorizations = 0;
+
+  predictorOrder = 0;
+  predictorHistory = 0;
+  predictorConsecutiveRejections = 0;
+  predictorSuspendedSteps = 0;
+  predictorForces = NULL;
+  predictorAccel = NULL;
+  numPredictedTimesteps = 0;
+  numRejectedPredictions = 0;
+  predictorIterationsSaved = 0.0;
+
   UpdateAlphas();
 
   forceModel->GetTangentStiffnessMatrixTopology(&tangentStiffnessMatrix);
@@ -64,33 +83,379 @@ ImplicitNewmarkSparse::ImplicitNewmarkSparse(int r, double timestep, SparseMatri
     exit(1);
   }
 
-  bufferConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
-
-  systemMatrix = new SparseMatrix(*tangentStiffnessMatrix);
-  systemMatrix->RemoveRowsColumns(numConstrainedDOFs, constrainedDOFs);
-  systemMatrix->BuildSuperMatrixIndices(numConstrainedDOFs, constrainedDOFs, tangentStiffnessMatrix);
+  // the reduced system matrix (the effective stiffness matrix with the constrained rows and columns removed) is built by RebuildSystemMatrix, 
+  // only if a solver needs it: the direct solvers, and PCG with the in-place constraints disabled
+  systemMatrix = NULL;
+  bufferConstrained = NULL;
+  numSystemMatrixConstrainedDOFs = 0;
+  systemMatrixConstrainedDOFs = NULL;
+  systemMatrixConstraintsChanged = true;
+  numChangedConstraintDOFs = 0;
+  maxConstraintUpdateDOFs = 64;
+  constraintUpdateSolver = NULL;
 
   #ifdef PARDISO
     printf("Creating Pardiso solver. Positive-definite solver: %d. Num threads: %d\n", positiveDefiniteSolver, numSolverThreads);
-    pardisoSolver = new PardisoSolver(systemMatrix, numSolverThreads, positiveDefiniteSolver);
+    pardisoSolver = NULL;
+  #endif
+
+  #ifdef SPOOLES
+    spoolesSolver = NULL;
   #endif
 
+  useInPlaceConstraints = false;
+
   #ifdef PCG
-    jacobiPreconditionedCGSolver = new CGSolver(systemMatrix);
+    jacobiPreconditionedCGSolver = NULL;
+
+    tangentStiffnessMatrix->BuildDiagonalIndices();
+    projectedCGDiagonal = (double*) malloc (sizeof(double) * r);
+    projectedCGSolver = new CGSolver(r, ImplicitNewmarkSparse::ProjectedSystemMatrixProduct, (void*)this);
+    useInPlaceConstraints = true;
   #endif
+
+  if (!useInPlaceConstraints)
+    RebuildSystemMatrix();
 }
 
 ImplicitNewmarkSparse::~ImplicitNewmarkSparse()
 {
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+  #endif
+
+  #ifdef PCG
+    delete(projectedCGSolver);
+    free(projectedCGDiagonal);
+    delete(jacobiPreconditionedCGSolver);
+  #endif
+
+  delete(constraintUpdateSolver);
+  free(systemMatrixConstrainedDOFs);
+  delete(systemMatrix);
+
   delete(tangentStiffnessMatrix);
   delete(rayleighDampingMatrix);
   free(bufferConstrained);
+  free(predictorForces);
+  free(predictorAccel);
 }
 
 void ImplicitNewmarkSparse::SetDampingMatrix(SparseMatrix * dampingMatrix)
 {
   IntegratorBaseSparse::SetDampingMatrix(dampingMatrix);
   tangentStiffnessMatrix->BuildSubMatrixIndices(*dampingMatrix, 1);
+  laggedJacobianIsValid = false;
+}
+
+void ImplicitNewmarkSparse::SetInternalForceScalingFactor(double internalForceScalingFactor)
+{
+  IntegratorBaseSparse::SetInternalForceScalingFactor(internalForceScalingFactor);
+  laggedJacobianIsValid = false;
+}
+
+void ImplicitNewmarkSparse::UseInPlaceConstraints(bool useInPlaceConstraints_)
+{
+  #ifdef PCG
+    useInPlaceConstraints = useInPlaceConstraints_;
+  #else
+    if (useInPlaceConstraints_)
+      printf("Warning: in-place constraints are only supported by the PCG solver. Using the reduced system matrix.\n");
+  #endif
+  laggedJacobianIsValid = false;
+}
+
+#ifdef PCG
+// Ax = tangentStiffnessMatrix * x, with the constrained rows zeroed out
+// (CG keeps x zero at the constrained DOFs, therefore the constrained columns do not contribute either)
+void ImplicitNewmarkSparse::ProjectedSystemMatrixProduct(const void * data, const double * x, double * Ax)
+{
+  ImplicitNewmarkSparse * integrator = (ImplicitNewmarkSparse*) data;
+  integrator->tangentStiffnessMatrix->MultiplyVector(x, Ax);
+  for(int i=0; i<integrator->numConstrainedDOFs; i++)
+    Ax[integrator->constrainedDOFs[i]] = 0.0;
+}
+
+int ImplicitNewmarkSparse::SolveWithInPlaceConstraints(double * x, double * rhs)
+{
+  // Jacobi preconditioner; constrained DOFs get unit diagonal
+  tangentStiffnessMatrix->GetDiagonal(projectedCGDiagonal);
+  for(int i=0; i<numConstrainedDOFs; i++)
+  {
+    projectedCGDiagonal[constrainedDOFs[i]] = 1.0;
+    rhs[constrainedDOFs[i]] = 0.0;
+  }
+  projectedCGSolver->SetDiagonal(projectedCGDiagonal);
+
+  memset(x, 0, sizeof(double) * r);
+  return projectedCGSolver->SolveLinearSystemWithJacobiPreconditioner(x, rhs, 1e-6, 10000);
+}
+#endif
+
+void ImplicitNewmarkSparse::SetConstrainedDOFs(int numConstrainedDOFs_, int * constrainedDOFs_)
+{
+  free(constrainedDOFs);
+  numConstrainedDOFs = numConstrainedDOFs_;
+  constrainedDOFs = (int*) malloc (sizeof(int) * numConstrainedDOFs);
+  memcpy(constrainedDOFs, constrainedDOFs_, sizeof(int) * numConstrainedDOFs);
+
+  for(int i=0; i<numConstrainedDOFs; i++)
+    q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+  systemMatrixConstraintsChanged = true;
+  delete(constraintUpdateSolver);
+  constraintUpdateSolver = NULL;
+
+  // count the DOFs whose constraint status differs from the constraints that systemMatrix was built for (both lists are sorted)
+  numChangedConstraintDOFs = 0;
+  int i = 0, j = 0;
+  while ((i < numSystemMatrixConstrainedDOFs) || (j < numConstrainedDOFs))
+  {
+    if ((j == numConstrainedDOFs) || ((i < numSystemMatrixConstrainedDOFs) && (systemMatrixConstrainedDOFs[i] < constrainedDOFs[j])))
+    {
+      numChangedConstraintDOFs++; // released
+      i++;
+    }
+    else if ((i == numSystemMatrixConstrainedDOFs) || (constrainedDOFs[j] < systemMatrixConstrainedDOFs[i]))
+    {
+      numChangedConstraintDOFs++; // newly constrained
+      j++;
+    }
+    else
+    {
+      i++;
+      j++;
+    }
+  }
+
+  if ((numChangedConstraintDOFs == 0) && (systemMatrix != NULL))
+  {
+    // back to the constraints of systemMatrix: its factorization is valid as is
+    systemMatrixConstraintsChanged = false;
+    return;
+  }
+
+  // keep the factorization of the current effective stiffness matrix (if any); it is corrected for the changed DOFs before the next solve
+  if (UseConstraintUpdate())
+    return;
+
+  laggedJacobianIsValid = false;
+}
+
+bool ImplicitNewmarkSparse::UseConstraintUpdate()
+{
+  #if defined(PARDISO) || defined(SPOOLES)
+    return systemMatrixConstraintsChanged && (systemMatrix != NULL) && (numChangedConstraintDOFs <= maxConstraintUpdateDOFs);
+  #else
+    return false;
+  #endif
+}
+
+int ImplicitNewmarkSparse::BuildConstraintUpdateSolver()
+{
+  delete(constraintUpdateSolver);
+  constraintUpdateSolver = NULL;
+
+  #if defined(PARDISO) || defined(SPOOLES)
+    // the base solver holds the factorization of systemMatrix, i.e., of the effective stiffness matrix (tangentStiffnessMatrix) reduced to systemMatrixConstrainedDOFs
+    #ifdef PARDISO
+      LinearSolver * baseSolver = pardisoSolver;
+    #else
+      LinearSolver * baseSolver = spoolesSolver;
+    #endif
+    try
+    {
+      constraintUpdateSolver = new ConstraintUpdateSolver(tangentStiffnessMatrix, numSystemMatrixConstrainedDOFs, systemMatrixConstrainedDOFs, baseSolver, numConstrainedDOFs, constrainedDOFs);
+    }
+    catch(int eCode)
+    {
+      printf("Error: unable to correct the factorization for the changed constraints. Code: %d\n", eCode);
+      return 1;
+    }
+    statistics.numAllocations++;
+  #endif
+
+  return 0;
+}
+
+void ImplicitNewmarkSparse::RebuildSystemMatrix()
+{
+  delete(constraintUpdateSolver);
+  constraintUpdateSolver = NULL;
+
+  delete(systemMatrix);
+  systemMatrix = new SparseMatrix(*tangentStiffnessMatrix);
+  systemMatrix->FreeDiagonalIndices(); // the diagonal indices of tangentStiffnessMatrix are not valid for the reduced matrix
+  systemMatrix->RemoveRowsColumns(numConstrainedDOFs, constrainedDOFs);
+  systemMatrix->BuildSuperMatrixIndices(numConstrainedDOFs, constrainedDOFs, tangentStiffnessMatrix);
+
+  free(bufferConstrained);
+  bufferConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
+  statistics.numAllocations += 2;
+
+  #ifdef PARDISO
+    delete(pardisoSolver);
+    PerformanceCounter counterSymbolicFactorizationTime;
+    #ifdef PARDISO_MIXED_PRECISION
+      pardisoSolver = new MixedPrecisionSolver(systemMatrix, numSolverThreads, positiveDefiniteSolver);
+    #else
+      pardisoSolver = new PardisoSolver(systemMatrix, numSolverThreads, positiveDefiniteSolver);
+    #endif
+    counterSymbolicFactorizationTime.StopCounter();
+    statistics.symbolicFactorizationTime = counterSymbolicFactorizationTime.GetElapsedTime();
+    statistics.numAllocations++;
+  #endif
+
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+    spoolesSolver = NULL;
+  #endif
+
+  #ifdef PCG
+    delete(jacobiPreconditionedCGSolver);
+    jacobiPreconditionedCGSolver = new CGSolver(systemMatrix);
+    statistics.numAllocations++;
+  #endif
+
+  free(systemMatrixConstrainedDOFs);
+  numSystemMatrixConstrainedDOFs = numConstrainedDOFs;
+  systemMatrixConstrainedDOFs = (int*) malloc (sizeof(int) * numConstrainedDOFs);
+  memcpy(systemMatrixConstrainedDOFs, constrainedDOFs, sizeof(int) * numConstrainedDOFs);
+  statistics.numAllocations++;
+  systemMatrixConstraintsChanged = false;
+  numChangedConstraintDOFs = 0;
+
+  laggedJacobianIsValid = false;
+}
+
+void ImplicitNewmarkSparse::UseLaggedJacobian(bool useLaggedJacobian_, double contractionThreshold, int maxAge)
+{
+  useLaggedJacobian = useLaggedJacobian_;
+  laggedJacobianContractionThreshold = contractionThreshold;
+  laggedJacobianMaxAge = maxAge;
+  laggedJacobianIsValid = false;
+  laggedJacobianStartError = 0.0;
+}
+
+int ImplicitNewmarkSparse::ChangeConstrainedDOFs(int numConstrainedDOFs_, int * constrainedDOFs_)
+{
+  laggedJacobianIsValid = false;
+  SetConstrainedDOFs(numConstrainedDOFs_, constrainedDOFs_);
+  return 0;
+}
+
+int ImplicitNewmarkSparse::FactorSystemMatrix()
+{
+  if (!useInPlaceConstraints)
+    systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+
+  int info = 0;
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+    spoolesSolver = new SPOOLESSolver(systemMatrix);
+    statistics.numAllocations++;
+  #endif
+
+  #ifdef PARDISO
+    info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+  #endif
+
+  return info;
+}
+
+// state layout: IntegratorBaseSparse state, tangentStiffnessMatrix (effective stiffness) and rayleighDampingMatrix entries,
+// laggedJacobianIsValid, laggedJacobianAge, predictorHistory, predictorConsecutiveRejections, predictorSuspendedSteps, laggedJacobianStartError, predictorAccel
+size_t ImplicitNewmarkSparse::GetStateSize()
+{
+  return IntegratorBaseSparse::GetStateSize() + GetMatrixStateSize(tangentStiffnessMatrix) + GetMatrixStateSize(rayleighDampingMatrix) + 5 * sizeof(int) + sizeof(double) * (r + 1);
+}
+
+void ImplicitNewmarkSparse::SaveState(char * data)
+{
+  IntegratorBaseSparse::SaveState(data);
+  data += IntegratorBaseSparse::GetStateSize();
+
+  data = SaveMatrixEntries(data, tangentStiffnessMatrix);
+  data = SaveMatrixEntries(data, rayleighDampingMatrix);
+
+  // a factorization corrected for changed constraints cannot be restored
+  int flags[5];
+  flags[0] = (useLaggedJacobian && laggedJacobianIsValid && (constraintUpdateSolver == NULL) && (useInPlaceConstraints || !systemMatrixConstraintsChanged)) ? 1 : 0;
+  flags[1] = laggedJacobianAge;
+  flags[2] = predictorHistory;
+  flags[3] = predictorConsecutiveRejections;
+  flags[4] = predictorSuspendedSteps;
+  data = SaveData(data, flags, sizeof(int) * 5);
+  data = SaveData(data, &laggedJacobianStartError, sizeof(double));
+
+  if (predictorAccel != NULL)
+    SaveData(data, predictorAccel, sizeof(double) * r);
+  else
+    memset(data, 0, sizeof(double) * r);
+}
+
+int ImplicitNewmarkSparse::LoadState(const char * data, size_t size)
+{
+  if (size < ImplicitNewmarkSparse::GetStateSize())
+  {
+    printf("Error: integrator state is too short (%d bytes).\n", (int)size);
+    return 1;
+  }
+
+  if (IntegratorBaseSparse::LoadState(data, size) != 0)
+    return 1;
+  data += IntegratorBaseSparse::GetStateSize();
+
+  data = LoadMatrixEntries(data, tangentStiffnessMatrix);
+  if (data != NULL)
+    data = LoadMatrixEntries(data, rayleighDampingMatrix);
+  if (data == NULL)
+  {
+    laggedJacobianIsValid = false;
+    return 1;
+  }
+
+  int flags[5];
+  data = LoadData(data, flags, sizeof(int) * 5);
+  laggedJacobianAge = flags[1];
+  predictorHistory = flags[2];
+  predictorConsecutiveRejections = flags[3];
+  predictorSuspendedSteps = flags[4];
+  data = LoadData(data, &laggedJacobianStartError, sizeof(double));
+
+  if (predictorAccel != NULL)
+    LoadData(data, predictorAccel, sizeof(double) * r);
+
+  // the factorization is not part of the state: recompute it from the restored effective stiffness matrix
+  laggedJacobianIsValid = false;
+  if (flags[0] && useLaggedJacobian)
+  {
+    if (systemMatrixConstraintsChanged && !useInPlaceConstraints)
+      RebuildSystemMatrix();
+    if (FactorSystemMatrix() == 0)
+      laggedJacobianIsValid = true;
+  }
+
+  return 0;
+}
+
+void ImplicitNewmarkSparse::UseNewtonPredictor(int order)
+{
+  if ((order < 0) || (order > 3))
+  {
+    printf("Warning: invalid Newton predictor order %d. Disabling the predictor.\n", order);
+    order = 0;
+  }
+
+  predictorOrder = order;
+  predictorConsecutiveRejections = 0;
+  predictorSuspendedSteps = 0;
+
+  if ((predictorOrder > 0) && (predictorForces == NULL))
+  {
+    predictorForces = (double*) malloc (sizeof(double) * r);
+    predictorAccel = (double*) calloc (r, sizeof(double));
+  }
 }
 
 void ImplicitNewmarkSparse::UpdateAlphas()
@@ -101,12 +466,16 @@ void ImplicitNewmarkSparse::UpdateAlphas()
   alpha4 = NewmarkGamma / (NewmarkBeta * timestep);
   alpha5 = 1 - NewmarkGamma/NewmarkBeta;
   alpha6 = (1.0 - NewmarkGamma / (2.0 * NewmarkBeta)) * timestep;
+
+  // the effective stiffness matrix depends on the timestep and the Newmark parameters
+  laggedJacobianIsValid = false;
 }
 
 // sets the state based on given q, qvel
 // automatically computes acceleration assuming zero external force
 int ImplicitNewmarkSparse::SetState(double * q_, double * qvel_)
 {
+  predictorHistory = 0;
   memcpy(q, q_, sizeof(double)*r);
 
   if (qvel_ != NULL)
@@ -133,13 +502,33 @@ int ImplicitNewmarkSparse::SetState(double * q_, double * qvel_)
   for(int i=0; i<r; i++)
     buffer[i] = -buffer[i] - internalForces[i];
 
+  if (systemMatrixConstraintsChanged && !useInPlaceConstraints)
+    RebuildSystemMatrix();
+
   // solve M * qaccel = buffer
-  RemoveRows(r, bufferConstrained, buffer, numConstrainedDOFs, constrainedDOFs);
 
   // use tangentStiffnessMatrix as the buffer place
   tangentStiffnessMatrix->ResetToZero();
   tangentStiffnessMatrix->AddSubMatrix(1.0, *massMatrix);
   tangentStiffnessMatrix->AddSubMatrix(1.0, *dampingMatrix, 1);
+
+  // the system matrix (and the solver) is overwritten below
+  laggedJacobianIsValid = false;
+
+  #ifdef PCG
+    if (useInPlaceConstraints)
+    {
+      int info = SolveWithInPlaceConstraints(qaccel, buffer);
+      if (info < 0)
+      {
+        printf("Error: PCG sparse solver returned non-zero exit status %d.\n", info);
+        return 1;
+      }
+      return 0;
+    }
+  #endif
+
+  RemoveRows(r, bufferConstrained, buffer, numConstrainedDOFs, constrainedDOFs);
   systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix); // must go via a matrix with tangentStiffnessMatrix's topology, because the AssignSuperMatrix indices were computed with respect to such topology
 
   memset(buffer, 0, sizeof(double) * r);
@@ -177,13 +566,61 @@ int ImplicitNewmarkSparse::SetState(double * q_, double * qvel_)
   return 0;
 }
  
+void ImplicitNewmarkSparse::BuildResidual(bool newStiffnessMatrix)
+{
+  memset(qresidual, 0, sizeof(double) * r);
+
+  if (useStaticSolver)
+  {
+    // no operation
+  }
+  else
+  {
+    if (newStiffnessMatrix)
+    {
+      // build effective stiffness: add mass matrix and damping matrix to tangentStiffnessMatrix
+      tangentStiffnessMatrix->ScalarMultiply(dampingStiffnessCoef, rayleighDampingMatrix);
+      rayleighDampingMatrix->AddSubMatrix(dampingMassCoef, *massMatrix);
+
+      rayleighDampingMatrix->ScalarMultiplyAdd(alpha4, tangentStiffnessMatrix);
+      //*tangentStiffnessMatrix += alpha4 * *rayleighDampingMatrix;
+      tangentStiffnessMatrix->AddSubMatrix(alpha4, *dampingMatrix, 1);
+
+      tangentStiffnessMatrix->AddSubMatrix(alpha1, *massMatrix);
+    }
+    // else: keep the effective stiffness (and the Rayleigh damping matrix) from the last assembly
+    
+    // compute force residual, store it into aux variable qresidual
+    // qresidual = M * qaccel + C * qvel - externalForces + internalForces
+
+    massMatrix->MultiplyVector(qaccel, qresidual);
+    rayleighDampingMatrix->MultiplyVectorAdd(qvel, qresidual);
+    dampingMatrix->MultiplyVectorAdd(qvel, qresidual);
+  }
+
+  // add externalForces, internalForces
+  for(int i=0; i<r; i++)
+  {
+    qresidual[i] += internalForces[i] - externalForces[i];
+    qresidual[i] *= -1;
+    qdelta[i] = qresidual[i];
+  }
+}
+
 int ImplicitNewmarkSparse::DoTimestep()
 {
   int numIter = 0;
 
+  statistics.BeginTimestep();
+  PerformanceCounter counterTimestep;
+
   double error0 = 0; // error after the first step
   double errorQuotient;
 
+  // keep the acceleration of the previous timestep for the third-order predictor
+  if (predictorOrder >= 3)
+    memcpy(predictorAccel, qaccel_1, sizeof(double) * r);
+
   // store current amplitudes and set initial guesses for qaccel, qvel
   for(int i=0; i<r; i++)
   {
@@ -195,10 +632,74 @@ int ImplicitNewmarkSparse::DoTimestep()
     qvel[i] = alpha4 * (q[i] - q_1[i]) + alpha5 * qvel_1[i] + alpha6 * qaccel_1[i];
   }
 
+  // lagged Jacobian: refactor once the factorization has been reused for laggedJacobianMaxAge timesteps
+  if ((laggedJacobianMaxAge > 0) && (laggedJacobianAge >= laggedJacobianMaxAge))
+    laggedJacobianIsValid = false;
+  laggedJacobianAge++;
+  double errorPrevious = 0; // error at the previous iteration
+
+  // Newton predictor: start from an extrapolated state instead of the previous state
+  // the residual at the previous state is evaluated first; it remains the reference of the relative convergence criterion
+  bool predicted = false;
+  bool predictionRejected = false;
+  double errorPredicted = 0.0;
+  if ((predictorOrder > 0) && (predictorHistory > 0) && !useStaticSolver)
+  {
+    if (predictorSuspendedSteps > 0)
+      predictorSuspendedSteps--;
+    else
+    {
+      PerformanceCounter counterForceAssemblyTime;
+      forceModel->GetInternalForce(q, internalForces);
+      counterForceAssemblyTime.StopCounter();
+      statistics.forceAssemblyTime += counterForceAssemblyTime.GetElapsedTime();
+
+      for(int i=0; i<r; i++)
+        internalForces[i] *= internalForceScalingFactor;
+      BuildResidual(false);
+      memcpy(predictorForces, internalForces, sizeof(double) * r);
+
+      for(int i=0; i<numConstrainedDOFs; i++)
+        qresidual[constrainedDOFs[i]] = 0.0;
+      error0 = 0;
+      for(int i=0; i<r; i++)
+        error0 += qresidual[i] * qresidual[i];
+
+      // q = q_n + h qvel_n + h^2 / 2 qaccel_n + h^2 / 6 (qaccel_n - qaccel_{n-1})
+      bool thirdOrder = (predictorOrder >= 3) && (predictorHistory > 1);
+      for(int i=0; i<r; i++)
+      {
+        double dq = timestep * qvel_1[i];
+        if (predictorOrder >= 2)
+          dq += 0.5 * timestep * timestep * qaccel_1[i];
+        if (thirdOrder)
+          dq += timestep * timestep / 6.0 * (qaccel_1[i] - predictorAccel[i]);
+
+        q[i] = q_1[i] + dq;
+        qaccel[i] = alpha1 * dq - alpha2 * qvel_1[i] - alpha3 * qaccel_1[i];
+        qvel[i] = alpha4 * dq + alpha5 * qvel_1[i] + alpha6 * qaccel_1[i];
+      }
+
+      for(int i=0; i<numConstrainedDOFs; i++)
+        q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+      predicted = true;
+    }
+  }
+
   do
   {
     int i;
 
+    // with the lagged Jacobian, the stiffness matrix is only assembled when the factorization is refreshed
+    bool refreshJacobian = !useLaggedJacobian || !laggedJacobianIsValid;
+
+    // the constraints changed: rebuild the reduced system matrix before it is refactored, 
+    // unless few DOFs changed, in which case each factorization is corrected by constraintUpdateSolver
+    if (refreshJacobian && systemMatrixConstraintsChanged && !useInPlaceConstraints && !UseConstraintUpdate())
+      RebuildSystemMatrix();
+    bool fullSizeSolve = useInPlaceConstraints || UseConstraintUpdate(); // solve with full-size vectors (no RemoveRows / InsertRows)
+
 /*
     printf("q:\n");
     for(int i=0; i<r; i++)
@@ -211,10 +712,23 @@ int ImplicitNewmarkSparse::DoTimestep()
     printf("\n");
 */
 
+    // force-first: after the first iteration, the forces and the residual are evaluated before the stiffness matrix, 
+    // which is only assembled if the residual shows that another solve is needed
+    // (with the predictor, this applies to the first iteration too);
+    // the residual uses the damping terms of the last assembly, which is exact without stiffness-proportional damping;
+    // in the full Newton mode with dampingStiffnessCoef != 0, the stiffness matrix is assembled together with the forces, so that the convergence test uses the residual at the current q
+    bool residualNeedsStiffness = !useLaggedJacobian && !useStaticSolver && (dampingStiffnessCoef != 0.0);
+    bool assembleStiffness = refreshJacobian && (((numIter == 0) && !predicted) || residualNeedsStiffness);
+
     PerformanceCounter counterForceAssemblyTime;
-    forceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    if (assembleStiffness)
+      forceModel->GetForceAndMatrix(q, internalForces, tangentStiffnessMatrix);
+    else
+      forceModel->GetInternalForce(q, internalForces);
     counterForceAssemblyTime.StopCounter();
     forceAssemblyTime = counterForceAssemblyTime.GetElapsedTime();
+    statistics.forceAssemblyTime += forceAssemblyTime;
+    PerformanceCounter counterSystemMatrixTime;
 
     //tangentStiffnessMatrix->Print();
     //tangentStiffnessMatrix->Save("K");
@@ -223,41 +737,10 @@ int ImplicitNewmarkSparse::DoTimestep()
     for(i=0; i<r; i++)
       internalForces[i] *= internalForceScalingFactor;
 
-    *tangentStiffnessMatrix *= internalForceScalingFactor;
-
-    memset(qresidual, 0, sizeof(double) * r);
-
-    if (useStaticSolver)
-    {
-      // no operation
-    }
-    else
-    {
-      // build effective stiffness: add mass matrix and damping matrix to tangentStiffnessMatrix
-      tangentStiffnessMatrix->ScalarMultiply(dampingStiffnessCoef, rayleighDampingMatrix);
-      rayleighDampingMatrix->AddSubMatrix(dampingMassCoef, *massMatrix);
-
-      rayleighDampingMatrix->ScalarMultiplyAdd(alpha4, tangentStiffnessMatrix);
-      //*tangentStiffnessMatrix += alpha4 * *rayleighDampingMatrix;
-      tangentStiffnessMatrix->AddSubMatrix(alpha4, *dampingMatrix, 1);
-
-      tangentStiffnessMatrix->AddSubMatrix(alpha1, *massMatrix);
-      
-      // compute force residual, store it into aux variable qresidual
-      // qresidual = M * qaccel + C * qvel - externalForces + internalForces
-
-      massMatrix->MultiplyVector(qaccel, qresidual);
-      rayleighDampingMatrix->MultiplyVectorAdd(qvel, qresidual);
-      dampingMatrix->MultiplyVectorAdd(qvel, qresidual);
-    }
+    if (assembleStiffness)
+      *tangentStiffnessMatrix *= internalForceScalingFactor;
 
-    // add externalForces, internalForces
-    for(i=0; i<r; i++)
-    {
-      qresidual[i] += internalForces[i] - externalForces[i];
-      qresidual[i] *= -1;
-      qdelta[i] = qresidual[i];
-    }
+    BuildResidual(assembleStiffness);
 
 /*
     printf("internal forces:\n");
@@ -276,12 +759,57 @@ int ImplicitNewmarkSparse::DoTimestep()
     printf("\n");
 */
 
+    // the constrained DOFs carry the reaction forces, which do not vanish at convergence
+    for(i=0; i<numConstrainedDOFs; i++)
+      qresidual[constrainedDOFs[i]] = 0.0;
     double error = 0;
     for(i=0; i<r; i++)
       error += qresidual[i] * qresidual[i];
 
+    if ((numIter == 0) && predicted)
+    {
+      errorPredicted = error;
+      if (error < error0)
+        errorQuotient = error / error0;
+      else
+      {
+        // the prediction did not reduce the residual: drop it, and start from the previous state
+        predictionRejected = true;
+        for(i=0; i<r; i++)
+        {
+          q[i] = q_1[i];
+          qaccel[i] = -alpha2 * qvel_1[i] - alpha3 * qaccel_1[i];
+          qvel[i] = alpha5 * qvel_1[i] + alpha6 * qaccel_1[i];
+        }
+        for(i=0; i<numConstrainedDOFs; i++)
+          q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = qaccel[constrainedDOFs[i]] = 0.0;
+
+        memcpy(internalForces, predictorForces, sizeof(double) * r);
+        if (assembleStiffness)
+        {
+          // the stiffness matrix was assembled at the rejected prediction: re-assemble it at the previous state
+          PerformanceCounter counterStiffnessAssemblyTime;
+          forceModel->GetTangentStiffnessMatrix(q, tangentStiffnessMatrix);
+          counterStiffnessAssemblyTime.StopCounter();
+          forceAssemblyTime += counterStiffnessAssemblyTime.GetElapsedTime();
+          statistics.forceAssemblyTime += counterStiffnessAssemblyTime.GetElapsedTime();
+          *tangentStiffnessMatrix *= internalForceScalingFactor;
+          BuildResidual(true);
+
+          for(i=0; i<numConstrainedDOFs; i++)
+            qresidual[constrainedDOFs[i]] = 0.0;
+          error0 = 0;
+          for(i=0; i<r; i++)
+            error0 += qresidual[i] * qresidual[i];
+        }
+        else
+          BuildResidual(false);
+        error = error0;
+        errorQuotient = 1.0;
+      }
+    }
     // on the first iteration, compute initial error
-    if (numIter == 0) 
+    else if (numIter == 0) 
     {
       error0 = error;
       errorQuotient = 1.0;
@@ -291,15 +819,52 @@ int ImplicitNewmarkSparse::DoTimestep()
       // error divided by the initial error, before performing this iteration
       errorQuotient = error / error0; 
     }
+    statistics.AddResidualNorm(sqrt(error));
+
+    // lagged Jacobian: if the residual at the start of the timestep grew too much since the previous timestep, refresh the matrix in the next iteration
+    // (with maxIterations = 1, the contraction within a timestep below is never measured)
+    if (numIter == 0)
+    {
+      if (!refreshJacobian && (laggedJacobianStartError > 0) && (laggedJacobianContractionThreshold * laggedJacobianContractionThreshold * error > laggedJacobianStartError))
+        laggedJacobianIsValid = false;
+      laggedJacobianStartError = error;
+    }
 
     if (errorQuotient < epsilon * epsilon)
     {
       break;
     }
 
+    // lagged Jacobian: if the residual did not contract fast enough with the old factorization, refresh it in the next iteration
+    if (!refreshJacobian && (numIter > 0) && (error > laggedJacobianContractionThreshold * laggedJacobianContractionThreshold * errorPrevious))
+      laggedJacobianIsValid = false;
+    errorPrevious = error;
+
+    double stiffnessAssemblyTime = 0.0;
+    if (refreshJacobian && !assembleStiffness)
+    {
+      // another solve is needed: assemble the stiffness matrix now, and rebuild the effective stiffness matrix and the residual with it
+      PerformanceCounter counterStiffnessAssemblyTime;
+      forceModel->GetTangentStiffnessMatrix(q, tangentStiffnessMatrix);
+      counterStiffnessAssemblyTime.StopCounter();
+      stiffnessAssemblyTime = counterStiffnessAssemblyTime.GetElapsedTime();
+      forceAssemblyTime += stiffnessAssemblyTime;
+      statistics.forceAssemblyTime += stiffnessAssemblyTime;
+
+      *tangentStiffnessMatrix *= internalForceScalingFactor;
+      BuildResidual(true);
+    }
+    if (refreshJacobian)
+      statistics.numStiffnessAssemblies++;
+
     //tangentStiffnessMatrix->Save("Keff");
-    RemoveRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
-    systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+    if (!fullSizeSolve)
+      RemoveRows(r, bufferConstrained, qdelta, numConstrainedDOFs, constrainedDOFs);
+    if (refreshJacobian && !useInPlaceConstraints)
+      systemMatrix->AssignSuperMatrix(tangentStiffnessMatrix);
+
+    counterSystemMatrixTime.StopCounter();
+    statistics.systemMatrixTime += counterSystemMatrixTime.GetElapsedTime() - stiffnessAssemblyTime;
 
     // solve: systemMatrix * buffer = bufferConstrained
 
@@ -307,20 +872,84 @@ int ImplicitNewmarkSparse::DoTimestep()
     memset(buffer, 0, sizeof(double) * r);
 
     #ifdef SPOOLES
-      SPOOLESSolver solver(systemMatrix);
-      int info = solver.SolveLinearSystem(buffer, bufferConstrained);
+      if (refreshJacobian)
+      {
+        PerformanceCounter counterFactorizationTime;
+        delete(spoolesSolver);
+        spoolesSolver = new SPOOLESSolver(systemMatrix);
+        counterFactorizationTime.StopCounter();
+        statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+        statistics.numFactorizations++;
+        statistics.numAllocations++;
+      }
+      int info = 0;
+      if (UseConstraintUpdate() && (refreshJacobian || (constraintUpdateSolver == NULL)))
+        info = BuildConstraintUpdateSolver();
+      PerformanceCounter counterSolveTime;
+      if (info == 0)
+      {
+        if (constraintUpdateSolver != NULL)
+          info = constraintUpdateSolver->SolveLinearSystem(buffer, qdelta);
+        else
+          info = spoolesSolver->SolveLinearSystem(buffer, bufferConstrained);
+      }
+      counterSolveTime.StopCounter();
+      statistics.solveTime += counterSolveTime.GetElapsedTime();
+      if (!useLaggedJacobian)
+      {
+        delete(constraintUpdateSolver);
+        constraintUpdateSolver = NULL;
+        delete(spoolesSolver);
+        spoolesSolver = NULL;
+      }
       char solverString[16] = "SPOOLES";
     #endif
 
     #ifdef PARDISO
-      int info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+      int info = 0;
+      if (refreshJacobian)
+      {
+        PerformanceCounter counterFactorizationTime;
+        info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+        counterFactorizationTime.StopCounter();
+        statistics.factorizationTime += counterFactorizationTime.GetElapsedTime();
+        statistics.numFactorizations++;
+      }
+      if ((info == 0) && UseConstraintUpdate() && (refreshJacobian || (constraintUpdateSolver == NULL)))
+        info = BuildConstraintUpdateSolver();
       if (info == 0)
-        info = pardisoSolver->SolveLinearSystem(buffer, bufferConstrained);
+      {
+        PerformanceCounter counterSolveTime;
+        if (constraintUpdateSolver != NULL)
+          info = constraintUpdateSolver->SolveLinearSystem(buffer, qdelta);
+        else
+          info = pardisoSolver->SolveLinearSystem(buffer, bufferConstrained);
+        counterSolveTime.StopCounter();
+        statistics.solveTime += counterSolveTime.GetElapsedTime();
+        #ifdef PARDISO_MIXED_PRECISION
+          statistics.numSolverIterations += pardisoSolver->GetNumRefinementIterations();
+          statistics.solverResidualError = pardisoSolver->GetResidualError();
+        #endif
+      }
       char solverString[16] = "PARDISO";
     #endif
 
     #ifdef PCG
-      int info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, bufferConstrained, 1e-6, 10000);
+      PerformanceCounter counterSolveTime;
+      int info;
+      if (useInPlaceConstraints)
+      {
+        info = SolveWithInPlaceConstraints(buffer, qdelta);
+        statistics.solverResidualError = projectedCGSolver->GetResidualError();
+      }
+      else
+      {
+        info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(buffer, bufferConstrained, 1e-6, 10000);
+        statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
+      }
+      counterSolveTime.StopCounter();
+      statistics.solveTime += counterSolveTime.GetElapsedTime();
+      statistics.numSolverIterations += abs(info);
       if (info > 0)
         info = 0;
       char solverString[16] = "PCG";
@@ -329,13 +958,28 @@ int ImplicitNewmarkSparse::DoTimestep()
     if (info != 0)
     {
       printf("Error: %s sparse solver returned non-zero exit status %d.\n", solverString, (int)info);
+      laggedJacobianIsValid = false;
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
       return 1;
     }
 
     counterSystemSolveTime.StopCounter();
     systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+    statistics.numNewtonIterations++;
+    statistics.systemMatrixNNZ = useInPlaceConstraints ? tangentStiffnessMatrix->GetNumEntries() : systemMatrix->GetNumEntries();
 
-    InsertRows(r, buffer, qdelta, numConstrainedDOFs, constrainedDOFs);
+    if (refreshJacobian)
+    {
+      numFactorizations++;
+      laggedJacobianIsValid = true;
+      laggedJacobianAge = 0;
+    }
+
+    if (fullSizeSolve)
+      memcpy(qdelta, buffer, sizeof(double) * r);
+    else
+      InsertRows(r, buffer, qdelta, numConstrainedDOFs, constrainedDOFs);
 
 /*
     printf("qdelta:\n");
@@ -377,12 +1021,62 @@ int ImplicitNewmarkSparse::DoTimestep()
     //printf("Warning: method did not converge in max number of iterations.\n");
   //}
 
+  if (predicted)
+    UpdatePredictorStatistics(predictionRejected, error0, errorPredicted);
+  predictorHistory++;
+
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
   return 0;
 }
 
+void ImplicitNewmarkSparse::UpdatePredictorStatistics(bool rejected, double error0, double errorPredicted)
+{
+  if (rejected)
+  {
+    statistics.predictorStatus = -1;
+    numRejectedPredictions++;
+
+    // the predictor keeps failing (e.g., in non-smooth motion): stop paying for the extra force evaluation for a while
+    predictorConsecutiveRejections++;
+    if (predictorConsecutiveRejections >= 3)
+    {
+      predictorConsecutiveRejections = 0;
+      predictorSuspendedSteps = 10;
+    }
+    return;
+  }
+
+  statistics.predictorStatus = 1;
+  numPredictedTimesteps++;
+  predictorConsecutiveRejections = 0;
+
+  // estimate of the saved Newton iterations: the residual reduction achieved by the predictor, 
+  // expressed in the average per-iteration residual reduction of the Newton iterations of this timestep
+  double saved;
+  int numSolves = statistics.numNewtonIterations;
+  if (numSolves == 0)
+    saved = 1.0; // converged at the predicted state
+  else
+  {
+    double predictorReduction = sqrt(errorPredicted / error0);
+    double newtonReduction = statistics.residualNorms[statistics.numResiduals - 1] / sqrt(errorPredicted);
+    double contraction = pow(newtonReduction, 1.0 / numSolves);
+    if ((contraction > 0.0) && (contraction < 1.0) && (predictorReduction > 0.0))
+      saved = log(predictorReduction) / log(contraction);
+    else
+      saved = 0.0;
+  }
+  statistics.predictorIterationsSaved = saved;
+  predictorIterationsSaved += saved;
+}
+
 void ImplicitNewmarkSparse::UseStaticSolver(bool useStaticSolver_)
 { 
   useStaticSolver = useStaticSolver_;
+  laggedJacobianIsValid = false;
+  predictorHistory = 0;
 
   if (!useStaticSolver) 
   {
@@ -394,3 +1088,10 @@ void ImplicitNewmarkSparse::UseStaticSolver(bool useStaticSolver_)
   }
 } 
 
+
+void ImplicitNewmarkSparse::GetLocalErrorEstimate(double * error)
+{
+  double factor = (NewmarkBeta - 1.0 / 6.0) * timestep * timestep;
+  for(int i=0; i<r; i++)
+    error[i] = factor * (qaccel[i] - qaccel_1[i]);
+}
@@ -38,6 +38,17 @@
   You can switch between these solvers at compile time,
   by modifying the file integratorSolverSelection.h (see below)
   (run-time solver switching would be possible too with more coding).
+
+  Each Newton iteration after the first one evaluates the internal forces and the 
+  residual first, and assembles the tangent stiffness matrix (if the factorization 
+  is to be refreshed) only if the iteration did not converge, so that the last 
+  iteration of a timestep does not assemble a stiffness matrix that would never be 
+  used. The Newmark residual needs the stiffness matrix only through the 
+  stiffness-proportional Rayleigh damping: it uses the damping matrix of the last 
+  assembly, except in the full Newton mode with dampingStiffnessCoef != 0, where the 
+  stiffness matrix is assembled together with the internal forces in every iteration. 
+  Backward Euler tests convergence on the residual of its nonlinear equations, 
+  which does not involve the stiffness matrix.
 */
 
 #ifndef _IMPLICITNEWMARKSPARSE_H_
@@ -68,6 +79,7 @@
 #ifdef PCG
   #include "sparseSolver/CGSolver.h"
 #endif
+#include "sparseSolver/ConstraintUpdateSolver.h"
 
 class ImplicitNewmarkSparse : public IntegratorBaseSparse
 {
@@ -83,6 +95,7 @@ public:
   // damping matrix provides damping in addition to mass and stiffness damping (it does not replace it)
   virtual void SetDampingMatrix(SparseMatrix * dampingMatrix);
   inline virtual void SetTimestep(double timestep) { this->timestep = timestep; UpdateAlphas(); }
+  virtual void SetInternalForceScalingFactor(double internalForceScalingFactor);
 
   // sets q, qvel 
   // automatically computes acceleration assuming zero external force
@@ -97,13 +110,82 @@ public:
   inline void SetNewmarkBeta(double NewmarkBeta) { this->NewmarkBeta = NewmarkBeta; UpdateAlphas(); }
   inline void SetNewmarkGamma(double NewmarkGamma) { this->NewmarkGamma = NewmarkGamma; UpdateAlphas(); }
 
+  // estimate of the local (truncation) error in q of the last timestep, written into "error" (a vector of length r); used for adaptive timestepping (see AdaptiveTimestepController)
+  // Newmark: (NewmarkBeta - 1/6) * timestep^2 * (qaccel_{n+1} - qaccel_n)  (Zienkiewicz and Xie 1991)
+  virtual void GetLocalErrorEstimate(double * error);
+  // the local error is O(timestep^{p+1}), where p is the order returned here (2 for NewmarkGamma=0.5, 1 otherwise)
+  virtual int GetErrorOrder() { return (NewmarkGamma == 0.5) ? 2 : 1; }
+
   // dynamic solver is default (i.e. useStaticSolver=false)
   virtual void UseStaticSolver(bool useStaticSolver);
 
+  // lagged-Jacobian (modified Newton) mode; default: disabled
+  // the effective stiffness matrix and its factorization are kept, and reused as a fixed Jacobian across Newton iterations and timesteps;
+  // in between refactorizations, only the internal forces are evaluated (no stiffness matrix assembly)
+  // the matrix is re-assembled and refactored when:
+  //   the residual contraction rate ||residual_k|| / ||residual_{k-1}|| of a Newton iteration exceeds "contractionThreshold" (the next iteration then uses a fresh matrix), or
+  //   the residual at the start of a timestep is larger than 1 / "contractionThreshold" times the residual at the start of the previous timestep
+  //   (the next iteration, or with maxIterations = 1 the next timestep, then uses a fresh matrix), or
+  //   the factorization has been reused for "maxAge" timesteps (maxAge <= 0 means no age limit), or
+  //   the timestep, Newmark parameters, internal force scaling factor, damping matrix or the static/dynamic solver mode are changed
+  // note: the stiffness-proportional part of the Rayleigh damping is lagged together with the stiffness matrix
+  // note: call InvalidateLaggedJacobian if you change the damping coefficients or the mass matrix
+  // note: with the PCG solver, there is no factorization to keep; in that case, the mode only saves the stiffness matrix assembly
+  // accuracy: with maxIterations = 1 (the default), each timestep takes a single Newton step, so a lagged matrix changes the result;
+  //   the error grows with the lag: with the defaults, the tip deflection of the bent beam in laggedJacobianTest differs from the full Newton mode by about 1%
+  //   (18 instead of 100 factorizations), and by about 10% with no age limit (maxAge = 0); lower maxAge and/or contractionThreshold to reduce the error;
+  //   with maxIterations > 1, the iteration converges to the same solution as the full Newton mode (up to epsilon), using more (cheaper) iterations
+  void UseLaggedJacobian(bool useLaggedJacobian, double contractionThreshold=0.5, int maxAge=10);
+  inline void InvalidateLaggedJacobian() { laggedJacobianIsValid = false; }
+
+  // Newton predictor; default: disabled (order = 0)
+  // each timestep starts the Newton iteration from a state extrapolated from the previous timesteps, instead of the previous state:
+  //   order 1: q = q_n + h qvel_n
+  //   order 2: q = q_n + h qvel_n + h^2 / 2 qaccel_n
+  //   order 3: q = q_n + h qvel_n + h^2 / 2 qaccel_n + h^2 / 6 (qaccel_n - qaccel_{n-1})
+  // the residual at the previous state is evaluated too (one extra internal force evaluation per timestep), and the prediction
+  // is dropped if it does not reduce the residual; after 3 consecutive dropped predictions, the predictor is suspended for 10 timesteps
+  // the convergence criterion remains relative to the residual at the previous state, so the predictor saves iterations without changing the tolerance
+  // note: not used by ImplicitBackwardEulerSparse (its Newton iteration linearizes around the previous state), and by the static solver
+  void UseNewtonPredictor(int order=2);
+  inline int GetNumPredictedTimesteps() { return numPredictedTimesteps; } // timesteps that started from an accepted prediction
+  inline int GetNumRejectedPredictions() { return numRejectedPredictions; }
+  // estimated total number of Newton iterations saved by the predictor (see IntegratorStatistics::predictorIterationsSaved)
+  inline double GetPredictorIterationsSaved() { return predictorIterationsSaved; }
+
+  // checkpointing (see integratorBase.h); the state also includes the effective stiffness and Rayleigh damping matrices, 
+  // and the lagged-Jacobian and predictor state; when a lagged Jacobian is restored, its factorization is recomputed 
+  // from the saved effective stiffness matrix (the stiffness matrix is not re-assembled)
+  // note: a factorization that was being corrected for changed constraints (see SetConstrainedDOFs) is not restored; the next timestep refactors
+  // note: with PCG and UseInPlaceConstraints(false), the Jacobi preconditioner (fixed at the first solve) is not part of the state;
+  // a restored simulation then agrees with the original one to the CG tolerance, rather than bitwise
+  virtual size_t GetStateSize();
+  virtual void SaveState(char * data);
+  virtual int LoadState(const char * data, size_t size);
+  // total number of times the system matrix was assembled and factored (in any mode)
+  inline int GetNumFactorizations() { return numFactorizations; }
+
+  // in-place constraints: the constrained DOFs are projected out inside the CG solver, which operates directly on the 
+  // full effective stiffness matrix (no RemoveRows / AssignSuperMatrix / InsertRows copies in each Newton iteration)
+  // only supported by the PCG solver, where it is the default; the direct solvers always solve with the reduced system matrix
+  // the reduced system matrix is only built (on the next solve) if the in-place constraints are disabled
+  void UseInPlaceConstraints(bool useInPlaceConstraints);
+
+  // changes the set of constrained DOFs (0-indexed, pre-sorted (ascending)); the constrained DOFs are set to zero in q, qvel, qaccel
+  // with a direct solver (PARDISO or SPOOLES), let m be the number of DOFs whose constraint status differs from the constraints that the 
+  // reduced system matrix was built for; if m <= maxConstraintUpdateDOFs (see SetMaxConstraintUpdateDOFs), the reduced system matrix is kept, 
+  // and its factorization (the current one, if any, and every later one) is corrected for the changed DOFs using a low-rank (Schur complement) update 
+  // (see sparseSolver/ConstraintUpdateSolver.h); otherwise, the reduced system matrix (and the direct solver's symbolic factorization) is rebuilt before the next solve
+  // with the in-place PCG constraints, no rebuild is necessary
+  virtual void SetConstrainedDOFs(int numConstrainedDOFs, int * constrainedDOFs);
+  // the threshold on m above which SetConstrainedDOFs rebuilds the reduced system matrix; default: 64
+  // the correction costs m solves per factorization, a dense m x m Schur complement, and O(r m) extra work per solve
+  inline void SetMaxConstraintUpdateDOFs(int maxConstraintUpdateDOFs_) { maxConstraintUpdateDOFs = maxConstraintUpdateDOFs_; }
+
 protected:
   SparseMatrix * rayleighDampingMatrix;
   SparseMatrix * tangentStiffnessMatrix;
-  SparseMatrix * systemMatrix;
+  SparseMatrix * systemMatrix; // the reduced system matrix; NULL until a solver needs it (see RebuildSystemMatrix)
 
   double * bufferConstrained;
 
@@ -116,15 +198,70 @@ protected:
   void UpdateAlphas();
   bool useStaticSolver;
 
+  // computes the force residual (qresidual, and a copy in qdelta) from internalForces and externalForces
+  // newStiffnessMatrix: tangentStiffnessMatrix holds a freshly assembled (and scaled) stiffness matrix, which is turned into the effective stiffness matrix;
+  // otherwise, the effective stiffness matrix from the last assembly is used for the residual's damping terms
+  virtual void BuildResidual(bool newStiffnessMatrix);
+
   int positiveDefiniteSolver;
   int numSolverThreads;
   #ifdef PARDISO
-    PardisoSolver * pardisoSolver;
+    #ifdef PARDISO_MIXED_PRECISION
+      MixedPrecisionSolver * pardisoSolver;
+    #else
+      PardisoSolver * pardisoSolver;
+    #endif
+  #endif
+
+  #ifdef SPOOLES
+    LinearSolver * spoolesSolver; // kept alive between solves in the lagged-Jacobian mode
   #endif
 
   #ifdef PCG
     CGSolver * jacobiPreconditionedCGSolver;
+
+    CGSolver * projectedCGSolver; // operates on the full tangentStiffnessMatrix
+    double * projectedCGDiagonal;
+    // solves tangentStiffnessMatrix * x = rhs on the unconstrained DOFs; x and rhs are full vectors (of length r), x is zero at the constrained DOFs
+    int SolveWithInPlaceConstraints(double * x, double * rhs);
+    static void ProjectedSystemMatrixProduct(const void * data, const double * x, double * Ax);
   #endif
+
+  bool useInPlaceConstraints;
+
+  // constraint changes
+  int numSystemMatrixConstrainedDOFs; // the constrained DOFs that systemMatrix (and its factorization) was built for
+  int * systemMatrixConstrainedDOFs;
+  bool systemMatrixConstraintsChanged; // true if constrainedDOFs differs from systemMatrixConstrainedDOFs, or systemMatrix was not built yet
+  ConstraintUpdateSolver * constraintUpdateSolver; // non-NULL while a factorization for systemMatrixConstrainedDOFs is being reused with the current constraints
+  int numChangedConstraintDOFs; // number of DOFs whose constraint status differs between constrainedDOFs and systemMatrixConstrainedDOFs
+  int maxConstraintUpdateDOFs;
+  bool UseConstraintUpdate(); // true if the constraints changed, and the factorizations of systemMatrix are corrected by constraintUpdateSolver (rather than rebuilding systemMatrix)
+  int BuildConstraintUpdateSolver(); // corrects the current factorization of systemMatrix for the current constraints; returns 0 on success
+  void RebuildSystemMatrix(); // rebuilds systemMatrix (and the solver) for the current constraints
+  virtual int ChangeConstrainedDOFs(int numConstrainedDOFs, int * constrainedDOFs);
+  int FactorSystemMatrix(); // copies the effective stiffness matrix into systemMatrix, and factors it (direct solvers); returns 0 on success
+
+  // lagged-Jacobian mode
+  bool useLaggedJacobian;
+  bool laggedJacobianIsValid; // true if the factorization of the current system matrix can be reused
+  double laggedJacobianContractionThreshold;
+  int laggedJacobianMaxAge;
+  int laggedJacobianAge; // number of timesteps since the last refactorization
+  double laggedJacobianStartError; // squared residual norm at the start of the previous timestep (0 if none)
+  int numFactorizations;
+
+  // Newton predictor
+  int predictorOrder;
+  int predictorHistory; // number of timesteps since the last state reset
+  int predictorConsecutiveRejections;
+  int predictorSuspendedSteps;
+  double * predictorForces; // internal forces at the previous state
+  double * predictorAccel; // qaccel_{n-1}
+  int numPredictedTimesteps;
+  int numRejectedPredictions;
+  double predictorIterationsSaved;
+  void UpdatePredictorStatistics(bool rejected, double error0, double errorPredicted);
 };
 
 #endif
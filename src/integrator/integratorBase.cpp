@@ -129,3 +129,59 @@ void IntegratorBase::ResetToRest()
   memset(qaccel_1,0,sizeof(double)*r);
 }
 
+
+// state layout: r, timestep, internalForceScalingFactor, dampingMassCoef, dampingStiffnessCoef, 
+// q, qvel, qaccel, q_1, qvel_1, qaccel_1, externalForces, internalForces
+size_t IntegratorBase::GetStateSize()
+{
+  return sizeof(int) + 4 * sizeof(double) + 8 * sizeof(double) * r;
+}
+
+void IntegratorBase::SaveState(char * data)
+{
+  data = SaveData(data, &r, sizeof(int));
+  data = SaveData(data, &timestep, sizeof(double));
+  data = SaveData(data, &internalForceScalingFactor, sizeof(double));
+  data = SaveData(data, &dampingMassCoef, sizeof(double));
+  data = SaveData(data, &dampingStiffnessCoef, sizeof(double));
+
+  double * vectors[8] = { q, qvel, qaccel, q_1, qvel_1, qaccel_1, externalForces, internalForces };
+  for(int i=0; i<8; i++)
+    data = SaveData(data, vectors[i], sizeof(double) * r);
+}
+
+int IntegratorBase::LoadState(const char * data, size_t size)
+{
+  if (size < IntegratorBase::GetStateSize())
+  {
+    printf("Error: integrator state is too short (%d bytes).\n", (int)size);
+    return 1;
+  }
+
+  int stateR;
+  data = LoadData(data, &stateR, sizeof(int));
+  if (stateR != r)
+  {
+    printf("Error: integrator state has %d DOFs, but the integrator has %d DOFs.\n", stateR, r);
+    return 1;
+  }
+
+  double stateTimestep, stateInternalForceScalingFactor;
+  data = LoadData(data, &stateTimestep, sizeof(double));
+  data = LoadData(data, &stateInternalForceScalingFactor, sizeof(double));
+  data = LoadData(data, &dampingMassCoef, sizeof(double));
+  data = LoadData(data, &dampingStiffnessCoef, sizeof(double));
+
+  double * vectors[8] = { q, qvel, qaccel, q_1, qvel_1, qaccel_1, externalForces, internalForces };
+  for(int i=0; i<8; i++)
+    data = LoadData(data, vectors[i], sizeof(double) * r);
+
+  // the setters update the derived quantities (e.g., system matrices); only call them if the value changed
+  if (stateTimestep != timestep)
+    SetTimestep(stateTimestep);
+  if (stateInternalForceScalingFactor != internalForceScalingFactor)
+    SetInternalForceScalingFactor(stateInternalForceScalingFactor);
+
+  return 0;
+}
+
@@ -64,8 +64,10 @@ class constructor. Several force model classes are provided, including
 the cubic polynomial reduced StVK model from [1], and a linearized version of 
 that model.
 
-For dense simulations, you need a BLAS and LAPACK library. This is necessary 
-to solve the r x r linear systems inside the implicit Newmark solver.
+For dense simulations (ImplicitNewmarkDense), the r x r linear systems inside 
+the implicit Newmark solver are solved with our own Gaussian elimination, which 
+is adequate for typical (small) r. For large r, a BLAS and LAPACK library 
+is faster.
 We have successfully used the following BLAS and LAPACK libraries:
 1. Windows: Intel Math Kernel Library for Windows
 2. Red Hat Linux: Intel Math Kernel Library for Linux
@@ -99,9 +101,10 @@ Both publications are available online at www.jernejbarbic.com .
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 // This abstract class is derived into: IntegratorBaseDense (dense systems)
-// and ImplicitNewmarkSparse ((large) sparse systems).
+// and IntegratorBaseSparse ((large) sparse systems).
 class IntegratorBase
 {
 public:
@@ -176,6 +179,19 @@ public:
   virtual double GetForceAssemblyTime() = 0;
   virtual double GetSystemSolveTime() = 0;
 
+  // === checkpointing (see also integratorCheckpoint.h) ===
+
+  // the state is a binary snapshot of everything that the next timesteps depend on (q, qvel, qaccel, their values at the previous timestep, 
+  // external forces, timestep, internal force scaling factor, damping coefficients, and, in the derived classes, e.g., constraints and lagged matrices), 
+  // so that a simulation restarted from it continues bitwise identically; integration parameters given to the constructor are not part of the state
+  // size of the state in bytes
+  virtual size_t GetStateSize();
+  // writes the state into "data" (GetStateSize() bytes)
+  virtual void SaveState(char * data);
+  // restores the state; the integrator must be constructed with the same parameters as the one that saved the state
+  // returns 0 on success, and non-zero if the data does not match this integrator (e.g., different r)
+  virtual int LoadState(const char * data, size_t size);
+
 protected:
 
   double * q; // current deformation amplitudes
@@ -200,6 +216,10 @@ protected:
   int r; // number of reduced DOFs 
 
   double timestep; 
+
+  // checkpoint helpers: copy "size" bytes into / out of the state data, and return the advanced data pointer
+  static inline char * SaveData(char * data, const void * src, size_t size) { memcpy(data, src, size); return data + size; }
+  static inline const char * LoadData(const char * data, void * dest, size_t size) { memcpy(dest, data, size); return data + size; }
 };
 
 #endif
@@ -0,0 +1,136 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "integratorBaseDense.h"
+
+IntegratorBaseDense::IntegratorBaseDense(int r, double timestep, double * massMatrix_, ReducedForceModel * reducedForceModel_, double dampingMassCoef, double dampingStiffnessCoef): IntegratorBase(r, timestep, dampingMassCoef, dampingStiffnessCoef), reducedForceModel(reducedForceModel_)
+{
+  systemSolveTime = 0.0;
+  forceAssemblyTime = 0.0;
+
+  massMatrix = (double*) malloc (sizeof(double) * r * r);
+  memcpy(massMatrix, massMatrix_, sizeof(double) * r * r);
+}
+
+IntegratorBaseDense::~IntegratorBaseDense()
+{
+  free(massMatrix);
+}
+
+double IntegratorBaseDense::GetKineticEnergy()
+{
+  double energy = 0.0;
+  for(int j=0; j<r; j++)
+    for(int i=0; i<r; i++)
+      energy += qvel[i] * massMatrix[r * j + i] * qvel[j];
+  return 0.5 * energy;
+}
+
+double IntegratorBaseDense::GetTotalMass()
+{
+  double mass = 0.0;
+  for(int i=0; i<r*r; i++)
+    mass += massMatrix[i];
+  return mass;
+}
+
+int IntegratorBaseDense::SolveLinearSystem(int r, double * A, int * pivots, double * b)
+{
+  // LU decomposition with partial pivoting (A = P L U)
+  for(int k=0; k<r; k++)
+  {
+    int pivot = k;
+    double pivotValue = fabs(A[r * k + k]);
+    for(int i=k+1; i<r; i++)
+    {
+      if (fabs(A[r * k + i]) > pivotValue)
+      {
+        pivot = i;
+        pivotValue = fabs(A[r * k + i]);
+      }
+    }
+
+    pivots[k] = pivot;
+    if (pivotValue == 0.0)
+      return 1;
+
+    if (pivot != k)
+    {
+      for(int j=0; j<r; j++)
+      {
+        double temp = A[r * j + k];
+        A[r * j + k] = A[r * j + pivot];
+        A[r * j + pivot] = temp;
+      }
+    }
+
+    double invPivot = 1.0 / A[r * k + k];
+    for(int i=k+1; i<r; i++)
+      A[r * k + i] *= invPivot;
+
+    for(int j=k+1; j<r; j++)
+    {
+      double Akj = A[r * j + k];
+      if (Akj == 0.0)
+        continue;
+      for(int i=k+1; i<r; i++)
+        A[r * j + i] -= A[r * k + i] * Akj;
+    }
+  }
+
+  // apply the row interchanges to b
+  for(int k=0; k<r; k++)
+  {
+    if (pivots[k] != k)
+    {
+      double temp = b[k];
+      b[k] = b[pivots[k]];
+      b[pivots[k]] = temp;
+    }
+  }
+
+  // forward substitution (L has a unit diagonal)
+  for(int k=0; k<r; k++)
+    for(int i=k+1; i<r; i++)
+      b[i] -= A[r * k + i] * b[k];
+
+  // back substitution
+  for(int k=r-1; k>=0; k--)
+  {
+    b[k] /= A[r * k + k];
+    for(int i=0; i<k; i++)
+      b[i] -= A[r * k + i] * b[k];
+  }
+
+  return 0;
+}
+
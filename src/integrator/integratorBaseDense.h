@@ -0,0 +1,80 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  A base class to timestep dense (reduced) dynamics.
+  E.g., reduced nonlinear FEM deformable dynamics (see [1] in integratorBase.h),
+  with the reduced StVK force model (ReducedStVKForceModel).
+
+  All dense matrices are r x r, and stored column-major.
+
+  See also integratorBase.h .
+*/
+
+#ifndef _INTEGRATORBASEDENSE_H_
+#define _INTEGRATORBASEDENSE_H_
+
+#include "forceModel/reducedForceModel.h"
+#include "integrator/integratorBase.h"
+
+class IntegratorBaseDense : public IntegratorBase
+{
+public:
+
+  // massMatrix is the r x r reduced mass matrix (U^T M U; the identity matrix if the basis is mass-orthonormal); it is copied
+  IntegratorBaseDense(int r, double timestep, double * massMatrix, ReducedForceModel * reducedForceModel, double dampingMassCoef=0.0, double dampingStiffnessCoef=0.0);
+
+  virtual ~IntegratorBaseDense();
+
+  inline virtual void SetReducedForceModel(ReducedForceModel * reducedForceModel) { this->reducedForceModel = reducedForceModel; }
+
+  // performs one step of simulation (returns 0 on sucess, and 1 on failure)
+  virtual int DoTimestep() = 0;
+
+  // returns the execution time of the last r x r linear system solve
+  inline virtual double GetSystemSolveTime() { return systemSolveTime; }
+  inline virtual double GetForceAssemblyTime() { return forceAssemblyTime; }
+
+  virtual double GetKineticEnergy();
+  virtual double GetTotalMass();
+
+protected:
+  double * massMatrix;
+  ReducedForceModel * reducedForceModel;
+
+  double systemSolveTime;
+  double forceAssemblyTime;
+
+  // solves A x = b with Gaussian elimination with partial pivoting (no BLAS / LAPACK needed; r is small)
+  // A (r x r, column-major) is overwritten by its LU factors, and b is overwritten by x; pivots is an int buffer of length r
+  // returns 0 on success, and 1 if the matrix is singular
+  static int SolveLinearSystem(int r, double * A, int * pivots, double * b);
+};
+
+#endif
+
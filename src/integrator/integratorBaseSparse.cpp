@@ -68,3 +68,93 @@ double IntegratorBaseSparse::GetTotalMass()
   return massMatrix->SumEntries();
 }
 
+
+// state layout: IntegratorBase state, then one byte per DOF (1 = constrained)
+size_t IntegratorBaseSparse::GetStateSize()
+{
+  return IntegratorBase::GetStateSize() + r;
+}
+
+void IntegratorBaseSparse::SaveState(char * data)
+{
+  IntegratorBase::SaveState(data);
+  data += IntegratorBase::GetStateSize();
+
+  memset(data, 0, r);
+  for(int i=0; i<numConstrainedDOFs; i++)
+    data[constrainedDOFs[i]] = 1;
+}
+
+int IntegratorBaseSparse::LoadState(const char * data, size_t size)
+{
+  if (size < IntegratorBaseSparse::GetStateSize())
+  {
+    printf("Error: integrator state is too short (%d bytes).\n", (int)size);
+    return 1;
+  }
+
+  if (IntegratorBase::LoadState(data, size) != 0)
+    return 1;
+  data += IntegratorBase::GetStateSize();
+
+  int stateNumConstrainedDOFs = 0;
+  for(int i=0; i<r; i++)
+    if (data[i])
+      stateNumConstrainedDOFs++;
+
+  int * stateConstrainedDOFs = (int*) malloc (sizeof(int) * stateNumConstrainedDOFs);
+  int numDifferentDOFs = (stateNumConstrainedDOFs != numConstrainedDOFs) ? 1 : 0;
+  stateNumConstrainedDOFs = 0;
+  for(int i=0; i<r; i++)
+  {
+    if (data[i])
+    {
+      stateConstrainedDOFs[stateNumConstrainedDOFs] = i;
+      if ((stateNumConstrainedDOFs >= numConstrainedDOFs) || (constrainedDOFs[stateNumConstrainedDOFs] != i))
+        numDifferentDOFs++;
+      stateNumConstrainedDOFs++;
+    }
+  }
+
+  int code = 0;
+  if (numDifferentDOFs > 0)
+    code = ChangeConstrainedDOFs(stateNumConstrainedDOFs, stateConstrainedDOFs);
+  free(stateConstrainedDOFs);
+
+  return code;
+}
+
+int IntegratorBaseSparse::ChangeConstrainedDOFs(int, int *)
+{
+  printf("Error: the constrained DOFs of the integrator state differ from those of the integrator, and this integrator does not support changing them.\n");
+  return 1;
+}
+
+size_t IntegratorBaseSparse::GetMatrixStateSize(SparseMatrix * matrix)
+{
+  return sizeof(int) + sizeof(double) * matrix->GetNumEntries();
+}
+
+char * IntegratorBaseSparse::SaveMatrixEntries(char * data, SparseMatrix * matrix)
+{
+  int numEntries = matrix->GetNumEntries();
+  data = SaveData(data, &numEntries, sizeof(int));
+  for(int row=0; row<matrix->GetNumRows(); row++)
+    data = SaveData(data, matrix->GetRowHandle(row), sizeof(double) * matrix->GetRowLength(row));
+  return data;
+}
+
+const char * IntegratorBaseSparse::LoadMatrixEntries(const char * data, SparseMatrix * matrix)
+{
+  int numEntries;
+  data = LoadData(data, &numEntries, sizeof(int));
+  if (numEntries != matrix->GetNumEntries())
+  {
+    printf("Error: the saved matrix has %d entries, but the matrix has %d entries.\n", numEntries, matrix->GetNumEntries());
+    return NULL;
+  }
+  for(int row=0; row<matrix->GetNumRows(); row++)
+    data = LoadData(data, matrix->GetRowHandle(row), sizeof(double) * matrix->GetRowLength(row));
+  return data;
+}
+
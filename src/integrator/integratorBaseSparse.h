@@ -39,6 +39,7 @@
 #include "sparseMatrix/sparseMatrix.h"
 #include "forceModel/forceModel.h"
 #include "integrator/integratorBase.h"
+#include "integrator/integratorStatistics.h"
 
 class IntegratorBaseSparse : public IntegratorBase
 {
@@ -64,9 +65,19 @@ public:
   inline virtual double GetSystemSolveTime() { return systemSolveTime; }
   inline virtual double GetForceAssemblyTime() { return forceAssemblyTime; }
 
+  // detailed solver statistics of the last timestep (Newton iterations, residual history, CG iterations, timing split, etc.; see integratorStatistics.h)
+  inline IntegratorStatistics * GetStatistics() { return &statistics; }
+  // streams the statistics of each subsequent timestep into a file (fileFormat: 0 = CSV, 1 = JSON); returns 0 on success
+  inline int OpenStatisticsFile(const char * filename, int fileFormat=0) { return statistics.OpenFile(filename, fileFormat); }
+
   virtual double GetKineticEnergy();
   virtual double GetTotalMass();
 
+  // checkpointing (see integratorBase.h); the state also includes the set of constrained DOFs
+  virtual size_t GetStateSize();
+  virtual void SaveState(char * data);
+  virtual int LoadState(const char * data, size_t size);
+
 protected:
   SparseMatrix * massMatrix; 
   ForceModel * forceModel;
@@ -78,6 +89,17 @@ protected:
 
   double systemSolveTime;
   double forceAssemblyTime;
+
+  IntegratorStatistics statistics;
+
+  // called by LoadState if the saved constrained DOFs differ from the current ones; returns 0 on success
+  // default: changing the constraints is not supported (returns 1)
+  virtual int ChangeConstrainedDOFs(int numConstrainedDOFs, int * constrainedDOFs);
+
+  // checkpoint helpers for the entries of a sparse matrix (its topology is not saved, and must match)
+  static size_t GetMatrixStateSize(SparseMatrix * matrix);
+  static char * SaveMatrixEntries(char * data, SparseMatrix * matrix);
+  static const char * LoadMatrixEntries(const char * data, SparseMatrix * matrix); // returns NULL if the number of entries does not match
 };
 
 #endif
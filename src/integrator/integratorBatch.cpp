@@ -0,0 +1,178 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "performanceCounter/performanceCounter.h"
+#include "integratorBatch.h"
+
+static void * IntegratorBatch_WorkerThread(void * arg)
+{
+  IntegratorBatch * batch = (IntegratorBatch*) arg;
+  batch->WorkerThread();
+  return NULL;
+}
+
+IntegratorBatch::IntegratorBatch(int numThreads_) : numThreads(numThreads_)
+{
+  if (numThreads < 1)
+    numThreads = 1;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&startCondition, NULL);
+  pthread_cond_init(&doneCondition, NULL);
+  generation = 0;
+  numBusyThreads = 0;
+  nextJob = 0;
+  shutdown = false;
+
+  // the calling thread is the first thread of the pool
+  threads = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
+  for(int i=1; i<numThreads; i++)
+  {
+    if (pthread_create(&threads[i], NULL, IntegratorBatch_WorkerThread, this) != 0)
+    {
+      printf("Error: unable to launch thread %d.\n", i);
+      exit(1);
+    }
+  }
+}
+
+IntegratorBatch::~IntegratorBatch()
+{
+  pthread_mutex_lock(&mutex);
+  shutdown = true;
+  pthread_cond_broadcast(&startCondition);
+  pthread_mutex_unlock(&mutex);
+
+  for(int i=1; i<numThreads; i++)
+  {
+    if (pthread_join(threads[i], NULL) != 0)
+    {
+      printf("Error: unable to join thread %d.\n", i);
+      exit(1);
+    }
+  }
+  free(threads);
+
+  pthread_cond_destroy(&doneCondition);
+  pthread_cond_destroy(&startCondition);
+  pthread_mutex_destroy(&mutex);
+}
+
+int IntegratorBatch::AddIntegrator(IntegratorBase * integrator)
+{
+  integrators.push_back(integrator);
+  status.push_back(0);
+  // until the first timestep is measured, the cost is estimated by the number of DOFs
+  cost.push_back((double)integrator->Getr());
+  schedule.push_back((int)schedule.size());
+  return (int)integrators.size() - 1;
+}
+
+struct IntegratorBatch_costComparator
+{
+  IntegratorBatch_costComparator(const std::vector<double> & cost_) : cost(cost_) {}
+  bool operator()(int a, int b) const { return cost[a] > cost[b]; }
+  const std::vector<double> & cost;
+};
+
+void IntegratorBatch::ProcessJobs()
+{
+  int numJobs = (int)schedule.size();
+  while (true)
+  {
+    pthread_mutex_lock(&mutex);
+    int job = nextJob++;
+    pthread_mutex_unlock(&mutex);
+
+    if (job >= numJobs)
+      break;
+
+    int index = schedule[job];
+    PerformanceCounter counter;
+    status[index] = integrators[index]->DoTimestep();
+    counter.StopCounter();
+    cost[index] = counter.GetElapsedTime();
+  }
+}
+
+void IntegratorBatch::WorkerThread()
+{
+  int lastGeneration = 0;
+  while (true)
+  {
+    pthread_mutex_lock(&mutex);
+    while ((generation == lastGeneration) && !shutdown)
+      pthread_cond_wait(&startCondition, &mutex);
+    if (shutdown)
+    {
+      pthread_mutex_unlock(&mutex);
+      break;
+    }
+    lastGeneration = generation;
+    pthread_mutex_unlock(&mutex);
+
+    ProcessJobs();
+
+    pthread_mutex_lock(&mutex);
+    numBusyThreads--;
+    if (numBusyThreads == 0)
+      pthread_cond_signal(&doneCondition);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+int IntegratorBatch::DoTimestep()
+{
+  // longest jobs first
+  std::stable_sort(schedule.begin(), schedule.end(), IntegratorBatch_costComparator(cost));
+
+  pthread_mutex_lock(&mutex);
+  nextJob = 0;
+  numBusyThreads = numThreads - 1;
+  generation++;
+  pthread_cond_broadcast(&startCondition);
+  pthread_mutex_unlock(&mutex);
+
+  ProcessJobs();
+
+  pthread_mutex_lock(&mutex);
+  while (numBusyThreads > 0)
+    pthread_cond_wait(&doneCondition, &mutex);
+  pthread_mutex_unlock(&mutex);
+
+  int numFailed = 0;
+  for(int i=0; i<(int)integrators.size(); i++)
+    if (status[i] != 0)
+      numFailed++;
+
+  return numFailed;
+}
+
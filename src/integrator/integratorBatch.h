@@ -0,0 +1,101 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Steps many independent simulations (integrators) in parallel.
+
+  Scenes with many small deformable objects do not scale with the multi-threaded
+  force models (each object is too small). This class instead distributes whole 
+  integrators across a pool of persistent worker threads: each call to DoTimestep 
+  performs one timestep of every integrator. Integrators are handed out dynamically,
+  most expensive first (initially by the number of DOFs, then by the measured time
+  of the previous timestep), which balances the load across the threads.
+
+  Each integrator keeps its own force model, solver and buffers across timesteps,
+  i.e., no memory is allocated by the batch in DoTimestep. The integrators must be 
+  independent: they must not share force models (or any other non-thread-safe data).
+  External forces, constraints, etc. are set on the individual integrators 
+  in between the calls to DoTimestep.
+
+  The integrators are not deleted in the destructor.
+*/
+
+#ifndef _INTEGRATORBATCH_H_
+#define _INTEGRATORBATCH_H_
+
+#include <vector>
+#include <pthread.h>
+#include "integratorBase.h"
+
+class IntegratorBatch
+{
+public:
+  // numThreads is the total number of threads (the calling thread also performs timesteps)
+  IntegratorBatch(int numThreads);
+  virtual ~IntegratorBatch();
+
+  // returns the index of the integrator in the batch
+  int AddIntegrator(IntegratorBase * integrator);
+  inline int GetNumIntegrators() { return (int)integrators.size(); }
+  inline IntegratorBase * GetIntegrator(int index) { return integrators[index]; }
+
+  // performs one timestep of all integrators
+  // returns the number of integrators whose DoTimestep failed (0 on success)
+  int DoTimestep();
+
+  // return value of DoTimestep of the given integrator, in the last batch timestep
+  inline int GetTimestepStatus(int index) { return status[index]; }
+  // wall-clock time of the last timestep of the given integrator
+  inline double GetTimestepTime(int index) { return cost[index]; }
+
+  inline int GetNumThreads() { return numThreads; }
+
+  // the loop of the worker threads (internal use)
+  void WorkerThread();
+
+protected:
+  int numThreads;
+  std::vector<IntegratorBase*> integrators;
+  std::vector<int> status;
+  std::vector<double> cost; // scheduling priority
+  std::vector<int> schedule; // integrator indices, sorted by descending cost
+
+  // thread pool
+  pthread_t * threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t startCondition, doneCondition;
+  int generation; // incremented at each batch timestep
+  int numBusyThreads;
+  int nextJob;
+  bool shutdown;
+
+  void ProcessJobs();
+};
+
+#endif
+
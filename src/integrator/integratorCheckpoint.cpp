@@ -0,0 +1,433 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+#include "integratorCheckpoint.h"
+
+// header: tag (8 bytes), version (int), r (int), integrator state size, force model state size (unsigned 64-bit each)
+#define CHECKPOINT_TAG "VEGACKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE (8 + 2 * sizeof(int) + 2 * sizeof(unsigned long long))
+
+static void WriteHeader(char * data, int r, size_t integratorStateSize, size_t forceModelStateSize)
+{
+  int version = CHECKPOINT_VERSION;
+  unsigned long long sizes[2] = { integratorStateSize, forceModelStateSize };
+  memcpy(data, CHECKPOINT_TAG, 8);
+  memcpy(data + 8, &version, sizeof(int));
+  memcpy(data + 8 + sizeof(int), &r, sizeof(int));
+  memcpy(data + 8 + 2 * sizeof(int), sizes, 2 * sizeof(unsigned long long));
+}
+
+// returns 0 if the header matches the integrator and the force model, and the file is long enough
+static int CheckHeader(const char * data, size_t fileSize, IntegratorBase * integrator, ForceModel * forceModel, size_t * integratorStateSize, size_t * forceModelStateSize)
+{
+  if ((fileSize < CHECKPOINT_HEADER_SIZE) || (memcmp(data, CHECKPOINT_TAG, 8) != 0))
+  {
+    printf("Error: not a checkpoint file.\n");
+    return 1;
+  }
+
+  int version, r;
+  unsigned long long sizes[2];
+  memcpy(&version, data + 8, sizeof(int));
+  memcpy(&r, data + 8 + sizeof(int), sizeof(int));
+  memcpy(sizes, data + 8 + 2 * sizeof(int), 2 * sizeof(unsigned long long));
+
+  if (version != CHECKPOINT_VERSION)
+  {
+    printf("Error: unsupported checkpoint version %d.\n", version);
+    return 1;
+  }
+
+  if (fileSize < CHECKPOINT_HEADER_SIZE + sizes[0] + sizes[1])
+  {
+    printf("Error: checkpoint file is truncated.\n");
+    return 1;
+  }
+
+  if ((r != integrator->Getr()) || (sizes[0] != integrator->GetStateSize()))
+  {
+    printf("Error: checkpoint does not match the integrator (r: %d vs %d, state size: %llu vs %llu bytes).\n", r, integrator->Getr(), sizes[0], (unsigned long long)integrator->GetStateSize());
+    return 1;
+  }
+
+  if ((forceModel != NULL) && (sizes[1] != forceModel->GetStateSize()))
+  {
+    printf("Error: checkpoint does not match the force model (state size: %llu vs %llu bytes).\n", sizes[1], (unsigned long long)forceModel->GetStateSize());
+    return 1;
+  }
+
+  *integratorStateSize = (size_t)sizes[0];
+  *forceModelStateSize = (size_t)sizes[1];
+  return 0;
+}
+
+static void * IntegratorCheckpoint_WriteThread(void * data)
+{
+  IntegratorCheckpoint * checkpoint = (IntegratorCheckpoint*) data;
+  checkpoint->WriteThread();
+  return NULL;
+}
+
+IntegratorCheckpoint::IntegratorCheckpoint()
+{
+  writing = false;
+  snapshot = NULL;
+  snapshotSize = 0;
+  filename = NULL;
+  useMemoryMapping = 0;
+  writeStatus = 0;
+}
+
+IntegratorCheckpoint::~IntegratorCheckpoint()
+{
+  Wait();
+}
+
+char * IntegratorCheckpoint::CreateSnapshot(IntegratorBase * integrator, ForceModel * forceModel, size_t * size)
+{
+  size_t integratorStateSize = integrator->GetStateSize();
+  size_t forceModelStateSize = (forceModel != NULL) ? forceModel->GetStateSize() : 0;
+  *size = CHECKPOINT_HEADER_SIZE + integratorStateSize + forceModelStateSize;
+
+  char * data = (char*) malloc (*size);
+  if (data == NULL)
+  {
+    printf("Error: could not allocate %llu bytes for the checkpoint.\n", (unsigned long long)*size);
+    return NULL;
+  }
+
+  WriteHeader(data, integrator->Getr(), integratorStateSize, forceModelStateSize);
+  integrator->SaveState(data + CHECKPOINT_HEADER_SIZE);
+  if (forceModel != NULL)
+    forceModel->SaveState(data + CHECKPOINT_HEADER_SIZE + integratorStateSize);
+
+  return data;
+}
+
+// a checkpoint is written into "<filename>.tmp", which is flushed to disk, and then renamed to filename,
+// so that a crash (or a full disk) during the write never leaves a truncated checkpoint under filename
+static char * GetTempFilename(const char * filename)
+{
+  char * tempFilename = (char*) malloc (sizeof(char) * (strlen(filename) + 8));
+  sprintf(tempFilename, "%s.tmp", filename);
+  return tempFilename;
+}
+
+// if code is 0, renames the (complete) temporary file to filename; otherwise, or if the rename fails, removes the temporary file
+// (only called once the temporary file has been created)
+static int ReplaceWithTempFile(const char * tempFilename, const char * filename, int code)
+{
+  if (code == 0)
+  {
+    #ifdef _WIN32
+      remove(filename); // rename does not overwrite under Windows
+    #endif
+    if (rename(tempFilename, filename) != 0)
+    {
+      printf("Error: could not rename %s to %s.\n", tempFilename, filename);
+      code = 1;
+    }
+  }
+  if (code != 0)
+    remove(tempFilename);
+  return code;
+}
+
+#ifndef _WIN32
+// creates the file at the given size, and memory-maps it; returns NULL on failure (the file is then removed)
+static char * CreateMappedFile(const char * filename, size_t size, int * fd)
+{
+  *fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (*fd < 0)
+  {
+    printf("Error: could not open checkpoint file %s.\n", filename);
+    return NULL;
+  }
+  if (ftruncate(*fd, size) != 0)
+  {
+    printf("Error: could not resize checkpoint file %s.\n", filename);
+    close(*fd);
+    remove(filename);
+    return NULL;
+  }
+  char * data = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+  if (data == (char*) MAP_FAILED)
+  {
+    printf("Error: could not memory-map checkpoint file %s.\n", filename);
+    close(*fd);
+    remove(filename);
+    return NULL;
+  }
+  return data;
+}
+
+// unmaps the file, and flushes it to disk; returns 0 on success
+static int CloseMappedFile(const char * filename, char * data, size_t size, int fd)
+{
+  munmap(data, size);
+  int code = 0;
+  if (fsync(fd) != 0)
+  {
+    printf("Error: could not write checkpoint file %s.\n", filename);
+    code = 1;
+  }
+  close(fd);
+  return code;
+}
+#endif
+
+int IntegratorCheckpoint::WriteFile(const char * filename, const char * snapshot, size_t size, int useMemoryMapping)
+{
+  char * tempFilename = GetTempFilename(filename);
+  int code = 0;
+
+  #ifndef _WIN32
+    if (useMemoryMapping)
+    {
+      int fd;
+      char * data = CreateMappedFile(tempFilename, size, &fd);
+      if (data == NULL)
+        code = 1;
+      else
+      {
+        memcpy(data, snapshot, size);
+        code = CloseMappedFile(tempFilename, data, size, fd);
+        code = ReplaceWithTempFile(tempFilename, filename, code);
+      }
+      free(tempFilename);
+      return code;
+    }
+  #endif
+
+  FILE * fout = fopen(tempFilename, "wb");
+  if (fout == NULL)
+  {
+    printf("Error: could not open checkpoint file %s.\n", tempFilename);
+    free(tempFilename);
+    return 1;
+  }
+  size_t written = fwrite(snapshot, 1, size, fout);
+  if (fflush(fout) != 0)
+    written = 0;
+  #ifdef _WIN32
+    if (_commit(_fileno(fout)) != 0)
+      written = 0;
+  #else
+    if (fsync(fileno(fout)) != 0)
+      written = 0;
+  #endif
+  if (fclose(fout) != 0)
+    written = 0;
+  if (written != size)
+  {
+    printf("Error: could not write checkpoint file %s.\n", tempFilename);
+    code = 1;
+  }
+  code = ReplaceWithTempFile(tempFilename, filename, code);
+  free(tempFilename);
+  return code;
+}
+
+int IntegratorCheckpoint::Save(const char * filename, IntegratorBase * integrator, ForceModel * forceModel, int useMemoryMapping)
+{
+  #ifndef _WIN32
+    if (useMemoryMapping)
+    {
+      // write the states directly into the mapped file (no intermediate snapshot)
+      size_t integratorStateSize = integrator->GetStateSize();
+      size_t forceModelStateSize = (forceModel != NULL) ? forceModel->GetStateSize() : 0;
+      size_t size = CHECKPOINT_HEADER_SIZE + integratorStateSize + forceModelStateSize;
+
+      char * tempFilename = GetTempFilename(filename);
+      int fd;
+      char * data = CreateMappedFile(tempFilename, size, &fd);
+      int code = 0;
+      if (data == NULL)
+        code = 1;
+      else
+      {
+        WriteHeader(data, integrator->Getr(), integratorStateSize, forceModelStateSize);
+        integrator->SaveState(data + CHECKPOINT_HEADER_SIZE);
+        if (forceModel != NULL)
+          forceModel->SaveState(data + CHECKPOINT_HEADER_SIZE + integratorStateSize);
+        code = CloseMappedFile(tempFilename, data, size, fd);
+        code = ReplaceWithTempFile(tempFilename, filename, code);
+      }
+      free(tempFilename);
+      return code;
+    }
+  #endif
+
+  size_t size;
+  char * data = CreateSnapshot(integrator, forceModel, &size);
+  if (data == NULL)
+    return 1;
+  int code = WriteFile(filename, data, size, 0);
+  free(data);
+  return code;
+}
+
+int IntegratorCheckpoint::Load(const char * filename, IntegratorBase * integrator, ForceModel * forceModel, int useMemoryMapping)
+{
+  const char * data = NULL;
+  size_t fileSize = 0;
+  char * buffer = NULL;
+
+  #ifndef _WIN32
+    int fd = -1;
+    if (useMemoryMapping)
+    {
+      fd = open(filename, O_RDONLY);
+      if (fd < 0)
+      {
+        printf("Error: could not open checkpoint file %s.\n", filename);
+        return 1;
+      }
+      struct stat fileStat;
+      if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0))
+      {
+        printf("Error: could not read checkpoint file %s.\n", filename);
+        close(fd);
+        return 1;
+      }
+      fileSize = (size_t)fileStat.st_size;
+      void * mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED)
+      {
+        printf("Error: could not memory-map checkpoint file %s.\n", filename);
+        close(fd);
+        return 1;
+      }
+      data = (const char*) mapping;
+    }
+  #endif
+
+  if (data == NULL)
+  {
+    FILE * fin = fopen(filename, "rb");
+    if (fin == NULL)
+    {
+      printf("Error: could not open checkpoint file %s.\n", filename);
+      return 1;
+    }
+    fseek(fin, 0, SEEK_END);
+    fileSize = (size_t)ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+    buffer = (char*) malloc (fileSize);
+    size_t numRead = fread(buffer, 1, fileSize, fin);
+    fclose(fin);
+    if (numRead != fileSize)
+    {
+      printf("Error: could not read checkpoint file %s.\n", filename);
+      free(buffer);
+      return 1;
+    }
+    data = buffer;
+  }
+
+  size_t integratorStateSize, forceModelStateSize;
+  int code = CheckHeader(data, fileSize, integrator, forceModel, &integratorStateSize, &forceModelStateSize);
+  if (code == 0)
+    code = integrator->LoadState(data + CHECKPOINT_HEADER_SIZE, integratorStateSize);
+  if ((code == 0) && (forceModel != NULL))
+    code = forceModel->LoadState(data + CHECKPOINT_HEADER_SIZE + integratorStateSize, forceModelStateSize);
+
+  #ifndef _WIN32
+    if (buffer == NULL)
+    {
+      munmap((void*)data, fileSize);
+      close(fd);
+    }
+  #endif
+  free(buffer);
+
+  return code;
+}
+
+int IntegratorCheckpoint::SaveAsync(const char * filename_, IntegratorBase * integrator, ForceModel * forceModel, int useMemoryMapping_)
+{
+  Wait();
+  writeStatus = 0;
+
+  snapshot = CreateSnapshot(integrator, forceModel, &snapshotSize);
+  if (snapshot == NULL)
+    return 1;
+
+  filename = (char*) malloc (sizeof(char) * (strlen(filename_) + 1));
+  strcpy(filename, filename_);
+  useMemoryMapping = useMemoryMapping_;
+
+  writing = true;
+  if (pthread_create(&thread, NULL, IntegratorCheckpoint_WriteThread, this) != 0)
+  {
+    printf("Error: unable to launch the checkpoint thread. Writing the checkpoint synchronously.\n");
+    WriteThread();
+    writing = false;
+    return writeStatus;
+  }
+
+  return 0;
+}
+
+void IntegratorCheckpoint::WriteThread()
+{
+  writeStatus = WriteFile(filename, snapshot, snapshotSize, useMemoryMapping);
+
+  free(snapshot);
+  snapshot = NULL;
+  free(filename);
+  filename = NULL;
+}
+
+int IntegratorCheckpoint::Wait()
+{
+  if (!writing)
+    return writeStatus;
+
+  if (pthread_join(thread, NULL) != 0)
+  {
+    printf("Error: unable to join the checkpoint thread.\n");
+    writeStatus = 1;
+  }
+  writing = false;
+
+  return writeStatus;
+}
+
@@ -0,0 +1,102 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Binary checkpoints of a simulation: the state of an integrator (see 
+  IntegratorBase::SaveState), and of its force model (ForceModel::SaveState).
+  A simulation restarted from a checkpoint continues bitwise identically,
+  provided that the integrator and the force model are constructed with
+  the same parameters as those that wrote the checkpoint.
+
+  File format: a header (the "VEGACKPT" tag, version, r, and the sizes of the 
+  two states in bytes), followed by the integrator state and the force model state.
+  The data is written in the native byte order.
+  A checkpoint is written into "<filename>.tmp", which is flushed to disk and
+  then renamed to filename; an interrupted write therefore leaves the previous 
+  checkpoint (if any) intact.
+
+  Checkpoints can be written:
+  - synchronously (Save),
+  - via a memory mapping of the file (useMemoryMapping=1): the (temporary) file is created
+    at its final size, and the states are written directly into the mapped 
+    pages (and, when loading, read from them without an intermediate buffer);
+    on Windows, regular file I/O is used instead,
+  - asynchronously (SaveAsync): the states are copied into a memory buffer, 
+    which is the only work done by the calling thread, and written to the file 
+    by a background thread, while the simulation keeps timestepping.
+*/
+
+#ifndef _INTEGRATORCHECKPOINT_H_
+#define _INTEGRATORCHECKPOINT_H_
+
+#include <pthread.h>
+#include "integratorBase.h"
+#include "forceModel/forceModel.h"
+
+class IntegratorCheckpoint
+{
+public:
+  IntegratorCheckpoint();
+  virtual ~IntegratorCheckpoint(); // waits for a pending asynchronous write
+
+  // writes the state of the integrator and of the force model (if not NULL) to a file
+  // returns 0 on success, and non-zero on failure
+  static int Save(const char * filename, IntegratorBase * integrator, ForceModel * forceModel=NULL, int useMemoryMapping=0);
+
+  // restores the state of the integrator and of the force model (if not NULL) from a file
+  // returns 0 on success, and non-zero on failure (e.g., the file does not match the integrator)
+  static int Load(const char * filename, IntegratorBase * integrator, ForceModel * forceModel=NULL, int useMemoryMapping=0);
+
+  // snapshots the state, and writes it to a file on a background thread
+  // if a previous asynchronous write is still in progress, waits for it first
+  // returns 0 if the write was started, and non-zero on failure
+  int SaveAsync(const char * filename, IntegratorBase * integrator, ForceModel * forceModel=NULL, int useMemoryMapping=0);
+  // waits for the pending asynchronous write (if any); returns 0 if the last asynchronous write succeeded
+  int Wait();
+  // true from SaveAsync until the following Wait
+  inline bool IsWriting() { return writing; }
+
+  // the background write (internal use)
+  void WriteThread();
+
+protected:
+  // snapshot of a checkpoint: header followed by the states
+  static char * CreateSnapshot(IntegratorBase * integrator, ForceModel * forceModel, size_t * size);
+  static int WriteFile(const char * filename, const char * snapshot, size_t size, int useMemoryMapping);
+
+  pthread_t thread;
+  bool writing;
+  char * snapshot;
+  size_t snapshotSize;
+  char * filename;
+  int useMemoryMapping;
+  int writeStatus;
+};
+
+#endif
+
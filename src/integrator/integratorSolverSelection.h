@@ -37,3 +37,8 @@
 //#define SPOOLES
 #define PCG
 
+// With PARDISO, the implicit integrators can optionally factor the system matrix
+// in single precision, and recover double-precision accuracy with iterative refinement
+// (see sparseSolver/MixedPrecisionSolver.h). This halves the memory of the factors.
+//#define PARDISO_MIXED_PRECISION
+
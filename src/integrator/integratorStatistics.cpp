@@ -0,0 +1,165 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdlib.h>
+#include <float.h>
+#include "integratorStatistics.h"
+
+// JSON has no representation for NaN and infinity (e.g., the residual norms of a diverged timestep): write them as null
+static void WriteJSONNumber(FILE * fout, const char * format, double value)
+{
+  if ((value >= -DBL_MAX) && (value <= DBL_MAX))
+    fprintf(fout, format, value);
+  else
+    fprintf(fout, "null");
+}
+
+IntegratorStatistics::IntegratorStatistics()
+{
+  symbolicFactorizationTime = 0.0;
+
+  residualNormsCapacity = 16;
+  residualNorms = (double*) malloc (sizeof(double) * residualNormsCapacity);
+
+  file = NULL;
+  fileFormat = 0;
+
+  BeginTimestep();
+  timestepIndex = -1;
+}
+
+IntegratorStatistics::~IntegratorStatistics()
+{
+  CloseFile();
+  free(residualNorms);
+}
+
+void IntegratorStatistics::BeginTimestep()
+{
+  timestepIndex++;
+  numNewtonIterations = 0;
+  numResiduals = 0;
+  numSolverIterations = 0;
+  solverResidualError = 0.0;
+  numStiffnessAssemblies = 0;
+  numFactorizations = 0;
+  numAllocations = 0;
+  predictorStatus = 0;
+  predictorIterationsSaved = 0.0;
+
+  forceAssemblyTime = 0.0;
+  systemMatrixTime = 0.0;
+  factorizationTime = 0.0;
+  solveTime = 0.0;
+  timestepTime = 0.0;
+
+  systemMatrixNNZ = 0;
+}
+
+void IntegratorStatistics::AddResidualNorm(double residualNorm)
+{
+  if (numResiduals == residualNormsCapacity)
+  {
+    residualNormsCapacity *= 2;
+    residualNorms = (double*) realloc (residualNorms, sizeof(double) * residualNormsCapacity);
+    numAllocations++;
+  }
+  residualNorms[numResiduals] = residualNorm;
+  numResiduals++;
+}
+
+void IntegratorStatistics::EndTimestep(double timestepTime_)
+{
+  timestepTime = timestepTime_;
+
+  if (file != NULL)
+  {
+    Write(file, fileFormat);
+    fflush(file);
+  }
+}
+
+int IntegratorStatistics::OpenFile(const char * filename, int fileFormat_)
+{
+  CloseFile();
+
+  file = fopen(filename, "w");
+  if (file == NULL)
+  {
+    printf("Error: could not open integrator statistics file %s.\n", filename);
+    return 1;
+  }
+
+  fileFormat = fileFormat_;
+  if (fileFormat == 0)
+    fprintf(file, "timestep,newtonIterations,residualNorms,solverIterations,solverResidualError,stiffnessAssemblies,factorizations,allocations,predictorStatus,predictorIterationsSaved,forceAssemblyTime,systemMatrixTime,factorizationTime,solveTime,timestepTime,systemMatrixNNZ\n");
+
+  return 0;
+}
+
+void IntegratorStatistics::CloseFile()
+{
+  if (file != NULL)
+    fclose(file);
+  file = NULL;
+}
+
+void IntegratorStatistics::Write(FILE * fout, int fileFormat)
+{
+  if (fileFormat == 0)
+  {
+    fprintf(fout, "%d,%d,", timestepIndex, numNewtonIterations);
+    for(int i=0; i<numResiduals; i++)
+      fprintf(fout, "%s%.10G", (i == 0) ? "" : ";", residualNorms[i]);
+    fprintf(fout, ",%d,%G,%d,%d,%d,%d,%G,%G,%G,%G,%G,%G,%d\n", numSolverIterations, solverResidualError, numStiffnessAssemblies, numFactorizations, numAllocations, predictorStatus, predictorIterationsSaved,
+      forceAssemblyTime, systemMatrixTime, factorizationTime, solveTime, timestepTime, systemMatrixNNZ);
+  }
+  else
+  {
+    fprintf(fout, "{\"timestep\": %d, \"newtonIterations\": %d, \"residualNorms\": [", timestepIndex, numNewtonIterations);
+    for(int i=0; i<numResiduals; i++)
+    {
+      fprintf(fout, "%s", (i == 0) ? "" : ", ");
+      WriteJSONNumber(fout, "%.10G", residualNorms[i]);
+    }
+    fprintf(fout, "], \"solverIterations\": %d, \"solverResidualError\": ", numSolverIterations);
+    WriteJSONNumber(fout, "%G", solverResidualError);
+    fprintf(fout, ", \"stiffnessAssemblies\": %d, \"factorizations\": %d, \"allocations\": %d, \"predictorStatus\": %d, \"predictorIterationsSaved\": ", numStiffnessAssemblies, numFactorizations, numAllocations, predictorStatus);
+    WriteJSONNumber(fout, "%G", predictorIterationsSaved);
+
+    const char * timeNames[5] = { "forceAssemblyTime", "systemMatrixTime", "factorizationTime", "solveTime", "timestepTime" };
+    double times[5] = { forceAssemblyTime, systemMatrixTime, factorizationTime, solveTime, timestepTime };
+    for(int i=0; i<5; i++)
+    {
+      fprintf(fout, ", \"%s\": ", timeNames[i]);
+      WriteJSONNumber(fout, "%G", times[i]);
+    }
+    fprintf(fout, ", \"systemMatrixNNZ\": %d}\n", systemMatrixNNZ);
+  }
+}
+
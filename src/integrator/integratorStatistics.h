@@ -0,0 +1,101 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Solver telemetry of the sparse integrators: a record of the work performed 
+  in the last timestep (Newton iterations, residual history, linear solver 
+  iterations, timing split, matrix size).
+
+  The record is reset at the beginning of each timestep, and filled in by
+  DoTimestep. It can optionally be streamed to a file, one record per timestep,
+  in the CSV or JSON (one JSON object per line) format.
+
+  See also integratorBaseSparse.h .
+*/
+
+#ifndef _INTEGRATORSTATISTICS_H_
+#define _INTEGRATORSTATISTICS_H_
+
+#include <stdio.h>
+
+class IntegratorStatistics
+{
+public:
+  IntegratorStatistics();
+  virtual ~IntegratorStatistics();
+
+  // === the statistics of the last timestep ===
+
+  int timestepIndex; // 0 for the first timestep
+  int numNewtonIterations; // number of linear system solves performed in the timestep
+  int numResiduals;
+  double * residualNorms; // L2 norms of the force residual, evaluated at the beginning of each Newton iteration (numResiduals entries)
+  int numSolverIterations; // total number of CG iterations, or of refinement iterations with PARDISO_MIXED_PRECISION (0 for the other direct solvers)
+  double solverResidualError; // relative residual error at the end of the last CG (or mixed-precision) solve
+  int numStiffnessAssemblies; // number of tangent stiffness matrix assemblies (the converged Newton iteration does not assemble one, except in the Newmark full Newton mode with stiffness-proportional damping)
+  int numFactorizations; // number of numeric factorizations (direct solvers)
+  int numAllocations; // number of heap allocations made by the integrator during the timestep (solver objects, system matrices and their buffers, the residual history; the allocations inside the PARDISO and SPOOLES libraries are not counted)
+  int predictorStatus; // Newton predictor (see ImplicitNewmarkSparse::UseNewtonPredictor): 0 = not used, 1 = accepted, -1 = rejected
+  double predictorIterationsSaved; // estimated number of Newton iterations saved by the accepted prediction (the predictor's residual reduction, divided by the average per-iteration reduction of the timestep)
+
+  double forceAssemblyTime; // internal forces and the tangent stiffness matrix (all Newton iterations)
+  double systemMatrixTime; // building the system matrix from the tangent stiffness matrix, and copying it into the solver
+  double factorizationTime; // numeric factorizations; SPOOLES performs the symbolic factorization together with the numeric factorization
+  double solveTime; // linear system solves (triangular solves for the direct solvers, all the iterations for CG)
+  double timestepTime; // total time of the timestep
+
+  int systemMatrixNNZ; // number of non-zero entries of the system matrix
+
+  // time of the symbolic factorization, which PARDISO performs only once, in the integrator constructor (it is not reset)
+  double symbolicFactorizationTime;
+
+  // === used by the integrators ===
+
+  void BeginTimestep(); // resets the statistics and advances the timestep index
+  void AddResidualNorm(double residualNorm);
+  void EndTimestep(double timestepTime); // sets the total time, and writes the record to the file (if any)
+
+  // === streaming to a file ===
+
+  // opens a file, and writes the statistics of all the subsequent timesteps into it
+  // fileFormat: 0 = CSV (a header line, then one line per timestep; the residual history is given as a ';'-separated list), 1 = JSON (one object per line)
+  // returns 0 on success, and non-zero on failure
+  int OpenFile(const char * filename, int fileFormat=0);
+  void CloseFile();
+
+  // prints the statistics of the last timestep to the given stream, in the selected format
+  void Write(FILE * fout, int fileFormat=0);
+
+protected:
+  int residualNormsCapacity;
+  FILE * file;
+  int fileFormat;
+};
+
+#endif
+
@@ -34,7 +34,13 @@
 #include "implicitNewmarkSparse.h"
 #include "centralDifferencesSparse.h"
 #include "implicitBackwardEulerSparse.h"
+#include "implicitBackwardEulerMatrixFree.h"
 #include "eulerSparse.h"
+#include "integratorBatch.h"
+#include "adaptiveTimestepController.h"
+#include "projectiveDynamicsSparse.h"
+#include "integratorCheckpoint.h"
+#include "implicitNewmarkDense.h"
 
 #endif
 
@@ -0,0 +1,266 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Test of the lagged-Jacobian (modified Newton) mode of the implicit sparse integrators.
+  A cantilever StVK beam is bent by a large tip load, with the default integrator
+  arguments (one Newton iteration per timestep). The test checks that the lagged
+  matrix is refreshed:
+    1. with the default UseLaggedJacobian arguments (age limit), and
+    2. with no age limit, by the residual growth test between timesteps.
+  With the default arguments, the tip deflection must be within 2% of the full Newton mode.
+  With several Newton iterations per timestep, the lagged mode must converge to the full Newton solution.
+  Finally, it runs the full Newton mode with several iterations per timestep (backward
+  Euler and Newmark), and checks that the stiffness matrix is assembled once per linear 
+  solve, i.e., that the converged iteration only evaluates the internal forces.
+  Returns 0 on success, and 1 on failure.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "volumetricMesh/tetMesh.h"
+#include "volumetricMesh/generateMassMatrix.h"
+#include "stvk/StVKElementABCDLoader.h"
+#include "stvk/StVKInternalForces.h"
+#include "stvk/StVKStiffnessMatrix.h"
+#include "elasticForceModel/StVKForceModel.h"
+#include "integrator/implicitNewmarkSparse.h"
+#include "integrator/implicitBackwardEulerSparse.h"
+
+// a 1 x 0.2 x 0.2 beam of nx x ny x nz cubes, each split into 6 tets
+static TetMesh * CreateBeam(int nx, int ny, int nz)
+{
+  double h = 1.0 / nx;
+  int numVertices = (nx + 1) * (ny + 1) * (nz + 1);
+  double * vertices = (double*) malloc (sizeof(double) * 3 * numVertices);
+  for(int i=0; i<=nx; i++)
+    for(int j=0; j<=ny; j++)
+      for(int k=0; k<=nz; k++)
+      {
+        int index = (i * (ny + 1) + j) * (nz + 1) + k;
+        vertices[3 * index + 0] = i * h;
+        vertices[3 * index + 1] = j * h;
+        vertices[3 * index + 2] = k * h;
+      }
+
+  // the six tets of a cube share the diagonal 0-7; all are positively oriented
+  int cubeTets[6][4] = { {0,3,1,7}, {0,1,5,7}, {0,2,3,7}, {0,6,2,7}, {0,5,4,7}, {0,4,6,7} };
+  int numElements = 6 * nx * ny * nz;
+  int * elements = (int*) malloc (sizeof(int) * 4 * numElements);
+  int el = 0;
+  for(int i=0; i<nx; i++)
+    for(int j=0; j<ny; j++)
+      for(int k=0; k<nz; k++)
+      {
+        int corners[8];
+        for(int corner=0; corner<8; corner++)
+          corners[corner] = ((i + ((corner >> 2) & 1)) * (ny + 1) + j + ((corner >> 1) & 1)) * (nz + 1) + k + (corner & 1);
+        for(int tet=0; tet<6; tet++, el++)
+          for(int vtx=0; vtx<4; vtx++)
+            elements[4 * el + vtx] = corners[cubeTets[tet][vtx]];
+      }
+
+  TetMesh * tetMesh = new TetMesh(numVertices, vertices, numElements, elements, 1E6, 0.45, 1000);
+  free(elements);
+  free(vertices);
+  return tetMesh;
+}
+
+// simulates numTimesteps timesteps; returns the number of stiffness matrix refreshes, and the tip deflection
+// maxIterations: Newton iterations per timestep (default integrator argument: 1)
+static int Simulate(TetMesh * tetMesh, ForceModel * forceModel, SparseMatrix * massMatrix, int numConstrainedDOFs, int * constrainedDOFs, double * externalForces,
+  int numTimesteps, bool useLaggedJacobian, bool useDefaultMaxAge, double * tipDeflection, int maxIterations=1)
+{
+  int r = 3 * tetMesh->getNumVertices();
+  double timestep = 0.01;
+  // no damping
+  ImplicitBackwardEulerSparse integrator(r, timestep, massMatrix, forceModel, 0, numConstrainedDOFs, constrainedDOFs, 0.0, 0.0, maxIterations, 1E-6);
+  if (useLaggedJacobian)
+  {
+    if (useDefaultMaxAge)
+      integrator.UseLaggedJacobian(true);
+    else
+      integrator.UseLaggedJacobian(true, 0.5, 0);
+  }
+  integrator.SetExternalForces(externalForces);
+
+  for(int i=0; i<numTimesteps; i++)
+    integrator.DoTimestep();
+
+  // the last vertex is at the free end of the beam
+  *tipDeflection = integrator.Getq()[r - 2];
+  return integrator.GetNumFactorizations();
+}
+
+// full Newton mode with up to maxIterations iterations per timestep; returns the number of timesteps in which 
+// the number of stiffness matrix assemblies differs from the number of linear solves (0 on success)
+static int CountFullNewtonAssemblies(ImplicitNewmarkSparse * integrator, const char * integratorName, double * externalForces, int numTimesteps, int maxIterations)
+{
+  integrator->SetExternalForces(externalForces);
+
+  int numMismatches = 0;
+  int numConverged = 0;
+  int numAssemblies = 0;
+  int numSolves = 0;
+  int numForceEvaluations = 0;
+  for(int i=0; i<numTimesteps; i++)
+  {
+    integrator->DoTimestep();
+    IntegratorStatistics * statistics = integrator->GetStatistics();
+    numAssemblies += statistics->numStiffnessAssemblies;
+    numSolves += statistics->numNewtonIterations;
+    numForceEvaluations += statistics->numResiduals;
+    if (statistics->numStiffnessAssemblies != statistics->numNewtonIterations)
+      numMismatches++;
+    if (statistics->numNewtonIterations < maxIterations)
+    {
+      numConverged++;
+      // the converged iteration evaluated the residual, but did not solve
+      if (statistics->numResiduals != statistics->numNewtonIterations + 1)
+        numMismatches++;
+    }
+  }
+
+  printf("Full Newton (%s, maxIterations = %d): %d stiffness matrix assemblies, %d solves, %d force evaluations; %d of %d timesteps converged\n", 
+    integratorName, maxIterations, numAssemblies, numSolves, numForceEvaluations, numConverged, numTimesteps);
+
+  if (numConverged == 0)
+  {
+    printf("Error: the %s Newton iteration never converged.\n", integratorName);
+    numMismatches++;
+  }
+
+  return numMismatches;
+}
+
+int main()
+{
+  TetMesh * tetMesh = CreateBeam(10, 2, 2);
+  int r = 3 * tetMesh->getNumVertices();
+
+  StVKElementABCD * precomputedIntegrals = StVKElementABCDLoader::load(tetMesh);
+  StVKInternalForces * stVKInternalForces = new StVKInternalForces(tetMesh, precomputedIntegrals);
+  StVKStiffnessMatrix * stVKStiffnessMatrix = new StVKStiffnessMatrix(stVKInternalForces);
+  StVKForceModel * forceModel = new StVKForceModel(stVKInternalForces, stVKStiffnessMatrix);
+
+  SparseMatrix * massMatrix;
+  GenerateMassMatrix::computeMassMatrix(tetMesh, &massMatrix, true);
+
+  // fix the x = 0 end, and pull the x = 1 end downwards
+  int numConstrainedDOFs = 0;
+  int * constrainedDOFs = (int*) malloc (sizeof(int) * r);
+  double * externalForces = (double*) calloc (r, sizeof(double));
+  for(int i=0; i<tetMesh->getNumVertices(); i++)
+  {
+    double x = (*tetMesh->getVertex(i))[0];
+    if (x < 1E-9)
+    {
+      for(int dof=0; dof<3; dof++)
+        constrainedDOFs[numConstrainedDOFs++] = 3 * i + dof;
+    }
+    if (x > 1.0 - 1E-9)
+      externalForces[3 * i + 1] = -20.0;
+  }
+
+  int numTimesteps = 100;
+  double tipFullNewton, tipDefault, tipNoMaxAge;
+  int numFullNewton = Simulate(tetMesh, forceModel, massMatrix, numConstrainedDOFs, constrainedDOFs, externalForces, numTimesteps, false, false, &tipFullNewton);
+  int numDefault = Simulate(tetMesh, forceModel, massMatrix, numConstrainedDOFs, constrainedDOFs, externalForces, numTimesteps, true, true, &tipDefault);
+  int numNoMaxAge = Simulate(tetMesh, forceModel, massMatrix, numConstrainedDOFs, constrainedDOFs, externalForces, numTimesteps, true, false, &tipNoMaxAge);
+  double errorDefault = fabs(tipDefault - tipFullNewton) / fabs(tipFullNewton);
+
+  printf("Full Newton:                      %d stiffness matrix refreshes, tip deflection %G\n", numFullNewton, tipFullNewton);
+  printf("Lagged Jacobian (default):        %d stiffness matrix refreshes, tip deflection %G (relative difference: %G)\n", numDefault, tipDefault, errorDefault);
+  printf("Lagged Jacobian (no age limit):   %d stiffness matrix refreshes, tip deflection %G (relative difference: %G)\n", numNoMaxAge, tipNoMaxAge, fabs(tipNoMaxAge - tipFullNewton) / fabs(tipFullNewton));
+
+  int exitCode = 0;
+  // the initial factorization, plus at least one refresh
+  if (numDefault < 2)
+  {
+    printf("Error: the lagged Jacobian was never refreshed with the default arguments.\n");
+    exitCode = 1;
+  }
+  if (numNoMaxAge < 2)
+  {
+    printf("Error: the lagged Jacobian was never refreshed by the residual growth test.\n");
+    exitCode = 1;
+  }
+  if (numDefault >= numFullNewton)
+  {
+    printf("Error: the lagged Jacobian did not save any stiffness matrix refreshes.\n");
+    exitCode = 1;
+  }
+  if (errorDefault > 0.02)
+  {
+    printf("Error: with the default arguments, the lagged Jacobian deviates from the full Newton mode by more than 2%%.\n");
+    exitCode = 1;
+  }
+
+  // several Newton iterations per timestep: the lagged Jacobian must converge to the full Newton solution
+  int maxIterations = 10;
+  double tipFullNewtonConverged, tipDefaultConverged;
+  int numFullNewtonConverged = Simulate(tetMesh, forceModel, massMatrix, numConstrainedDOFs, constrainedDOFs, externalForces, numTimesteps, false, false, &tipFullNewtonConverged, maxIterations);
+  int numDefaultConverged = Simulate(tetMesh, forceModel, massMatrix, numConstrainedDOFs, constrainedDOFs, externalForces, numTimesteps, true, true, &tipDefaultConverged, maxIterations);
+  double errorConverged = fabs(tipDefaultConverged - tipFullNewtonConverged) / fabs(tipFullNewtonConverged);
+  printf("maxIterations = %d: full Newton %d stiffness matrix refreshes, lagged Jacobian %d (relative difference: %G)\n", 
+    maxIterations, numFullNewtonConverged, numDefaultConverged, errorConverged);
+  if (errorConverged > 1E-5)
+  {
+    printf("Error: with several Newton iterations, the lagged Jacobian does not converge to the full Newton solution.\n");
+    exitCode = 1;
+  }
+
+  // full Newton, several iterations per timestep
+  ImplicitBackwardEulerSparse backwardEuler(r, 0.01, massMatrix, forceModel, 0, numConstrainedDOFs, constrainedDOFs, 0.1, 0.0, maxIterations, 1E-6);
+  ImplicitNewmarkSparse newmark(r, 0.01, massMatrix, forceModel, 0, numConstrainedDOFs, constrainedDOFs, 0.1, 0.0, maxIterations, 1E-6);
+  if (CountFullNewtonAssemblies(&backwardEuler, "backward Euler", externalForces, 20, maxIterations) != 0)
+  {
+    printf("Error: the backward Euler full Newton mode assembled the stiffness matrix without a subsequent solve.\n");
+    exitCode = 1;
+  }
+  if (CountFullNewtonAssemblies(&newmark, "Newmark", externalForces, 20, maxIterations) != 0)
+  {
+    printf("Error: the Newmark full Newton mode assembled the stiffness matrix without a subsequent solve.\n");
+    exitCode = 1;
+  }
+
+  if (exitCode == 0)
+    printf("Test passed.\n");
+
+  free(externalForces);
+  free(constrainedDOFs);
+  delete(massMatrix);
+  delete(forceModel);
+  delete(stVKStiffnessMatrix);
+  delete(stVKInternalForces);
+  delete(precomputedIntegrals);
+  delete(tetMesh);
+
+  return exitCode;
+}
@@ -0,0 +1,502 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "performanceCounter/performanceCounter.h"
+#include "insertRows/insertRows.h"
+#include "minivector/mat3d.h"
+#include "volumetricMesh/volumetricMeshENuMaterial.h"
+#include "polarDecomposition/polarDecomposition.h"
+#include "integrator/projectiveDynamicsSparse.h"
+
+ProjectiveDynamicsSparse::ProjectiveDynamicsSparse(TetMesh * tetMesh_, double timestep, SparseMatrix * massMatrix_, int numConstrainedDOFs_, int * constrainedDOFs_, double dampingMassCoef, double dampingStiffnessCoef, int numIterations_, int numThreads_, int numSolverThreads_): IntegratorBaseSparse(3 * tetMesh_->getNumVertices(), timestep, massMatrix_, NULL, numConstrainedDOFs_, constrainedDOFs_, dampingMassCoef, dampingStiffnessCoef), tetMesh(tetMesh_), numThreads(numThreads_), numSolverThreads(numSolverThreads_), numIterations(numIterations_)
+{
+  if (massMatrix->Getn() != r)
+  {
+    printf("Error: the provided mass matrix does not have correct size. Mass matrix: %d x %d. Mesh DOFs: %d.\n", massMatrix->Getn(), massMatrix->Getn(), r);
+    exit(1);
+  }
+
+  if (numThreads < 1)
+    numThreads = 1;
+
+  numElements = tetMesh->getNumElements();
+  numFactorizations = 0;
+
+  // constraint weights, and the gradients of the shape functions
+  weights = (double*) malloc (sizeof(double) * numElements);
+  shapeGradients = (double*) malloc (sizeof(double) * 12 * numElements);
+  for(int el=0; el<numElements; el++)
+  {
+    VolumetricMesh::Material * material = tetMesh->getElementMaterial(el);
+    VolumetricMesh::ENuMaterial * eNuMaterial = downcastENuMaterial(material);
+    if (eNuMaterial == NULL)
+    {
+      printf("Error: mesh does not consist of E, nu materials.\n");
+      throw 1;
+    }
+    weights[el] = 2.0 * eNuMaterial->getMu() * tetMesh->getElementVolume(el);
+
+    // F = Ds * inv(Dm), where the columns of Ds, Dm are the (deformed, rest) edge vectors x_i - x_0, i=1,2,3
+    Vec3d * v0 = tetMesh->getVertex(el, 0);
+    Mat3d Dm;
+    for(int i=0; i<3; i++)
+    {
+      Vec3d edge = *tetMesh->getVertex(el, i+1) - *v0;
+      for(int j=0; j<3; j++)
+        Dm[j][i] = edge[j];
+    }
+    Mat3d DmInv = inv(Dm);
+
+    // F_ij = delta_ij + sum_k u_{k,i} * shapeGradient_{k,j}
+    double * D = &shapeGradients[12 * el];
+    for(int j=0; j<3; j++)
+    {
+      D[j] = 0.0;
+      for(int k=1; k<4; k++)
+      {
+        D[3 * k + j] = DmInv[k-1][j];
+        D[j] -= DmInv[k-1][j];
+      }
+    }
+  }
+
+  // L = sum_e w_e G_e^T G_e; acts identically on the x, y and z components
+  SparseMatrixOutline outline(r);
+  for(int el=0; el<numElements; el++)
+  {
+    double * D = &shapeGradients[12 * el];
+    for(int k=0; k<4; k++)
+      for(int l=0; l<4; l++)
+      {
+        double entry = weights[el] * (D[3*k+0] * D[3*l+0] + D[3*k+1] * D[3*l+1] + D[3*k+2] * D[3*l+2]);
+        int vtxk = tetMesh->getVertexIndex(el, k);
+        int vtxl = tetMesh->getVertexIndex(el, l);
+        for(int dim=0; dim<3; dim++)
+          outline.AddEntry(3 * vtxk + dim, 3 * vtxl + dim, entry);
+      }
+  }
+  laplacianMatrix = new SparseMatrix(&outline);
+
+  rhs = (double*) malloc (sizeof(double) * r);
+  rhsConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
+  bufferConstrained = (double*) malloc (sizeof(double) * (r - numConstrainedDOFs));
+
+  // split the local step workload
+  threadRhs = (double*) malloc (sizeof(double) * r * numThreads);
+  threadEnergy = (double*) malloc (sizeof(double) * numThreads);
+  startElement = (int*) malloc (sizeof(int) * numThreads);
+  endElement = (int*) malloc (sizeof(int) * numThreads);
+
+  int remainder = numElements % numThreads;
+  // the first 'remainder' threads will process one element more
+  int jobSize = numElements / numThreads;
+  for(int rank=0; rank < numThreads; rank++)
+  {
+    if (rank < remainder)
+    { 
+      startElement[rank] = rank * (jobSize+1);
+      endElement[rank] = (rank+1) * (jobSize+1);
+    }      
+    else      
+    { 
+      startElement[rank] = remainder * (jobSize+1) + (rank-remainder) * jobSize;
+      endElement[rank] = remainder * (jobSize+1) + ((rank-remainder)+1) * jobSize;
+    }
+  }
+
+  systemMatrix = NULL;
+
+  #ifdef PARDISO
+    pardisoSolver = NULL;
+  #endif
+
+  #ifdef SPOOLES
+    spoolesSolver = NULL;
+  #endif
+
+  #ifdef PCG
+    jacobiPreconditionedCGSolver = NULL;
+  #endif
+
+  RebuildSystemMatrix();
+}
+
+ProjectiveDynamicsSparse::~ProjectiveDynamicsSparse()
+{
+  #ifdef PARDISO
+    delete(pardisoSolver);
+  #endif
+
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+  #endif
+
+  #ifdef PCG
+    delete(jacobiPreconditionedCGSolver);
+  #endif
+
+  delete(systemMatrix);
+  delete(laplacianMatrix);
+
+  free(weights);
+  free(shapeGradients);
+  free(rhs);
+  free(rhsConstrained);
+  free(bufferConstrained);
+  free(threadRhs);
+  free(threadEnergy);
+  free(startElement);
+  free(endElement);
+}
+
+void ProjectiveDynamicsSparse::SetTimestep(double timestep)
+{
+  this->timestep = timestep;
+  RebuildSystemMatrix();
+}
+
+void ProjectiveDynamicsSparse::SetInternalForceScalingFactor(double internalForceScalingFactor)
+{
+  this->internalForceScalingFactor = internalForceScalingFactor;
+  RebuildSystemMatrix();
+}
+
+void ProjectiveDynamicsSparse::RebuildSystemMatrix()
+{
+  // A = (1 / timestep^2 + dampingMassCoef / timestep) M + internalForceScalingFactor * (1 + dampingStiffnessCoef / timestep) L
+  double massFactor = 1.0 / (timestep * timestep) + dampingMassCoef / timestep;
+  double laplacianFactor = internalForceScalingFactor * (1.0 + dampingStiffnessCoef / timestep);
+
+  SparseMatrixOutline outline(r);
+  for(int row=0; row<r; row++)
+  {
+    for(int j=0; j<massMatrix->GetRowLength(row); j++)
+      outline.AddEntry(row, massMatrix->GetColumnIndex(row, j), massFactor * massMatrix->GetEntry(row, j));
+    for(int j=0; j<laplacianMatrix->GetRowLength(row); j++)
+      outline.AddEntry(row, laplacianMatrix->GetColumnIndex(row, j), laplacianFactor * laplacianMatrix->GetEntry(row, j));
+  }
+
+  delete(systemMatrix);
+  systemMatrix = new SparseMatrix(&outline);
+  systemMatrix->RemoveRowsColumns(numConstrainedDOFs, constrainedDOFs);
+  statistics.numAllocations++;
+
+  FactorSystemMatrix();
+}
+
+void ProjectiveDynamicsSparse::FactorSystemMatrix()
+{
+  PerformanceCounter counterFactorization;
+
+  #ifdef PARDISO
+    delete(pardisoSolver);
+    printf("Creating Pardiso solver. Num threads: %d\n", numSolverThreads);
+    pardisoSolver = new PardisoSolver(systemMatrix, numSolverThreads, 1);
+    statistics.numAllocations++;
+    int info = pardisoSolver->ComputeCholeskyDecomposition(systemMatrix);
+    if (info != 0)
+      printf("Error: PARDISO factorization of the projective dynamics system matrix failed. Return code: %d.\n", info);
+  #endif
+
+  #ifdef SPOOLES
+    delete(spoolesSolver);
+    spoolesSolver = new SPOOLESSolver(systemMatrix);
+    statistics.numAllocations++;
+  #endif
+
+  #ifdef PCG
+    delete(jacobiPreconditionedCGSolver);
+    jacobiPreconditionedCGSolver = new CGSolver(systemMatrix);
+    statistics.numAllocations++;
+  #endif
+
+  counterFactorization.StopCounter();
+  statistics.factorizationTime += counterFactorization.GetElapsedTime();
+  statistics.numFactorizations++;
+  numFactorizations++;
+}
+
+int ProjectiveDynamicsSparse::SetState(double * q_, double * qvel_)
+{
+  memcpy(q, q_, sizeof(double)*r);
+
+  if (qvel_ != NULL)
+    memcpy(qvel, qvel_, sizeof(double)*r);
+  else
+    memset(qvel, 0, sizeof(double)*r);
+
+  memset(qaccel, 0, sizeof(double)*r);
+
+  for(int i=0; i<numConstrainedDOFs; i++)
+    q[constrainedDOFs[i]] = qvel[constrainedDOFs[i]] = 0.0;
+
+  return 0;
+}
+
+double ProjectiveDynamicsSparse::LocalStep(int startElement, int endElement, double * rhs)
+{
+  double energy = 0.0;
+  for(int el=startElement; el<endElement; el++)
+  {
+    int vtxIndex[4];
+    for(int vtx=0; vtx<4; vtx++)
+      vtxIndex[vtx] = tetMesh->getVertexIndex(el, vtx);
+    double * D = &shapeGradients[12 * el];
+
+    // deformation gradient (row-major)
+    double F[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+    for(int k=0; k<4; k++)
+    {
+      double * u = &q[3 * vtxIndex[k]];
+      for(int i=0; i<3; i++)
+        for(int j=0; j<3; j++)
+          F[3 * i + j] += u[i] * D[3 * k + j];
+    }
+
+    double R[9]; // rotation (row-major)
+    double S[9]; // symmetric (row-major)
+    double det = PolarDecomposition::Compute(F, R, S, 1E-6);
+    if (det < 0)
+    {
+      // flip R so that it becomes orthogonal
+      for(int i=0; i<9; i++)
+        R[i] *= -1.0;
+    }
+
+    // projection target (R - I), and the energy w/2 || F - R ||^2
+    double P[9];
+    for(int i=0; i<9; i++)
+    {
+      double diff = F[i] - R[i];
+      energy += 0.5 * weights[el] * diff * diff;
+      P[i] = R[i];
+    }
+    P[0] -= 1.0;
+    P[4] -= 1.0;
+    P[8] -= 1.0;
+
+    // rhs += w_e G_e^T (R - I)
+    for(int k=0; k<4; k++)
+    {
+      double * target = &rhs[3 * vtxIndex[k]];
+      for(int i=0; i<3; i++)
+        target[i] += weights[el] * (P[3*i+0] * D[3*k+0] + P[3*i+1] * D[3*k+1] + P[3*i+2] * D[3*k+2]);
+    }
+  }
+
+  return energy;
+}
+
+struct ProjectiveDynamicsSparse_threadArg
+{
+  ProjectiveDynamicsSparse * projectiveDynamicsSparse;
+  int startElement, endElement;
+  double * rhs;
+  double * energy;
+};
+
+void * ProjectiveDynamicsSparse_WorkerThread(void * arg)
+{
+  struct ProjectiveDynamicsSparse_threadArg * threadArgp = (struct ProjectiveDynamicsSparse_threadArg*) arg;
+  *(threadArgp->energy) = threadArgp->projectiveDynamicsSparse->LocalStep(threadArgp->startElement, threadArgp->endElement, threadArgp->rhs);
+  return NULL;
+}
+
+// computes sum_e w_e G_e^T (R_e - I) into "rhs", using numThreads threads
+void ProjectiveDynamicsSparse::ParallelLocalStep(double * rhs, double * energy)
+{
+  memset(rhs, 0, sizeof(double) * r);
+
+  if (numThreads == 1)
+  {
+    double elasticEnergy = LocalStep(0, numElements, rhs);
+    if (energy != NULL)
+      *energy = elasticEnergy;
+    return;
+  }
+
+  struct ProjectiveDynamicsSparse_threadArg * threadArgv = (struct ProjectiveDynamicsSparse_threadArg*) malloc (sizeof(struct ProjectiveDynamicsSparse_threadArg) * numThreads);
+  pthread_t * tid = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
+  statistics.numAllocations += 2;
+
+  memset(threadRhs, 0, sizeof(double) * r * numThreads);
+  for(int i=0; i<numThreads; i++)
+  {
+    threadArgv[i].projectiveDynamicsSparse = this;
+    threadArgv[i].startElement = startElement[i];
+    threadArgv[i].endElement = endElement[i];
+    threadArgv[i].rhs = &threadRhs[r * i];
+    threadArgv[i].energy = &threadEnergy[i];
+  }
+
+  for(int i=0; i<numThreads; i++)
+  {
+    if (pthread_create(&tid[i], NULL, ProjectiveDynamicsSparse_WorkerThread, &threadArgv[i]) != 0)
+    {
+      printf("Error: unable to launch thread %d.\n", i);
+      exit(1);
+    }
+  }
+
+  for(int i=0; i<numThreads; i++)
+  {
+    if (pthread_join(tid[i], NULL) != 0)
+    {
+      printf("Error: unable to join thread %d.\n", i);
+      exit(1);
+    } 
+  }
+
+  free(threadArgv);
+  free(tid);
+
+  // assemble
+  double elasticEnergy = 0.0;
+  for(int i=0; i<numThreads; i++)
+  {
+    double * source = &threadRhs[r * i];
+    for(int j=0; j<r; j++)
+      rhs[j] += source[j];
+    elasticEnergy += threadEnergy[i];
+  }
+
+  if (energy != NULL)
+    *energy = elasticEnergy;
+}
+
+double ProjectiveDynamicsSparse::GetElasticEnergy()
+{
+  double energy;
+  ParallelLocalStep(buffer, &energy);
+  return internalForceScalingFactor * energy;
+}
+
+int ProjectiveDynamicsSparse::DoTimestep()
+{
+  PerformanceCounter counterTimestep;
+  statistics.BeginTimestep();
+  statistics.systemMatrixNNZ = systemMatrix->GetNumEntries();
+
+  // store current amplitudes and set initial guesses for qaccel, qvel
+  for(int i=0; i<r; i++)
+  {
+    q_1[i] = q[i]; 
+    qvel_1[i] = qvel[i];
+    qaccel_1[i] = qaccel[i];
+  }
+
+  // the part of the right-hand side that is constant during the timestep:
+  // qresidual = M (q_n + timestep * qvel_n) / timestep^2 + dampingMassCoef / timestep * M q_n + f_ext + internalForceScalingFactor * dampingStiffnessCoef / timestep * L q_n
+  for(int i=0; i<r; i++)
+    buffer[i] = (1.0 / (timestep * timestep) + dampingMassCoef / timestep) * q_1[i] + qvel_1[i] / timestep;
+  massMatrix->MultiplyVector(buffer, qresidual);
+  for(int i=0; i<r; i++)
+    qresidual[i] += externalForces[i];
+  if (dampingStiffnessCoef != 0.0)
+  {
+    laplacianMatrix->MultiplyVector(q_1, buffer);
+    double factor = internalForceScalingFactor * dampingStiffnessCoef / timestep;
+    for(int i=0; i<r; i++)
+      qresidual[i] += factor * buffer[i];
+  }
+
+  // initial guess: inertial motion
+  for(int i=0; i<r; i++)
+    q[i] = q_1[i] + timestep * qvel_1[i];
+  for(int i=0; i<numConstrainedDOFs; i++)
+    q[constrainedDOFs[i]] = 0.0;
+
+  int info = 0;
+  for(int iter=0; iter<numIterations; iter++)
+  {
+    // local step
+    PerformanceCounter counterForceAssemblyTime;
+    ParallelLocalStep(rhs, NULL);
+    for(int i=0; i<r; i++)
+      rhs[i] = qresidual[i] + internalForceScalingFactor * rhs[i];
+    counterForceAssemblyTime.StopCounter();
+    statistics.forceAssemblyTime += counterForceAssemblyTime.GetElapsedTime();
+
+    // global step
+    PerformanceCounter counterSystemSolveTime;
+    RemoveRows(r, rhsConstrained, rhs, numConstrainedDOFs, constrainedDOFs);
+
+    #ifdef SPOOLES
+      info = spoolesSolver->SolveLinearSystem(bufferConstrained, rhsConstrained);
+      char solverString[16] = "SPOOLES";
+    #endif
+
+    #ifdef PARDISO
+      info = pardisoSolver->SolveLinearSystem(bufferConstrained, rhsConstrained);
+      char solverString[16] = "PARDISO";
+    #endif
+
+    #ifdef PCG
+      // warm start from the current iterate
+      RemoveRows(r, bufferConstrained, q, numConstrainedDOFs, constrainedDOFs);
+      info = jacobiPreconditionedCGSolver->SolveLinearSystemWithJacobiPreconditioner(bufferConstrained, rhsConstrained, 1e-8, 10000);
+      if (info >= 0)
+      {
+        statistics.numSolverIterations += info;
+        info = 0;
+      }
+      statistics.solverResidualError = jacobiPreconditionedCGSolver->GetResidualError();
+      char solverString[16] = "PCG";
+    #endif
+
+    counterSystemSolveTime.StopCounter();
+    systemSolveTime = counterSystemSolveTime.GetElapsedTime();
+    statistics.solveTime += systemSolveTime;
+
+    if (info != 0)
+    {
+      printf("Error: %s sparse solver returned non-zero exit status %d.\n", solverString, (int)info);
+      counterTimestep.StopCounter();
+      statistics.EndTimestep(counterTimestep.GetElapsedTime());
+      return 1;
+    }
+
+    InsertRows(r, bufferConstrained, q, numConstrainedDOFs, constrainedDOFs);
+    statistics.numNewtonIterations++;
+  }
+
+  for(int i=0; i<r; i++)
+  {
+    qvel[i] = (q[i] - q_1[i]) / timestep;
+    qaccel[i] = (qvel[i] - qvel_1[i]) / timestep;
+  }
+
+  counterTimestep.StopCounter();
+  statistics.EndTimestep(counterTimestep.GetElapsedTime());
+
+  return 0;
+}
+
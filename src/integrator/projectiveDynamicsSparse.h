@@ -0,0 +1,150 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "integrator" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC     *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  A class to timestep large sparse dynamics using projective dynamics
+  (local/global solver), with as-rigid-as-possible tet constraints:
+
+  Sofien Bouaziz, Sebastian Martin, Tiantian Liu, Ladislav Kavan, Mark Pauly:
+  Projective Dynamics: Fusing Constraint Projections for Fast Simulation, 
+  ACM Transactions on Graphics 33(4) (SIGGRAPH 2014)
+
+  Each timestep minimizes the implicit Euler objective 
+    1 / (2 timestep^2) || M^{1/2} (q - q_n - timestep * qvel_n) ||^2 - f_ext^T q + sum_e w_e / 2 || F_e(q) - R_e ||_F^2,
+  where F_e is the deformation gradient of tet e, and R_e is the closest rotation to F_e.
+  The local step computes the rotations R_e (polar decomposition, in parallel),
+  and the global step solves a linear system whose matrix 
+    A = (1 / timestep^2 + dampingMassCoef / timestep) M + (1 + dampingStiffnessCoef / timestep) L,  L = sum_e w_e G_e^T G_e
+  does not depend on q. The matrix is therefore factored only once (in the constructor),
+  and each local/global iteration costs the same (one local step, and one pair of triangular solves). 
+  A fixed number of iterations is performed per timestep, which gives a fixed cost per timestep.
+  The matrix is refactored only if the timestep, the damping or the internal force scaling factor are changed.
+
+  The constraint weights are w_e = 2 * mu_e * volume_e (mu_e = Lame's coefficient of tet e),
+  i.e., the material is approximated by the as-rigid-as-possible (corotational) energy, without the volume term.
+  Internal forces (a ForceModel) are not used.
+
+  The solver is selected in integratorSolverSelection.h (a Cholesky factorization with PARDISO or SPOOLES; 
+  with PCG, the constant system matrix is solved with Jacobi-preconditioned CG, warm-started from the previous iterate).
+*/
+
+#ifndef _PROJECTIVEDYNAMICSSPARSE_H_
+#define _PROJECTIVEDYNAMICSSPARSE_H_
+
+#include "integrator/integratorSolverSelection.h"
+#include "integrator/integratorBaseSparse.h"
+#include "volumetricMesh/tetMesh.h"
+
+#ifdef PARDISO
+  #include "sparseSolvers.h"
+#endif
+#ifdef SPOOLES
+  #include "sparseSolvers.h"
+#endif
+#ifdef PCG
+  #include "sparseSolver/CGSolver.h"
+#endif
+
+class ProjectiveDynamicsSparse : public IntegratorBaseSparse
+{
+public:
+
+  // tetMesh gives the rest configuration and the materials (must be E, nu materials); it must remain valid during the lifetime of the integrator
+  // constrainedDOFs is an integer array of degrees of freedom that are to be fixed to zero (e.g., to permanently fix a vertex in a deformable simulation)
+  // constrainedDOFs are 0-indexed (separate DOFs for x,y,z), and must be pre-sorted (ascending)
+  // numIterations is the number of local/global iterations performed in each timestep
+  // numThreads is the number of threads for the local step; numSolverThreads applies only to the PARDISO solver (0 = single-threading)
+  ProjectiveDynamicsSparse(TetMesh * tetMesh, double timestep, SparseMatrix * massMatrix, int numConstrainedDOFs=0, int * constrainedDOFs=NULL, double dampingMassCoef=0.0, double dampingStiffnessCoef=0.0, int numIterations=10, int numThreads=1, int numSolverThreads=0);
+
+  virtual ~ProjectiveDynamicsSparse();
+
+  // the following three routines rebuild and refactor the system matrix
+  virtual void SetTimestep(double timestep);
+  virtual void SetInternalForceScalingFactor(double internalForceScalingFactor);
+  // the damping coefficients are read when the system matrix is built; call this after changing them
+  void RebuildSystemMatrix();
+
+  // sets q, and (optionally) qvel; qaccel is set to zero
+  // returns 0
+  virtual int SetState(double * q, double * qvel=NULL);
+
+  // performs one step of simulation (returns 0 on sucess, and 1 on failure)
+  // in the statistics (see GetStatistics), numNewtonIterations is the number of local/global iterations, and forceAssemblyTime is the time of the local steps
+  virtual int DoTimestep(); 
+
+  inline void SetNumIterations(int numIterations) { this->numIterations = numIterations; }
+  inline int GetNumIterations() { return numIterations; }
+  // total number of times the system matrix was factored
+  inline int GetNumFactorizations() { return numFactorizations; }
+
+  // the as-rigid-as-possible elastic energy of the current configuration: sum_e w_e / 2 || F_e - R_e ||_F^2 (computes the rotations)
+  double GetElasticEnergy();
+
+  // the local step for elements startElement <= el < endElement: computes the rotations of the elements, and adds 
+  // sum_e w_e G_e^T (R_e - I) into rhs; returns the elastic energy of the elements (internal use, by the worker threads)
+  double LocalStep(int startElement, int endElement, double * rhs);
+
+protected:
+  TetMesh * tetMesh;
+  int numElements;
+  int numThreads;
+  int numSolverThreads;
+  int numIterations;
+  int numFactorizations;
+
+  double * weights; // w_e
+  double * shapeGradients; // gradients of the four shape functions of each tet (12 entries per tet)
+
+  SparseMatrix * laplacianMatrix; // L (without the internal force scaling factor)
+  SparseMatrix * systemMatrix; // A, with the constrained DOFs removed
+
+  double * rhs;
+  double * rhsConstrained;
+  double * bufferConstrained;
+  double * threadRhs; // one rhs buffer per thread
+  double * threadEnergy;
+  int * startElement, * endElement;
+
+  void ParallelLocalStep(double * rhs, double * energy);
+  void FactorSystemMatrix();
+
+  #ifdef PARDISO
+    PardisoSolver * pardisoSolver;
+  #endif
+
+  #ifdef SPOOLES
+    SPOOLESSolver * spoolesSolver;
+  #endif
+
+  #ifdef PCG
+    CGSolver * jacobiPreconditionedCGSolver;
+  #endif
+};
+
+#endif
+
@@ -28,13 +28,26 @@
 
 #include "isotropicHyperelasticFEM/isotropicHyperelasticFEM.h"
 #include "matrix/matrixIO.h"
+#include "volumetricMesh/volumetricMeshThreads.h"
+#include "volumetricMesh/generateStiffnessMatrixTopology.h"
+#include "isotropicHyperelasticFEM/svd3x3.h"
 
-IsotropicHyperelasticFEM::IsotropicHyperelasticFEM(TetMesh * tetMesh_, IsotropicMaterial * isotropicMaterial_, double principalStretchThreshold_, bool addGravity_, double g_) :
+struct IsotropicHyperelasticFEM::PrecomputationData
+{
+  IsotropicHyperelasticFEM * isotropicHyperelasticFEM;
+  SparseMatrix * stiffnessMatrixTopology;
+};
+
+IsotropicHyperelasticFEM::IsotropicHyperelasticFEM(TetMesh * tetMesh_, IsotropicMaterial * isotropicMaterial_, double principalStretchThreshold_, bool addGravity_, double g_, VolumetricMeshCache * cache_, int numThreads) :
   tetMesh(tetMesh_),
   isotropicMaterial(isotropicMaterial_),
   principalStretchThreshold(principalStretchThreshold_),
   addGravity(addGravity_), 
-  g(g_)
+  g(g_),
+  cache(cache_),
+  svdMethod(SVD_JACOBI_BATCHED),
+  svdMethodSet(false),
+  batchedSVDClass(&typeid(IsotropicHyperelasticFEM))
 {
   if (tetMesh->getNumElementVertices() != 4)
   {
@@ -48,7 +61,21 @@ IsotropicHyperelasticFEM::IsotropicHyperelasticFEM(TetMesh * tetMesh_, Isotropic
   // create space for F, U, Fhat, V, area weighted normals, and dmInverses (D_m^{-1})
   // each tet has numElementVertices vertices
   areaWeightedVertexNormals = (Vec3d*) malloc (sizeof(Vec3d) * numElements * tetMesh->getNumElementVertices());
-  dmInverses = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
+
+  // dmInverses are loaded from the cache if possible
+  size_t precomputedBlockSize = sizeof(Mat3d) * numElements;
+  precomputedBlock = NULL;
+  precomputedBlockFromCache = false;
+  if (cache != NULL)
+  {
+    precomputedBlock = (char*) cache->LoadWithSize("IsotropicHyperelasticFEM", precomputedBlockSize);
+    precomputedBlockFromCache = (precomputedBlock != NULL);
+  }
+  if (precomputedBlock == NULL)
+    precomputedBlock = (char*) malloc (precomputedBlockSize);
+  dmInverses = (Mat3d*) precomputedBlock;
+
+  memoryLean = false;
   Fs = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
   Fhats = (Vec3d*) malloc (sizeof(Vec3d)* numElements);
   Vs = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
@@ -66,41 +93,6 @@ IsotropicHyperelasticFEM::IsotropicHyperelasticFEM(TetMesh * tetMesh_, Isotropic
     restVerticesPosition[3*i+2] = (*v)[2];
   }
 
-  ComputeTetVolumes();
-
-  ComputeAreaWeightedVertexNormals(); //see p3 section 4 of [Irving 04]
-  // precompute dmInverses (D_m^{-1}), which are needed to compute the 
-  // deformation gradients at runtime ( F = D_s D_m^{-1} (see [Irving 04]) )
-  PrepareDeformGrad(); //see p3 section 3 of [Irving 04]
-
-  // build stiffness matrix skeleton
-  // (i.e., create memory space for the non-zero entries of the stiffness matrix)
-  SparseMatrix * stiffnessMatrixTopology;
-  GetStiffnessMatrixTopology(&stiffnessMatrixTopology);
-
-  // build acceleration indices so that we can quickly write the element stiffness matrices into the global stiffness matrix
-  row_ = (int**) malloc (sizeof(int*) * numElements);
-  column_ = (int**) malloc (sizeof(int*) * numElements);
-
-  int numElementVertices = tetMesh->getNumElementVertices();
-
-  for (int el=0; el < numElements; el++)
-  {
-    row_[el] = (int*) malloc (sizeof(int) * numElementVertices);
-    column_[el] = (int*) malloc (sizeof(int) * numElementVertices * numElementVertices);
-
-    for(int vertex=0; vertex<numElementVertices; vertex++)
-      row_[el][vertex] = tetMesh->getVertexIndex(el, vertex);
-
-    // seek for value row[j] in list associated with row[i]
-    for(int i=0; i<numElementVertices; i++)
-      for(int j=0; j<numElementVertices; j++)
-        column_[el][numElementVertices * i + j] =
-          stiffnessMatrixTopology->GetInverseIndex(3 * row_[el][i], 3 * row_[el][j]) / 3;
-  }
-
-  delete(stiffnessMatrixTopology);
-
   // DS = D_s
   // dDSdU = d D_s / d U
   // set dDSdU here, it's a constant matrix (does not change during the simulation)
@@ -124,8 +116,27 @@ IsotropicHyperelasticFEM::IsotropicHyperelasticFEM(TetMesh * tetMesh_, Isotropic
   dDSdU[tensor9x12Index(2,1,3,2)] = 1.0;
   dDSdU[tensor9x12Index(2,2,3,2)] = 1.0;
 
+  // dF / dU is constant; it is precomputed below (and freed in the memory-lean mode, see SetMemoryLean)
   dFdUs = (double*) malloc (sizeof(double) * 108 * numElements);
-  Compute_dFdU(); // dF / dU is constant; precompute it
+
+  // build stiffness matrix skeleton
+  // (i.e., create memory space for the non-zero entries of the stiffness matrix)
+  SparseMatrix * stiffnessMatrixTopology;
+  GetStiffnessMatrixTopology(&stiffnessMatrixTopology);
+
+  // the per-element precomputation (tet volumes, area-weighted vertex normals, dmInverses, dFdUs,
+  // and the acceleration indices) is independent for each element; it is performed in parallel
+  row_ = (int**) malloc (sizeof(int*) * numElements);
+  column_ = (int**) malloc (sizeof(int*) * numElements);
+  struct PrecomputationData data = { this, stiffnessMatrixTopology };
+  VolumetricMeshThreads::RunOnElements(numElements, numThreads, PrecomputeElementRange, &data);
+
+  delete(stiffnessMatrixTopology);
+
+  if ((!precomputedBlockFromCache) && (cache != NULL))
+    cache->Save("IsotropicHyperelasticFEM", precomputedBlock, precomputedBlockSize);
+
+  dGdFs = NULL; // allocated on demand, by ComputeForcesAndLinearization
 
   // set the renumbering indices for conversion from Teran's order to row-major order
   rowMajorMatrixToTeran[0] = 0;
@@ -150,9 +161,13 @@ IsotropicHyperelasticFEM::~IsotropicHyperelasticFEM()
   free(Vs);
   free(Fhats);
   free(Fs);
-  free(dmInverses);
+  if (precomputedBlockFromCache)
+    VolumetricMeshCache::Release(precomputedBlock);
+  else
+    free(precomputedBlock);
   free(areaWeightedVertexNormals);
   free(dFdUs);
+  free(dGdFs);
   free(tetVolumes);
 
   int numElements = tetMesh->getNumElements();
@@ -165,6 +180,35 @@ IsotropicHyperelasticFEM::~IsotropicHyperelasticFEM()
   free(column_);
 }
 
+void IsotropicHyperelasticFEM::SetMemoryLean(bool memoryLean)
+{
+  if (memoryLean == this->memoryLean)
+    return;
+
+  this->memoryLean = memoryLean;
+  if (memoryLean)
+  {
+    free(Us);
+    free(Vs);
+    free(Fhats);
+    free(Fs);
+    free(dFdUs);
+    Us = Vs = Fs = NULL;
+    Fhats = NULL;
+    dFdUs = NULL;
+  }
+  else
+  {
+    int numElements = tetMesh->getNumElements();
+    Fs = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
+    Fhats = (Vec3d*) malloc (sizeof(Vec3d)* numElements);
+    Vs = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
+    Us = (Mat3d*) malloc (sizeof(Mat3d) * numElements);
+    dFdUs = (double*) malloc (sizeof(double) * 108 * numElements);
+    Compute_dFdU(0, numElements);
+  }
+}
+
 /*
   Compute the elastic strain energy given the current vertex displacements u
 */
@@ -190,37 +234,55 @@ void IsotropicHyperelasticFEM::ComputeForces(double * u, double * internalForces
   Note that this won't compute the actual values of the entries (they are set to zero).
   The sparsity structure does not change at runtime.
 */
-void IsotropicHyperelasticFEM::GetStiffnessMatrixTopology(SparseMatrix ** tangentStiffnessMatrix)
+void IsotropicHyperelasticFEM::PrecomputeElementRange(void * data_, int startElement, int endElement)
 {
-  int numVertices = tetMesh->getNumVertices();
-  int numElementVertices = tetMesh->getNumElementVertices(); // This will always be 4.
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  struct PrecomputationData * data = (struct PrecomputationData*) data_;
+  IsotropicHyperelasticFEM * fem = data->isotropicHyperelasticFEM;
 
-  // build the non-zero locations of the tangent stiffness matrix
-  SparseMatrixOutline * emptyMatrix = new SparseMatrixOutline(3 * numVertices);
-  int numElements = tetMesh->getNumElements();
-  for (int el=0; el < numElements; el++)
+  fem->ComputeTetVolumes(startElement, endElement);
+  fem->ComputeAreaWeightedVertexNormals(startElement, endElement); //see p3 section 4 of [Irving 04]
+  // precompute dmInverses (D_m^{-1}), which are needed to compute the 
+  // deformation gradients at runtime ( F = D_s D_m^{-1} (see [Irving 04]) )
+  if (!fem->precomputedBlockFromCache)
+    fem->PrepareDeformGrad(startElement, endElement); //see p3 section 3 of [Irving 04]
+  fem->Compute_dFdU(startElement, endElement); // dF / dU is constant; precompute it
+  fem->BuildAccelerationIndices(data->stiffnessMatrixTopology, startElement, endElement);
+}
+
+// build acceleration indices so that we can quickly write the element stiffness matrices into the global stiffness matrix
+void IsotropicHyperelasticFEM::BuildAccelerationIndices(SparseMatrix * stiffnessMatrixTopology, int startElement, int endElement)
+{
+  int numElementVertices = tetMesh->getNumElementVertices();
+
+  for (int el=startElement; el < endElement; el++)
   {
+    row_[el] = (int*) malloc (sizeof(int) * numElementVertices);
+    column_[el] = (int*) malloc (sizeof(int) * numElementVertices * numElementVertices);
+
     for(int vertex=0; vertex<numElementVertices; vertex++)
-      vertices[vertex] = tetMesh->getVertexIndex(el, vertex);
+      row_[el][vertex] = tetMesh->getVertexIndex(el, vertex);
 
-    for (int i=0; i<numElementVertices; i++)
-      for (int j=0; j<numElementVertices; j++)
-      {
-        for(int k=0; k<3; k++)
-          for(int l=0; l<3; l++)
-          {
-            // only add the entry if both vertices are free (non-fixed)
-            // the corresponding elt is in row 3*i+k, column 3*j+l
-            emptyMatrix->AddEntry( 3*vertices[i]+k, 3*vertices[j]+l, 0.0 );
-          }
-      }
+    // seek for value row[j] in list associated with row[i]
+    for(int i=0; i<numElementVertices; i++)
+      for(int j=0; j<numElementVertices; j++)
+        column_[el][numElementVertices * i + j] =
+          stiffnessMatrixTopology->GetInverseIndex(3 * row_[el][i], 3 * row_[el][j]) / 3;
+  }
+}
+
+void IsotropicHyperelasticFEM::GetStiffnessMatrixTopology(SparseMatrix ** tangentStiffnessMatrix)
+{
+  if (cache != NULL)
+  {
+    *tangentStiffnessMatrix = cache->LoadSparseMatrixTopology("stiffnessMatrixTopology");
+    if (*tangentStiffnessMatrix != NULL)
+      return;
   }
 
-  *tangentStiffnessMatrix = new SparseMatrix(emptyMatrix);
-  delete(emptyMatrix);
+  *tangentStiffnessMatrix = GenerateStiffnessMatrixTopology::Generate(tetMesh);
 
-  free(vertices);
+  if (cache != NULL)
+    cache->SaveSparseMatrixTopology("stiffnessMatrixTopology", *tangentStiffnessMatrix);
 }
 
 /*
@@ -242,10 +304,127 @@ void IsotropicHyperelasticFEM::GetForceAndTangentStiffnessMatrix(double * u, dou
   GetEnergyAndForceAndTangentStiffnessMatrixHelper(u, NULL, internalForce, tangentStiffnessMatrix, computationMode);
 }
 
-void IsotropicHyperelasticFEM::ComputeTetVolumes()
+/*
+  Compute the internal forces given the current vertex displacements u,
+  and prepare the matrix-free products with the tangent stiffness matrix at u.
+*/
+void IsotropicHyperelasticFEM::ComputeForcesAndLinearization(double * u, double * internalForces)
+{
+  int computationMode = COMPUTE_INTERNALFORCES | COMPUTE_LINEARIZATION;
+  GetEnergyAndForceAndTangentStiffnessMatrixHelper(u, NULL, internalForces, NULL, computationMode);
+}
+
+int IsotropicHyperelasticFEM::MultiplyTangentStiffnessMatrix(double * v, double * Kv)
 {
+  memset(Kv, 0, sizeof(double) * 3 * tetMesh->getNumVertices());
+  if (dGdFs == NULL)
+  {
+    printf("Error: MultiplyTangentStiffnessMatrix called before ComputeForcesAndLinearization.\n");
+    return 1;
+  }
+  MultiplyTangentStiffnessMatrixWorkhorse(0, tetMesh->getNumElements(), v, Kv);
+  return 0;
+}
+
+/*
+  The element stiffness matrix is K = [(dP/dF)*Bm]*(dF/du) (see ComputeTetK).
+  Its first nine rows (vertices a,b,c) equal dGdF * dFdU; the nodal force of 
+  vertex d is minus the sum of the nodal forces of a,b,c. 
+  Therefore, K * v can be computed with a 9x12 and a 9x9 matrix-vector product per element.
+*/
+void IsotropicHyperelasticFEM::MultiplyTangentStiffnessMatrixWorkhorse(int startEl, int endEl, double * v, double * Kv)
+{
+  for (int el=startEl; el<endEl; el++)
+  {
+    int vIndex[4];
+    double vElement[12];
+    for(int vtx=0; vtx<4; vtx++)
+    {
+      vIndex[vtx] = 3 * tetMesh->getVertexIndex(el, vtx);
+      for(int i=0; i<3; i++)
+        vElement[3 * vtx + i] = v[vIndex[vtx] + i];
+    }
+
+    // dF = dF/du * v
+    double dFdU[12];
+    Compute_dFdU(el, dFdU);
+    double dF[9];
+    for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+        dF[3 * i + j] = dFdU[j] * vElement[i] + dFdU[3 + j] * vElement[3 + i] + dFdU[6 + j] * vElement[6 + i] + dFdU[9 + j] * vElement[9 + i];
+
+    // dG = dG/dF * dF (nodal force differentials at vertices a,b,c)
+    double * dGdF = &dGdFs[81 * el];
+    double dG[9];
+    for (int row=0; row<9; row++)
+    {
+      double result = 0;
+      for (int inner=0; inner<9; inner++)
+        result += dGdF[9 * row + inner] * dF[inner];
+      dG[row] = result;
+    }
+
+    for(int i=0; i<3; i++)
+    {
+      Kv[vIndex[0] + i] += dG[i];
+      Kv[vIndex[1] + i] += dG[3 + i];
+      Kv[vIndex[2] + i] += dG[6 + i];
+      Kv[vIndex[3] + i] -= dG[i] + dG[3 + i] + dG[6 + i];
+    }
+  }
+}
+
+int IsotropicHyperelasticFEM::GetTangentStiffnessMatrixDiagonal(double * diagonal)
+{
+  memset(diagonal, 0, sizeof(double) * 3 * tetMesh->getNumVertices());
+  if (dGdFs == NULL)
+  {
+    printf("Error: GetTangentStiffnessMatrixDiagonal called before ComputeForcesAndLinearization.\n");
+    return 1;
+  }
+
   int numElements = tetMesh->getNumElements();
   for (int el=0; el<numElements; el++)
+  {
+    double dFdU[12];
+    Compute_dFdU(el, dFdU);
+    double * dGdF = &dGdFs[81 * el];
+
+    // K(row, column) = sum_inner dGdF(row, inner) * dFdU(inner, column), for row < 9 
+    // K(9 + i, 9 + i) = -K(i, 9 + i) - K(3 + i, 9 + i) - K(6 + i, 9 + i)
+    // (only the entries inner = 3 * (row % 3) + j of dFdU(inner, column) are non-zero, see Compute_dFdU)
+    double KDiag[12];
+    for(int i=0; i<3; i++)
+      KDiag[9 + i] = 0.0;
+    for (int row=0; row<9; row++)
+    {
+      int vtx = row / 3;
+      double * dGdFRow = &dGdF[9 * row + 3 * (row % 3)];
+      double result = 0;
+      double resultD = 0;
+      for (int j=0; j<3; j++)
+      {
+        result += dGdFRow[j] * dFdU[3 * vtx + j];
+        resultD += dGdFRow[j] * dFdU[9 + j];
+      }
+      KDiag[row] = result;
+      KDiag[9 + row % 3] -= resultD;
+    }
+
+    for(int vtx=0; vtx<4; vtx++)
+    {
+      int vIndex = 3 * tetMesh->getVertexIndex(el, vtx);
+      for(int i=0; i<3; i++)
+        diagonal[vIndex + i] += KDiag[3 * vtx + i];
+    }
+  }
+
+  return 0;
+}
+
+void IsotropicHyperelasticFEM::ComputeTetVolumes(int startElement, int endElement)
+{
+  for (int el=startElement; el<endElement; el++)
     tetVolumes[el] = TetMesh::getTetVolume(tetMesh->getVertex(el, 0), tetMesh->getVertex(el, 1), tetMesh->getVertex(el, 2), tetMesh->getVertex(el, 3));
 }
 
@@ -253,10 +432,9 @@ void IsotropicHyperelasticFEM::ComputeTetVolumes()
   Compute the area-weighted vertex normals.
   See p3 section 4 of [Irving 04] for more details.
 */
-void IsotropicHyperelasticFEM::ComputeAreaWeightedVertexNormals()
+void IsotropicHyperelasticFEM::ComputeAreaWeightedVertexNormals(int startElement, int endElement)
 {
-  int numElements = tetMesh->getNumElements();
-  for (int el=0; el<numElements; el++)
+  for (int el=startElement; el<endElement; el++)
   {
     Vec3d * va = tetMesh->getVertex(el, 0);
     Vec3d * vb = tetMesh->getVertex(el, 1);
@@ -312,10 +490,9 @@ void IsotropicHyperelasticFEM::ComputeAreaWeightedVertexNormals()
   The Dm is a 3x3 matrix where the columns are the edge vectors of a
   tet in rest configuration. See p3 section 3 of [Irving 04] for more details.
  */
-void IsotropicHyperelasticFEM::PrepareDeformGrad()
+void IsotropicHyperelasticFEM::PrepareDeformGrad(int startElement, int endElement)
 {
-  int numElements = tetMesh->getNumElements();
-  for (int el=0; el<numElements; el++)
+  for (int el=startElement; el<endElement; el++)
   {
     Vec3d * va = tetMesh->getVertex(el, 0);
     Vec3d * vb = tetMesh->getVertex(el, 1);
@@ -382,6 +559,91 @@ void IsotropicHyperelasticFEM::GetEnergyAndForceAndTangentStiffnessMatrixHelperP
     // reset stiffness matrix
     tangentStiffnessMatrix->ResetToZero();
   }
+
+  if ((computationMode & COMPUTE_LINEARIZATION) && (dGdFs == NULL))
+    dGdFs = (double*) malloc (sizeof(double) * 81 * tetMesh->getNumElements());
+}
+
+/*
+  Compute the deformation gradient F.
+  F = Ds * inv(Dm), where Ds is a 3x3 matrix where
+  the columns are edge vectors of a tet in the current deformation,
+  and Dm is a 3x3 matrix where the columns are edge vectors of a tet in
+  the rest configuration. See p3 section 3 of [Irving 04] for more details.
+*/
+void IsotropicHyperelasticFEM::ComputeDeformationGradient(int el, Mat3d & F)
+{
+  int vaIndex = 3 * tetMesh->getVertexIndex(el, 0);
+  int vbIndex = 3 * tetMesh->getVertexIndex(el, 1);
+  int vcIndex = 3 * tetMesh->getVertexIndex(el, 2);
+  int vdIndex = 3 * tetMesh->getVertexIndex(el, 3);
+
+  Vec3d va(currentVerticesPosition[vaIndex], currentVerticesPosition[vaIndex+1], currentVerticesPosition[vaIndex+2]);
+  Vec3d vb(currentVerticesPosition[vbIndex], currentVerticesPosition[vbIndex+1], currentVerticesPosition[vbIndex+2]);
+  Vec3d vc(currentVerticesPosition[vcIndex], currentVerticesPosition[vcIndex+1], currentVerticesPosition[vcIndex+2]);
+  Vec3d vd(currentVerticesPosition[vdIndex], currentVerticesPosition[vdIndex+1], currentVerticesPosition[vdIndex+2]);
+
+  Vec3d ds1 = vd - va;
+  Vec3d ds2 = vd - vb;
+  Vec3d ds3 = vd - vc;
+  
+  Mat3d tmp(ds1[0], ds2[0], ds3[0], ds1[1], ds2[1], ds3[1], ds1[2], ds2[2], ds3[2]);
+  F = tmp * dmInverses[el];
+}
+
+/*
+  Computes the deformation gradients and their modified SVDs for the elements startEl <= el < endEl 
+  (at most SVDBatchSize elements), storing them into F[el - startEl], U[el - startEl], Fhat[el - startEl] and V[el - startEl]. 
+  The eigendecompositions of F^T F are computed for all the elements at once, using the batched SVD3x3 routine.
+*/
+int IsotropicHyperelasticFEM::ModifiedSVDBatch(int startEl, int endEl, Mat3d * F, Mat3d * U, Vec3d * Fhat, Mat3d * V)
+{
+  int numBatchElements = endEl - startEl;
+  double normalEqBuffer[6][SVDBatchSize];
+  double eigenValueBuffer[3][SVDBatchSize];
+  double eigenVectorBuffer[9][SVDBatchSize];
+  double * normalEq[6] = { normalEqBuffer[0], normalEqBuffer[1], normalEqBuffer[2], normalEqBuffer[3], normalEqBuffer[4], normalEqBuffer[5] };
+  double * eigenValues[3] = { eigenValueBuffer[0], eigenValueBuffer[1], eigenValueBuffer[2] };
+  double * eigenVectors[9];
+  for(int j=0; j<9; j++)
+    eigenVectors[j] = eigenVectorBuffer[j];
+
+  // form F^T F (upper triangle)
+  for(int i=0; i<numBatchElements; i++)
+  {
+    ComputeDeformationGradient(startEl + i, F[i]);
+    Mat3d & Fi = F[i];
+    normalEq[0][i] = Fi[0][0] * Fi[0][0] + Fi[1][0] * Fi[1][0] + Fi[2][0] * Fi[2][0];
+    normalEq[1][i] = Fi[0][0] * Fi[0][1] + Fi[1][0] * Fi[1][1] + Fi[2][0] * Fi[2][1];
+    normalEq[2][i] = Fi[0][0] * Fi[0][2] + Fi[1][0] * Fi[1][2] + Fi[2][0] * Fi[2][2];
+    normalEq[3][i] = Fi[0][1] * Fi[0][1] + Fi[1][1] * Fi[1][1] + Fi[2][1] * Fi[2][1];
+    normalEq[4][i] = Fi[0][1] * Fi[0][2] + Fi[1][1] * Fi[1][2] + Fi[2][1] * Fi[2][2];
+    normalEq[5][i] = Fi[0][2] * Fi[0][2] + Fi[1][2] * Fi[1][2] + Fi[2][2] * Fi[2][2];
+  }
+
+  SVD3x3::SymmetricEigenDecomposition(numBatchElements, normalEq, eigenValues, eigenVectors);
+
+  int exitCode = 0;
+  for(int i=0; i<numBatchElements; i++)
+  {
+    Vec3d eigenValue(eigenValues[0][i], eigenValues[1][i], eigenValues[2][i]);
+    V[i].set(eigenVectors[0][i], eigenVectors[1][i], eigenVectors[2][i],
+      eigenVectors[3][i], eigenVectors[4][i], eigenVectors[5][i],
+      eigenVectors[6][i], eigenVectors[7][i], eigenVectors[8][i]);
+    if (ModifiedSVDFromEigenDecomposition(F[i], eigenValue, U[i], Fhat[i], V[i]) != 0)
+    {
+      printf("error in diagonalization, el=%d\n", startEl + i);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+// SVD_JACOBI_BATCHED bypasses ModifiedSVD, so by default it is only used if ModifiedSVD is not overloaded, i.e., if this object is of the class batchedSVDClass itself
+bool IsotropicHyperelasticFEM::UseBatchedSVD()
+{
+  return (svdMethod == SVD_JACOBI_BATCHED) && (svdMethodSet || (typeid(*this) == *batchedSVDClass));
 }
 
 /*
@@ -400,69 +662,69 @@ int IsotropicHyperelasticFEM::GetEnergyAndForceAndTangentStiffnessMatrixHelperWo
   double energyResult = 0.0;
   //bool dropBelowThreshold = false; // becomes true when a principal stretch falls below the threshold; only used for printing out informative comments
   
+  // In the memory-lean mode, the deformation gradients and their SVDs are not stored for all the elements,
+  // but only for the current batch of elements (SVD_JACOBI_BATCHED), or the current element.
+  Mat3d batchF[SVDBatchSize], batchU[SVDBatchSize], batchV[SVDBatchSize];
+  Vec3d batchFhat[SVDBatchSize];
+  bool batchedSVD = UseBatchedSVD();
+
   // traverse the elements and assemble strain energy, internal forces and tangent stiffness matrix
   int exitCode = 0;
   for (int el=startEl; el<endEl; el++)
   {
-    /*
-      Compute the deformation gradient F.
-      F = Ds * inv(Dm), where Ds is a 3x3 matrix where
-      the columns are edge vectors of a tet in the current deformation,
-      and Dm is a 3x3 matrix where the columns are edge vectors of a tet in
-      the rest configuration. See p3 section 3 of [Irving 04] for more details.
-     */
-    int vaIndex = 3 * tetMesh->getVertexIndex(el, 0);
-    int vbIndex = 3 * tetMesh->getVertexIndex(el, 1);
-    int vcIndex = 3 * tetMesh->getVertexIndex(el, 2);
-    int vdIndex = 3 * tetMesh->getVertexIndex(el, 3);
-
-    Vec3d va(currentVerticesPosition[vaIndex], currentVerticesPosition[vaIndex+1], currentVerticesPosition[vaIndex+2]);
-    Vec3d vb(currentVerticesPosition[vbIndex], currentVerticesPosition[vbIndex+1], currentVerticesPosition[vbIndex+2]);
-    Vec3d vc(currentVerticesPosition[vcIndex], currentVerticesPosition[vcIndex+1], currentVerticesPosition[vcIndex+2]);
-    Vec3d vd(currentVerticesPosition[vdIndex], currentVerticesPosition[vdIndex+1], currentVerticesPosition[vdIndex+2]);
-
-    Vec3d ds1 = vd - va;
-    Vec3d ds2 = vd - vb;
-    Vec3d ds3 = vd - vc;
-    
-    Mat3d tmp(ds1[0], ds2[0], ds3[0], ds1[1], ds2[1], ds3[1], ds1[2], ds2[2], ds3[2]);
-    Fs[el] = tmp * dmInverses[el];
-    //printf("F =\n");
-    //Fs[el].print();
+    int batchElement = (el - startEl) % SVDBatchSize;
+    int slot = memoryLean ? (batchedSVD ? batchElement : 0) : el;
+    Mat3d & F = memoryLean ? batchF[slot] : Fs[slot];
+    Mat3d & U = memoryLean ? batchU[slot] : Us[slot];
+    Mat3d & V = memoryLean ? batchV[slot] : Vs[slot];
+    Vec3d & Fhat = memoryLean ? batchFhat[slot] : Fhats[slot];
+
+    if (batchedSVD)
+    {
+      // the deformation gradients and their SVDs are computed for a batch of elements at a time
+      if (batchElement == 0)
+      {
+        int batchEnd = (el + SVDBatchSize < endEl) ? el + SVDBatchSize : endEl;
+        if (ModifiedSVDBatch(el, batchEnd, &F, &U, &Fhat, &V) != 0)
+          exitCode = 1;
+      }
+    }
+    else
+    {
+      ComputeDeformationGradient(el, F);
+      //printf("F =\n");
+      //F.print();
 
-    /*
-      The deformation gradient has now been computed and is available in Fs[el]
-    */
+      /*
+        The deformation gradient has now been computed and is available in F
+      */
 
-    // perform modified SVD on the deformation gradient
-    Mat3d & F = Fs[el];
-    Mat3d & U = Us[el];
-    Mat3d & V = Vs[el];
-    Vec3d & Fhat = Fhats[el];
-    if (ModifiedSVD(F, U, Fhat, V) != 0)
-    {
-      printf("error in diagonalization, el=%d\n", el);
-      exitCode = 1;
+      // perform modified SVD on the deformation gradient
+      if (ModifiedSVD(F, U, Fhat, V) != 0)
+      {
+        printf("error in diagonalization, el=%d\n", el);
+        exitCode = 1;
+      }
     }
 
     /*
       SVD for the deformation gradient has now been computed.
-      It is available in Us[el], Fhats[el], Vs[el].
+      It is available in U, Fhat, V (i.e., Us[el], Fhats[el], Vs[el], unless in the memory-lean mode).
     */
 
     // clamp fHat if below the principal stretch threshold
     double fHat[3];
     for(int i = 0; i < 3; i++)
     {
-      if(Fhats[el][i] < principalStretchThreshold)
+      if(Fhat[i] < principalStretchThreshold)
       {
         //dropBelowThreshold = true;
-        Fhats[el][i] = principalStretchThreshold;
+        Fhat[i] = principalStretchThreshold;
       }
     }
-    fHat[0] = Fhats[el][0];
-    fHat[1] = Fhats[el][1];
-    fHat[2] = Fhats[el][2];
+    fHat[0] = Fhat[0];
+    fHat[1] = Fhat[1];
+    fHat[2] = Fhat[2];
 
     // query the user-provided isotropic material to compute the strain energy
     if (computationMode & COMPUTE_ENERGY)
@@ -483,10 +745,10 @@ int IsotropicHyperelasticFEM::GetEnergyAndForceAndTangentStiffnessMatrixHelperWo
       Vec3d pHatv(pHat);
   
       // This is the 1st equation in p3 section 5 of [Irving 04]
-      // P = Us[el] * diag(pHat) * trans(Vs[el])
-      Mat3d P = Us[el];
+      // P = U * diag(pHat) * trans(V)
+      Mat3d P = U;
       P.multiplyDiagRight(pHatv);
-      P = P * trans(Vs[el]);
+      P = P * trans(V);
 
       //printf("--- P ---\n");
       //P.print();
@@ -536,7 +798,14 @@ int IsotropicHyperelasticFEM::GetEnergyAndForceAndTangentStiffnessMatrixHelperWo
        */
 
       double K[144];
-      ComputeTetK(el, K);
+      if (memoryLean)
+      {
+        double dPdF[81];
+        Compute_dPdF(el, U, Fhat, V, dPdF);
+        ComputeTetKFrom_dPdF(el, dPdF, K);
+      }
+      else
+        ComputeTetK(el, K);
 
       // write matrices in place
       for(int vtxIndexA=0; vtxIndexA<4; vtxIndexA++)
@@ -558,6 +827,18 @@ int IsotropicHyperelasticFEM::GetEnergyAndForceAndTangentStiffnessMatrixHelperWo
             }
         }
     }
+
+    if (computationMode & COMPUTE_LINEARIZATION)
+    {
+      // store dG/dF, for the matrix-free products with the tangent stiffness matrix
+      double dPdF[81];
+      if (memoryLean)
+        Compute_dPdF(el, U, Fhat, V, dPdF);
+      else
+        Compute_dPdF(el, dPdF);
+      Compute_dGdF(&(areaWeightedVertexNormals[4 * el + 0]), &(areaWeightedVertexNormals[4 * el + 1]),
+                   &(areaWeightedVertexNormals[4 * el + 2]), dPdF, &dGdFs[81 * el]);
+    }
   }
 
   //if (dropBelowThreshold)
@@ -672,10 +953,9 @@ void IsotropicHyperelasticFEM::Compute_dGdF(Vec3d * b0, Vec3d * b1, Vec3d * b2,
   The dF/dU is stored as dFdU in our code, and dDs/dU as dDSdU,
   and inv(Dm) as dmInv
  */
-void IsotropicHyperelasticFEM::Compute_dFdU()
+void IsotropicHyperelasticFEM::Compute_dFdU(int startElement, int endElement)
 {
-  int numElements = tetMesh->getNumElements();
-  for (int el=0; el<numElements; el++)
+  for (int el=startElement; el<endElement; el++)
   {
     double * dFdU = &dFdUs[108 * el];
     Mat3d & dmInv = dmInverses[el];
@@ -693,6 +973,32 @@ void IsotropicHyperelasticFEM::Compute_dFdU()
   }
 }
 
+/*
+  Compute the derivative of the deformation gradient F with respect
+  to the displacement vector u (of the four vertices of the tet), in compact form.
+
+  Because F = Ds*inv(Dm) (see p3 section 3 of [Irving 04]), where the columns
+  of Ds are x_d - x_a, x_d - x_b, x_d - x_c, dF/dU is a sparse 9x12 matrix:
+
+    dF_ij / du_mn = delta_in * dFdU[3 * m + j],
+
+  where dFdU[3 * m + j] = -inv(Dm)_mj for the vertices m = 0, 1, 2 (a, b, c),
+  and dFdU[9 + j] = sum_k inv(Dm)_kj for the vertex m = 3 (d).
+  The products with dF/dU use these 12 coefficients, computed on the fly from dmInverses, which is cheaper
+  than streaming through the 108 entries of dFdUs for each element (and also works in the memory-lean mode).
+ */
+void IsotropicHyperelasticFEM::Compute_dFdU(int el, double dFdU[12])
+{
+  Mat3d & dmInv = dmInverses[el];
+  for (int j=0; j<3; j++)
+  {
+    dFdU[j] = -dmInv[0][j];
+    dFdU[3 + j] = -dmInv[1][j];
+    dFdU[6 + j] = -dmInv[2][j];
+    dFdU[9 + j] = dmInv[0][j] + dmInv[1][j] + dmInv[2][j];
+  }
+}
+
 /*
   Compute the element stiffness matrix K. 
   Since a tet has 12 dof (i.e., 4 vertices * 3 dof), the element K has 144 entries.
@@ -719,26 +1025,28 @@ void IsotropicHyperelasticFEM::ComputeTetK(int el, double K[144])
     | dP_33/dF_11  dP_33/dF_12  dP_33/dF_13  dP_33/dF_21 ... dP_33/dF_33 |
   */
   double dPdF[81]; //in 9x9 matrix format
-  double dGdF[81]; //in 9x9 matrix format
-
-  //dF_dU should be already executed by the constructor before running this function
   Compute_dPdF(el, dPdF);
+  ComputeTetKFrom_dPdF(el, dPdF, K);
+}
+
+// the second half of ComputeTetK: computes K, given dP/dF
+void IsotropicHyperelasticFEM::ComputeTetKFrom_dPdF(int el, double dPdF[81], double K[144])
+{
+  double dGdF[81]; //in 9x9 matrix format
   Compute_dGdF(&(areaWeightedVertexNormals[4 * el + 0]), &(areaWeightedVertexNormals[4 * el + 1]),
                &(areaWeightedVertexNormals[4 * el + 2]), dPdF, dGdF);
-  double * dFdU = &dFdUs[108 * el];
+  double dFdU[12];
+  Compute_dFdU(el, dFdU);
 
   // K is stored column-major (however, it doesn't matter because K is symmetric)
+  // dGdF is 9x9, and dFdU is 9x12; column 3 * m + n of dFdU is non-zero only in the rows 3 * n + j (see Compute_dFdU)
   for (int row=0; row<9; row++)
   {
     for (int column=0; column<12; column++)
     {
-      double result = 0;
-      for (int inner=0; inner<9; inner++)
-      {
-	//dGdF is 9x9, and dFdU is 9x12
-	result += dGdF[9 * row + inner]*dFdU[12 * inner + column];
-      }
-      K[12 * column + row] = result;
+      double * dGdFRow = &dGdF[9 * row + 3 * (column % 3)];
+      double * dFdUColumn = &dFdU[3 * (column / 3)];
+      K[12 * column + row] = dGdFRow[0] * dFdUColumn[0] + dGdFRow[1] * dFdUColumn[1] + dGdFRow[2] * dFdUColumn[2];
     }
   }
 
@@ -849,7 +1157,13 @@ inline double IsotropicHyperelasticFEM::gammaValue(int i, int j, double sigma[3]
 // see [Teran 05]
 void IsotropicHyperelasticFEM::Compute_dPdF(int el, double dPdF[81])
 {
-  double sigma[3] = { Fhats[el][0], Fhats[el][1], Fhats[el][2] };
+  Compute_dPdF(el, Us[el], Fhats[el], Vs[el], dPdF);
+}
+
+// same as above, for the given SVD of the deformation gradient of element el
+void IsotropicHyperelasticFEM::Compute_dPdF(int el, Mat3d & U, Vec3d & Fhat, Mat3d & V, double dPdF[81])
+{
+  double sigma[3] = { Fhat[0], Fhat[1], Fhat[2] };
 
   double sigma1square = sigma[0] * sigma[0];
   double sigma2square = sigma[1] * sigma[1];
@@ -863,9 +1177,9 @@ void IsotropicHyperelasticFEM::Compute_dPdF(int el, double dPdF[81])
   invariants[2] = sigma1square * sigma2square * sigma3square;
 
   //double E[3];
-  //E[0] = 0.5 * (Fhats[el][0] * Fhats[el][0] - 1);
-  //E[1] = 0.5 * (Fhats[el][1] * Fhats[el][1] - 1);
-  //E[2] = 0.5 * (Fhats[el][2] * Fhats[el][2] - 1);
+  //E[0] = 0.5 * (Fhat[0] * Fhat[0] - 1);
+  //E[1] = 0.5 * (Fhat[1] * Fhat[1] - 1);
+  //E[2] = 0.5 * (Fhat[2] * Fhat[2] - 1);
 
   double gradient[3];
   /*
@@ -965,8 +1279,8 @@ void IsotropicHyperelasticFEM::Compute_dPdF(int el, double dPdF[81])
     | dP_22/dF_00  dP_22/dF_01 dP_22/dF_02 dP_22/dF_10 ... dP22/dF_22 |
    */
 
-  Mat3d UT = trans(Us[el]); // trans(*U);
-  Mat3d VT = trans(Vs[el]); // trans(*V);
+  Mat3d UT = trans(U);
+  Mat3d VT = trans(V);
 
   /*
     U->print();
@@ -982,7 +1296,7 @@ void IsotropicHyperelasticFEM::Compute_dPdF(int el, double dPdF[81])
   {
     eiejVector[column] = 1.0;
     Mat3d ei_ej(eiejVector);
-    Mat3d ut_eiej_v = UT*ei_ej*(Vs[el]);
+    Mat3d ut_eiej_v = UT*ei_ej*V;
     double ut_eiej_v_TeranVector[9]; //in Teran order
     ut_eiej_v_TeranVector[rowMajorMatrixToTeran[0]] = ut_eiej_v[0][0];
     ut_eiej_v_TeranVector[rowMajorMatrixToTeran[1]] = ut_eiej_v[0][1];
@@ -1005,7 +1319,7 @@ void IsotropicHyperelasticFEM::Compute_dPdF(int el, double dPdF[81])
       dPdF_resultVector[teranToRowMajorMatrix[innerRow]] = tempResult;
     }
     Mat3d dPdF_resultMatrix(dPdF_resultVector);
-    Mat3d u_dpdf_vt = (Us[el])*dPdF_resultMatrix*VT;
+    Mat3d u_dpdf_vt = U*dPdF_resultMatrix*VT;
     dPdF[column +  0] = u_dpdf_vt[0][0];
     dPdF[column +  9] = u_dpdf_vt[0][1];
     dPdF[column + 18] = u_dpdf_vt[0][2];
@@ -1051,6 +1365,14 @@ void IsotropicHyperelasticFEM::ComputeDampingForces(double dampingPsi, double da
 {
   Mat3d I(1.0); // identity matrix
 
+  // the memory-lean mode needs the current positions, to recompute the deformation gradients
+  if (memoryLean)
+  {
+    int numVertices3 = 3 * tetMesh->getNumVertices();
+    for(int i=0; i<numVertices3; i++)
+      currentVerticesPosition[i] = restVerticesPosition[i] + u[i];
+  }
+
   // --- damping forces ---
   int numElements = tetMesh->getNumElements();
   for (int el=0; el<numElements; el++)
@@ -1074,8 +1396,17 @@ void IsotropicHyperelasticFEM::ComputeDampingForces(double dampingPsi, double da
 	      velocity1[1], velocity2[1], velocity3[1], 
 	      velocity1[2], velocity2[2], velocity3[2]);
 
-    Mat3d & U = Us[el];
-    Mat3d & V = Vs[el];
+    // in the memory-lean mode, the SVD of the deformation gradient is recomputed from u
+    Mat3d leanF, leanU, leanV;
+    Vec3d leanFhat;
+    if (memoryLean)
+    {
+      ComputeDeformationGradient(el, leanF);
+      ModifiedSVD(leanF, leanU, leanFhat, leanV);
+    }
+
+    Mat3d & U = memoryLean ? leanU : Us[el];
+    Mat3d & V = memoryLean ? leanV : Vs[el];
     Mat3d FDotHat = trans(U) * (tmp * dmInverses[el]) * V;
     Mat3d Phat = 2 * dampingPsi * FDotHat + dampingAlpha * (FDotHat[0][0] + FDotHat[1][1] + FDotHat[2][2]) * I;
     Mat3d P = U * Phat * trans(V);
@@ -1129,11 +1460,44 @@ void IsotropicHyperelasticFEM::ComputeDampingForces(double dampingPsi, double da
   Fhat is then recovered using sqrt from Fhat^2.
   To recover U, compute U = F * V * diag(Fhat^{-1}).
   Care must be taken when singular values of Fhat are small (handled in the code below).
+
+  The eigendecomposition of F^T F is computed using SVD3x3 (a fixed number of Jacobi sweeps, see svd3x3.h), 
+  or using eigen_sym (see SetSVDMethod). ModifiedSVDFromEigenDecomposition performs the rest of the computation.
 */
 
 #define modifiedSVD_singularValue_eps 1e-8
 
 int IsotropicHyperelasticFEM::ModifiedSVD(Mat3d & F, Mat3d & U, Vec3d & Fhat, Mat3d & V)
+{
+  // form F^T F and do eigendecomposition
+  Mat3d normalEq = trans(F) * F;
+  Vec3d eigenValues;
+
+  if (svdMethod == SVD_EIGEN_SYM)
+  {
+    Vec3d eigenVectors[3];
+
+    // note that normalEq is changed after calling eigen_sym
+    eigen_sym(normalEq, eigenValues, eigenVectors);
+
+    V.set(eigenVectors[0][0], eigenVectors[1][0], eigenVectors[2][0],
+      eigenVectors[0][1], eigenVectors[1][1], eigenVectors[2][1],
+      eigenVectors[0][2], eigenVectors[1][2], eigenVectors[2][2]);
+  }
+  else
+    SVD3x3::SymmetricEigenDecomposition(normalEq, eigenValues, V);
+
+  /*
+    printf("--- original V ---\n");
+    V.print();
+    printf("--- eigenValues ---\n");
+    printf("%G %G %G\n", eigenValues[0], eigenValues[1], eigenValues[2]);
+  */
+
+  return ModifiedSVDFromEigenDecomposition(F, eigenValues, U, Fhat, V);
+}
+
+int IsotropicHyperelasticFEM::ModifiedSVDFromEigenDecomposition(Mat3d & F, Vec3d & eigenValues, Mat3d & U, Vec3d & Fhat, Mat3d & V)
 {
   // The code handles the following necessary special situations (see the code below) :
 
@@ -1149,24 +1513,6 @@ int IsotropicHyperelasticFEM::ModifiedSVD(Mat3d & F, Mat3d & U, Vec3d & Fhat, Ma
   //      and the corresponding column of U
   //---------------------------------------------------------
 
-  // form F^T F and do eigendecomposition
-  Mat3d normalEq = trans(F) * F;
-  Vec3d eigenValues;
-  Vec3d eigenVectors[3];
-
-  // note that normalEq is changed after calling eigen_sym
-  eigen_sym(normalEq, eigenValues, eigenVectors);
-
-  V.set(eigenVectors[0][0], eigenVectors[1][0], eigenVectors[2][0],
-    eigenVectors[0][1], eigenVectors[1][1], eigenVectors[2][1],
-    eigenVectors[0][2], eigenVectors[1][2], eigenVectors[2][2]);
-  /*
-    printf("--- original V ---\n");
-    V.print();
-    printf("--- eigenValues ---\n");
-    printf("%G %G %G\n", eigenValues[0], eigenValues[1], eigenValues[2]);
-  */
-
   // Handle situation:
   // 1. det(V) == -1
   //    - simply multiply a column of V by -1
@@ -30,7 +30,9 @@
 #define _ISOTROPICHYPERELASTICFEM_H_
 
 #include <float.h>
+#include <typeinfo>
 #include "volumetricMesh/tetMesh.h"
+#include "volumetricMesh/volumetricMeshCache.h"
 #include "sparseMatrix/sparseMatrix.h"
 #include "isotropicHyperelasticFEM/isotropicMaterial.h"
 
@@ -60,7 +62,9 @@ public:
   // Before creating this class, you must first create the tet mesh, and create an instance of the "IsotropicMaterial" material (e.g., NeoHookeanMaterial).
   // If the principal stretches are smaller than the principalStretchThreshold, they will be clamped to that.  This is important to ensure invertibility. For example, a typical principalStretchThreshold value (e.g., for invertible StVK) would be 0.6. By default, clamping is disabled.
   // Note: material properties in the "tetMesh" variable are ignored (only geometry is used); the material properties are specified by "isotropicMaterial" (and may be non-homogeneous) 
-  IsotropicHyperelasticFEM(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial, double principalStretchThreshold=-DBL_MAX, bool addGravity=false, double g=9.81);
+  // cache: if not NULL, the precomputed element data (dmInverses) and the stiffness matrix topology are loaded from the cache if available, and otherwise computed and stored into the cache (see volumetricMesh/volumetricMeshCache.h)
+  // numThreads: number of threads used for the precomputation in the constructor
+  IsotropicHyperelasticFEM(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial, double principalStretchThreshold=-DBL_MAX, bool addGravity=false, double g=9.81, VolumetricMeshCache * cache=NULL, int numThreads=1);
   virtual ~IsotropicHyperelasticFEM();
 
   double ComputeEnergy(double * u); // get the nonlinear elastic strain energy
@@ -79,6 +83,18 @@ public:
   // get both nonlinear internal forces and nonlinear stiffness matrix
   void GetForceAndTangentStiffnessMatrix(double * u, double * internalForces, SparseMatrix * tangentStiffnessMatrix);
 
+  // matrix-free tangent stiffness matrix:
+  // computes the internal forces at u, and stores the derivative of the element nodal forces with respect to F (dG/dF, 81 doubles per tet) at u
+  // afterwards, the tangent stiffness matrix at u can be multiplied with vectors element by element, without ever assembling the sparse matrix
+  void ComputeForcesAndLinearization(double * u, double * internalForces);
+  // Kv = K(u) * v, where u is the displacement vector given to the last ComputeForcesAndLinearization call
+  // v and Kv must be (pre-allocated) vectors of length 3 * numVertices
+  // returns 0 on success, and 1 (with Kv set to zero) if ComputeForcesAndLinearization has not been called yet
+  virtual int MultiplyTangentStiffnessMatrix(double * v, double * Kv);
+  // computes the diagonal of K(u) (e.g., for Jacobi preconditioning), u is as in MultiplyTangentStiffnessMatrix
+  // returns 0 on success, and 1 (with the diagonal set to zero) if ComputeForcesAndLinearization has not been called yet
+  int GetTangentStiffnessMatrixDiagonal(double * diagonal);
+
   // compute damping forces based on the velocity of the vertices,
   // see p6 section 6.2 of [Irving 04]
   void ComputeDampingForces(double dampingPsi, double dampingAlpha, double * u, double * uvel, double * dampingForces);
@@ -88,18 +104,39 @@ public:
 
   inline TetMesh * GetTetMesh() { return tetMesh; }
 
+  // selects the routine used to compute the SVD of the deformation gradients (via the eigendecomposition of F^T F, see ModifiedSVD):
+  // SVD_JACOBI: fixed-iteration Jacobi (see svd3x3.h); one element at a time, about as fast as SVD_EIGEN_SYM
+  // SVD_JACOBI_BATCHED: same, but processes SVDBatchSize elements at once (faster); this is the default
+  //   note: this bypasses ModifiedSVD; therefore, by default, it is only used by IsotropicHyperelasticFEM and IsotropicHyperelasticFEMMT,
+  //   and classes derived from them (which may overload ModifiedSVD) use SVD_JACOBI instead; calling SetSVDMethod(SVD_JACOBI_BATCHED) enables it in any class
+  // SVD_EIGEN_SYM: eigen_sym from minivector/mat3d.h
+  typedef enum { SVD_JACOBI, SVD_JACOBI_BATCHED, SVD_EIGEN_SYM } SVDMethodType;
+  void SetSVDMethod(SVDMethodType svdMethod) { this->svdMethod = svdMethod; svdMethodSet = true; }
+  // returns the method that is actually used (see above)
+  inline SVDMethodType GetSVDMethod() { return ((svdMethod == SVD_JACOBI_BATCHED) && !UseBatchedSVD()) ? SVD_JACOBI : svdMethod; }
+
+  // memory-lean mode: the deformation gradients and their SVDs (Fs, Us, Vs, Fhats) are not stored for all the elements,
+  // but only temporarily, during the computation; ComputeDampingForces then recomputes them from u
+  // note: in this mode, ComputeTetK and Compute_dPdF(el, dPdF) are not used (the workhorse calls ComputeTetKFrom_dPdF and Compute_dPdF(el, U, Fhat, V, dPdF) instead),
+  // and dFdUs is not stored; to customize the stiffness matrix in both modes, overload ComputeTetKFrom_dPdF and/or Compute_dPdF(el, U, Fhat, V, dPdF)
+  void SetMemoryLean(bool memoryLean);
+  inline bool GetMemoryLean() { return memoryLean; }
+
   // === Advanced functions below; you normally do not need to use them: ===
   // Computes strain energy, internal forces, and/or tangent stiffness matrix, as requested by computationMode. It returns 0 on success, and non-zero on failure.
   // computationMode:
   // bit 0: compute energy
   // bit 1: compute internal force
   // bit 2: compute stiffness matrix
-  typedef enum { COMPUTE_ENERGY=1, COMPUTE_INTERNALFORCES=2, COMPUTE_TANGENTSTIFFNESSMATRIX=4 } computationModeType;
+  // bit 3: store the element dG/dF matrices for MultiplyTangentStiffnessMatrix
+  typedef enum { COMPUTE_ENERGY=1, COMPUTE_INTERNALFORCES=2, COMPUTE_TANGENTSTIFFNESSMATRIX=4, COMPUTE_LINEARIZATION=8 } computationModeType;
   virtual int GetEnergyAndForceAndTangentStiffnessMatrixHelper(double * u, double * energy, double * internalForces, SparseMatrix * tangentStiffnessMatrix, int computationMode);
   // Initialization for "GetEnergyAndForceAndTangentStiffnessMatrixPrologue" (must always be called before calling "GetEnergyAndForceAndTangentStiffnessMatrixHelperWorkhorse")
   void GetEnergyAndForceAndTangentStiffnessMatrixHelperPrologue(double * u, double * energy, double * internalForces, SparseMatrix * tangentStiffnessMatrix, int computationMode);
   // The workhorse (main computational routine); processes mesh elements startEl <= el < endEl (assembles partial strain energy, internal forces, and/or tangent stiffness matrix, as requested by computationMode. It returns 0 on success, and non-zero on failure.
   int GetEnergyAndForceAndTangentStiffnessMatrixHelperWorkhorse(int startEl, int endEl, double * u, double * energy, double * internalForces, SparseMatrix * tangentStiffnessMatrix, int computationMode);
+  // Adds the K * v contributions of mesh elements startEl <= el < endEl into Kv (the matrix-free product routine)
+  void MultiplyTangentStiffnessMatrixWorkhorse(int startEl, int endEl, double * v, double * Kv);
 
 protected:
   TetMesh * tetMesh;
@@ -108,6 +145,11 @@ protected:
   // acceleration indices
   int ** row_;
   int ** column_;
+  void BuildAccelerationIndices(SparseMatrix * stiffnessMatrixTopology, int startElement, int endElement);
+
+  // performs all the per-element precomputation for the elements startElement <= el < endElement (see VolumetricMeshThreads)
+  struct PrecomputationData;
+  static void PrecomputeElementRange(void * data, int startElement, int endElement);
 
   double * restVerticesPosition;    // length equals to the #vertices in the mesh times 3
   double * currentVerticesPosition; // it equals restVerticesPosition + u
@@ -127,6 +169,8 @@ protected:
   // of the edge vectors of a tet. See p3 section 3 of [Irving 04]
   // length of this array equals to the number of tet in the mesh
   Mat3d * dmInverses;
+  // Fs, Fhats, Vs and Us contain the values of the last computation; they (and dFdUs) are NULL in the memory-lean mode
+  bool memoryLean;
   // an array of deformation gradient F
   Mat3d * Fs;
   // an array of F^hat (i.e., the principal stretches)
@@ -138,12 +182,12 @@ protected:
 
   // tet volumes; necessary to compute the elastic strain energy
   double * tetVolumes;
-  void ComputeTetVolumes();
+  void ComputeTetVolumes(int startElement, int endElement);
 
   // the area weighted vertex normals in the rest configuration
-  void ComputeAreaWeightedVertexNormals();
+  void ComputeAreaWeightedVertexNormals(int startElement, int endElement);
   // compute inv(Dm)
-  void PrepareDeformGrad(); // called once in the constructor
+  void PrepareDeformGrad(int startElement, int endElement); // called once in the constructor
 
   // given a vector, find a unit vector that is orthogonal to it
   void FindOrthonormalVector(Vec3d & v, Vec3d & result);
@@ -152,14 +196,23 @@ protected:
   virtual double ComputeEnergyFromStretches(int elementIndex, double * lambda);
   // Compute the diagonalized first Piola-Kirchhoff stress P^hat
   virtual void ComputeDiagonalPFromStretches(int elementIndex, double * lambda, double * PDiag);
-  // Compute the element stiffness matrix
+  // Compute the element stiffness matrix (by default, via Compute_dPdF(el, dPdF) and ComputeTetKFrom_dPdF)
   virtual void ComputeTetK(int el, double K[144]);
+  // the element stiffness matrix, given dPdF
+  virtual void ComputeTetKFrom_dPdF(int el, double dPdF[81], double K[144]);
   // Compute the derivative of the first Piola Kirchhoff stress P with respect to
   // the deformation gradient F. Since P and F both have 9 entries, dPdF has 81 entries
+  // (by default, via Compute_dPdF(el, Us[el], Fhats[el], Vs[el], dPdF))
   virtual void Compute_dPdF(int el, double dPdF[81]);
+  // same as above, given the SVD of the deformation gradient (instead of taking it from Us[el], Fhats[el], Vs[el])
+  // note: if you overload only one of the two variants in a derived class, add "using IsotropicHyperelasticFEM::Compute_dPdF;" to it, so that the other one is not hidden
+  virtual void Compute_dPdF(int el, Mat3d & U, Vec3d & Fhat, Mat3d & V, double dPdF[81]);
   // Compute the derivative of the deformation gradient F with respect 
-  // to the displacement vector u
-  void Compute_dFdU();
+  // to the displacement vector u, storing it into dFdUs (for the elements startElement <= el < endElement)
+  void Compute_dFdU(int startElement, int endElement);
+  // same as above, for element el, in compact form: dF/dU is a sparse 9x12 matrix, 
+  // given by 12 coefficients (see the implementation); this does not require dFdUs
+  void Compute_dFdU(int el, double dFdU[12]);
   // The G is a 3x3 matrix where the columns are the nodal forces 
   // (see p3 section 4 of [Irving 04]). So dGdF is the derivative of G (i.e., nodal forces)
   // with respect to the deformation gradient F
@@ -172,7 +225,17 @@ protected:
 
   // dFdUs is an array of dFdU (i.e., derivative of the deformation gradient with
   // respect to the displacement vector u), and dFdU is stored as a array of doubles.
+  // (the products with dF/dU use the compact form computed by Compute_dFdU(el, dFdU); dFdUs is kept for derived classes)
   double * dFdUs; // array of length 9x12 x numElements
+
+  // dmInverses are either malloc-ed or loaded from the cache
+  VolumetricMeshCache * cache;
+  char * precomputedBlock;
+  bool precomputedBlockFromCache;
+
+  // dGdFs is an array of dGdF at the last linearization (see ComputeForcesAndLinearization)
+  // it is only allocated once the matrix-free product is first used
+  double * dGdFs; // array of length 9x9 x numElements
   // Ds is the matrix which the columns are the edge vector of a tet (see p3 
   // section 3 of [Irving 04]). dDSdU is a 9x12 matrix which stores the derivative
   // of the Ds matrix with respect to the displacement vector u. Because Ds has 9 entries
@@ -216,6 +279,18 @@ protected:
   // (see the macro modifiedSVD_singularValue_eps in the implementation).
   // Note: you can overload this function (in your own derived class) if you want to provide your own, custom/faster SVD.
   virtual int ModifiedSVD(Mat3d & F, Mat3d & U, Vec3d & Fhat, Mat3d & V);
+  // the second half of ModifiedSVD: given the eigendecomposition F^T F = V diag(eigenValues) V^T (eigenvalues in descending order), computes U and Fhat, and fixes V
+  int ModifiedSVDFromEigenDecomposition(Mat3d & F, Vec3d & eigenValues, Mat3d & U, Vec3d & Fhat, Mat3d & V);
+
+  SVDMethodType svdMethod;
+  bool svdMethodSet; // true if SetSVDMethod was called
+  const std::type_info * batchedSVDClass; // the class that uses SVD_JACOBI_BATCHED by default (its ModifiedSVD is not overloaded)
+  bool UseBatchedSVD();
+  static const int SVDBatchSize = 32;
+  // computes the deformation gradients F[i], and their modified SVDs U[i], Fhat[i], V[i], of the elements el = startEl + i < endEl (at most SVDBatchSize elements), with SVD_JACOBI_BATCHED
+  int ModifiedSVDBatch(int startEl, int endEl, Mat3d * F, Mat3d * U, Vec3d * Fhat, Mat3d * V);
+  // computes the deformation gradient F of element el from currentVerticesPosition
+  void ComputeDeformationGradient(int el, Mat3d & F);
 };
 
 #endif
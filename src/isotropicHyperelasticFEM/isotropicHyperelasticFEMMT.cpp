@@ -33,15 +33,37 @@
 #include <pthread.h>
 #include "isotropicHyperelasticFEMMT.h"
 
-IsotropicHyperelasticFEMMT::IsotropicHyperelasticFEMMT(TetMesh * tetMesh_, IsotropicMaterial * isotropicMaterial_, double principalStretchThreshold_, bool addGravity_, double g_, int numThreads_) :
-  IsotropicHyperelasticFEM(tetMesh_, isotropicMaterial_, principalStretchThreshold_, addGravity_, g_),
+IsotropicHyperelasticFEMMT::IsotropicHyperelasticFEMMT(TetMesh * tetMesh_, IsotropicMaterial * isotropicMaterial_, double principalStretchThreshold_, bool addGravity_, double g_, int numThreads_, VolumetricMeshCache * cache_) :
+  IsotropicHyperelasticFEM(tetMesh_, isotropicMaterial_, principalStretchThreshold_, addGravity_, g_, cache_, numThreads_),
   numThreads(numThreads_)
 {
+  batchedSVDClass = &typeid(IsotropicHyperelasticFEMMT);
   Initialize();
 }
 
 IsotropicHyperelasticFEMMT::~IsotropicHyperelasticFEMMT()
 {
+  if (productThreads != NULL)
+  {
+    pthread_mutex_lock(&productMutex);
+    productShutdown = true;
+    pthread_cond_broadcast(&productStartCondition);
+    pthread_mutex_unlock(&productMutex);
+
+    for(int i=1; i<numThreads; i++)
+    {
+      if (pthread_join(productThreads[i], NULL) != 0)
+      {
+        printf("Error: unable to join thread %d.\n", i);
+        exit(1);
+      }
+    }
+    free(productThreads);
+  }
+  pthread_cond_destroy(&productDoneCondition);
+  pthread_cond_destroy(&productStartCondition);
+  pthread_mutex_destroy(&productMutex);
+
   free(startElement);
   free(endElement);
   free(energyBuffer);
@@ -123,6 +145,16 @@ void IsotropicHyperelasticFEMMT::Initialize()
   printf("Num threads: %d \n", numThreads);
   printf("Canonical job size: %d \n", jobSize);
   printf("Num threads with job size augmented by one edge: %d \n", remainder);
+
+  // the product threads are launched at the first product
+  productThreads = NULL;
+  pthread_mutex_init(&productMutex, NULL);
+  pthread_cond_init(&productStartCondition, NULL);
+  pthread_cond_init(&productDoneCondition, NULL);
+  productGeneration = 0;
+  numBusyProductThreads = 0;
+  productShutdown = false;
+  productVector = NULL;
 }
 
 int IsotropicHyperelasticFEMMT::GetEnergyAndForceAndTangentStiffnessMatrixHelper(double * u, double * energy, double * internalForces, SparseMatrix * tangentStiffnessMatrix, int computationMode)
@@ -197,6 +229,108 @@ int IsotropicHyperelasticFEMMT::GetEnergyAndForceAndTangentStiffnessMatrixHelper
   return code;
 }
 
+struct IsotropicHyperelasticFEMMT_productThreadArg
+{
+  IsotropicHyperelasticFEMMT * isotropicHyperelasticFEMMT;
+  int rank;
+};
+
+void * IsotropicHyperelasticFEMMT_ProductWorkerThread(void * arg)
+{
+  struct IsotropicHyperelasticFEMMT_productThreadArg * threadArgp = (struct IsotropicHyperelasticFEMMT_productThreadArg*) arg;
+  IsotropicHyperelasticFEMMT * isotropicHyperelasticFEMMT = threadArgp->isotropicHyperelasticFEMMT;
+  int rank = threadArgp->rank;
+  free(threadArgp);
+
+  isotropicHyperelasticFEMMT->ProductWorkerThread(rank);
+
+  return NULL;
+}
+
+void IsotropicHyperelasticFEMMT::LaunchProductThreads()
+{
+  productThreads = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
+  for(int i=1; i<numThreads; i++)
+  {
+    struct IsotropicHyperelasticFEMMT_productThreadArg * threadArgp = (struct IsotropicHyperelasticFEMMT_productThreadArg*) malloc (sizeof(struct IsotropicHyperelasticFEMMT_productThreadArg));
+    threadArgp->isotropicHyperelasticFEMMT = this;
+    threadArgp->rank = i;
+    if (pthread_create(&productThreads[i], NULL, IsotropicHyperelasticFEMMT_ProductWorkerThread, threadArgp) != 0)
+    {
+      printf("Error: unable to launch thread %d.\n", i);
+      exit(1);
+    }
+  }
+}
+
+void IsotropicHyperelasticFEMMT::ProductWorkerThread(int rank)
+{
+  int numVertices3 = 3 * tetMesh->getNumVertices();
+  double * Kv = &internalForceBuffer[rank * numVertices3];
+
+  int lastGeneration = 0;
+  while (true)
+  {
+    pthread_mutex_lock(&productMutex);
+    while ((productGeneration == lastGeneration) && !productShutdown)
+      pthread_cond_wait(&productStartCondition, &productMutex);
+    if (productShutdown)
+    {
+      pthread_mutex_unlock(&productMutex);
+      break;
+    }
+    lastGeneration = productGeneration;
+    pthread_mutex_unlock(&productMutex);
+
+    memset(Kv, 0, sizeof(double) * numVertices3);
+    MultiplyTangentStiffnessMatrixWorkhorse(startElement[rank], endElement[rank], productVector, Kv);
+
+    pthread_mutex_lock(&productMutex);
+    numBusyProductThreads--;
+    if (numBusyProductThreads == 0)
+      pthread_cond_signal(&productDoneCondition);
+    pthread_mutex_unlock(&productMutex);
+  }
+}
+
+int IsotropicHyperelasticFEMMT::MultiplyTangentStiffnessMatrix(double * v, double * Kv)
+{
+  int numVertices3 = 3 * tetMesh->getNumVertices();
+  memset(Kv, 0, sizeof(double) * numVertices3);
+  if (dGdFs == NULL)
+  {
+    printf("Error: MultiplyTangentStiffnessMatrix called before ComputeForcesAndLinearization.\n");
+    return 1;
+  }
+
+  if ((productThreads == NULL) && (numThreads > 1))
+    LaunchProductThreads();
+
+  // wake up the product threads; the calling thread processes rank 0, directly into Kv
+  pthread_mutex_lock(&productMutex);
+  productVector = v;
+  numBusyProductThreads = numThreads - 1;
+  productGeneration++;
+  pthread_cond_broadcast(&productStartCondition);
+  pthread_mutex_unlock(&productMutex);
+
+  MultiplyTangentStiffnessMatrixWorkhorse(startElement[0], endElement[0], v, Kv);
+
+  pthread_mutex_lock(&productMutex);
+  while (numBusyProductThreads > 0)
+    pthread_cond_wait(&productDoneCondition, &productMutex);
+  pthread_mutex_unlock(&productMutex);
+
+  for(int i=1; i<numThreads; i++)
+  {
+    double * source = &internalForceBuffer[i * numVertices3];
+    for(int j=0; j<numVertices3; j++)
+      Kv[j] += source[j];
+  }
+
+  return 0;
+}
+
 int IsotropicHyperelasticFEMMT::GetStartElement(int rank)
 {
   return startElement[rank];
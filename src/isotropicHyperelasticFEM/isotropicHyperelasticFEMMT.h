@@ -29,6 +29,7 @@
 #ifndef _ISOTROPICHYPERELASTICFEMMT_H_
 #define _ISOTROPICHYPERELASTICFEMMT_H_
 
+#include <pthread.h>
 #include "isotropicHyperelasticFEM.h"
 
 /*
@@ -36,6 +37,9 @@
   It uses POSIX threads ("pthreads") as the threading API.
   Each thread assembles the internal force with respect to a subset of all the mesh elements. 
   At the end, the individual results are added into a global internal force vector.
+  The matrix-free products with the tangent stiffness matrix are parallelized in the same way;
+  as they are cheap and called many times per timestep (e.g., by the CG solver), their threads 
+  are launched once (at the first product) and then kept waiting for the subsequent products.
 
   See also "isotropicHyperelasticFEM.h".
 */
@@ -45,16 +49,22 @@ class IsotropicHyperelasticFEMMT : public IsotropicHyperelasticFEM
 public:
   // see "isotropicHyperelasticFEM.h" for usage
   // numThreads is the number of threads to use for the computation
-  IsotropicHyperelasticFEMMT(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial, double principalStretchThreshold=-DBL_MAX, bool addGravity=false, double g=9.81, int numThreads=1);
+  IsotropicHyperelasticFEMMT(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial, double principalStretchThreshold=-DBL_MAX, bool addGravity=false, double g=9.81, int numThreads=1, VolumetricMeshCache * cache=NULL);
   virtual ~IsotropicHyperelasticFEMMT();
 
   // Computes strain energy, internal forces, and/or tangent stiffness matrix, as requested by computationMode. It returns 0 on success, and non-zero on failure.
   // this is an advanced function; you normally do not need to use it
   virtual int GetEnergyAndForceAndTangentStiffnessMatrixHelper(double * u, double * energy, double * internalForces, SparseMatrix * tangentStiffnessMatrix, int computationMode);
 
+  // multi-threaded matrix-free product Kv = K(u) * v (see "isotropicHyperelasticFEM.h")
+  virtual int MultiplyTangentStiffnessMatrix(double * v, double * Kv);
+
   int GetStartElement(int rank);
   int GetEndElement(int rank);
 
+  // advanced: the loop of the product threads (called internally)
+  void ProductWorkerThread(int rank);
+
 protected:
   int numThreads;
   int * startElement, * endElement;
@@ -62,7 +72,17 @@ protected:
   double * internalForceBuffer;
   SparseMatrix ** tangentStiffnessMatrixBuffer;
 
+  // persistent product threads (the calling thread processes rank 0)
+  pthread_t * productThreads;
+  pthread_mutex_t productMutex;
+  pthread_cond_t productStartCondition, productDoneCondition;
+  int productGeneration;
+  int numBusyProductThreads;
+  bool productShutdown;
+  double * productVector;
+
   void Initialize();
+  void LaunchProductThreads();
 };
 
 #endif
@@ -0,0 +1,187 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "isotropic hyperelastic FEM" library , Copyright (C) 2012 USC         *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code authors: Jernej Barbic, Fun Shing Sin                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <math.h>
+#include <float.h>
+#include "svd3x3.h"
+
+/*
+  The symmetric matrix is stored as its diagonal d0, d1, d2, and its off-diagonal entries o01, o12, o20.
+  The Jacobi rotation in the (p,q) plane (with r being the third index, and (p,q,r) a cyclic permutation of (0,1,2)) 
+  zeroes out the entry (p,q). It is a rotation around the axis r; its (unnormalized) quaternion is multiplied into (qw, qp, qq, qr).
+  In the (p,q) plane: spp = d_p, sqq = d_q, spq = o_pq, srp = o_rp, srq = o_rq.
+*/
+static inline void SVD3x3_JacobiRotation(double & spp, double & sqq, double & spq, double & srp, double & srq, 
+  double & qw, double & qp, double & qq, double & qr)
+{
+  // cosine and sine of the rotation angle theta, with tan(2 theta) = 2 spq / (sqq - spp), and |theta| <= pi/4 
+  // (see Numerical Recipes, Section 11.1); using the half-angle formulas for cos(theta) and sin(theta),
+  // c = (r + |d|) / m, s = 2 spq sign(d) / m, t = tan(theta) = 2 spq sign(d) / (r + |d|), 
+  // where r = sqrt(d^2 + 4 spq^2), m = sqrt(2 r (r + |d|));
+  // the rotation is the identity if spq = 0 and d = 0 (m = 0)
+  double d = sqq - spp;
+  double rd = sqrt(d * d + 4.0 * spq * spq) + fabs(d);
+  double m = sqrt(2.0 * (rd - fabs(d)) * rd);
+  bool identity = (m == 0.0);
+  double invm = 1.0 / (identity ? 1.0 : m);
+  double signedspq = (d < 0.0) ? -2.0 * spq : 2.0 * spq;
+  double c = identity ? 1.0 : rd * invm;
+  double s = signedspq * invm;
+  double t = identity ? 0.0 : signedspq / rd;
+
+  // rotate the matrix
+  double tspq = t * spq;
+  spp -= tspq;
+  sqq += tspq;
+  spq = 0.0;
+  double rp = srp;
+  srp = c * rp - s * srq;
+  srq = s * rp + c * srq;
+
+  // accumulate the rotation, by the angle -theta around the axis r, into the quaternion;
+  // the rotation quaternion is (cos(theta/2), -sin(theta/2) e_r), which is used unnormalized, 
+  // as (1, -tan(theta/2) e_r) (the quaternion is normalized only once, when converted to a matrix)
+  double th = s / (1.0 + c);
+  double w = qw, vp = qp, vq = qq, vr = qr;
+  qw = w + th * vr;
+  qr = vr - th * w;
+  qp = vp - th * vq;
+  qq = vq + th * vp;
+}
+
+// converts the (not necessarily normalized) quaternion into a rotation matrix (row-major)
+static inline void SVD3x3_QuaternionToMatrix(double w, double x, double y, double z, double * V0, double * V1, double * V2, double * V3, double * V4, double * V5, double * V6, double * V7, double * V8)
+{
+  double scale = 2.0 / (w * w + x * x + y * y + z * z);
+  double xs = x * scale, ys = y * scale, zs = z * scale;
+  double wx = w * xs, wy = w * ys, wz = w * zs;
+  double xx = x * xs, xy = x * ys, xz = x * zs;
+  double yy = y * ys, yz = y * zs, zz = z * zs;
+  *V0 = 1.0 - (yy + zz); *V1 = xy - wz;         *V2 = xz + wy;
+  *V3 = xy + wz;         *V4 = 1.0 - (xx + zz); *V5 = yz - wx;
+  *V6 = xz - wy;         *V7 = yz + wx;         *V8 = 1.0 - (xx + yy);
+}
+
+// if ei < ej, swaps the eigenvalues i and j, and the columns i and j of V (negating one of them, so that V remains a rotation)
+static inline void SVD3x3_CompareSwap(double & ei, double & ej, double & V0i, double & V1i, double & V2i, double & V0j, double & V1j, double & V2j)
+{
+  bool swap = (ei < ej);
+  double eiNew = swap ? ej : ei;
+  double ejNew = swap ? ei : ej;
+  ei = eiNew;
+  ej = ejNew;
+
+  double a, b;
+  a = swap ? V0j : V0i; b = swap ? -V0i : V0j; V0i = a; V0j = b;
+  a = swap ? V1j : V1i; b = swap ? -V1i : V1j; V1i = a; V1j = b;
+  a = swap ? V2j : V2i; b = swap ? -V2i : V2j; V2i = a; V2j = b;
+}
+
+void SVD3x3::SymmetricEigenDecomposition(const Mat3d & A, Vec3d & eigenValues, Mat3d & V, int numSweeps)
+{
+  double d0 = A[0][0], d1 = A[1][1], d2 = A[2][2];
+  double o01 = A[0][1], o12 = A[1][2], o20 = A[2][0];
+  double qw = 1.0, qx = 0.0, qy = 0.0, qz = 0.0;
+
+  for(int sweep=0; sweep<numSweeps; sweep++)
+  {
+    SVD3x3_JacobiRotation(d0, d1, o01, o20, o12, qw, qx, qy, qz);
+    SVD3x3_JacobiRotation(d1, d2, o12, o01, o20, qw, qy, qz, qx);
+    SVD3x3_JacobiRotation(d2, d0, o20, o12, o01, qw, qz, qx, qy);
+  }
+
+  double v[9];
+  SVD3x3_QuaternionToMatrix(qw, qx, qy, qz, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]);
+
+  // sort in descending order
+  SVD3x3_CompareSwap(d0, d1, v[0], v[3], v[6], v[1], v[4], v[7]);
+  SVD3x3_CompareSwap(d1, d2, v[1], v[4], v[7], v[2], v[5], v[8]);
+  SVD3x3_CompareSwap(d0, d1, v[0], v[3], v[6], v[1], v[4], v[7]);
+
+  eigenValues = Vec3d(d0, d1, d2);
+  V.set(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+}
+
+void SVD3x3::SymmetricEigenDecomposition(int numMatrices, double * const A[6], double * const eigenValues[3], double * const V[9], int numSweeps)
+{
+  // the matrices are processed in chunks; within a chunk, the same operation is applied to all the matrices, 
+  // in a loop without branches, which the compiler can vectorize
+  #define SVD3X3_CHUNK 32
+  double d0[SVD3X3_CHUNK], d1[SVD3X3_CHUNK], d2[SVD3X3_CHUNK];
+  double o01[SVD3X3_CHUNK], o12[SVD3X3_CHUNK], o20[SVD3X3_CHUNK];
+  double qw[SVD3X3_CHUNK], qx[SVD3X3_CHUNK], qy[SVD3X3_CHUNK], qz[SVD3X3_CHUNK];
+  double v[9][SVD3X3_CHUNK];
+
+  for(int start=0; start<numMatrices; start+=SVD3X3_CHUNK)
+  {
+    int size = numMatrices - start;
+    if (size > SVD3X3_CHUNK)
+      size = SVD3X3_CHUNK;
+
+    for(int i=0; i<size; i++)
+    {
+      d0[i] = A[0][start+i];
+      o01[i] = A[1][start+i];
+      o20[i] = A[2][start+i];
+      d1[i] = A[3][start+i];
+      o12[i] = A[4][start+i];
+      d2[i] = A[5][start+i];
+      qw[i] = 1.0;
+      qx[i] = qy[i] = qz[i] = 0.0;
+    }
+
+    for(int sweep=0; sweep<numSweeps; sweep++)
+    {
+      for(int i=0; i<size; i++)
+        SVD3x3_JacobiRotation(d0[i], d1[i], o01[i], o20[i], o12[i], qw[i], qx[i], qy[i], qz[i]);
+      for(int i=0; i<size; i++)
+        SVD3x3_JacobiRotation(d1[i], d2[i], o12[i], o01[i], o20[i], qw[i], qy[i], qz[i], qx[i]);
+      for(int i=0; i<size; i++)
+        SVD3x3_JacobiRotation(d2[i], d0[i], o20[i], o12[i], o01[i], qw[i], qz[i], qx[i], qy[i]);
+    }
+
+    for(int i=0; i<size; i++)
+    {
+      SVD3x3_QuaternionToMatrix(qw[i], qx[i], qy[i], qz[i], &v[0][i], &v[1][i], &v[2][i], &v[3][i], &v[4][i], &v[5][i], &v[6][i], &v[7][i], &v[8][i]);
+      SVD3x3_CompareSwap(d0[i], d1[i], v[0][i], v[3][i], v[6][i], v[1][i], v[4][i], v[7][i]);
+      SVD3x3_CompareSwap(d1[i], d2[i], v[1][i], v[4][i], v[7][i], v[2][i], v[5][i], v[8][i]);
+      SVD3x3_CompareSwap(d0[i], d1[i], v[0][i], v[3][i], v[6][i], v[1][i], v[4][i], v[7][i]);
+    }
+
+    for(int i=0; i<size; i++)
+    {
+      eigenValues[0][start+i] = d0[i];
+      eigenValues[1][start+i] = d1[i];
+      eigenValues[2][start+i] = d2[i];
+      for(int j=0; j<9; j++)
+        V[j][start+i] = v[j][i];
+    }
+  }
+  #undef SVD3X3_CHUNK
+}
+
@@ -0,0 +1,71 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "isotropic hyperelastic FEM" library , Copyright (C) 2012 USC         *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code authors: Jernej Barbic, Fun Shing Sin                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _SVD3X3_H_
+#define _SVD3X3_H_
+
+/*
+  Fast eigendecomposition of symmetric 3x3 matrices, used to compute the SVD of the 
+  deformation gradients in IsotropicHyperelasticFEM (via the eigendecomposition of F^T F, see ModifiedSVD).
+
+  The routine performs a fixed number of cyclic Jacobi sweeps (each sweep rotates the (0,1), (1,2) and (2,0) planes),
+  with the rotations accumulated as a quaternion, as in:
+
+  A. McAdams, A. Selle, R. Tamstorf, J. Teran, E. Sifakis: 
+  Computing the Singular Value Decomposition of 3x3 matrices with minimal branching and elementary floating point operations,
+  Technical Report, University of Wisconsin - Madison, 2011
+
+  Unlike in the report, the Jacobi rotations are exact (not approximate), so that the result 
+  is accurate to double precision after a few sweeps. There are no data-dependent branches. 
+  The eigenvector matrix V is always a rotation (det(V) = 1), and the eigenvalues are sorted in descending order 
+  (the same convention as eigen_sym in minivector/mat3d.h).
+
+  The batched version processes many matrices at once, stored in a structure-of-arrays layout. 
+  Its inner loops run over the matrices, and can be vectorized by the compiler (SSE/AVX); with gcc, this requires 
+  -fno-math-errno (or -ffast-math), otherwise the sqrt calls prevent vectorization.
+*/
+
+#include "minivector/mat3d.h"
+
+class SVD3x3
+{
+public:
+  // A = V * diag(eigenValues) * V^T
+  static void SymmetricEigenDecomposition(const Mat3d & A, Vec3d & eigenValues, Mat3d & V, int numSweeps=defaultNumSweeps);
+
+  // batched version, for numMatrices matrices:
+  // A[0], ..., A[5] are arrays (of length numMatrices) of the entries a00, a01, a02, a11, a12, a22 of the matrices
+  // the output eigenValues[0..2] and V[0..8] (row-major) are arrays of length numMatrices
+  static void SymmetricEigenDecomposition(int numMatrices, double * const A[6], double * const eigenValues[3], double * const V[9], int numSweeps=defaultNumSweeps);
+
+  // with 4 sweeps, the result is accurate to double precision 
+  static const int defaultNumSweeps = 4;
+};
+
+#endif
+
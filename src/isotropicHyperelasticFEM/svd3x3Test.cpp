@@ -0,0 +1,425 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "isotropic hyperelastic FEM" library , Copyright (C) 2012 USC         *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code authors: Jernej Barbic, Fun Shing Sin                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+  Accuracy and throughput test of the SVD3x3 routine, against eigen_sym (the SVD_EIGEN_SYM method of IsotropicHyperelasticFEM).
+
+  Random deformation gradients F are generated in several classes: near the identity, general (about half of them inverted),
+  with repeated singular values, degenerate (rank 2, rank 1, zero), and tiny. For each F, the test checks:
+    1. the eigendecomposition F^T F = V diag(lambda) V^T: the residual, orthogonality of V, det(V) = 1, descending order, 
+       and the eigenvalues against eigen_sym;
+    2. the modified SVD F = U diag(Fhat) V^T of IsotropicHyperelasticFEM, with the SVD_JACOBI method against the SVD_EIGEN_SYM method: 
+       the residual, det(U) = det(V) = 1, and Fhat;
+    3. that the batched routine gives the same result as the scalar routine.
+  It also checks that the default SVD method is SVD_JACOBI_BATCHED, except in a derived class that overloads ModifiedSVD.
+  Afterwards, it prints the time per matrix of eigen_sym, SVD3x3 (scalar and batched), and of the modified SVD with both methods.
+
+  Usage: svd3x3Test [numMatrices]
+  Returns 0 on success, and 1 on failure.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "minivector/mat3d.h"
+#include "performanceCounter/performanceCounter.h"
+#include "volumetricMesh/tetMesh.h"
+#include "isotropicHyperelasticFEM/svd3x3.h"
+#include "isotropicHyperelasticFEM/neoHookeanIsotropicMaterial.h"
+#include "isotropicHyperelasticFEM/isotropicHyperelasticFEM.h"
+
+// gives access to the (protected) modified SVD of IsotropicHyperelasticFEM
+class SVDTestFEM : public IsotropicHyperelasticFEM
+{
+public:
+  SVDTestFEM(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial) : IsotropicHyperelasticFEM(tetMesh, isotropicMaterial) {}
+  int ComputeModifiedSVD(Mat3d & F, Mat3d & U, Vec3d & Fhat, Mat3d & V) { return ModifiedSVD(F, U, Fhat, V); }
+};
+
+// overloads the modified SVD (only counts the calls); the default SVD method must not bypass it
+class CountingSVDFEM : public IsotropicHyperelasticFEM
+{
+public:
+  CountingSVDFEM(TetMesh * tetMesh, IsotropicMaterial * isotropicMaterial) : IsotropicHyperelasticFEM(tetMesh, isotropicMaterial), numCalls(0) {}
+  int numCalls;
+protected:
+  virtual int ModifiedSVD(Mat3d & F, Mat3d & U, Vec3d & Fhat, Mat3d & V) { numCalls++; return IsotropicHyperelasticFEM::ModifiedSVD(F, U, Fhat, V); }
+};
+
+#define NUM_CLASSES 7
+static const char * className[NUM_CLASSES] = { "near identity", "general", "repeated", "rank 2", "rank 1", "zero", "tiny" };
+
+static double Random()
+{
+  return 2.0 * rand() / RAND_MAX - 1.0;
+}
+
+static Mat3d RandomRotation()
+{
+  // normalized random quaternion
+  double q[4], norm2 = 0.0;
+  do
+  {
+    norm2 = 0.0;
+    for(int i=0; i<4; i++)
+    {
+      q[i] = Random();
+      norm2 += q[i] * q[i];
+    }
+  }
+  while ((norm2 > 1.0) || (norm2 < 1E-6));
+  double norm = sqrt(norm2);
+  double w = q[0] / norm, x = q[1] / norm, y = q[2] / norm, z = q[3] / norm;
+  return Mat3d(1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y),
+               2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x),
+               2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y));
+}
+
+static Mat3d RandomF(int classIndex)
+{
+  Mat3d R = RandomRotation();
+  Mat3d S = RandomRotation();
+  switch (classIndex)
+  {
+    case 0: // near identity
+      return Mat3d(1.0 + 0.3 * Random(), 0.3 * Random(), 0.3 * Random(), 0.3 * Random(), 1.0 + 0.3 * Random(), 0.3 * Random(), 0.3 * Random(), 0.3 * Random(), 1.0 + 0.3 * Random());
+    case 1: // general, inverted if det(F) < 0
+      return Mat3d(Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random());
+    case 2: // two (or three) equal singular values, possibly inverted
+    {
+      double s0 = 0.5 + fabs(Random());
+      double s1 = (rand() % 2 == 0) ? s0 : 0.5 + fabs(Random());
+      double sign = (rand() % 2 == 0) ? 1.0 : -1.0;
+      return R * Mat3d(s0, 0, 0, 0, s1, 0, 0, 0, sign * s1) * trans(S);
+    }
+    case 3: // rank 2 (a flattened element)
+      return R * Mat3d(0.5 + fabs(Random()), 0, 0, 0, 0.5 + fabs(Random()), 0, 0, 0, 0) * trans(S);
+    case 4: // rank 1 (an element collapsed onto a line)
+      return R * Mat3d(0.5 + fabs(Random()), 0, 0, 0, 0, 0, 0, 0, 0) * trans(S);
+    case 5: // zero (an element collapsed to a point)
+      return Mat3d(0, 0, 0, 0, 0, 0, 0, 0, 0);
+    default: // tiny
+      return 1E-6 * Mat3d(Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random());
+  }
+}
+
+static double MaxAbs(const Mat3d & A)
+{
+  double result = 0.0;
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      result = fmax(result, fabs(A[i][j]));
+  return result;
+}
+
+static double MaxAbsDiff(const Mat3d & A, const Mat3d & B)
+{
+  double result = 0.0;
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      result = fmax(result, fabs(A[i][j] - B[i][j]));
+  return result;
+}
+
+static Mat3d Diag(const Vec3d & d)
+{
+  return Mat3d(d[0], 0, 0, 0, d[1], 0, 0, 0, d[2]);
+}
+
+static void SortDescending(Vec3d & v)
+{
+  for(int i=0; i<2; i++)
+    for(int j=0; j<2-i; j++)
+      if (v[j] < v[j+1])
+      {
+        double tmp = v[j];
+        v[j] = v[j+1];
+        v[j+1] = tmp;
+      }
+}
+
+static Mat3d Identity()
+{
+  return Mat3d(1, 0, 0, 0, 1, 0, 0, 0, 1);
+}
+
+// errors are relative to the largest entry of F^T F (for eigenvalues), or of F (for singular values)
+struct SVDTestErrors
+{
+  double eigenResidual, eigenOrthogonality, eigenDeterminant, eigenValueDiff;
+  double svdResidual[2], svdDeterminant[2], FhatDiff;
+  int numUnsorted, numFailedSVD, numInverted;
+};
+
+int main(int argc, char ** argv)
+{
+  int numMatrices = 700000;
+  if (argc > 1)
+    numMatrices = atoi(argv[1]);
+  if (numMatrices < NUM_CLASSES)
+    numMatrices = NUM_CLASSES;
+
+  // a single tet, only used to access the modified SVD
+  double vertices[12] = { 0, 0, 0,  1, 0, 0,  0, 1, 0,  0, 0, 1 };
+  int elements[4] = { 0, 1, 2, 3 };
+  TetMesh * tetMesh = new TetMesh(4, vertices, 1, elements, 1E6, 0.45, 1000);
+  NeoHookeanIsotropicMaterial * material = new NeoHookeanIsotropicMaterial(tetMesh);
+  SVDTestFEM * fem = new SVDTestFEM(tetMesh, material);
+
+  srand(1);
+  Mat3d * F = (Mat3d*) malloc (sizeof(Mat3d) * numMatrices);
+  Mat3d * FTF = (Mat3d*) malloc (sizeof(Mat3d) * numMatrices);
+  for(int i=0; i<numMatrices; i++)
+  {
+    F[i] = RandomF(i % NUM_CLASSES);
+    FTF[i] = trans(F[i]) * F[i];
+  }
+
+  // === accuracy ===
+
+  SVDTestErrors errors[NUM_CLASSES];
+  for(int c=0; c<NUM_CLASSES; c++)
+  {
+    SVDTestErrors & e = errors[c];
+    e.eigenResidual = e.eigenOrthogonality = e.eigenDeterminant = e.eigenValueDiff = 0.0;
+    e.svdResidual[0] = e.svdResidual[1] = e.svdDeterminant[0] = e.svdDeterminant[1] = e.FhatDiff = 0.0;
+    e.numUnsorted = e.numFailedSVD = e.numInverted = 0;
+  }
+
+  for(int i=0; i<numMatrices; i++)
+  {
+    SVDTestErrors & e = errors[i % NUM_CLASSES];
+    double scaleFTF = MaxAbs(FTF[i]);
+    double scaleF = MaxAbs(F[i]);
+    if (scaleFTF == 0.0)
+      scaleFTF = scaleF = 1.0;
+    if (det(F[i]) < 0.0)
+      e.numInverted++;
+
+    // eigendecomposition
+    Vec3d lambda;
+    Mat3d V;
+    SVD3x3::SymmetricEigenDecomposition(FTF[i], lambda, V);
+    e.eigenResidual = fmax(e.eigenResidual, MaxAbsDiff(V * Diag(lambda) * trans(V), FTF[i]) / scaleFTF);
+    e.eigenOrthogonality = fmax(e.eigenOrthogonality, MaxAbsDiff(trans(V) * V, Identity()));
+    e.eigenDeterminant = fmax(e.eigenDeterminant, fabs(det(V) - 1.0));
+    if ((lambda[0] < lambda[1]) || (lambda[1] < lambda[2]))
+      e.numUnsorted++;
+
+    Mat3d A = FTF[i]; // eigen_sym modifies its input
+    Vec3d lambdaRef;
+    Vec3d eigenVectorsRef[3];
+    eigen_sym(A, lambdaRef, eigenVectorsRef);
+    for(int j=0; j<3; j++)
+      e.eigenValueDiff = fmax(e.eigenValueDiff, fabs(lambda[j] - lambdaRef[j]) / scaleFTF);
+
+    // modified SVD, with both methods
+    Vec3d Fhat[2];
+    const IsotropicHyperelasticFEM::SVDMethodType methods[2] = { IsotropicHyperelasticFEM::SVD_JACOBI, IsotropicHyperelasticFEM::SVD_EIGEN_SYM };
+    for(int method=0; method<2; method++)
+    {
+      fem->SetSVDMethod(methods[method]);
+      Mat3d U, VSVD;
+      if (fem->ComputeModifiedSVD(F[i], U, Fhat[method], VSVD) != 0)
+        e.numFailedSVD++;
+      e.svdResidual[method] = fmax(e.svdResidual[method], MaxAbsDiff(U * Diag(Fhat[method]) * trans(VSVD), F[i]) / scaleF);
+      e.svdDeterminant[method] = fmax(e.svdDeterminant[method], fmax(fabs(det(U) - 1.0), fabs(det(VSVD) - 1.0)));
+    }
+    // with repeated singular values, the two methods may negate a different (but equal) entry of Fhat for inverted elements
+    for(int method=0; method<2; method++)
+      SortDescending(Fhat[method]);
+    for(int j=0; j<3; j++)
+      e.FhatDiff = fmax(e.FhatDiff, fabs(Fhat[0][j] - Fhat[1][j]) / scaleF);
+  }
+
+  /*
+    Tolerances: the eigendecomposition of F^T F is accurate to a few ulps of its largest eigenvalue (with both routines).
+    Singular values are square roots of the eigenvalues, so that a small singular value s has an error of about eps / s
+    (relative to the largest one); for the degenerate classes (s = 0), this is about sqrt(eps) ~ 1E-8, which is close
+    to the threshold below which ModifiedSVD treats a singular value as zero. Therefore, U is not always a rotation for 
+    degenerate (and some tiny) F, with either method. The modified SVD is required to be as accurate as with SVD_EIGEN_SYM.
+  */
+  const double eigenTolerance = 1E-13;
+  const double svdTolerance = 1E-6;
+
+  int exitCode = 0;
+  printf("Accuracy (%d matrices; errors relative to the largest entry of F^T F, or of F):\n", numMatrices);
+  printf("%-14s %9s | %9s %9s %9s %9s %9s | %9s %9s %9s %9s %9s\n", "class", "inverted", "residual", "orthog.", "det(V)", "vs eig.", "unsorted",
+    "SVD res.", "ref. res.", "det(U,V)", "ref. det", "Fhat diff");
+  for(int c=0; c<NUM_CLASSES; c++)
+  {
+    SVDTestErrors & e = errors[c];
+    printf("%-14s %9d | %9.2E %9.2E %9.2E %9.2E %9d | %9.2E %9.2E %9.2E %9.2E %9.2E\n", className[c], e.numInverted,
+      e.eigenResidual, e.eigenOrthogonality, e.eigenDeterminant, e.eigenValueDiff, e.numUnsorted,
+      e.svdResidual[0], e.svdResidual[1], e.svdDeterminant[0], e.svdDeterminant[1], e.FhatDiff);
+
+    if ((e.eigenResidual > eigenTolerance) || (e.eigenOrthogonality > eigenTolerance) || (e.eigenDeterminant > eigenTolerance) || 
+        (e.eigenValueDiff > eigenTolerance) || (e.numUnsorted > 0))
+    {
+      printf("Error: inaccurate eigendecomposition (class: %s).\n", className[c]);
+      exitCode = 1;
+    }
+    if ((e.svdResidual[0] > fmax(svdTolerance, 10.0 * e.svdResidual[1])) || (e.svdDeterminant[0] > fmax(eigenTolerance, 10.0 * e.svdDeterminant[1])) || 
+        (e.FhatDiff > svdTolerance) || (e.numFailedSVD > 0))
+    {
+      printf("Error: inaccurate modified SVD (class: %s).\n", className[c]);
+      exitCode = 1;
+    }
+  }
+
+  // default SVD method: batched, unless ModifiedSVD may be overloaded
+  IsotropicHyperelasticFEM * defaultFEM = new IsotropicHyperelasticFEM(tetMesh, material);
+  CountingSVDFEM * countingFEM = new CountingSVDFEM(tetMesh, material);
+  double u[12] = { 0.1, 0, 0,  0, 0, 0,  0, 0, 0,  0, 0, -0.2 };
+  double internalForces[12];
+  countingFEM->ComputeForces(u, internalForces);
+  printf("Default SVD method: %d (derived class: %d, ModifiedSVD calls: %d)\n", (int) defaultFEM->GetSVDMethod(), (int) countingFEM->GetSVDMethod(), countingFEM->numCalls);
+  if ((defaultFEM->GetSVDMethod() != IsotropicHyperelasticFEM::SVD_JACOBI_BATCHED) || 
+      (countingFEM->GetSVDMethod() != IsotropicHyperelasticFEM::SVD_JACOBI) || (countingFEM->numCalls != 1))
+  {
+    printf("Error: the default SVD method bypasses an overloaded ModifiedSVD, or is not batched.\n");
+    exitCode = 1;
+  }
+  delete(countingFEM);
+  delete(defaultFEM);
+
+  // batched versus scalar routine
+  double * A[6], * lambdaBatch[3], * VBatch[9];
+  for(int j=0; j<6; j++)
+    A[j] = (double*) malloc (sizeof(double) * numMatrices);
+  for(int j=0; j<3; j++)
+    lambdaBatch[j] = (double*) malloc (sizeof(double) * numMatrices);
+  for(int j=0; j<9; j++)
+    VBatch[j] = (double*) malloc (sizeof(double) * numMatrices);
+  for(int i=0; i<numMatrices; i++)
+  {
+    A[0][i] = FTF[i][0][0];
+    A[1][i] = FTF[i][0][1];
+    A[2][i] = FTF[i][0][2];
+    A[3][i] = FTF[i][1][1];
+    A[4][i] = FTF[i][1][2];
+    A[5][i] = FTF[i][2][2];
+  }
+  SVD3x3::SymmetricEigenDecomposition(numMatrices, A, lambdaBatch, VBatch);
+
+  double batchDiff = 0.0;
+  for(int i=0; i<numMatrices; i++)
+  {
+    Vec3d lambda;
+    Mat3d V;
+    SVD3x3::SymmetricEigenDecomposition(FTF[i], lambda, V);
+    for(int j=0; j<3; j++)
+      batchDiff = fmax(batchDiff, fabs(lambda[j] - lambdaBatch[j][i]));
+    for(int j=0; j<9; j++)
+      batchDiff = fmax(batchDiff, fabs(V[j / 3][j % 3] - VBatch[j][i]));
+  }
+  printf("Batched versus scalar routine: max difference %G\n", batchDiff);
+  if (batchDiff > eigenTolerance)
+  {
+    printf("Error: the batched routine differs from the scalar routine.\n");
+    exitCode = 1;
+  }
+
+  // === throughput ===
+
+  // the sum prevents the compiler from optimizing the loops away
+  double sum = 0.0;
+  PerformanceCounter counter;
+
+  counter.StartCounter();
+  for(int i=0; i<numMatrices; i++)
+  {
+    Mat3d A = FTF[i];
+    Vec3d lambda;
+    Vec3d eigenVectors[3];
+    eigen_sym(A, lambda, eigenVectors);
+    sum += lambda[0] + eigenVectors[0][1];
+  }
+  counter.StopCounter();
+  double timeEigenSym = counter.GetElapsedTime();
+
+  counter.StartCounter();
+  for(int i=0; i<numMatrices; i++)
+  {
+    Vec3d lambda;
+    Mat3d V;
+    SVD3x3::SymmetricEigenDecomposition(FTF[i], lambda, V);
+    sum += lambda[0] + V[1][0];
+  }
+  counter.StopCounter();
+  double timeSVD3x3 = counter.GetElapsedTime();
+
+  counter.StartCounter();
+  SVD3x3::SymmetricEigenDecomposition(numMatrices, A, lambdaBatch, VBatch);
+  counter.StopCounter();
+  double timeSVD3x3Batched = counter.GetElapsedTime();
+  sum += lambdaBatch[0][numMatrices - 1];
+
+  double timeModifiedSVD[2];
+  const IsotropicHyperelasticFEM::SVDMethodType methods[2] = { IsotropicHyperelasticFEM::SVD_JACOBI, IsotropicHyperelasticFEM::SVD_EIGEN_SYM };
+  for(int method=0; method<2; method++)
+  {
+    fem->SetSVDMethod(methods[method]);
+    counter.StartCounter();
+    for(int i=0; i<numMatrices; i++)
+    {
+      Mat3d U, V;
+      Vec3d Fhat;
+      fem->ComputeModifiedSVD(F[i], U, Fhat, V);
+      sum += Fhat[0] + U[0][1];
+    }
+    counter.StopCounter();
+    timeModifiedSVD[method] = counter.GetElapsedTime();
+  }
+
+  double toNs = 1E9 / numMatrices;
+  printf("Throughput (time per matrix):\n");
+  printf("  eigen_sym:                     %.1f ns\n", toNs * timeEigenSym);
+  printf("  SVD3x3:                        %.1f ns\n", toNs * timeSVD3x3);
+  printf("  SVD3x3 (batched):              %.1f ns\n", toNs * timeSVD3x3Batched);
+  printf("  modified SVD (SVD_EIGEN_SYM):  %.1f ns\n", toNs * timeModifiedSVD[1]);
+  printf("  modified SVD (SVD_JACOBI):     %.1f ns\n", toNs * timeModifiedSVD[0]);
+  printf("(checksum: %G)\n", sum);
+
+  if (exitCode == 0)
+    printf("Test passed.\n");
+
+  for(int j=0; j<9; j++)
+    free(VBatch[j]);
+  for(int j=0; j<3; j++)
+    free(lambdaBatch[j]);
+  for(int j=0; j<6; j++)
+    free(A[j]);
+  free(FTF);
+  free(F);
+  delete(fem);
+  delete(material);
+  delete(tetMesh);
+
+  return exitCode;
+}
@@ -107,3 +107,179 @@ double PolarDecomposition::Compute(const double * M, double * Q, double * S, dou
   return (det);
 }
 
+
+/*
+  One Newton iteration of the warm-started polar decomposition.
+  The entries of R and M are R[stride * k], M[stride * k], k=0..8 (row-major), 
+  so that the same code serves a single matrix (stride=1) and a chunk of matrices stored as a structure of arrays.
+  Let A = R^T M, and S = sym(A). The rotation R * exp(omega) makes R^T M symmetric to first order if
+  (tr(S) I - S) omega = k, where k = (A21 - A12, A02 - A20, A10 - A01).
+  The update exp(omega) is replaced by the rotation of the quaternion (1, omega / 2), which has the same fixed point.
+  Returns |omega|^2, or -1 if tr(S) I - S is not positive-definite (in which case R is not modified).
+*/
+static inline double PolarDecomposition_WarmStartedIteration(double * R, const double * M, int stride)
+{
+  double A[9];
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      A[3 * i + j] = R[stride * i] * M[stride * j] + R[stride * (3 + i)] * M[stride * (3 + j)] + R[stride * (6 + i)] * M[stride * (6 + j)];
+
+  // G = tr(S) I - S
+  double tr = A[0] + A[4] + A[8];
+  double g00 = tr - A[0];
+  double g11 = tr - A[4];
+  double g22 = tr - A[8];
+  double g01 = -0.5 * (A[1] + A[3]);
+  double g02 = -0.5 * (A[2] + A[6]);
+  double g12 = -0.5 * (A[5] + A[7]);
+
+  double k0 = A[7] - A[5];
+  double k1 = A[2] - A[6];
+  double k2 = A[3] - A[1];
+
+  // omega = G^{-1} k, using the adjugate of G
+  double c00 = g11 * g22 - g12 * g12;
+  double c01 = g02 * g12 - g01 * g22;
+  double c02 = g01 * g12 - g02 * g11;
+  double c11 = g00 * g22 - g02 * g02;
+  double c12 = g01 * g02 - g00 * g12;
+  double c22 = g00 * g11 - g01 * g01;
+  double det = g00 * c00 + g01 * c01 + g02 * c02;
+
+  // Sylvester's criterion (no short-circuit evaluation and no conditional division, to keep the code branch-free)
+  bool positiveDefinite = (g00 > 0.0) & (c22 > 0.0) & (det > 0.0);
+  double invDet = (positiveDefinite ? 1.0 : 0.0) / (positiveDefinite ? det : 1.0);
+
+  // half of omega, i.e., the vector part of the quaternion (1, omega / 2)
+  double x = 0.5 * invDet * (c00 * k0 + c01 * k1 + c02 * k2);
+  double y = 0.5 * invDet * (c01 * k0 + c11 * k1 + c12 * k2);
+  double z = 0.5 * invDet * (c02 * k0 + c12 * k1 + c22 * k2);
+
+  double scale = 2.0 / (1.0 + x * x + y * y + z * z);
+  double xs = x * scale, ys = y * scale, zs = z * scale;
+  double xx = x * xs, xy = x * ys, xz = x * zs;
+  double yy = y * ys, yz = y * zs, zz = z * zs;
+  double Q[9] = { 1.0 - (yy + zz), xy - zs,         xz + ys,
+                  xy + zs,         1.0 - (xx + zz), yz - xs,
+                  xz - ys,         yz + xs,         1.0 - (xx + yy) };
+
+  // R = R * Q
+  for(int i=0; i<3; i++)
+  {
+    double r0 = R[stride * (3 * i + 0)];
+    double r1 = R[stride * (3 * i + 1)];
+    double r2 = R[stride * (3 * i + 2)];
+    R[stride * (3 * i + 0)] = r0 * Q[0] + r1 * Q[3] + r2 * Q[6];
+    R[stride * (3 * i + 1)] = r0 * Q[1] + r1 * Q[4] + r2 * Q[7];
+    R[stride * (3 * i + 2)] = r0 * Q[2] + r1 * Q[5] + r2 * Q[8];
+  }
+
+  return positiveDefinite ? 4.0 * (x * x + y * y + z * z) : -1.0;
+}
+
+// determinant of M, with the same storage convention as above
+static inline double PolarDecomposition_Determinant(const double * M, int stride)
+{
+  return M[0] * (M[stride * 4] * M[stride * 8] - M[stride * 5] * M[stride * 7]) 
+       + M[stride * 1] * (M[stride * 5] * M[stride * 6] - M[stride * 3] * M[stride * 8]) 
+       + M[stride * 2] * (M[stride * 3] * M[stride * 7] - M[stride * 4] * M[stride * 6]);
+}
+
+// S = sym(R^T M), with the same storage convention as above
+static inline void PolarDecomposition_SymmetricFactor(const double * R, const double * M, double * S, int stride)
+{
+  double A[9];
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      A[3 * i + j] = R[stride * i] * M[stride * j] + R[stride * (3 + i)] * M[stride * (3 + j)] + R[stride * (6 + i)] * M[stride * (6 + j)];
+
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      S[stride * (3 * i + j)] = 0.5 * (A[3 * i + j] + A[3 * j + i]);
+}
+
+int PolarDecomposition::ComputeWarmStarted(const double * M, double * R, double * S, double tolerance, int maxIterations)
+{
+  // for det(M) < 0, the Newton iteration would converge to the rotation closest to M (with S indefinite), not to -Q of Compute
+  if (PolarDecomposition_Determinant(M, 1) <= 0.0)
+    return 1;
+
+  double tolerance2 = tolerance * tolerance;
+  for(int iter=0; iter<maxIterations; iter++)
+  {
+    double omega2 = PolarDecomposition_WarmStartedIteration(R, M, 1);
+    if (omega2 < 0.0)
+      return 1;
+
+    if (omega2 < tolerance2)
+    {
+      PolarDecomposition_SymmetricFactor(R, M, S, 1);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+void PolarDecomposition::ComputeWarmStarted(int numMatrices, const double * M, double * R, double * S, int * failed, double tolerance, int maxIterations)
+{
+  // the matrices are processed in chunks, stored as a structure of arrays; 
+  // all the matrices in a chunk are iterated together, until they have all converged
+  #define POLARDECOMPOSITION_CHUNK 32
+  double Mc[9 * POLARDECOMPOSITION_CHUNK];
+  double Rc[9 * POLARDECOMPOSITION_CHUNK];
+  double Sc[9 * POLARDECOMPOSITION_CHUNK];
+  double omega2[POLARDECOMPOSITION_CHUNK];
+  int failedc[POLARDECOMPOSITION_CHUNK];
+
+  double tolerance2 = tolerance * tolerance;
+  for(int start=0; start<numMatrices; start+=POLARDECOMPOSITION_CHUNK)
+  {
+    int size = numMatrices - start;
+    if (size > POLARDECOMPOSITION_CHUNK)
+      size = POLARDECOMPOSITION_CHUNK;
+
+    for(int i=0; i<size; i++)
+    {
+      for(int k=0; k<9; k++)
+      {
+        Mc[POLARDECOMPOSITION_CHUNK * k + i] = M[9 * (start + i) + k];
+        Rc[POLARDECOMPOSITION_CHUNK * k + i] = R[9 * (start + i) + k];
+      }
+      omega2[i] = tolerance2;
+    }
+
+    for(int i=0; i<size; i++)
+      failedc[i] = (PolarDecomposition_Determinant(&Mc[i], POLARDECOMPOSITION_CHUNK) <= 0.0);
+
+    for(int iter=0; iter<maxIterations; iter++)
+    {
+      for(int i=0; i<size; i++)
+        omega2[i] = PolarDecomposition_WarmStartedIteration(&Rc[i], &Mc[i], POLARDECOMPOSITION_CHUNK);
+
+      int converged = 1;
+      for(int i=0; i<size; i++)
+      {
+        failedc[i] |= (omega2[i] < 0.0);
+        converged &= (failedc[i] | (omega2[i] < tolerance2));
+      }
+
+      if (converged)
+        break;
+    }
+
+    for(int i=0; i<size; i++)
+      PolarDecomposition_SymmetricFactor(&Rc[i], &Mc[i], &Sc[i], POLARDECOMPOSITION_CHUNK);
+
+    for(int i=0; i<size; i++)
+    {
+      for(int k=0; k<9; k++)
+      {
+        R[9 * (start + i) + k] = Rc[POLARDECOMPOSITION_CHUNK * k + i];
+        S[9 * (start + i) + k] = Sc[POLARDECOMPOSITION_CHUNK * k + i];
+      }
+      failed[start + i] = failedc[i] | !(omega2[i] < tolerance2);
+    }
+  }
+  #undef POLARDECOMPOSITION_CHUNK
+}
@@ -32,6 +32,22 @@ public:
   // All matrices are row-major
   static double Compute(const double * M, double * Q, double * S, double tolerance = 1E-6);
 
+  // Warm-started polar decomposition M = R * S, for a matrix M with det(M) > 0.
+  // On input, R is an initial guess for the rotation (e.g., the rotation computed at the previous timestep); on output, it is the rotation.
+  // The rotation is updated using Newton's method: R <- R * exp(omega), where (tr(S) I - S) omega = 2 * axial(skew(R^T M)), until |omega| < tolerance.
+  // If the initial guess is close, this converges in one or two iterations (regardless of how large the rotation is).
+  // Returns 0 on success, and 1 if the iteration did not converge in maxIterations (e.g., det(M) <= 0, or the initial guess was too far); 
+  // in that case, R and S are unspecified, and you should call Compute instead.
+  // All matrices are row-major.
+  static int ComputeWarmStarted(const double * M, double * R, double * S, double tolerance = 1E-6, int maxIterations = 8);
+
+  // Batched version of ComputeWarmStarted, for numMatrices matrices.
+  // M, R and S are arrays of numMatrices row-major 3x3 matrices (9 doubles each).
+  // R contains the initial guesses on input. On output, failed[i] is 0 on success, and 1 if ComputeWarmStarted would have failed on matrix i.
+  // The matrices are processed in chunks, using branch-free loops that the compiler can vectorize (SSE/AVX);
+  // with gcc, this requires -fno-trapping-math (or -ffast-math).
+  static void ComputeWarmStarted(int numMatrices, const double * M, double * R, double * S, int * failed, double tolerance = 1E-6, int maxIterations = 8);
+
 protected:
 
   // one-norm of a 3 x 3 matrix
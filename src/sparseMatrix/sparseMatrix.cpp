@@ -232,6 +232,21 @@ SparseMatrix::SparseMatrix(SparseMatrixOutline * sparseMatrixOutline)
   InitFromOutline(sparseMatrixOutline);
 }
 
+SparseMatrix::SparseMatrix(int numRows_, const int * rowLength_, const int * columnIndices_)
+{
+  numRows = numRows_;
+  Allocate();
+
+  for(int i=0; i<numRows; i++)
+  {
+    rowLength[i] = rowLength_[i];
+    columnIndices[i] = (int*) malloc (sizeof(int) * rowLength[i]);
+    columnEntries[i] = (double*) calloc (rowLength[i], sizeof(double));
+    memcpy(columnIndices[i], columnIndices_, sizeof(int) * rowLength[i]);
+    columnIndices_ += rowLength[i];
+  }
+}
+
 // construct matrix from the outline
 void SparseMatrix::InitFromOutline(SparseMatrixOutline * sparseMatrixOutline)
 {
@@ -651,6 +666,7 @@ void SparseMatrix::BuildDiagonalIndices()
 void SparseMatrix::FreeDiagonalIndices()
 {
   free(diagonalIndices);
+  diagonalIndices = NULL;
 }
 
 void SparseMatrix::GetDiagonal(double * diagonal)
@@ -737,6 +753,15 @@ void SparseMatrix::SumRowEntries(double * rowSums) const
   }
 }
 
+int SparseMatrix::IsDiagonal() const
+{
+  for(int i=0; i<numRows; i++)
+    for(int j=0; j<rowLength[i]; j++)
+      if ((columnIndices[i][j] != i) && (columnEntries[i][j] != 0.0))
+        return 0;
+  return 1;
+}
+
 void SparseMatrix::MakeLinearDataArray(double * data) const
 {
   int count=0;
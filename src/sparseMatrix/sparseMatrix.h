@@ -153,6 +153,8 @@ public:
 
   SparseMatrix(char * filename); // load from text file (same text file format as SparseMatrixOutline)
   SparseMatrix(SparseMatrixOutline * sparseMatrixOutline); // create it from the outline
+  // create a zero matrix with the given sparsity pattern; columnIndices lists the (sorted) column indices of row 0, followed by those of row 1, etc.
+  SparseMatrix(int numRows, const int * rowLength, const int * columnIndices);
   SparseMatrix(const SparseMatrix & source); // copy constructor
   ~SparseMatrix();
 
@@ -185,6 +187,7 @@ public:
   int GetNumEntries() const; // returns the total number of non-zero entries
   double SumEntries() const; // returns the sum of all matrix entries
   void SumRowEntries(double * rowSums) const; // returns the sum of all entries in each row
+  int IsDiagonal() const; // returns 1 if all off-diagonal entries are zero (e.g., a lumped mass matrix), and 0 otherwise
   double GetMaxAbsEntry() const; // max abs value of a matrix entry
   double GetInfinityNorm() const; // matrix infinity norm
   void Print(int sparsePrint=0) const; // prints the matrix out to standard output
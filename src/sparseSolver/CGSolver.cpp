@@ -38,11 +38,13 @@ CGSolver::CGSolver(SparseMatrix * A_): A(A_)
   multiplicator = CGSolver::DefaultMultiplicator;
   multiplicatorData = (void*)A;
   invDiagonal = NULL;
+  residualError = 0.0;
 }
 
 CGSolver::CGSolver(int numRows_, blackBoxProductType callBackFunction_, void * data_, double * diagonal): numRows(numRows_), multiplicator(callBackFunction_), multiplicatorData(data_), A(NULL)
 {
   InitBuffers();
+  residualError = 0.0;
   invDiagonal = (double*) malloc (sizeof(double) * numRows);
   if (diagonal == NULL)
   {
@@ -83,6 +85,15 @@ int CGSolver::SolveLinearSystem(double * x, const double * b)
   return SolveLinearSystemWithJacobiPreconditioner(x, b, 1E-6, 1000, 0);
 }
 
+void CGSolver::SetDiagonal(double * diagonal)
+{
+  if (invDiagonal == NULL)
+    invDiagonal = (double*) malloc (sizeof(double) * numRows);
+
+  for(int i=0; i<numRows; i++)
+    invDiagonal[i] = 1.0 / diagonal[i];
+}
+
 int CGSolver::SolveLinearSystemWithoutPreconditioner(double * x, const double * b, double eps, int maxIterations, int verbose)
 {
   int iteration=1;
@@ -132,6 +143,7 @@ int CGSolver::SolveLinearSystemWithoutPreconditioner(double * x, const double *
     iteration++;
   }
 
+  residualError = (initialResidualNorm2 > 0) ? sqrt(residualNorm2 / initialResidualNorm2) : 0.0;
   return (iteration-1) * ((residualNorm2 > eps * eps * initialResidualNorm2) ? -1 : 1);
 }
 
@@ -202,6 +214,7 @@ int CGSolver::SolveLinearSystemWithJacobiPreconditioner(double * x, const double
     printf("Warning: residualNorm2=%G is negative. Input matrix might not be SPD. Solution could be incorrect.\n", residualNorm2);
   }
 
+  residualError = (initialResidualNorm2 > 0) ? sqrt(residualNorm2 / initialResidualNorm2) : 0.0;
   return (iteration-1) * ((residualNorm2 > eps * eps * initialResidualNorm2) ? -1 : 1);
 }
 
@@ -84,6 +84,12 @@ public:
 
   virtual int SolveLinearSystem(double * x, const double * b); // implements the virtual method from LinearSolver by calling "SolveLinearSystemWithJacobiPreconditioner" with default parameters
 
+  // sets (or replaces) the matrix diagonal used by the Jacobi preconditioner; e.g., when the black-box matrix changes
+  void SetDiagonal(double * diagonal);
+
+  // relative residual error (as used in the convergence criterium) at the end of the last solve
+  inline double GetResidualError() { return residualError; }
+
   // computes the dot product of two vectors
   double ComputeDotProduct(double * v1, double * v2); // length of vectors v1, v2 equals numRows (dimension of A)
 
@@ -94,6 +100,7 @@ protected:
   SparseMatrix * A; 
   double * r, * d, * q; // terminology from Shewchuk's work
   double * invDiagonal;
+  double residualError;
 
   double ComputeTriDotProduct(double * x, double * y, double * z); // sum_i x[i] * y[i] * z[i]
   static void DefaultMultiplicator(const void * data, const double * x, double * Ax);
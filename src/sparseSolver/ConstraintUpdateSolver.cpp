@@ -0,0 +1,270 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ConstraintUpdateSolver.h"
+
+ConstraintUpdateSolver::ConstraintUpdateSolver(const SparseMatrix * A_, int numBaseConstrainedDOFs, const int * baseConstrainedDOFs, LinearSolver * baseSolver_, int numConstrainedDOFs, const int * constrainedDOFs, int verbose) : A(A_), baseSolver(baseSolver_)
+{
+  n = A->Getn();
+
+  // build the DOF maps
+  fullToBase = (int*) malloc (sizeof(int) * n);
+  isConstrained = (int*) calloc (n, sizeof(int));
+  for(int i=0; i<n; i++)
+    fullToBase[i] = 0;
+  for(int i=0; i<numBaseConstrainedDOFs; i++)
+    fullToBase[baseConstrainedDOFs[i]] = -1;
+  for(int i=0; i<numConstrainedDOFs; i++)
+    isConstrained[constrainedDOFs[i]] = 1;
+
+  nf = 0;
+  numReleasedDOFs = 0;
+  int numNewlyConstrainedDOFs = 0;
+  for(int i=0; i<n; i++)
+  {
+    if (fullToBase[i] == -1)
+    {
+      if (!isConstrained[i])
+        numReleasedDOFs++;
+    }
+    else
+    {
+      fullToBase[i] = nf;
+      nf++;
+      if (isConstrained[i])
+        numNewlyConstrainedDOFs++;
+    }
+  }
+
+  m = numReleasedDOFs + numNewlyConstrainedDOFs;
+  baseToFull = (int*) malloc (sizeof(int) * nf);
+  updatedDOFs = (int*) malloc (sizeof(int) * m);
+  int releasedIndex = 0;
+  int newlyConstrainedIndex = numReleasedDOFs;
+  for(int i=0; i<n; i++)
+  {
+    if (fullToBase[i] == -1)
+    {
+      if (!isConstrained[i])
+        updatedDOFs[releasedIndex++] = i;
+    }
+    else
+    {
+      baseToFull[fullToBase[i]] = i;
+      if (isConstrained[i])
+        updatedDOFs[newlyConstrainedIndex++] = i;
+    }
+  }
+
+  if (verbose >= 1)
+    printf("Constraint update: %d released DOFs, %d newly constrained DOFs.\n", numReleasedDOFs, numNewlyConstrainedDOFs);
+
+  baseRhs = (double*) malloc (sizeof(double) * nf);
+  baseX = (double*) malloc (sizeof(double) * nf);
+  z = (double*) malloc (sizeof(double) * m);
+
+  // W = A_FF^{-1} B (one solve per column of B)
+  W = (double*) calloc (nf * m, sizeof(double));
+  for(int j=0; j<m; j++)
+  {
+    memset(baseRhs, 0, sizeof(double) * nf);
+    int dof = updatedDOFs[j];
+    if (j < numReleasedDOFs)
+    {
+      // column of A_FR equals the row of A_RF (A is symmetric)
+      for(int k=0; k<A->GetRowLength(dof); k++)
+      {
+        int column = fullToBase[A->GetColumnIndex(dof, k)];
+        if (column >= 0)
+          baseRhs[column] = A->GetEntry(dof, k);
+      }
+    }
+    else
+      baseRhs[fullToBase[dof]] = 1.0;
+
+    baseSolver->SolveLinearSystem(&W[nf * j], baseRhs);
+  }
+
+  // S = D - B^T W, where D = [ A_RR 0 ; 0 0 ]
+  S = (double*) malloc (sizeof(double) * m * m);
+  pivots = (int*) malloc (sizeof(int) * m);
+  for(int j=0; j<m; j++)
+  {
+    MultiplyBTranspose(&W[nf * j], &S[m * j]);
+    for(int i=0; i<m; i++)
+      S[m * j + i] *= -1.0;
+
+    if (j < numReleasedDOFs)
+    {
+      int dof = updatedDOFs[j];
+      for(int i=0; i<numReleasedDOFs; i++)
+      {
+        int index = A->GetInverseIndex(updatedDOFs[i], dof);
+        if (index >= 0)
+          S[m * j + i] += A->GetEntry(updatedDOFs[i], index);
+      }
+    }
+  }
+
+  if (LUDecomposition(m, S, pivots) != 0)
+  {
+    printf("Error: constraint update Schur complement is singular.\n");
+    throw 1;
+  }
+}
+
+ConstraintUpdateSolver::~ConstraintUpdateSolver()
+{
+  free(updatedDOFs);
+  free(fullToBase);
+  free(baseToFull);
+  free(isConstrained);
+  free(W);
+  free(S);
+  free(pivots);
+  free(baseRhs);
+  free(baseX);
+  free(z);
+}
+
+void ConstraintUpdateSolver::MultiplyBTranspose(const double * xBase, double * result)
+{
+  for(int j=0; j<m; j++)
+  {
+    int dof = updatedDOFs[j];
+    if (j < numReleasedDOFs)
+    {
+      result[j] = 0.0;
+      for(int k=0; k<A->GetRowLength(dof); k++)
+      {
+        int column = fullToBase[A->GetColumnIndex(dof, k)];
+        if (column >= 0)
+          result[j] += A->GetEntry(dof, k) * xBase[column];
+      }
+    }
+    else
+      result[j] = xBase[fullToBase[dof]];
+  }
+}
+
+int ConstraintUpdateSolver::SolveLinearSystem(double * x, const double * rhs)
+{
+  // y = A_FF^{-1} rhs_F
+  for(int k=0; k<nf; k++)
+    baseRhs[k] = rhs[baseToFull[k]];
+  memset(baseX, 0, sizeof(double) * nf);
+  int info = baseSolver->SolveLinearSystem(baseX, baseRhs);
+
+  // S z = [ rhs_R ; 0 ] - B^T y
+  MultiplyBTranspose(baseX, z);
+  for(int j=0; j<m; j++)
+    z[j] = ((j < numReleasedDOFs) ? rhs[updatedDOFs[j]] : 0.0) - z[j];
+  LUSolve(m, S, pivots, z);
+
+  // x_F = y - W z
+  for(int j=0; j<m; j++)
+  {
+    double * column = &W[nf * j];
+    for(int k=0; k<nf; k++)
+      baseX[k] -= column[k] * z[j];
+  }
+
+  memset(x, 0, sizeof(double) * n);
+  for(int k=0; k<nf; k++)
+    x[baseToFull[k]] = baseX[k];
+  for(int j=0; j<numReleasedDOFs; j++)
+    x[updatedDOFs[j]] = z[j];
+  for(int j=numReleasedDOFs; j<m; j++)
+    x[updatedDOFs[j]] = 0.0;
+
+  return info;
+}
+
+int ConstraintUpdateSolver::LUDecomposition(int m, double * S, int * pivots)
+{
+  #define ELT(i,j) S[m * (j) + (i)]
+  for(int k=0; k<m; k++)
+  {
+    // find the pivot
+    int pivot = k;
+    for(int i=k+1; i<m; i++)
+      if (fabs(ELT(i,k)) > fabs(ELT(pivot,k)))
+        pivot = i;
+    pivots[k] = pivot;
+
+    if (ELT(pivot,k) == 0.0)
+      return 1;
+
+    if (pivot != k)
+    {
+      for(int j=0; j<m; j++)
+      {
+        double temp = ELT(k,j);
+        ELT(k,j) = ELT(pivot,j);
+        ELT(pivot,j) = temp;
+      }
+    }
+
+    for(int i=k+1; i<m; i++)
+    {
+      ELT(i,k) /= ELT(k,k);
+      for(int j=k+1; j<m; j++)
+        ELT(i,j) -= ELT(i,k) * ELT(k,j);
+    }
+  }
+  #undef ELT
+  return 0;
+}
+
+void ConstraintUpdateSolver::LUSolve(int m, const double * S, const int * pivots, double * x)
+{
+  #define ELT(i,j) S[m * (j) + (i)]
+  for(int k=0; k<m; k++)
+  {
+    double temp = x[k];
+    x[k] = x[pivots[k]];
+    x[pivots[k]] = temp;
+  }
+
+  for(int i=0; i<m; i++)
+    for(int j=0; j<i; j++)
+      x[i] -= ELT(i,j) * x[j];
+
+  for(int i=m-1; i>=0; i--)
+  {
+    for(int j=i+1; j<m; j++)
+      x[i] -= ELT(i,j) * x[j];
+    x[i] /= ELT(i,i);
+  }
+  #undef ELT
+}
+
@@ -0,0 +1,100 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _CONSTRAINTUPDATESOLVER_H_
+#define _CONSTRAINTUPDATESOLVER_H_
+
+/*
+  Solves A * x = rhs, where A is a symmetric n x n sparse matrix, subject to
+  x[i] = 0 for a given set of constrained DOFs, by re-using an existing 
+  factorization of A with a *different* set of constrained DOFs (the "base" set).
+
+  This makes it possible to add or remove a few constrained DOFs (e.g., when 
+  pinning or releasing vertices) without refactoring the system. 
+
+  Let F be the DOFs that are free in the base set, R the DOFs that are released 
+  (constrained in the base set, but not anymore), and E the DOFs that are newly constrained 
+  (selection matrix on F). The solver solves the bordered system
+
+    [ A_FF  A_FR  E ] [ x_F ]   [ rhs_F ]
+    [ A_RF  A_RR  0 ] [ x_R ] = [ rhs_R ]
+    [ E^T   0     0 ] [ lambda] [   0   ]
+
+  using the base factorization of A_FF and a dense m x m Schur complement 
+  (capacitance matrix), where m = #R + #E. Construction requires m solves
+  with the base factorization; each subsequent solve requires one solve with
+  the base factorization, plus O(n m) work.
+*/
+
+#include "sparseSolver/linearSolver.h"
+#include "sparseMatrix/sparseMatrix.h"
+
+class ConstraintUpdateSolver : public LinearSolver
+{
+public:
+
+  // A is the full (unconstrained) n x n matrix; it must be symmetric
+  // baseSolver solves the system with A_FF, i.e., A with the rows and columns of the base constrained DOFs removed (as with SparseMatrix::RemoveRowsColumns)
+  // constrainedDOFs is the new set of constrained DOFs (need not be sorted)
+  // the constructor computes the Schur complement; A, baseSolver must not be deleted or modified while this object is in use
+  // throws an integer exception if the Schur complement is singular
+  ConstraintUpdateSolver(const SparseMatrix * A, int numBaseConstrainedDOFs, const int * baseConstrainedDOFs, LinearSolver * baseSolver, int numConstrainedDOFs, const int * constrainedDOFs, int verbose=0);
+  virtual ~ConstraintUpdateSolver();
+
+  // solve: A * x = rhs, with x zero at the (new) constrained DOFs
+  // x and rhs are full vectors (length n); the entries of rhs at the constrained DOFs are ignored
+  // rhs is not modified
+  virtual int SolveLinearSystem(double * x, const double * rhs);
+
+  // number of DOFs whose constraint status differs from the base set (= m); the update is only efficient when this is small
+  inline int GetNumUpdatedDOFs() { return m; }
+
+protected:
+  int n, nf; // full size, size of the base system
+  int m; // number of released plus newly constrained DOFs
+  int numReleasedDOFs; // the first numReleasedDOFs entries of updatedDOFs are released DOFs, the rest are newly constrained DOFs
+  int * updatedDOFs; // in the full numbering
+  int * fullToBase; // full DOF index -> base system index (-1 if constrained in the base set)
+  int * baseToFull;
+  int * isConstrained; // 1 if constrained in the new set
+
+  const SparseMatrix * A;
+  LinearSolver * baseSolver;
+
+  double * W; // A_FF^{-1} B, nf x m, column-major
+  double * S; // LU-factored Schur complement, m x m, column-major
+  int * pivots;
+  double * baseRhs, * baseX, * z; // buffers
+
+  void MultiplyBTranspose(const double * xBase, double * result); // result = B^T * xBase
+  static int LUDecomposition(int m, double * S, int * pivots); // partial pivoting, in place; returns 0 on success, 1 if singular
+  static void LUSolve(int m, const double * S, const int * pivots, double * x); // solves in place
+};
+
+#endif
+
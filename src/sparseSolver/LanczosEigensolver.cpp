@@ -0,0 +1,649 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "LanczosEigensolver.h"
+#include "sparseSolverAvailability.h"
+#include "PardisoSolver.h"
+#include "SPOOLESSolver.h"
+#include "CGSolver.h"
+
+// the parallel version is used when the code is compiled with -fopenmp
+#ifdef _OPENMP
+  #define USE_OPENMP
+  #include <omp.h>
+#endif
+
+LanczosEigensolver::LanczosEigensolver(SparseMatrix * K_, SparseMatrix * M_, int numThreads_, int verbose_) : numThreads(numThreads_), verbose(verbose_), K(K_), M(M_)
+{
+  n = K->Getn();
+  if (M->Getn() != n)
+  {
+    printf("Error: the mass matrix does not have correct size. Mass matrix: %d x %d. Stiffness matrix: %d x %d.\n", M->Getn(), M->Getn(), n, n);
+    throw 1;
+  }
+
+  if (numThreads < 1)
+    numThreads = 1;
+
+  blockSize = 6;
+  maxBasisSize = 0;
+  epsilon = 1E-8;
+
+  sigma = 0.0;
+  numLinearSolves = 0;
+  basisSize = 0;
+  Q = NULL;
+  mw = NULL;
+  coef = NULL;
+  randomSeed = 1;
+}
+
+LanczosEigensolver::~LanczosEigensolver()
+{
+}
+
+void LanczosEigensolver::SetParameters(int blockSize_, int maxBasisSize_, double epsilon_)
+{
+  blockSize = blockSize_;
+  maxBasisSize = maxBasisSize_;
+  epsilon = epsilon_;
+}
+
+// uniform in [-1,1]; deterministic, so that the results are reproducible
+double LanczosEigensolver::Random()
+{
+  randomSeed = 1103515245 * randomSeed + 12345;
+  return 2.0 * ((randomSeed >> 8) & 0xFFFFFF) / (double)0xFFFFFF - 1.0;
+}
+
+void LanczosEigensolver::MultiplyM(const double * x, double * Mx)
+{
+  int ** indices = M->GetColumnIndices();
+  double ** entries = M->GetEntries();
+  int * rowLengths = M->GetRowLengths();
+
+  #ifdef USE_OPENMP
+    #pragma omp parallel for num_threads(numThreads)
+  #endif
+  for(int i=0; i<n; i++)
+  {
+    double sum = 0.0;
+    for(int j=0; j<rowLengths[i]; j++)
+      sum += entries[i][j] * x[indices[i][j]];
+    Mx[i] = sum;
+  }
+}
+
+double LanczosEigensolver::Dot(const double * x, const double * y)
+{
+  double sum = 0.0;
+  #ifdef USE_OPENMP
+    #pragma omp parallel for reduction(+:sum) num_threads(numThreads)
+  #endif
+  for(int i=0; i<n; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+void LanczosEigensolver::OrthogonalizeVector(double * w, int numColumns, double * projections)
+{
+  MultiplyM(w, mw);
+
+  // coef = Q^T M w
+  #ifdef USE_OPENMP
+    #pragma omp parallel for num_threads(numThreads)
+  #endif
+  for(int j=0; j<numColumns; j++)
+  {
+    double * q = &Q[(size_t)n * j];
+    double sum = 0.0;
+    for(int i=0; i<n; i++)
+      sum += q[i] * mw[i];
+    coef[j] = sum;
+  }
+
+  // w -= Q coef
+  #ifdef USE_OPENMP
+    #pragma omp parallel for num_threads(numThreads)
+  #endif
+  for(int i=0; i<n; i++)
+  {
+    double sum = 0.0;
+    for(int j=0; j<numColumns; j++)
+      sum += Q[(size_t)n * j + i] * coef[j];
+    w[i] -= sum;
+  }
+
+  if (projections != NULL)
+  {
+    for(int j=0; j<numColumns; j++)
+      projections[j] += coef[j];
+  }
+}
+
+void LanczosEigensolver::OrthogonalizeBlock(double * W, int numBasis, double * h, double * R)
+{
+  memset(h, 0, sizeof(double) * numBasis * blockSize);
+  memset(R, 0, sizeof(double) * blockSize * blockSize);
+  double * projections = (double*) malloc (sizeof(double) * (numBasis + blockSize));
+
+  for(int c=0; c<blockSize; c++)
+  {
+    double * w = &W[(size_t)n * c];
+    MultiplyM(w, mw);
+    double originalNorm = sqrt(fabs(Dot(w, mw)));
+
+    // two passes of classical Gram-Schmidt (against the basis, and the already processed columns of this block)
+    int numColumns = numBasis + c;
+    memset(projections, 0, sizeof(double) * numColumns);
+    for(int pass=0; pass<2; pass++)
+      OrthogonalizeVector(w, numColumns, projections);
+    for(int j=0; j<numBasis; j++)
+      h[numBasis * c + j] = projections[j];
+    for(int j=0; j<c; j++)
+      R[blockSize * c + j] = projections[numBasis + j];
+
+    MultiplyM(w, mw);
+    double norm = sqrt(fabs(Dot(w, mw)));
+    if (norm <= 1E-10 * originalNorm || norm == 0.0)
+    {
+      // w is (numerically) in the span of the basis (invariant subspace found): continue with a random vector
+      for(int i=0; i<n; i++)
+        w[i] = Random();
+      for(int pass=0; pass<2; pass++)
+        OrthogonalizeVector(w, numColumns, NULL);
+      MultiplyM(w, mw);
+      double randomNorm = sqrt(fabs(Dot(w, mw)));
+      for(int i=0; i<n; i++)
+        w[i] /= randomNorm;
+    }
+    else
+    {
+      R[blockSize * c + c] = norm;
+      for(int i=0; i<n; i++)
+        w[i] /= norm;
+    }
+
+    memcpy(&Q[(size_t)n * (numBasis + c)], w, sizeof(double) * n);
+  }
+
+  free(projections);
+}
+
+int LanczosEigensolver::ComputeEigenpairs(int numEigenvalues, double * eigenvalues, double * eigenvectors, int numRigidModes, double shift)
+{
+  int b = blockSize;
+  if (b < 1)
+    b = 1;
+  int maxBasis = maxBasisSize;
+  if (maxBasis <= 0)
+  {
+    maxBasis = 4 * numEigenvalues;
+    if (maxBasis < numEigenvalues + 100)
+      maxBasis = numEigenvalues + 100;
+  }
+  if (maxBasis > n - b)
+    maxBasis = n - b;
+  maxBasis = (maxBasis / b) * b; // multiple of the block size
+
+  if ((numEigenvalues > maxBasis) || (numEigenvalues <= 0))
+  {
+    printf("Error: cannot compute %d eigenvalues with a %d x %d matrix, block size %d, and maximal basis size %d.\n", numEigenvalues, n, n, b, maxBasis);
+    return 1;
+  }
+
+  // select the shift
+  sigma = shift;
+  if ((numRigidModes > 0) && (sigma == 0.0))
+  {
+    // K is singular; shift by a small fraction of the average diagonal ratio
+    double traceK = 0.0, traceM = 0.0;
+    for(int i=0; i<n; i++)
+    {
+      traceK += K->GetEntry(i, K->GetInverseIndex(i, i));
+      traceM += M->GetEntry(i, M->GetInverseIndex(i, i));
+    }
+    sigma = -1E-4 * traceK / traceM;
+  }
+
+  if (verbose >= 1)
+    printf("Computing %d eigenvalues (shift: %G, block size: %d, maximal basis size: %d)...\n", numEigenvalues, sigma, b, maxBasis);
+
+  // factor A = K - sigma * M
+  SparseMatrix * A = new SparseMatrix(*K);
+  if (sigma != 0.0)
+  {
+    A->BuildSubMatrixIndices(*M);
+    A->AddSubMatrix(-sigma, *M);
+    A->FreeSubMatrixIndices();
+  }
+
+  #if defined(PARDISO_SOLVER_IS_AVAILABLE)
+    PardisoSolver * solver = new PardisoSolver(A, numThreads, 0);
+    int info = solver->ComputeCholeskyDecomposition(A);
+    if (info != 0)
+    {
+      printf("Error: factorization of the shifted matrix failed (exit code %d).\n", info);
+      delete(solver);
+      delete(A);
+      return 1;
+    }
+  #elif defined(SPOOLES_SOLVER_IS_AVAILABLE)
+    SPOOLESSolver * solver = new SPOOLESSolver(A);
+  #else
+    CGSolver * solver = new CGSolver(A);
+  #endif
+
+  Q = (double*) malloc (sizeof(double) * n * (maxBasis + b));
+  mw = (double*) malloc (sizeof(double) * n);
+  coef = (double*) malloc (sizeof(double) * (maxBasis + b));
+  double * W = (double*) malloc (sizeof(double) * n * b);
+  double * MQ = (double*) malloc (sizeof(double) * n * b);
+  double * h = (double*) malloc (sizeof(double) * (maxBasis + b) * b);
+  double * R = (double*) malloc (sizeof(double) * b * b);
+  double * T = (double*) calloc (maxBasis * maxBasis, sizeof(double)); // column-major, upper block triangle
+  double * Tfull = (double*) malloc (sizeof(double) * maxBasis * maxBasis);
+  double * theta = (double*) malloc (sizeof(double) * maxBasis);
+  double * S = (double*) malloc (sizeof(double) * maxBasis * maxBasis);
+  int * order = (int*) malloc (sizeof(int) * maxBasis);
+  // identity permutation, in case the iteration stops before the first Rayleigh-Ritz step
+  for(int i=0; i<maxBasis; i++)
+    order[i] = i;
+
+  // random starting block
+  randomSeed = 1;
+  for(int i=0; i<n*b; i++)
+    W[i] = Random();
+  OrthogonalizeBlock(W, 0, h, R);
+
+  numLinearSolves = 0;
+  basisSize = 0;
+  int converged = 0;
+  bool solverFailed = false;
+  while (basisSize + b <= maxBasis)
+  {
+    int start = basisSize;
+
+    // W = (K - sigma M)^{-1} M Q_j
+    for(int c=0; c<b; c++)
+      MultiplyM(&Q[(size_t)n * (start + c)], &MQ[(size_t)n * c]);
+
+    #if defined(PARDISO_SOLVER_IS_AVAILABLE)
+      info = solver->SolveLinearSystemMultipleRHS(W, MQ, b);
+      if (info != 0)
+      {
+        solverFailed = true;
+        break;
+      }
+    #else
+      for(int c=0; c<b; c++)
+      {
+        #if defined(SPOOLES_SOLVER_IS_AVAILABLE)
+          solver->SolveLinearSystem(&W[(size_t)n * c], &MQ[(size_t)n * c]);
+        #else
+          memset(&W[(size_t)n * c], 0, sizeof(double) * n);
+          int numCGIterations = solver->SolveLinearSystemWithJacobiPreconditioner(&W[(size_t)n * c], &MQ[(size_t)n * c], 1E-12, 10 * n);
+          if ((numCGIterations < 0) && (verbose >= 1))
+            printf("Warning: CG solver did not converge (residual error: %G).\n", solver->GetResidualError());
+        #endif
+      }
+    #endif
+    numLinearSolves += b;
+
+    // Lanczos step: T(0:start+b, block j) = Q^T M W; the next block of Q is the M-orthonormalized remainder of W
+    basisSize = start + b;
+    OrthogonalizeBlock(W, basisSize, h, R);
+    for(int c=0; c<b; c++)
+      for(int i=0; i<basisSize; i++)
+        T[maxBasis * (start + c) + i] = h[basisSize * c + i];
+
+    if ((basisSize < numEigenvalues) && (basisSize + b <= maxBasis))
+      continue;
+
+    // Rayleigh-Ritz: eigendecomposition of the symmetric part of T
+    int N = basisSize;
+    for(int i=0; i<N; i++)
+      for(int j=i; j<N; j++)
+      {
+        // column j stores the rows up to the end of its block; i <= j is always stored, and so is (j,i) if in the same block
+        double value = T[maxBasis * j + i];
+        if (j / b == i / b)
+          value = 0.5 * (value + T[maxBasis * i + j]);
+        Tfull[N * i + j] = Tfull[N * j + i] = value;
+      }
+    SymmetricEigenDecomposition(N, Tfull, theta, S);
+
+    // order by |theta| (descending), i.e., by the distance of the eigenvalue from the shift
+    for(int i=0; i<N; i++)
+      order[i] = i;
+    for(int i=1; i<N; i++)
+    {
+      int value = order[i];
+      int j = i - 1;
+      while ((j >= 0) && (fabs(theta[order[j]]) < fabs(theta[value])))
+      {
+        order[j+1] = order[j];
+        j--;
+      }
+      order[j+1] = value;
+    }
+
+    // residual of the Ritz pair (theta, Q s) is Q_next * R * s(last block), i.e., its M-norm is || R * s(last block) ||
+    converged = 0;
+    for(int k=0; k<numEigenvalues; k++)
+    {
+      double * s = &S[N * order[k]];
+      double residual2 = 0.0;
+      for(int row=0; row<b; row++)
+      {
+        double entry = 0.0;
+        for(int c=row; c<b; c++)
+          entry += R[b * c + row] * s[start + c];
+        residual2 += entry * entry;
+      }
+      if (sqrt(residual2) <= epsilon * fabs(theta[order[k]]))
+        converged++;
+    }
+
+    if (verbose >= 2)
+      printf("Basis size: %d. Converged eigenpairs: %d / %d.\n", basisSize, converged, numEigenvalues);
+
+    if (converged == numEigenvalues)
+      break;
+  }
+
+  if (solverFailed)
+    printf("Error: linear solve with the shifted matrix failed.\n");
+  else if (converged < numEigenvalues)
+    printf("Warning: only %d out of %d eigenpairs converged (maximal basis size: %d).\n", converged, numEigenvalues, maxBasis);
+
+  // Ritz values and vectors; lambda = sigma + 1 / theta
+  int N = basisSize;
+  for(int k=0; (k<numEigenvalues) && !solverFailed; k++)
+  {
+    double * s = &S[N * order[k]];
+    double * x = &eigenvectors[(size_t)n * k];
+    #ifdef USE_OPENMP
+      #pragma omp parallel for num_threads(numThreads)
+    #endif
+    for(int i=0; i<n; i++)
+    {
+      double sum = 0.0;
+      for(int j=0; j<N; j++)
+        sum += Q[(size_t)n * j + i] * s[j];
+      x[i] = sum;
+    }
+    eigenvalues[k] = sigma + 1.0 / theta[order[k]];
+  }
+
+  // sort ascending
+  for(int i=1; i<numEigenvalues; i++)
+  {
+    for(int j=i; (j > 0) && (eigenvalues[j-1] > eigenvalues[j]); j--)
+    {
+      double temp = eigenvalues[j];
+      eigenvalues[j] = eigenvalues[j-1];
+      eigenvalues[j-1] = temp;
+      memcpy(mw, &eigenvectors[(size_t)n * j], sizeof(double) * n);
+      memcpy(&eigenvectors[(size_t)n * j], &eigenvectors[(size_t)n * (j-1)], sizeof(double) * n);
+      memcpy(&eigenvectors[(size_t)n * (j-1)], mw, sizeof(double) * n);
+    }
+  }
+
+  for(int i=0; (i<numRigidModes) && (i<numEigenvalues); i++)
+    eigenvalues[i] = 0.0;
+
+  if (verbose >= 1)
+    printf("Eigensolve completed. Basis size: %d. Linear solves: %d.\n", basisSize, numLinearSolves);
+
+  free(order);
+  free(S);
+  free(theta);
+  free(Tfull);
+  free(T);
+  free(R);
+  free(h);
+  free(MQ);
+  free(W);
+  free(coef);
+  free(mw);
+  free(Q);
+  coef = mw = Q = NULL;
+  delete(solver);
+  delete(A);
+
+  return (converged == numEigenvalues) ? 0 : 1;
+}
+
+// Householder tridiagonalization (tred2) and the implicit QL algorithm (tql2),
+// adapted from the public-domain JAMA library (derived from EISPACK)
+void LanczosEigensolver::SymmetricEigenDecomposition(int N, double * A, double * d, double * V)
+{
+  #define VV(i,j) V[N * (i) + (j)]
+  double * e = (double*) malloc (sizeof(double) * N);
+  memcpy(V, A, sizeof(double) * N * N);
+
+  // tred2
+  for(int j=0; j<N; j++)
+    d[j] = VV(N-1,j);
+
+  for(int i=N-1; i>0; i--)
+  {
+    double scale = 0.0;
+    double h = 0.0;
+    for(int k=0; k<i; k++)
+      scale += fabs(d[k]);
+
+    if (scale == 0.0)
+    {
+      e[i] = d[i-1];
+      for(int j=0; j<i; j++)
+      {
+        d[j] = VV(i-1,j);
+        VV(i,j) = 0.0;
+        VV(j,i) = 0.0;
+      }
+    }
+    else
+    {
+      for(int k=0; k<i; k++)
+      {
+        d[k] /= scale;
+        h += d[k] * d[k];
+      }
+      double f = d[i-1];
+      double g = sqrt(h);
+      if (f > 0)
+        g = -g;
+      e[i] = scale * g;
+      h = h - f * g;
+      d[i-1] = f - g;
+      for(int j=0; j<i; j++)
+        e[j] = 0.0;
+
+      for(int j=0; j<i; j++)
+      {
+        f = d[j];
+        VV(j,i) = f;
+        g = e[j] + VV(j,j) * f;
+        for(int k=j+1; k<=i-1; k++)
+        {
+          g += VV(k,j) * d[k];
+          e[k] += VV(k,j) * f;
+        }
+        e[j] = g;
+      }
+      f = 0.0;
+      for(int j=0; j<i; j++)
+      {
+        e[j] /= h;
+        f += e[j] * d[j];
+      }
+      double hh = f / (h + h);
+      for(int j=0; j<i; j++)
+        e[j] -= hh * d[j];
+      for(int j=0; j<i; j++)
+      {
+        f = d[j];
+        g = e[j];
+        for(int k=j; k<=i-1; k++)
+          VV(k,j) -= (f * e[k] + g * d[k]);
+        d[j] = VV(i-1,j);
+        VV(i,j) = 0.0;
+      }
+    }
+    d[i] = h;
+  }
+
+  // accumulate transformations
+  for(int i=0; i<N-1; i++)
+  {
+    VV(N-1,i) = VV(i,i);
+    VV(i,i) = 1.0;
+    double h = d[i+1];
+    if (h != 0.0)
+    {
+      for(int k=0; k<=i; k++)
+        d[k] = VV(k,i+1) / h;
+      for(int j=0; j<=i; j++)
+      {
+        double g = 0.0;
+        for(int k=0; k<=i; k++)
+          g += VV(k,i+1) * VV(k,j);
+        for(int k=0; k<=i; k++)
+          VV(k,j) -= g * d[k];
+      }
+    }
+    for(int k=0; k<=i; k++)
+      VV(k,i+1) = 0.0;
+  }
+  for(int j=0; j<N; j++)
+  {
+    d[j] = VV(N-1,j);
+    VV(N-1,j) = 0.0;
+  }
+  VV(N-1,N-1) = 1.0;
+  e[0] = 0.0;
+
+  // tql2
+  for(int i=1; i<N; i++)
+    e[i-1] = e[i];
+  e[N-1] = 0.0;
+
+  double f = 0.0;
+  double tst1 = 0.0;
+  for(int l=0; l<N; l++)
+  {
+    // find small subdiagonal element
+    if (fabs(d[l]) + fabs(e[l]) > tst1)
+      tst1 = fabs(d[l]) + fabs(e[l]);
+    int m = l;
+    while (m < N)
+    {
+      if (fabs(e[m]) <= DBL_EPSILON * tst1)
+        break;
+      m++;
+    }
+
+    // if m == l, d[l] is an eigenvalue; otherwise, iterate
+    if (m > l)
+    {
+      do
+      {
+        // compute implicit shift
+        double g = d[l];
+        double p = (d[l+1] - g) / (2.0 * e[l]);
+        double r = hypot(p, 1.0);
+        if (p < 0)
+          r = -r;
+        d[l] = e[l] / (p + r);
+        d[l+1] = e[l] * (p + r);
+        double dl1 = d[l+1];
+        double h = g - d[l];
+        for(int i=l+2; i<N; i++)
+          d[i] -= h;
+        f = f + h;
+
+        // implicit QL transformation
+        p = d[m];
+        double c = 1.0;
+        double c2 = c;
+        double c3 = c;
+        double el1 = e[l+1];
+        double s = 0.0;
+        double s2 = 0.0;
+        for(int i=m-1; i>=l; i--)
+        {
+          c3 = c2;
+          c2 = c;
+          s2 = s;
+          g = c * e[i];
+          h = c * p;
+          r = hypot(p, e[i]);
+          e[i+1] = s * r;
+          s = e[i] / r;
+          c = p / r;
+          p = c * d[i] - s * g;
+          d[i+1] = h + s * (c * g + s * d[i]);
+
+          // accumulate transformation
+          for(int k=0; k<N; k++)
+          {
+            h = VV(k,i+1);
+            VV(k,i+1) = s * VV(k,i) + c * h;
+            VV(k,i) = c * VV(k,i) - s * h;
+          }
+        }
+        p = -s * s2 * c3 * el1 * e[l] / dl1;
+        e[l] = s * p;
+        d[l] = c * p;
+      }
+      while (fabs(e[l]) > DBL_EPSILON * tst1);
+    }
+    d[l] = d[l] + f;
+    e[l] = 0.0;
+  }
+
+  // store the eigenvectors as rows of V
+  for(int i=0; i<N; i++)
+    for(int j=i+1; j<N; j++)
+    {
+      double temp = VV(i,j);
+      VV(i,j) = VV(j,i);
+      VV(j,i) = temp;
+    }
+
+  free(e);
+  #undef VV
+}
+
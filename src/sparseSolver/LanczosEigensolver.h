@@ -0,0 +1,125 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _LANCZOSEIGENSOLVER_H_
+#define _LANCZOSEIGENSOLVER_H_
+
+/*
+  Computes the lowest eigenvalues and eigenvectors of the sparse generalized 
+  eigenproblem K x = lambda M x, where K is symmetric (e.g., a stiffness matrix),
+  and M is symmetric positive-definite (e.g., a mass matrix). 
+
+  The solver uses shift-invert block Lanczos with full reorthogonalization:
+  the Krylov space of the operator (K - shift * M)^{-1} M is built in the 
+  M-inner product, and the eigenpairs are extracted with the Rayleigh-Ritz 
+  procedure. The eigenvalues closest to the shift converge first. 
+  The shifted matrix K - shift * M is factored once, using Pardiso or SPOOLES 
+  if available (see sparseSolverAvailability.h), otherwise the Jacobi-preconditioned 
+  conjugate gradient solver is used (this requires K - shift * M to be positive-definite).
+
+  The computed eigenvectors are M-orthonormal (mass-normalized): x_i^T M x_j = delta_ij.
+  Output format is compatible with WriteModesToDisk (see matrix/matrixIO.h);
+  frequencies (in Hz) are sqrt(lambda_i) / (2 pi).
+
+  Free-floating objects (no constraints) have zero eigenvalues (rigid modes; 6 in 3D).
+  K is then singular, and a negative shift must be used. If "numRigidModes" is specified,
+  a negative shift is chosen automatically, and the lowest "numRigidModes" eigenvalues 
+  are reported as exactly zero.
+
+  The block size must be at least the multiplicity of the eigenvalues that are to be 
+  resolved (6 for the rigid modes of a 3D object, 2 for symmetric cross-sections, etc.).
+
+  The matrix-vector products and the dense block operations are multi-threaded 
+  with OpenMP if the code is compiled with -fopenmp.
+*/
+
+#include "sparseSolver/linearSolver.h"
+#include "sparseMatrix/sparseMatrix.h"
+
+class LanczosEigensolver
+{
+public:
+
+  // K and M must have the same dimension; the non-zero pattern of M must be a subset of that of K (always true for FEM matrices)
+  // constrained DOFs, if any, must be removed from K and M beforehand (e.g., using SparseMatrix::RemoveRowsColumns)
+  // K and M are not modified
+  LanczosEigensolver(SparseMatrix * K, SparseMatrix * M, int numThreads=1, int verbose=0);
+  virtual ~LanczosEigensolver();
+
+  // computes the numEigenvalues eigenvalues closest to "shift" (for shift <= the lowest eigenvalue, these are the lowest eigenvalues),
+  // and the corresponding M-orthonormal eigenvectors
+  // output: eigenvalues (length numEigenvalues, ascending), eigenvectors (n x numEigenvalues, column-major); both must be pre-allocated
+  // numRigidModes: number of zero eigenvalues of K (e.g., 6 for an unconstrained 3D object); if shift is 0, a negative shift is then chosen automatically
+  // returns 0 on success, and 1 if not all eigenpairs converged within the maximal basis size (the output then contains the current approximations)
+  int ComputeEigenpairs(int numEigenvalues, double * eigenvalues, double * eigenvectors, int numRigidModes=0, double shift=0.0);
+
+  // blockSize: number of vectors in a Lanczos block (default: 6)
+  // maxBasisSize: maximal size of the Krylov basis (0 = automatic: max(4 * numEigenvalues, numEigenvalues + 100)); the memory is n * maxBasisSize doubles
+  // epsilon: convergence tolerance, relative to the eigenvalue of the shift-inverted operator (default: 1E-8)
+  void SetParameters(int blockSize, int maxBasisSize=0, double epsilon=1E-8);
+
+  // statistics of the last call to ComputeEigenpairs
+  inline int GetNumLinearSolves() { return numLinearSolves; }
+  inline int GetBasisSize() { return basisSize; }
+  inline double GetShift() { return sigma; }
+
+protected:
+  int n;
+  int numThreads;
+  int verbose;
+  SparseMatrix * K, * M;
+
+  int blockSize;
+  int maxBasisSize;
+  double epsilon;
+
+  // state of the current solve
+  double sigma;
+  int numLinearSolves;
+  int basisSize;
+  double * Q; // M-orthonormal Krylov basis, n x (maxBasis + blockSize), column-major
+  double * mw; // buffer of length n
+  double * coef; // buffer of length maxBasis + blockSize
+  unsigned int randomSeed;
+
+  void MultiplyM(const double * x, double * Mx);
+  double Dot(const double * x, const double * y);
+  // M-orthogonalizes the block W (n x blockSize) against the first numBasis columns of Q, M-orthonormalizes it, and stores it into Q (columns numBasis, ..., numBasis + blockSize - 1)
+  // h (numBasis x blockSize) are the projections of W onto the basis; R (blockSize x blockSize) are the coefficients w.r.t. the new columns
+  void OrthogonalizeBlock(double * W, int numBasis, double * h, double * R);
+  // removes the components along the first numColumns columns of Q from w, adding the coefficients to projections (if non-NULL)
+  void OrthogonalizeVector(double * w, int numColumns, double * projections);
+  double Random();
+
+  // symmetric tridiagonal eigensolver (Householder reduction followed by the implicit QL algorithm)
+  // input: A (N x N, symmetric), output: eigenvalues (d), eigenvectors (V; the i-th eigenvector is V[N*i], ..., V[N*i+N-1])
+  static void SymmetricEigenDecomposition(int N, double * A, double * d, double * V);
+};
+
+#endif
+
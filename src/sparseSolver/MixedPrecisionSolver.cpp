@@ -0,0 +1,130 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "MixedPrecisionSolver.h"
+#include "PardisoSolver.h"
+
+MixedPrecisionSolver::MixedPrecisionSolver(const SparseMatrix * A_, int numThreads, int positiveDefinite, int verbose_, int maxRefinementIterations_, double epsilon_) : verbose(verbose_), maxRefinementIterations(maxRefinementIterations_), epsilon(epsilon_), A(A_)
+{
+  int directIterative = 0;
+  int singlePrecision = 1;
+  pardisoSolver = new PardisoSolver(A, numThreads, positiveDefinite, directIterative, verbose, singlePrecision);
+  lowPrecisionSolver = pardisoSolver;
+  InitBuffers();
+}
+
+MixedPrecisionSolver::MixedPrecisionSolver(const SparseMatrix * A_, LinearSolver * lowPrecisionSolver_, int verbose_, int maxRefinementIterations_, double epsilon_) : verbose(verbose_), maxRefinementIterations(maxRefinementIterations_), epsilon(epsilon_), A(A_), pardisoSolver(NULL), lowPrecisionSolver(lowPrecisionSolver_)
+{
+  InitBuffers();
+}
+
+void MixedPrecisionSolver::InitBuffers()
+{
+  n = A->Getn();
+  AInfNorm = A->GetInfinityNorm();
+  residual = (double*) malloc (sizeof(double) * n);
+  correction = (double*) malloc (sizeof(double) * n);
+  numRefinementIterations = 0;
+  residualError = 0.0;
+}
+
+MixedPrecisionSolver::~MixedPrecisionSolver()
+{
+  delete(pardisoSolver);
+  free(residual);
+  free(correction);
+}
+
+int MixedPrecisionSolver::ComputeCholeskyDecomposition(const SparseMatrix * A)
+{
+  this->A = A;
+  AInfNorm = A->GetInfinityNorm();
+
+  if (pardisoSolver == NULL)
+    return 0;
+
+  return (int)pardisoSolver->ComputeCholeskyDecomposition(A);
+}
+
+double MixedPrecisionSolver::InfNorm(int n, const double * x)
+{
+  double norm = 0.0;
+  for(int i=0; i<n; i++)
+    if (fabs(x[i]) > norm)
+      norm = fabs(x[i]);
+  return norm;
+}
+
+int MixedPrecisionSolver::SolveLinearSystem(double * x, const double * rhs)
+{
+  memset(x, 0, sizeof(double) * n);
+  memcpy(residual, rhs, sizeof(double) * n);
+
+  numRefinementIterations = 0;
+  residualError = 0.0;
+  if (InfNorm(n, rhs) == 0.0)
+    return 0;
+
+  for(int iter=0; iter<maxRefinementIterations; iter++)
+  {
+    int info = lowPrecisionSolver->SolveLinearSystem(correction, residual);
+    numRefinementIterations++;
+    if (info != 0)
+    {
+      printf("Error: low-precision solve returned non-zero exit code %d.\n", info);
+      return info;
+    }
+
+    for(int i=0; i<n; i++)
+      x[i] += correction[i];
+
+    // residual = rhs - A * x, in double precision
+    A->MultiplyVector(x, residual);
+    for(int i=0; i<n; i++)
+      residual[i] = rhs[i] - residual[i];
+
+    double xNorm = InfNorm(n, x);
+    residualError = (xNorm > 0.0) ? InfNorm(n, residual) / (AInfNorm * xNorm) : 1.0;
+
+    if (verbose >= 2)
+      printf("Refinement iteration %d: residual error: %G\n", iter, residualError);
+
+    if (residualError <= epsilon)
+      return 0;
+  }
+
+  if (verbose >= 1)
+    printf("Warning: mixed-precision iterative refinement did not converge in %d iterations. Residual error: %G\n", maxRefinementIterations, residualError);
+
+  return 1;
+}
+
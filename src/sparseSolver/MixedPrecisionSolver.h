@@ -0,0 +1,105 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "sparseSolver" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC   *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _MIXEDPRECISIONSOLVER_H_
+#define _MIXEDPRECISIONSOLVER_H_
+
+/*
+  Solves A * x = rhs, where A is sparse, symmetric, and usually large.
+
+  The matrix is factored in single precision, which halves the memory
+  of the factors and speeds up the factorization. Double-precision accuracy 
+  is then recovered using iterative refinement against the double-precision matrix A:
+
+    x = 0, r = rhs
+    repeat: solve A * d = r using the single-precision factors, x += d, r = rhs - A * x
+
+  Refinement converges when cond(A) is (well) below 1 / (single-precision epsilon) ~ 1E7.
+  The stopping criterium is the same as in LAPACK's dsposv: 
+  || r ||_inf <= epsilon * || A ||_inf * || x ||_inf .
+
+  By default, the single-precision factorization is computed with Pardiso 
+  (see PardisoSolver.h). Any other (low-precision) LinearSolver can be used 
+  instead, by using the second constructor.
+*/
+
+#include "sparseSolver/linearSolver.h"
+#include "sparseMatrix/sparseMatrix.h"
+
+class PardisoSolver;
+
+class MixedPrecisionSolver : public LinearSolver
+{
+public:
+
+  // the constructor computes the permutation to re-order A (only the topology of A matters for this step), and has the same parameters as PardisoSolver
+  // A is not modified
+  MixedPrecisionSolver(const SparseMatrix * A, int numThreads, int positiveDefinite=0, int verbose=0, int maxRefinementIterations=30, double epsilon=1E-13);
+
+  // uses an existing low-precision solver for A, instead of the single-precision Pardiso solver 
+  // (it is not deleted in the destructor, and it is the responsibility of the caller to update it when A changes)
+  MixedPrecisionSolver(const SparseMatrix * A, LinearSolver * lowPrecisionSolver, int verbose=0, int maxRefinementIterations=30, double epsilon=1E-13);
+
+  virtual ~MixedPrecisionSolver();
+
+  // factors a single-precision copy of A (same as PardisoSolver::ComputeCholeskyDecomposition)
+  // A must have the same topology as in the constructor
+  // A is used in the subsequent solves to compute the residuals; it must not be deleted or modified until the next call to this routine
+  int ComputeCholeskyDecomposition(const SparseMatrix * A);
+
+  // solve: A * x = rhs, using the single-precision factorization and iterative refinement
+  // rhs is not modified
+  // returns 0 on success, and 1 if the refinement did not converge (this happens if A is too ill-conditioned for single precision)
+  virtual int SolveLinearSystem(double * x, const double * rhs);
+
+  inline void SetRefinementParameters(int maxRefinementIterations, double epsilon) { this->maxRefinementIterations = maxRefinementIterations; this->epsilon = epsilon; }
+
+  // statistics of the last solve
+  inline int GetNumRefinementIterations() { return numRefinementIterations; } // number of low-precision solves
+  inline double GetResidualError() { return residualError; } // || r ||_inf / (|| A ||_inf * || x ||_inf)
+
+protected:
+  int n;
+  int verbose;
+  int maxRefinementIterations;
+  double epsilon;
+  const SparseMatrix * A;
+  double AInfNorm;
+  PardisoSolver * pardisoSolver; // NULL if the low-precision solver was provided by the user
+  LinearSolver * lowPrecisionSolver;
+  double * residual, * correction;
+
+  int numRefinementIterations;
+  double residualError;
+
+  void InitBuffers();
+  static double InfNorm(int n, const double * x);
+};
+
+#endif
+
@@ -59,8 +59,14 @@
   #define PARDISO pardiso
 #endif
 
-PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positiveDefinite_, int directIterative_, int verbose_) : numThreads(numThreads_), positiveDefinite(positiveDefinite_), directIterative(directIterative_), verbose(verbose_)
+PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positiveDefinite_, int directIterative_, int verbose_, int singlePrecision_) : numThreads(numThreads_), positiveDefinite(positiveDefinite_), directIterative(directIterative_), verbose(verbose_), singlePrecision(singlePrecision_)
 {
+  if (singlePrecision && directIterative)
+  {
+    printf("Error: Pardiso single-precision mode cannot be combined with the direct-iterative solver.\n");
+    throw 103;
+  }
+
   mkl_set_num_threads(numThreads);
 
   n = A->Getn();
@@ -81,6 +87,18 @@ PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positi
   if (verbose >= 2)
     printf("numUpperTriEntries: %d\n", numUpperTriangleEntries);
 
+  af = NULL;
+  xf = NULL;
+  rhsf = NULL;
+  if (singlePrecision)
+  {
+    af = (float*) malloc (sizeof(float) * numUpperTriangleEntries);  
+    xf = (float*) malloc (sizeof(float) * n);  
+    rhsf = (float*) malloc (sizeof(float) * n);  
+    for(int i=0; i<numUpperTriangleEntries; i++)
+      af[i] = (float) a[i];
+  }
+
   // permute & do symbolic factorization
 
   mtype = positiveDefinite ? 2 : -2;
@@ -113,6 +131,7 @@ PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positi
   iparm[18] = 0; // no Output: Mflops for LU factorization
   iparm[19] = 0; // Output: Numbers of CG Iterations
   iparm[20] = 1; // pivoting method
+  iparm[27] = singlePrecision ? 1 : 0; // 0=double precision, 1=single precision (a, x, rhs are then float arrays)
 
 /*
   iparm[0] = 0;
@@ -135,7 +154,7 @@ PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positi
   /* -------------------------------------------------------------------- */
   phase = 11;
   PARDISO (pt, &maxfct, &mnum, &mtype, &phase,
-           &n, a, ia, ja, NULL, &nrhs,
+           &n, GetValues(), ia, ja, NULL, &nrhs,
           iparm, &msglvl, NULL, NULL, &error);
 
   if (error != 0)
@@ -155,7 +174,7 @@ PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positi
 PardisoSolver::~PardisoSolver()
 {
   phase = -1;
-  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &nrhs, iparm, &msglvl, NULL, NULL, &error);
+  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, GetValues(), ia, ja, NULL, &nrhs, iparm, &msglvl, NULL, NULL, &error);
 
   if (error != 0)
     printf("Error: Pardiso Cholesky dealloacation returned non-zero exit code %d.\n", error);
@@ -163,6 +182,17 @@ PardisoSolver::~PardisoSolver()
   free(a);
   free(ia);
   free(ja);
+  free(af);
+  free(xf);
+  free(rhsf);
+}
+
+void * PardisoSolver::GetValues()
+{
+  if (singlePrecision)
+    return af;
+  else
+    return a;
 }
 
 void PardisoSolver::DisabledSolverError() {}
@@ -180,9 +210,16 @@ MKL_INT PardisoSolver::ComputeCholeskyDecomposition(const SparseMatrix * A)
   int oneIndexed = 1;
   A->GenerateCompressedRowMajorFormat(a, NULL, NULL, upperTriangleOnly, oneIndexed);
 
+  if (singlePrecision)
+  {
+    int numEntries = ia[n] - 1;
+    for(int i=0; i<numEntries; i++)
+      af[i] = (float) a[i];
+  }
+
   // factor 
   phase = 22;
-  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &nrhs, iparm, &msglvl, NULL, NULL,  &error);
+  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, GetValues(), ia, ja, NULL, &nrhs, iparm, &msglvl, NULL, NULL,  &error);
 
   if (error != 0)
     printf("Error: Pardiso Cholesky decomposition returned non-zero exit code %d.\n", error);
@@ -205,7 +242,16 @@ int PardisoSolver::SolveLinearSystem(double * x, const double * rhs)
     printf("Solving linear system...(%d threads, using previously computed LU)\n", numThreads);
 
   phase = 33;
-  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &nrhs, iparm, &msglvl, (double*)rhs, x, &error);
+  if (singlePrecision)
+  {
+    for(int i=0; i<n; i++)
+      rhsf[i] = (float) rhs[i];
+    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, af, ia, ja, NULL, &nrhs, iparm, &msglvl, rhsf, xf, &error);
+    for(int i=0; i<n; i++)
+      x[i] = xf[i];
+  }
+  else
+    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &nrhs, iparm, &msglvl, (double*)rhs, x, &error);
 
   if (error != 0)
     printf("Error: Pardiso solve returned non-zero exit code %d.\n", error);
@@ -229,7 +275,20 @@ MKL_INT PardisoSolver::SolveLinearSystemMultipleRHS(double * x, const double * r
 
   phase = 33;
 
-  PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &numRHS, iparm, &msglvl, (double*)rhs, x, &error);
+  if (singlePrecision)
+  {
+    float * multipleRHSf = (float*) malloc (sizeof(float) * n * numRHS);
+    float * multipleXf = (float*) malloc (sizeof(float) * n * numRHS);
+    for(int i=0; i<n*numRHS; i++)
+      multipleRHSf[i] = (float) rhs[i];
+    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, af, ia, ja, NULL, &numRHS, iparm, &msglvl, multipleRHSf, multipleXf, &error);
+    for(int i=0; i<n*numRHS; i++)
+      x[i] = multipleXf[i];
+    free(multipleXf);
+    free(multipleRHSf);
+  }
+  else
+    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, NULL, &numRHS, iparm, &msglvl, (double*)rhs, x, &error);
 
   if (error != 0)
     printf("Error: Pardiso solve returned non-zero exit code %d.\n", error);
@@ -271,7 +330,7 @@ MKL_INT PardisoSolver::SolveLinearSystemDirectIterative(const SparseMatrix * A,
 
 // Pardiso Solver is not available
 
-PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positiveDefinite_, int directIterative_, int verbose_) : numThreads(numThreads_), positiveDefinite(positiveDefinite_), directIterative(directIterative_), verbose(verbose_) 
+PardisoSolver::PardisoSolver(const SparseMatrix * A, int numThreads_, int positiveDefinite_, int directIterative_, int verbose_, int singlePrecision_) : numThreads(numThreads_), positiveDefinite(positiveDefinite_), directIterative(directIterative_), verbose(verbose_), singlePrecision(singlePrecision_) 
 {
   DisabledSolverError();
 }
@@ -52,7 +52,10 @@ public:
   // the constructor will compute the permutation to re-order A 
   // only the topology of A matters for this step
   // A is not modified
-  PardisoSolver(const SparseMatrix * A, int numThreads, int positiveDefinite=0, int directIterative=0, int verbose=0);
+  // if singlePrecision is 1, the factorization is computed and stored in single precision (halves the memory of the factors);
+  // the solution is then accurate only to single precision (see MixedPrecisionSolver for iterative refinement to double precision);
+  // singlePrecision cannot be combined with directIterative
+  PardisoSolver(const SparseMatrix * A, int numThreads, int positiveDefinite=0, int directIterative=0, int verbose=0, int singlePrecision=0);
   virtual ~PardisoSolver();
 
   MKL_INT ComputeCholeskyDecomposition(const SparseMatrix * A); // perform complete Cholesky factorization
@@ -72,8 +75,10 @@ protected:
   int positiveDefinite;
   int directIterative;
   int verbose;
+  int singlePrecision;
   double * a;
   int * ia, * ja;
+  float * af, * xf, * rhsf; // single-precision copies of a, x, rhs (singlePrecision mode only)
 
   void *pt[64];
   MKL_INT iparm[64];
@@ -81,6 +86,7 @@ protected:
   MKL_INT nrhs; 
   MKL_INT maxfct, mnum, phase, error, msglvl;
 
+  void * GetValues(); // a or af, depending on the precision
   static void DisabledSolverError();
 };
 
@@ -32,6 +32,9 @@
 #include "PardisoSolver.h"
 #include "SPOOLESSolver.h"
 #include "SPOOLESSolverMT.h"
+#include "MixedPrecisionSolver.h"
+#include "ConstraintUpdateSolver.h"
+#include "LanczosEigensolver.h"
 
 #endif
 
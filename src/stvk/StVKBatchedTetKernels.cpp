@@ -0,0 +1,273 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "StVK" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC           *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "StVKBatchedTetKernels.h"
+
+#define W STVK_BATCH_WIDTH
+
+StVKBatchedTetKernels::StVKBatchedTetKernels(TetMesh * tetMesh, double * lambdaLame, double * muLame)
+{
+  numElements = tetMesh->getNumElements();
+  numBatches = (numElements + W - 1) / W;
+
+  // the lanes past the last element are padded with zeros (they are computed, but never scattered)
+  batches = (Batch*) calloc (numBatches, sizeof(Batch));
+
+  for(int el=0; el<numElements; el++)
+  {
+    Batch * batch = &batches[el / W];
+    int lane = el % W;
+
+    Vec3d v0 = *(tetMesh->getVertex(el, 0));
+    Vec3d v1 = *(tetMesh->getVertex(el, 1));
+    Vec3d v2 = *(tetMesh->getVertex(el, 2));
+    Vec3d v3 = *(tetMesh->getVertex(el, 3));
+
+    // the gradients of the barycentric coordinates 1,2,3 are the rows of the inverse of [v1-v0 | v2-v0 | v3-v0]
+    Vec3d e1 = v1 - v0;
+    Vec3d e2 = v2 - v0;
+    Vec3d e3 = v3 - v0;
+    Mat3d edges(e1[0], e2[0], e3[0],
+                e1[1], e2[1], e3[1],
+                e1[2], e2[2], e3[2]);
+    Mat3d edgesInv = inv(edges);
+
+    Vec3d Phig[4];
+    for(int i=1; i<4; i++)
+      Phig[i] = edgesInv[i-1];
+    Phig[0] = -1.0 * (Phig[1] + Phig[2] + Phig[3]);
+
+    for(int a=0; a<4; a++)
+    {
+      for(int j=0; j<3; j++)
+        batch->Phig[a][j][lane] = Phig[a][j];
+      batch->vertices[a][lane] = tetMesh->getVertexIndex(el, a);
+    }
+
+    batch->volume[lane] = fabs(det(edges) / 6);
+    batch->lambda[lane] = lambdaLame[el];
+    batch->mu[lane] = muLame[el];
+  }
+}
+
+StVKBatchedTetKernels::~StVKBatchedTetKernels()
+{
+  free(batches);
+}
+
+void StVKBatchedTetKernels::ComputeDisplacementGradient(Batch * batch, double * vertexDisplacements, double G[3][3][W])
+{
+  // gather the displacements of the element vertices
+  double u[4][3][W];
+  for(int a=0; a<4; a++)
+    for(int lane=0; lane<W; lane++)
+    {
+      double * ua = &vertexDisplacements[3 * batch->vertices[a][lane]];
+      u[a][0][lane] = ua[0];
+      u[a][1][lane] = ua[1];
+      u[a][2][lane] = ua[2];
+    }
+
+  // G = sum_a u_a Phig_a^T
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      for(int lane=0; lane<W; lane++)
+        G[i][j][lane] = u[0][i][lane] * batch->Phig[0][j][lane] + u[1][i][lane] * batch->Phig[1][j][lane] + 
+                        u[2][i][lane] * batch->Phig[2][j][lane] + u[3][i][lane] * batch->Phig[3][j][lane];
+}
+
+// S(E) = lambda tr(E) I + 2 mu E, for E1 = (G + G^T) / 2 (linear strain) and E2 = G^T G / 2 (quadratic strain)
+#define STVK_BATCH_STRESSES(batch, G, S1, S2)\
+  for(int i=0; i<3; i++)\
+    for(int j=0; j<3; j++)\
+      for(int lane=0; lane<W; lane++)\
+      {\
+        S1[i][j][lane] = batch->mu[lane] * (G[i][j][lane] + G[j][i][lane]);\
+        S2[i][j][lane] = batch->mu[lane] * (G[0][i][lane] * G[0][j][lane] + G[1][i][lane] * G[1][j][lane] + G[2][i][lane] * G[2][j][lane]);\
+      }\
+  for(int lane=0; lane<W; lane++)\
+  {\
+    double trace1 = batch->lambda[lane] * (G[0][0][lane] + G[1][1][lane] + G[2][2][lane]);\
+    double trace2 = 0.0;\
+    for(int i=0; i<3; i++)\
+      for(int j=0; j<3; j++)\
+        trace2 += G[i][j][lane] * G[i][j][lane];\
+    trace2 *= 0.5 * batch->lambda[lane];\
+    for(int i=0; i<3; i++)\
+    {\
+      S1[i][i][lane] += trace1;\
+      S2[i][i][lane] += trace2;\
+    }\
+  }
+
+void StVKBatchedTetKernels::AddForces(double * vertexDisplacements, double * forces, int elementLow, int elementHigh, int terms)
+{
+  // the force terms of degree 1, 2, 3 are V P Phig_c, with P = S1 (linear), G S1 + S2 (quadratic), G S2 (cubic);
+  // the selected terms are V (A + G B) Phig_c
+  double wLinear = (terms & LINEAR) ? 1.0 : 0.0;
+  double wQuadratic = (terms & QUADRATIC) ? 1.0 : 0.0;
+  double wCubic = (terms & CUBIC) ? 1.0 : 0.0;
+
+  int batchLow = elementLow / W;
+  int batchHigh = (elementHigh + W - 1) / W;
+  for(int batchIndex=batchLow; batchIndex<batchHigh; batchIndex++)
+  {
+    Batch * batch = &batches[batchIndex];
+
+    double G[3][3][W];
+    ComputeDisplacementGradient(batch, vertexDisplacements, G);
+
+    double S1[3][3][W], S2[3][3][W];
+    STVK_BATCH_STRESSES(batch, G, S1, S2);
+
+    double A[3][3][W], B[3][3][W];
+    for(int i=0; i<3; i++)
+      for(int j=0; j<3; j++)
+        for(int lane=0; lane<W; lane++)
+        {
+          A[i][j][lane] = wLinear * S1[i][j][lane] + wQuadratic * S2[i][j][lane];
+          B[i][j][lane] = wQuadratic * S1[i][j][lane] + wCubic * S2[i][j][lane];
+        }
+
+    // VP = V (A + G B)
+    double VP[3][3][W];
+    for(int i=0; i<3; i++)
+      for(int j=0; j<3; j++)
+        for(int lane=0; lane<W; lane++)
+          VP[i][j][lane] = batch->volume[lane] * (A[i][j][lane] + G[i][0][lane] * B[0][j][lane] + G[i][1][lane] * B[1][j][lane] + G[i][2][lane] * B[2][j][lane]);
+
+    // element forces
+    double f[4][3][W];
+    for(int c=0; c<4; c++)
+      for(int i=0; i<3; i++)
+        for(int lane=0; lane<W; lane++)
+          f[c][i][lane] = VP[i][0][lane] * batch->Phig[c][0][lane] + VP[i][1][lane] * batch->Phig[c][1][lane] + VP[i][2][lane] * batch->Phig[c][2][lane];
+
+    // scatter
+    int laneLow = elementLow - W * batchIndex;
+    if (laneLow < 0)
+      laneLow = 0;
+    int laneHigh = elementHigh - W * batchIndex;
+    if (laneHigh > W)
+      laneHigh = W;
+    for(int lane=laneLow; lane<laneHigh; lane++)
+      for(int c=0; c<4; c++)
+      {
+        double * force = &forces[3 * batch->vertices[c][lane]];
+        force[0] += f[c][0][lane];
+        force[1] += f[c][1][lane];
+        force[2] += f[c][2][lane];
+      }
+  }
+}
+
+/*
+  Derivatives of the force terms on vertex c with respect to the displacements of vertex e, with 
+  pc = Phig_c, pe = Phig_e, a1 = G pc, b1 = G pe:
+    linear:    V [ mu (pe . pc) I + lambda pc pe^T + mu pe pc^T ]
+    quadratic: V [ (pe^T S1 pc) I + lambda (a1 pe^T + pc b1^T) + mu (b1 pc^T + pe a1^T) + mu (pe . pc) (G + G^T) ]
+    cubic:     V [ (pe^T S2 pc) I + lambda a1 b1^T + mu b1 a1^T + mu (pe . pc) G G^T ]
+*/
+void StVKBatchedTetKernels::ComputeStiffnessBlocks(double * vertexDisplacements, int batchIndex, int terms, double * blocks)
+{
+  double wLinear = (terms & LINEAR) ? 1.0 : 0.0;
+  double wQuadratic = (terms & QUADRATIC) ? 1.0 : 0.0;
+  double wCubic = (terms & CUBIC) ? 1.0 : 0.0;
+
+  Batch * batch = &batches[batchIndex];
+
+  double G[3][3][W];
+  ComputeDisplacementGradient(batch, vertexDisplacements, G);
+
+  double S1[3][3][W], S2[3][3][W];
+  STVK_BATCH_STRESSES(batch, G, S1, S2);
+
+  // S = the stress of the identity term; H = the symmetric matrix multiplying mu (pe . pc)
+  double S[3][3][W], H[3][3][W];
+  for(int i=0; i<3; i++)
+    for(int j=0; j<3; j++)
+      for(int lane=0; lane<W; lane++)
+      {
+        S[i][j][lane] = wQuadratic * S1[i][j][lane] + wCubic * S2[i][j][lane];
+        H[i][j][lane] = wQuadratic * (G[i][j][lane] + G[j][i][lane]) + 
+          wCubic * (G[i][0][lane] * G[j][0][lane] + G[i][1][lane] * G[j][1][lane] + G[i][2][lane] * G[j][2][lane]);
+      }
+  for(int i=0; i<3; i++)
+    for(int lane=0; lane<W; lane++)
+      H[i][i][lane] += wLinear;
+
+  // Gp[c] = G Phig_c, SPhig[c] = S Phig_c
+  double Gp[4][3][W], SPhig[4][3][W];
+  for(int c=0; c<4; c++)
+    for(int i=0; i<3; i++)
+      for(int lane=0; lane<W; lane++)
+      {
+        Gp[c][i][lane] = G[i][0][lane] * batch->Phig[c][0][lane] + G[i][1][lane] * batch->Phig[c][1][lane] + G[i][2][lane] * batch->Phig[c][2][lane];
+        SPhig[c][i][lane] = S[i][0][lane] * batch->Phig[c][0][lane] + S[i][1][lane] * batch->Phig[c][1][lane] + S[i][2][lane] * batch->Phig[c][2][lane];
+      }
+
+  for(int c=0; c<4; c++)
+    for(int e=0; e<4; e++)
+    {
+      double * block = &blocks[W * 9 * (4 * c + e)];
+
+      double identity[W], pepc[W];
+      for(int lane=0; lane<W; lane++)
+      {
+        pepc[lane] = batch->Phig[e][0][lane] * batch->Phig[c][0][lane] + batch->Phig[e][1][lane] * batch->Phig[c][1][lane] + batch->Phig[e][2][lane] * batch->Phig[c][2][lane];
+        identity[lane] = batch->Phig[e][0][lane] * SPhig[c][0][lane] + batch->Phig[e][1][lane] * SPhig[c][1][lane] + batch->Phig[e][2][lane] * SPhig[c][2][lane];
+      }
+
+      for(int k=0; k<3; k++)
+        for(int l=0; l<3; l++)
+          for(int lane=0; lane<W; lane++)
+          {
+            double pck = batch->Phig[c][k][lane];
+            double pcl = batch->Phig[c][l][lane];
+            double pek = batch->Phig[e][k][lane];
+            double pel = batch->Phig[e][l][lane];
+            double a1k = Gp[c][k][lane];
+            double a1l = Gp[c][l][lane];
+            double b1k = Gp[e][k][lane];
+            double b1l = Gp[e][l][lane];
+
+            double lambdaTerm = wLinear * pck * pel + wQuadratic * (a1k * pel + pck * b1l) + wCubic * a1k * b1l;
+            double muTerm = wLinear * pek * pcl + wQuadratic * (b1k * pcl + pek * a1l) + wCubic * b1k * a1l + pepc[lane] * H[k][l][lane];
+            double value = batch->lambda[lane] * lambdaTerm + batch->mu[lane] * muTerm;
+            if (k == l)
+              value += identity[lane];
+
+            block[W * (3 * k + l) + lane] = batch->volume[lane] * value;
+          }
+    }
+}
+
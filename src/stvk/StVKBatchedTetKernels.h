@@ -0,0 +1,97 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "StVK" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC           *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _STVKBATCHEDTETKERNELS_H_
+#define _STVKBATCHEDTETKERNELS_H_
+
+/*
+  Batched (SIMD-friendly) evaluation of the St.Venant-Kirchhoff internal forces and tangent stiffness 
+  matrix blocks of a tetrahedral mesh. See StVKInternalForces::UseBatchedKernels.
+
+  The elements are grouped into batches of STVK_BATCH_WIDTH consecutive elements. The per-element data 
+  (basis function gradients, volume, Lame parameters, vertex indices) is stored in a structure-of-arrays 
+  layout, with the elements of a batch in consecutive memory locations. All computations run over the 
+  elements of a batch in the innermost loop, which the compiler vectorizes (e.g., with SSE2, AVX2 or AVX-512, 
+  depending on the compiler flags; a batch width of 8 fills an AVX-512 register with doubles). The element 
+  forces and stiffness blocks are then scattered into the global vector / matrix.
+
+  Instead of the A,B,C,D coefficients, the kernels use the equivalent deformation gradient form of StVK: 
+  with the displacement gradient G = sum_a u_a Phig_a^T, F = I + G, and the Green strain 
+  E = (G + G^T) / 2 + G^T G / 2, the force on vertex c is V (I + G) S Phig_c, where S = lambda tr(E) I + 2 mu E.
+  The terms of degree 1, 2, 3 in the displacements are exactly the linear, quadratic and cubic terms of
+  StVKInternalForces. The results agree with the A,B,C,D computation up to the floating-point roundoff.
+*/
+
+#include "volumetricMesh/tetMesh.h"
+
+#ifndef STVK_BATCH_WIDTH
+  #define STVK_BATCH_WIDTH 8
+#endif
+
+class StVKBatchedTetKernels
+{
+public:
+
+  // lambdaLame and muLame are the per-element Lame parameters
+  StVKBatchedTetKernels(TetMesh * tetMesh, double * lambdaLame, double * muLame);
+  virtual ~StVKBatchedTetKernels();
+
+  // selection of the terms (of degree 1, 2, 3 in the displacements) of the internal forces
+  typedef enum { LINEAR = 1, QUADRATIC = 2, CUBIC = 4, ALL = 7 } termsType;
+
+  // adds the selected terms of the internal forces of elements elementLow <= el < elementHigh
+  void AddForces(double * vertexDisplacements, double * forces, int elementLow, int elementHigh, int terms);
+
+  // computes the derivatives of the selected force terms, for the elements of the given batch:
+  // blocks[STVK_BATCH_WIDTH * (9 * (4 * c + e) + 3 * k + l) + i] is entry (k,l) of the 3x3 block d f_c / d u_e of element STVK_BATCH_WIDTH * batch + i
+  // (blocks must hold 144 * STVK_BATCH_WIDTH doubles)
+  void ComputeStiffnessBlocks(double * vertexDisplacements, int batch, int terms, double * blocks);
+
+  inline int GetNumBatches() { return numBatches; }
+
+protected:
+  int numElements;
+  int numBatches;
+
+  typedef struct
+  {
+    double Phig[4][3][STVK_BATCH_WIDTH]; // basis function gradients
+    double volume[STVK_BATCH_WIDTH];
+    double lambda[STVK_BATCH_WIDTH];
+    double mu[STVK_BATCH_WIDTH];
+    int vertices[4][STVK_BATCH_WIDTH];
+  } Batch;
+
+  Batch * batches;
+
+  // G = displacement gradient of the elements of the batch
+  void ComputeDisplacementGradient(Batch * batch, double * vertexDisplacements, double G[3][3][STVK_BATCH_WIDTH]);
+};
+
+#endif
+
@@ -50,6 +50,13 @@ public:
 
   virtual ~StVKCubeABCD() {}
 
+  virtual elementABCDType GetType() { return CUBE; }
+  // coefficients (the same for all the cubes), as flat arrays (A: 8x8 matrices, B: 8x8, C: 8x8x8 vectors, D: 8x8x8x8)
+  inline Mat3d * GetA() { return &A_[0][0]; }
+  inline double * GetB() { return &B_[0][0]; }
+  inline Vec3d * GetC() { return &C_[0][0][0]; }
+  inline double * GetD() { return &D_[0][0][0][0]; }
+
 protected:
   Mat3d A_[8][8];
   double B_[8][8];
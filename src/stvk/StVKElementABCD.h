@@ -52,6 +52,13 @@ public:
   virtual void ReleaseElementIterator(void * elementIterator);
   virtual void PrepareElement(int el, void * elementIterator); // must call each time before accessing an element
 
+  // the type of the coefficients; StVKInternalForces and StVKStiffnessMatrix use it to select, once per mesh, 
+  // a compile-time specialized kernel with inlined coefficient access (see StVKElementABCDInline.h)
+  // GENERIC (the default) uses the virtual functions above; a class derived from one of the specialized 
+  // classes that changes the coefficients must return GENERIC
+  typedef enum { GENERIC, TET, TETHIGHMEMORY, CUBE } elementABCDType;
+  virtual elementABCDType GetType() { return GENERIC; }
+
 protected:
 };
 
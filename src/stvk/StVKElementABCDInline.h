@@ -0,0 +1,218 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "StVK" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC           *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _STVKELEMENTABCDINLINE_H_
+#define _STVKELEMENTABCDINLINE_H_
+
+/*
+  Non-virtual views of the St.Venant-Kirchhoff A,B,C,D coefficients, used as template parameters 
+  of the element kernels in StVKInternalForces and StVKStiffnessMatrix.
+
+  Each view offers the same coefficient access as StVKElementABCD, but without the virtual calls and 
+  the element iterator, and with the number of element vertices known at compile time (which allows
+  the compiler to inline the coefficient computation, and to unroll the loops over the element vertices).
+  StVKElementABCDInline wraps an arbitrary StVKElementABCD (through the virtual functions); it is used 
+  for the coefficient classes without a specialized view.
+
+  The views compute the same values, with the same floating-point operations, as the virtual functions.
+  See also StVKElementABCD.h .
+*/
+
+#include "stvk/StVKElementABCD.h"
+#include "stvk/StVKTetABCD.h"
+#include "stvk/StVKTetHighMemoryABCD.h"
+#include "stvk/StVKCubeABCD.h"
+
+// any StVKElementABCD (virtual coefficient access)
+class StVKElementABCDInline
+{
+public:
+  StVKElementABCDInline(StVKElementABCD * precomputedIntegrals_, int numElementVertices_): precomputedIntegrals(precomputedIntegrals_), numElementVertices(numElementVertices_) { precomputedIntegrals->AllocateElementIterator(&elIter); }
+  ~StVKElementABCDInline() { precomputedIntegrals->ReleaseElementIterator(elIter); }
+
+  inline int GetNumElementVertices() { return numElementVertices; }
+  inline void PrepareElement(int el) { precomputedIntegrals->PrepareElement(el, elIter); }
+
+  inline Mat3d A(int i, int j) { return precomputedIntegrals->A(elIter, i, j); }
+  inline double B(int i, int j) { return precomputedIntegrals->B(elIter, i, j); }
+  inline Vec3d C(int i, int j, int k) { return precomputedIntegrals->C(elIter, i, j, k); }
+  inline double D(int i, int j, int k, int l) { return precomputedIntegrals->D(elIter, i, j, k, l); }
+
+protected:
+  StVKElementABCD * precomputedIntegrals;
+  int numElementVertices;
+  void * elIter;
+};
+
+// StVKTetABCD: the coefficients are computed from the basis function gradients
+class StVKTetABCDInline
+{
+public:
+  StVKTetABCDInline(StVKElementABCD * precomputedIntegrals, int): tetABCD((StVKTetABCD*) precomputedIntegrals) {}
+
+  inline int GetNumElementVertices() { return 4; }
+  inline void PrepareElement(int el) 
+  {
+    StVKTetABCD::elementData * elementData = tetABCD->GetElementData(el);
+    volume = elementData->volume;
+    for(int i=0; i<4; i++)
+      Phig[i] = elementData->Phig[i];
+    for(int i=0; i<4; i++)
+      for(int j=0; j<4; j++)
+      {
+        dots[i][j] = dot(Phig[i], Phig[j]);
+        volumeDots[i][j] = volume * dots[i][j];
+      }
+  }
+
+  inline Mat3d A(int i, int j) { return volume * tensorProduct(Phig[i], Phig[j]); }
+  inline double B(int i, int j) { return volumeDots[i][j]; }
+  inline Vec3d C(int i, int j, int k) { return volumeDots[j][k] * Phig[i]; }
+  inline double D(int i, int j, int k, int l) { return volumeDots[i][j] * dots[k][l]; }
+
+protected:
+  StVKTetABCD * tetABCD;
+  double volume;
+  Vec3d Phig[4];
+  double dots[4][4];
+  double volumeDots[4][4];
+};
+
+// StVKTetHighMemoryABCD: explicitly stored coefficients (compact storage, see StVKTetHighMemoryABCD.h)
+class StVKTetHighMemoryABCDInline
+{
+public:
+  StVKTetHighMemoryABCDInline(StVKElementABCD * precomputedIntegrals, int): tetABCD((StVKTetHighMemoryABCD*) precomputedIntegrals) 
+  {
+    cIndex = tetABCD->GetCIndex();
+    dIndex = tetABCD->GetDIndex();
+    singlePrecision = tetABCD->IsSinglePrecision();
+  }
+
+  inline int GetNumElementVertices() { return 4; }
+  inline void PrepareElement(int el) 
+  {
+    A_ = tetABCD->GetElementA(el);
+    B_ = tetABCD->GetElementB(el);
+    if (singlePrecision)
+    {
+      // convert the element's coefficients to double precision once, instead of at each access
+      float * CSinglePrecision = tetABCD->GetElementCSinglePrecision(el);
+      for(int i=0; i<40; i++)
+        CBuffer[i] = Vec3d(CSinglePrecision[3*i+0], CSinglePrecision[3*i+1], CSinglePrecision[3*i+2]);
+      float * DSinglePrecision = tetABCD->GetElementDSinglePrecision(el);
+      for(int i=0; i<55; i++)
+        DBuffer[i] = DSinglePrecision[i];
+      C_ = CBuffer;
+      D_ = DBuffer;
+    }
+    else
+    {
+      C_ = tetABCD->GetElementC(el);
+      D_ = tetABCD->GetElementD(el);
+    }
+  }
+
+  inline Mat3d A(int i, int j) { return (i <= j) ? A_[StVKTetHighMemoryABCD::PairIndex(i,j)] : trans(A_[StVKTetHighMemoryABCD::PairIndex(i,j)]); }
+  inline double B(int i, int j) { return B_[StVKTetHighMemoryABCD::PairIndex(i,j)]; }
+  inline const Vec3d & C(int i, int j, int k) { return C_[cIndex[16 * i + 4 * j + k]]; }
+  inline double D(int i, int j, int k, int l) { return D_[dIndex[64 * i + 16 * j + 4 * k + l]]; }
+
+protected:
+  StVKTetHighMemoryABCD * tetABCD;
+  const int * cIndex;
+  const int * dIndex;
+  bool singlePrecision;
+  Mat3d * A_;
+  double * B_;
+  Vec3d * C_;
+  double * D_;
+  Vec3d CBuffer[40];
+  double DBuffer[55];
+};
+
+// StVKCubeABCD: the same coefficients for all the elements
+class StVKCubeABCDInline
+{
+public:
+  StVKCubeABCDInline(StVKElementABCD * precomputedIntegrals, int) 
+  {
+    StVKCubeABCD * cubeABCD = (StVKCubeABCD*) precomputedIntegrals;
+    A_ = cubeABCD->GetA();
+    B_ = cubeABCD->GetB();
+    C_ = cubeABCD->GetC();
+    D_ = cubeABCD->GetD();
+  }
+
+  inline int GetNumElementVertices() { return 8; }
+  inline void PrepareElement(int) {}
+
+  inline const Mat3d & A(int i, int j) { return A_[8 * i + j]; }
+  inline double B(int i, int j) { return B_[8 * i + j]; }
+  inline const Vec3d & C(int i, int j, int k) { return C_[64 * i + 8 * j + k]; }
+  inline double D(int i, int j, int k, int l) { return D_[512 * i + 64 * j + 8 * k + l]; }
+
+protected:
+  Mat3d * A_;
+  double * B_;
+  Vec3d * C_;
+  double * D_;
+};
+
+// executes "kernelCall" with "abcd" set to the view matching elementABCDType (the type of precomputedIntegrals)
+#define STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, kernelCall)\
+  switch (elementABCDType)\
+  {\
+    case StVKElementABCD::TET:\
+    {\
+      StVKTetABCDInline abcd(precomputedIntegrals, numElementVertices);\
+      kernelCall;\
+    }\
+    break;\
+    case StVKElementABCD::TETHIGHMEMORY:\
+    {\
+      StVKTetHighMemoryABCDInline abcd(precomputedIntegrals, numElementVertices);\
+      kernelCall;\
+    }\
+    break;\
+    case StVKElementABCD::CUBE:\
+    {\
+      StVKCubeABCDInline abcd(precomputedIntegrals, numElementVertices);\
+      kernelCall;\
+    }\
+    break;\
+    default:\
+    {\
+      StVKElementABCDInline abcd(precomputedIntegrals, numElementVertices);\
+      kernelCall;\
+    }\
+    break;\
+  }
+
+#endif
+
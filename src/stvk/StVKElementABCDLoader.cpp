@@ -33,7 +33,7 @@
 #include "volumetricMesh/cubicMesh.h"
 #include "volumetricMesh/tetMesh.h"
 
-StVKElementABCD * StVKElementABCDLoader::load(VolumetricMesh * volumetricMesh, unsigned int loadingFlag)
+StVKElementABCD * StVKElementABCDLoader::load(VolumetricMesh * volumetricMesh, unsigned int loadingFlag, int numThreads)
 {
   if (volumetricMesh == NULL)
   {
@@ -62,8 +62,9 @@ StVKElementABCD * StVKElementABCDLoader::load(VolumetricMesh * volumetricMesh, u
     }
     else
     {
-      printf("Using the high-memory coefficient version.\n");
-      stVKElementABCD = new StVKTetHighMemoryABCD(tetMesh); 
+      bool singlePrecision = ((loadingFlag & 2) != 0);
+      printf("Using the high-memory coefficient version%s.\n", singlePrecision ? " (single precision)" : "");
+      stVKElementABCD = new StVKTetHighMemoryABCD(tetMesh, singlePrecision, NULL, numThreads); 
     }
   }
 
@@ -44,7 +44,9 @@ public:
   // loadingFlag: 
   //   0 : use the low-memory version (default)
   //   1 : use the high-memory version (only applies with tet meshes); with this setting, computation speeds will be higher, at the expense of more memory (however, difference is typically not large and speeds might even decrease with large meshes when running out of memory)
-  static StVKElementABCD * load(VolumetricMesh * volumetricMesh, unsigned int loadingFlag=0); 
+  //   3 : use the high-memory version, with the C and D coefficients stored in single precision (see StVKTetHighMemoryABCD.h)
+  // numThreads: number of threads used to precompute the coefficients (high-memory version only)
+  static StVKElementABCD * load(VolumetricMesh * volumetricMesh, unsigned int loadingFlag=0, int numThreads=1); 
 };
 
 #endif
@@ -28,6 +28,7 @@
 
 #include "stvk/StVKInternalForces.h"
 #include "volumetricMesh/volumetricMeshENuMaterial.h"
+#include "stvk/StVKElementABCDInline.h"
 
 StVKInternalForces::StVKInternalForces(VolumetricMesh * volumetricMesh_, StVKElementABCD * precomputedABCDIntegrals_, bool addGravity_, double g_): volumetricMesh(volumetricMesh_), precomputedIntegrals(precomputedABCDIntegrals_), gravityForce(NULL), addGravity(addGravity_), g(g_) 
 {
@@ -51,6 +52,8 @@ StVKInternalForces::StVKInternalForces(VolumetricMesh * volumetricMesh_, StVKEle
 
   buffer = (double*) malloc (sizeof(double) * 3 * volumetricMesh->getNumVertices());
   numElementVertices = volumetricMesh->getNumElementVertices();
+  elementABCDType = precomputedIntegrals->GetType();
+  batchedKernels = NULL;
   InitGravity();
 }
 
@@ -60,6 +63,25 @@ StVKInternalForces::~StVKInternalForces()
   free(buffer);
   free(lambdaLame);
   free(muLame);
+  delete(batchedKernels);
+}
+
+int StVKInternalForces::UseBatchedKernels(bool useBatchedKernels)
+{
+  delete(batchedKernels);
+  batchedKernels = NULL;
+
+  if (!useBatchedKernels)
+    return 0;
+
+  if (volumetricMesh->getElementType() != VolumetricMesh::TET)
+  {
+    printf("Error: batched StVK kernels are only available for tet meshes.\n");
+    return 1;
+  }
+
+  batchedKernels = new StVKBatchedTetKernels((TetMesh*) volumetricMesh, lambdaLame, muLame);
+  return 0;
 }
 
 void StVKInternalForces::InitGravity()
@@ -112,19 +134,38 @@ void StVKInternalForces::ComputeForces(double * vertexDisplacements, double * fo
   //PerformanceCounter forceCounter;
 
   ResetVector(forces);
-  AddLinearTermsContribution(vertexDisplacements, forces);
-  AddQuadraticTermsContribution(vertexDisplacements, forces);
-  AddCubicTermsContribution(vertexDisplacements, forces);
+  AddAllTermsContribution(vertexDisplacements, forces);
+  SubtractGravityForce(forces);
 
+  //forceCounter.StopCounter();
+  //printf("Internal forces: %G\n", forceCounter.GetElapsedTime());
+}
+
+void StVKInternalForces::SubtractGravityForce(double * forces)
+{
   if (addGravity)
   {
     int n = volumetricMesh->getNumVertices();
     for(int i=0; i<3*n; i++)
       forces[i] -= gravityForce[i];
   }
+}
 
-  //forceCounter.StopCounter();
-  //printf("Internal forces: %G\n", forceCounter.GetElapsedTime());
+void StVKInternalForces::AddAllTermsContribution(double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
+{
+  if (batchedKernels != NULL)
+  {
+    if (elementLow < 0)
+      elementLow = 0;
+    if (elementHigh < 0)
+      elementHigh = volumetricMesh->getNumElements();
+    batchedKernels->AddForces(vertexDisplacements, forces, elementLow, elementHigh, StVKBatchedTetKernels::ALL);
+    return;
+  }
+
+  AddLinearTermsContribution(vertexDisplacements, forces, elementLow, elementHigh);
+  AddQuadraticTermsContribution(vertexDisplacements, forces, elementLow, elementHigh);
+  AddCubicTermsContribution(vertexDisplacements, forces, elementLow, elementHigh);
 }
 
 void StVKInternalForces::AddLinearTermsContribution(double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
@@ -134,32 +175,42 @@ void StVKInternalForces::AddLinearTermsContribution(double * vertexDisplacements
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  if (batchedKernels != NULL)
+  {
+    batchedKernels->AddForces(vertexDisplacements, forces, elementLow, elementHigh, StVKBatchedTetKernels::LINEAR);
+    return;
+  }
+
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddLinearTermsKernel(abcd, vertexDisplacements, forces, elementLow, elementHigh));
+}
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+template<class ABCD>
+void StVKInternalForces::AddLinearTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
-    for(int ver=0; ver<numElementVertices; ver++)
+    abcd.PrepareElement(el);
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing force on vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing force on vertex c
     {
       // linear terms
-      for (int a=0; a<numElementVertices; a++) // over all vertices
+      for (int a=0; a<numElVertices; a++) // over all vertices
       {
         Vec3d qa(vertexDisplacements[3*vertices[a]+0],
                  vertexDisplacements[3*vertices[a]+1],
                  vertexDisplacements[3*vertices[a]+2]);
 
-        Vec3d force = lambda * (precomputedIntegrals->A(elIter,c,a) * qa) +
-                      (mu * precomputedIntegrals->B(elIter,a,c)) * qa +
-                      mu * (precomputedIntegrals->A(elIter,a,c) * qa);
+        Vec3d force = lambda * (abcd.A(c,a) * qa) +
+                      (mu * abcd.B(a,c)) * qa +
+                      mu * (abcd.A(a,c) * qa);
 
         forces[3*vertices[c]+0] += force[0];
         forces[3*vertices[c]+1] += force[1];
@@ -169,8 +220,6 @@ void StVKInternalForces::AddLinearTermsContribution(double * vertexDisplacements
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
 void StVKInternalForces::AddQuadraticTermsContribution(double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
@@ -180,25 +229,35 @@ void StVKInternalForces::AddQuadraticTermsContribution(double * vertexDisplaceme
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  if (batchedKernels != NULL)
+  {
+    batchedKernels->AddForces(vertexDisplacements, forces, elementLow, elementHigh, StVKBatchedTetKernels::QUADRATIC);
+    return;
+  }
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddQuadraticTermsKernel(abcd, vertexDisplacements, forces, elementLow, elementHigh));
+}
+
+template<class ABCD>
+void StVKInternalForces::AddQuadraticTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
-    for(int ver=0; ver<numElementVertices; ver++)
+    abcd.PrepareElement(el);
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing force on vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing force on vertex c
     {
       // quadratic terms
-      for (int a=0; a<numElementVertices; a++) // over all vertices
-        for(int b=0; b<numElementVertices; b++)
+      for (int a=0; a<numElVertices; a++) // over all vertices
+        for(int b=0; b<numElVertices; b++)
         {
 /*
           Vec3d force(0,0,0);
@@ -234,11 +293,11 @@ void StVKInternalForces::AddQuadraticTermsContribution(double * vertexDisplaceme
 
           double dotp = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2];
 
-          Vec3d forceTerm1 = 0.5 * lambda * dotp * precomputedIntegrals->C(elIter,c,a,b) +
-                             mu * dotp * precomputedIntegrals->C(elIter,a,b,c);
+          Vec3d forceTerm1 = 0.5 * lambda * dotp * abcd.C(c,a,b) +
+                             mu * dotp * abcd.C(a,b,c);
 
-          Vec3d C = lambda * precomputedIntegrals->C(elIter,a,b,c) +
-                    mu * (precomputedIntegrals->C(elIter,c,a,b) + precomputedIntegrals->C(elIter,b,a,c)); 
+          Vec3d C = lambda * abcd.C(a,b,c) +
+                    mu * (abcd.C(c,a,b) + abcd.C(b,a,c)); 
 
           double dotCqa = C[0] * qa[0] + C[1] * qa[1] + C[2] * qa[2];
 
@@ -250,8 +309,6 @@ void StVKInternalForces::AddQuadraticTermsContribution(double * vertexDisplaceme
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
 void StVKInternalForces::AddCubicTermsContribution(double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
@@ -261,32 +318,42 @@ void StVKInternalForces::AddCubicTermsContribution(double * vertexDisplacements,
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  if (batchedKernels != NULL)
+  {
+    batchedKernels->AddForces(vertexDisplacements, forces, elementLow, elementHigh, StVKBatchedTetKernels::CUBIC);
+    return;
+  }
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddCubicTermsKernel(abcd, vertexDisplacements, forces, elementLow, elementHigh));
+}
+
+template<class ABCD>
+void StVKInternalForces::AddCubicTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
+    abcd.PrepareElement(el);
 
-    for(int ver=0; ver<numElementVertices; ver++)
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing force on vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing force on vertex c
     {
       int vc = vertices[c];
       // cubic terms
-      for(int a=0; a<numElementVertices; a++) // over all vertices
+      for(int a=0; a<numElVertices; a++) // over all vertices
       {
         int va = vertices[a];
-        for(int b=0; b<numElementVertices; b++)
+        for(int b=0; b<numElVertices; b++)
         {
           int vb = vertices[b];
-          for(int d=0; d<numElementVertices; d++)
+          for(int d=0; d<numElVertices; d++)
           {
             int vd = vertices[d];
 /*
@@ -317,7 +384,7 @@ void StVKInternalForces::AddCubicTermsContribution(double * vertexDisplacements,
             double * force = &(forces[3*vc]);
 
             double dotp = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2]; 
-            double scalar = dotp * (0.5 * lambda * precomputedIntegrals->D(elIter,a,b,c,d) + mu * precomputedIntegrals->D(elIter,a,c,b,d) );
+            double scalar = dotp * (0.5 * lambda * abcd.D(a,b,c,d) + mu * abcd.D(a,c,b,d) );
 
             force[0] += scalar * qd[0];
             force[1] += scalar * qd[1];
@@ -329,8 +396,6 @@ void StVKInternalForces::AddCubicTermsContribution(double * vertexDisplacements,
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
 void StVKInternalForces::ResetVector(double * vec)
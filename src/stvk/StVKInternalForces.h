@@ -66,9 +66,10 @@ code essentially gives two separate simulators: full simulations (no reduction),
 and reduced simulations.
 
 With tet meshes, there is a choice between a low-memory implementation and a 
-high-memory implementation. With a few thousand tetrahedra (depending on the 
-size and availability of your memory), you can gain a small speedup (e.g. 1.5x) 
-by using a high-memory version (see StVKTetHighMemoryABCD.h).
+high-memory implementation. The high-memory version stores about 2 Kb per 
+tetrahedron (1.5 Kb in single precision), and can give a small speedup 
+(e.g. 1.2x-1.5x), as long as the coefficients fit into the memory 
+(see StVKTetHighMemoryABCD.h).
 
 Note: all matrices are stored in the column-major order (same format as in LAPACK).
 
@@ -76,6 +77,7 @@ Note: all matrices are stored in the column-major order (same format as in LAPAC
 
 #include "volumetricMesh/volumetricMesh.h"
 #include "stvk/StVKElementABCD.h"
+#include "stvk/StVKBatchedTetKernels.h"
 
 class StVKInternalForces
 {
@@ -105,6 +107,18 @@ public:
   void AddLinearTermsContribution(double * vertexDisplacements, double * forces, int elementLow=-1, int elementHigh=-1);
   void AddQuadraticTermsContribution(double * vertexDisplacements, double * forces, int elementLow=-1, int elementHigh=-1);
   void AddCubicTermsContribution(double * vertexDisplacements, double * forces, int elementLow=-1, int elementHigh=-1);
+  // adds all three terms (the same as the three routines above; with the batched kernels, in a single pass over the elements)
+  void AddAllTermsContribution(double * vertexDisplacements, double * forces, int elementLow=-1, int elementHigh=-1);
+  // subtracts the gravity force from "forces", if the gravity is enabled (see SetGravity)
+  void SubtractGravityForce(double * forces);
+
+  // batched (SIMD) kernels for tet meshes (see StVKBatchedTetKernels.h); default: disabled
+  // when enabled, the force routines of this class, and the stiffness matrix routines of StVKStiffnessMatrix 
+  // (and of the multi-threaded classes) use the batched kernels instead of the A,B,C,D coefficients; 
+  // the results agree with the default kernels up to the floating-point roundoff
+  // returns 0 on success, and 1 if the mesh is not a tet mesh
+  int UseBatchedKernels(bool useBatchedKernels);
+  inline StVKBatchedTetKernels * GetBatchedKernels() { return batchedKernels; }
   
 protected:
   VolumetricMesh * volumetricMesh;
@@ -122,6 +136,14 @@ protected:
 
   double * lambdaLame;
   double * muLame;
+
+  // the element kernels, one instantiation for each coefficient view in StVKElementABCDInline.h;
+  // the Add*TermsContribution routines select the instantiation matching elementABCDType
+  StVKElementABCD::elementABCDType elementABCDType;
+  StVKBatchedTetKernels * batchedKernels;
+  template<class ABCD> void AddLinearTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh);
+  template<class ABCD> void AddQuadraticTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh);
+  template<class ABCD> void AddCubicTermsKernel(ABCD & abcd, double * vertexDisplacements, double * forces, int elementLow, int elementHigh);
 };
 
 #endif
@@ -105,9 +105,7 @@ void * StVKInternalForcesMT_WorkerThread(void * arg)
 
   if (threadArgp->computationTarget == 0)
   {
-    stVKInternalForcesMT->AddLinearTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
-    stVKInternalForcesMT->AddQuadraticTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
-    stVKInternalForcesMT->AddCubicTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
+    stVKInternalForcesMT->AddAllTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
   }
 
   if (threadArgp->computationTarget == 1)
@@ -0,0 +1,504 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "StVK" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC           *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "StVKReducedInternalForces.h"
+
+/*
+  The linear, quadratic and cubic terms f1, f2, f3 of the StVK internal forces are homogeneous
+  polynomials of degree 1, 2, 3 in the displacements. Their coefficients in the reduced coordinates
+  are obtained by polarization, with a = U_j, b = U_k, c = U_l (basis vectors):
+
+    linear:    coefficient of q_j           = f1(a)
+    quadratic: coefficient of q_j^2         = f2(a)
+               coefficient of q_j q_k       = f2(a+b) - f2(a) - f2(b)
+    cubic:     coefficient of q_j^3         = f3(a)
+               coefficient of q_j^2 q_k     = (f3(a+b) - f3(a-b)) / 2 - f3(b)
+               coefficient of q_j q_k^2     = (f3(a+b) + f3(a-b)) / 2 - f3(a)
+               coefficient of q_j q_k q_l   = f3(a+b+c) - f3(a+b) - f3(a+c) - f3(b+c) + f3(a) + f3(b) + f3(c)
+
+  (all projected onto the basis with U^T). Phase 0 evaluates the terms on the single basis vectors
+  and the pairs, and phase 1 assembles the coefficients (evaluating f3 on the triples).
+  The tasks are distributed among the threads in a round-robin fashion.
+*/
+
+struct StVKReducedInternalForces::PrecomputationData
+{
+  StVKReducedInternalForces * object;
+  StVKInternalForces * stVKInternalForces;
+  double * U;
+  int n3;
+  int phase;
+  int rank;
+  int numThreads;
+
+  // projected terms: f2(a), f3(a) for the single basis vectors; f2(a+b), f3(a+b), f3(a-b) for the pairs (j < k)
+  double * singles2;
+  double * singles3;
+  double * pairs2;
+  double * pairs3Plus;
+  double * pairs3Minus;
+};
+
+// index of the combination j <= k in the lexicographic order
+static inline int StVKReducedInternalForces_PairIndex(int r, int j, int k)
+{
+  return j * r - j * (j - 1) / 2 + (k - j);
+}
+
+// result = U^T * f
+static void StVKReducedInternalForces_Project(int n3, int r, double * U, double * f, double * result)
+{
+  for(int i=0; i<r; i++)
+  {
+    double * Ui = &U[(size_t)n3 * i];
+    double value = 0.0;
+    for(int v=0; v<n3; v++)
+      value += Ui[v] * f[v];
+    result[i] = value;
+  }
+}
+
+void * StVKReducedInternalForces::PrecomputationThread(void * arg)
+{
+  PrecomputationData * data = (PrecomputationData*) arg;
+  StVKReducedInternalForces * object = data->object;
+  StVKInternalForces * stVKInternalForces = data->stVKInternalForces;
+  int r = object->r;
+  int n3 = data->n3;
+  double * U = data->U;
+
+  double * u = (double*) malloc (sizeof(double) * n3);
+  double * f = (double*) malloc (sizeof(double) * n3);
+
+  int task = 0;
+  if (data->phase == 0)
+  {
+    for(int j=0; j<r; j++)
+      for(int k=j; k<r; k++, task++)
+      {
+        if (task % data->numThreads != data->rank)
+          continue;
+
+        double * Uj = &U[(size_t)n3 * j];
+        double * Uk = &U[(size_t)n3 * k];
+        int pair = StVKReducedInternalForces_PairIndex(r, j, k);
+
+        if (j == k)
+        {
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddLinearTermsContribution(Uj, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &object->linearCoef[r * j]);
+
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddQuadraticTermsContribution(Uj, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &data->singles2[r * j]);
+
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddCubicTermsContribution(Uj, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &data->singles3[r * j]);
+        }
+        else
+        {
+          for(int v=0; v<n3; v++)
+            u[v] = Uj[v] + Uk[v];
+
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddQuadraticTermsContribution(u, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &data->pairs2[r * pair]);
+
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddCubicTermsContribution(u, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &data->pairs3Plus[r * pair]);
+
+          for(int v=0; v<n3; v++)
+            u[v] = Uj[v] - Uk[v];
+
+          memset(f, 0, sizeof(double) * n3);
+          stVKInternalForces->AddCubicTermsContribution(u, f);
+          StVKReducedInternalForces_Project(n3, r, U, f, &data->pairs3Minus[r * pair]);
+        }
+      }
+  }
+  else
+  {
+    // quadratic coefficients
+    for(int j=0; j<r; j++)
+      for(int k=j; k<r; k++, task++)
+      {
+        if (task % data->numThreads != data->rank)
+          continue;
+
+        int pair = StVKReducedInternalForces_PairIndex(r, j, k);
+        double * coef = &object->quadraticCoef[r * pair];
+        if (j == k)
+          memcpy(coef, &data->singles2[r * j], sizeof(double) * r);
+        else
+        {
+          for(int i=0; i<r; i++)
+            coef[i] = data->pairs2[r * pair + i] - data->singles2[r * j + i] - data->singles2[r * k + i];
+        }
+      }
+
+    // cubic coefficients
+    double * coef = object->cubicCoef;
+    for(int j=0; j<r; j++)
+      for(int k=j; k<r; k++)
+        for(int l=k; l<r; l++, task++, coef += r)
+        {
+          if (task % data->numThreads != data->rank)
+            continue;
+
+          if ((j == k) && (k == l))
+            memcpy(coef, &data->singles3[r * j], sizeof(double) * r);
+          else if (j == k)
+          {
+            // q_j^2 q_l
+            int pair = StVKReducedInternalForces_PairIndex(r, j, l);
+            for(int i=0; i<r; i++)
+              coef[i] = 0.5 * (data->pairs3Plus[r * pair + i] - data->pairs3Minus[r * pair + i]) - data->singles3[r * l + i];
+          }
+          else if (k == l)
+          {
+            // q_j q_k^2
+            int pair = StVKReducedInternalForces_PairIndex(r, j, k);
+            for(int i=0; i<r; i++)
+              coef[i] = 0.5 * (data->pairs3Plus[r * pair + i] + data->pairs3Minus[r * pair + i]) - data->singles3[r * j + i];
+          }
+          else
+          {
+            // q_j q_k q_l
+            double * Uj = &U[(size_t)n3 * j];
+            double * Uk = &U[(size_t)n3 * k];
+            double * Ul = &U[(size_t)n3 * l];
+            for(int v=0; v<n3; v++)
+              u[v] = Uj[v] + Uk[v] + Ul[v];
+
+            memset(f, 0, sizeof(double) * n3);
+            stVKInternalForces->AddCubicTermsContribution(u, f);
+            StVKReducedInternalForces_Project(n3, r, U, f, coef);
+
+            double * jk = &data->pairs3Plus[r * StVKReducedInternalForces_PairIndex(r, j, k)];
+            double * jl = &data->pairs3Plus[r * StVKReducedInternalForces_PairIndex(r, j, l)];
+            double * kl = &data->pairs3Plus[r * StVKReducedInternalForces_PairIndex(r, k, l)];
+            for(int i=0; i<r; i++)
+              coef[i] += - jk[i] - jl[i] - kl[i] + data->singles3[r * j + i] + data->singles3[r * k + i] + data->singles3[r * l + i];
+          }
+        }
+  }
+
+  free(f);
+  free(u);
+
+  return NULL;
+}
+
+StVKReducedInternalForces::StVKReducedInternalForces(int r_, double * U, StVKInternalForces * stVKInternalForces, int numThreads): r(r_)
+{
+  Allocate();
+
+  if (numThreads < 1)
+    numThreads = 1;
+
+  int n3 = 3 * stVKInternalForces->GetVolumetricMesh()->getNumVertices();
+
+  double * singles2 = (double*) malloc (sizeof(double) * r * r);
+  double * singles3 = (double*) malloc (sizeof(double) * r * r);
+  double * pairs2 = (double*) calloc (numQuadraticTerms * r, sizeof(double));
+  double * pairs3Plus = (double*) calloc (numQuadraticTerms * r, sizeof(double));
+  double * pairs3Minus = (double*) calloc (numQuadraticTerms * r, sizeof(double));
+
+  PrecomputationData * threadData = (PrecomputationData*) malloc (sizeof(PrecomputationData) * numThreads);
+  pthread_t * tid = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
+
+  for(int phase=0; phase<2; phase++)
+  {
+    for(int rank=0; rank<numThreads; rank++)
+    {
+      PrecomputationData * data = &threadData[rank];
+      data->object = this;
+      data->stVKInternalForces = stVKInternalForces;
+      data->U = U;
+      data->n3 = n3;
+      data->phase = phase;
+      data->rank = rank;
+      data->numThreads = numThreads;
+      data->singles2 = singles2;
+      data->singles3 = singles3;
+      data->pairs2 = pairs2;
+      data->pairs3Plus = pairs3Plus;
+      data->pairs3Minus = pairs3Minus;
+    }
+
+    if (numThreads == 1)
+      PrecomputationThread(&threadData[0]);
+    else
+    {
+      for(int rank=0; rank<numThreads; rank++)
+      {
+        if (pthread_create(&tid[rank], NULL, StVKReducedInternalForces::PrecomputationThread, &threadData[rank]) != 0)
+        {
+          printf("Error: unable to launch thread %d.\n", rank);
+          exit(1);
+        }
+      }
+
+      for(int rank=0; rank<numThreads; rank++)
+      {
+        if (pthread_join(tid[rank], NULL) != 0)
+        {
+          printf("Error: unable to join thread %d.\n", rank);
+          exit(1);
+        }
+      }
+    }
+  }
+
+  free(tid);
+  free(threadData);
+  free(pairs3Minus);
+  free(pairs3Plus);
+  free(pairs2);
+  free(singles3);
+  free(singles2);
+}
+
+StVKReducedInternalForces::StVKReducedInternalForces(const char * filename)
+{
+  r = 0;
+  linearCoef = quadraticCoef = cubicCoef = NULL;
+
+  FILE * fin = fopen(filename, "rb");
+  if (!fin)
+  {
+    printf("Error: could not open reduced StVK coefficient file %s.\n", filename);
+    return;
+  }
+
+  int rFile;
+  if ((fread(&rFile, sizeof(int), 1, fin) != 1) || (rFile <= 0))
+  {
+    printf("Error: invalid reduced StVK coefficient file %s.\n", filename);
+    fclose(fin);
+    return;
+  }
+
+  r = rFile;
+  Allocate();
+
+  size_t numLinear = (size_t) r * r;
+  size_t numQuadratic = (size_t) numQuadraticTerms * r;
+  size_t numCubic = (size_t) numCubicTerms * r;
+  if ((fread(linearCoef, sizeof(double), numLinear, fin) != numLinear) ||
+      (fread(quadraticCoef, sizeof(double), numQuadratic, fin) != numQuadratic) ||
+      (fread(cubicCoef, sizeof(double), numCubic, fin) != numCubic))
+  {
+    printf("Error: reduced StVK coefficient file %s is truncated.\n", filename);
+    free(linearCoef);
+    free(quadraticCoef);
+    free(cubicCoef);
+    linearCoef = quadraticCoef = cubicCoef = NULL;
+    r = 0;
+  }
+
+  fclose(fin);
+}
+
+StVKReducedInternalForces::~StVKReducedInternalForces()
+{
+  free(linearCoef);
+  free(quadraticCoef);
+  free(cubicCoef);
+}
+
+void StVKReducedInternalForces::Allocate()
+{
+  numQuadraticTerms = r * (r + 1) / 2;
+  numCubicTerms = r * (r + 1) * (r + 2) / 6;
+  linearCoef = (double*) calloc ((size_t) r * r, sizeof(double));
+  quadraticCoef = (double*) calloc ((size_t) numQuadraticTerms * r, sizeof(double));
+  cubicCoef = (double*) calloc ((size_t) numCubicTerms * r, sizeof(double));
+}
+
+int StVKReducedInternalForces::Save(const char * filename)
+{
+  FILE * fout = fopen(filename, "wb");
+  if (!fout)
+  {
+    printf("Error: could not write reduced StVK coefficient file %s.\n", filename);
+    return 1;
+  }
+
+  size_t numLinear = (size_t) r * r;
+  size_t numQuadratic = (size_t) numQuadraticTerms * r;
+  size_t numCubic = (size_t) numCubicTerms * r;
+  int fail = (fwrite(&r, sizeof(int), 1, fout) != 1) ||
+             (fwrite(linearCoef, sizeof(double), numLinear, fout) != numLinear) ||
+             (fwrite(quadraticCoef, sizeof(double), numQuadratic, fout) != numQuadratic) ||
+             (fwrite(cubicCoef, sizeof(double), numCubic, fout) != numCubic);
+  fclose(fout);
+
+  if (fail)
+  {
+    printf("Error: could not write reduced StVK coefficient file %s.\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+void StVKReducedInternalForces::ComputeForces(double * q, double * forces)
+{
+  ComputeForceAndStiffnessMatrix(q, forces, NULL);
+}
+
+void StVKReducedInternalForces::ComputeStiffnessMatrix(double * q, double * stiffnessMatrix)
+{
+  ComputeForceAndStiffnessMatrix(q, NULL, stiffnessMatrix);
+}
+
+// forces or stiffnessMatrix can be NULL
+// the derivative of the monomial q_j q_k q_l with respect to q_j, q_k, q_l is q_k q_l, q_j q_l, q_j q_k;
+// adding these to columns j, k, l of the stiffness matrix is correct also when some of the indices coincide
+void StVKReducedInternalForces::ComputeForceAndStiffnessMatrix(double * q, double * forces, double * stiffnessMatrix)
+{
+  // linear terms
+  if (forces != NULL)
+  {
+    memset(forces, 0, sizeof(double) * r);
+    for(int j=0; j<r; j++)
+    {
+      double * coef = &linearCoef[r * j];
+      for(int i=0; i<r; i++)
+        forces[i] += coef[i] * q[j];
+    }
+  }
+
+  if (stiffnessMatrix != NULL)
+    memcpy(stiffnessMatrix, linearCoef, sizeof(double) * r * r);
+
+  // quadratic terms
+  double * coef = quadraticCoef;
+  for(int j=0; j<r; j++)
+    for(int k=j; k<r; k++, coef += r)
+    {
+      if (forces != NULL)
+      {
+        double monomial = q[j] * q[k];
+        for(int i=0; i<r; i++)
+          forces[i] += monomial * coef[i];
+      }
+
+      if (stiffnessMatrix != NULL)
+      {
+        double * Kj = &stiffnessMatrix[r * j];
+        double * Kk = &stiffnessMatrix[r * k];
+        double qj = q[j];
+        double qk = q[k];
+        for(int i=0; i<r; i++)
+        {
+          Kj[i] += qk * coef[i];
+          Kk[i] += qj * coef[i];
+        }
+      }
+    }
+
+  // cubic terms
+  coef = cubicCoef;
+  for(int j=0; j<r; j++)
+    for(int k=j; k<r; k++)
+    {
+      double qjqk = q[j] * q[k];
+      for(int l=k; l<r; l++, coef += r)
+      {
+        if (forces != NULL)
+        {
+          double monomial = qjqk * q[l];
+          for(int i=0; i<r; i++)
+            forces[i] += monomial * coef[i];
+        }
+
+        if (stiffnessMatrix != NULL)
+        {
+          double * Kj = &stiffnessMatrix[r * j];
+          double * Kk = &stiffnessMatrix[r * k];
+          double * Kl = &stiffnessMatrix[r * l];
+          double qkql = q[k] * q[l];
+          double qjql = q[j] * q[l];
+          for(int i=0; i<r; i++)
+          {
+            Kj[i] += qkql * coef[i];
+            Kk[i] += qjql * coef[i];
+            Kl[i] += qjqk * coef[i];
+          }
+        }
+      }
+    }
+}
+
+// the terms of degree d of the internal forces contribute q^T f_d(q) / (d+1) to the energy
+double StVKReducedInternalForces::ComputeEnergy(double * q)
+{
+  double energy = 0.0;
+
+  for(int j=0; j<r; j++)
+  {
+    double * coef = &linearCoef[r * j];
+    double dot = 0.0;
+    for(int i=0; i<r; i++)
+      dot += q[i] * coef[i];
+    energy += 0.5 * dot * q[j];
+  }
+
+  double oneThird = 1.0 / 3;
+  double * coef = quadraticCoef;
+  for(int j=0; j<r; j++)
+    for(int k=j; k<r; k++, coef += r)
+    {
+      double dot = 0.0;
+      for(int i=0; i<r; i++)
+        dot += q[i] * coef[i];
+      energy += oneThird * dot * q[j] * q[k];
+    }
+
+  double oneQuarter = 1.0 / 4;
+  coef = cubicCoef;
+  for(int j=0; j<r; j++)
+    for(int k=j; k<r; k++)
+      for(int l=k; l<r; l++, coef += r)
+      {
+        double dot = 0.0;
+        for(int i=0; i<r; i++)
+          dot += q[i] * coef[i];
+        energy += oneQuarter * dot * q[j] * q[k] * q[l];
+      }
+
+  return energy;
+}
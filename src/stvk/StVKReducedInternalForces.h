@@ -0,0 +1,107 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "StVK" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC           *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _STVKREDUCEDINTERNALFORCES_H_
+#define _STVKREDUCEDINTERNALFORCES_H_
+
+/*
+  Reduced StVK internal forces (see [1] in integrator/integratorBase.h).
+
+  Given a basis U (a 3n x r matrix, column-major, e.g., modes loaded with ReadModesFromDisk or
+  ReadMatrixFromDisk from the "matrix" library), the reduced internal forces
+
+    fred(q) = U^T f(U q),
+
+  where f are the StVK internal forces, are a cubic polynomial in the reduced coordinates q.
+  This class precomputes the coefficients of this polynomial (once; the cost is proportional
+  to the size of the mesh), after which the reduced internal forces and the reduced tangent
+  stiffness matrix Kred(q) = d fred / d q = U^T K(U q) U can be evaluated in O(r^4) time,
+  independently of the size of the mesh.
+
+  The coefficients are computed by evaluating the linear, quadratic and cubic terms of the
+  StVK internal forces (StVKInternalForces::Add*TermsContribution) on the basis vectors and
+  their sums, and projecting the results onto the basis. The precomputation can be multi-threaded.
+
+  The reduced internal forces are returned with the same sign as in StVKInternalForces, i.e.,
+  they are the left-hand side term in M * q'' + fred(q) = fext. Gravity is not included
+  (add U^T * gravity to the reduced external forces instead).
+*/
+
+#include "stvk/StVKInternalForces.h"
+
+class StVKReducedInternalForces
+{
+public:
+
+  // U is a 3n x r matrix (column-major), where n is the number of vertices of the mesh of stVKInternalForces
+  // numThreads: number of threads used for the precomputation
+  StVKReducedInternalForces(int r, double * U, StVKInternalForces * stVKInternalForces, int numThreads=1);
+  // loads previously saved coefficients (see Save); on failure, an error is printed, and Getr() returns 0
+  StVKReducedInternalForces(const char * filename);
+  virtual ~StVKReducedInternalForces();
+
+  inline int Getr() { return r; }
+
+  // saves the polynomial coefficients to a binary file; returns 0 on success
+  int Save(const char * filename);
+
+  // reduced internal forces (a vector of length r)
+  void ComputeForces(double * q, double * forces);
+  // reduced tangent stiffness matrix (r x r, column-major)
+  void ComputeStiffnessMatrix(double * q, double * stiffnessMatrix);
+  // both of the above, in a single pass over the coefficients
+  void ComputeForceAndStiffnessMatrix(double * q, double * forces, double * stiffnessMatrix);
+  // elastic strain energy of the reduced deformation U q
+  double ComputeEnergy(double * q);
+
+  // the polynomial: fred(q) = linearCoef * q + sum_{j<=k} quadraticCoef_{jk} q_j q_k + sum_{j<=k<=l} cubicCoef_{jkl} q_j q_k q_l
+  // linearCoef is an r x r matrix (column-major), quadraticCoef and cubicCoef are arrays of r-vectors, one for each
+  // combination of indices (j<=k, resp. j<=k<=l), in lexicographic order
+  inline double * GetLinearCoef() { return linearCoef; }
+  inline double * GetQuadraticCoef() { return quadraticCoef; }
+  inline double * GetCubicCoef() { return cubicCoef; }
+  inline int GetNumQuadraticTerms() { return numQuadraticTerms; }
+  inline int GetNumCubicTerms() { return numCubicTerms; }
+
+protected:
+  int r;
+  int numQuadraticTerms; // r (r+1) / 2
+  int numCubicTerms; // r (r+1) (r+2) / 6
+
+  double * linearCoef;
+  double * quadraticCoef;
+  double * cubicCoef;
+
+  void Allocate();
+
+  // precomputation
+  struct PrecomputationData;
+  static void * PrecomputationThread(void * arg);
+};
+
+#endif
@@ -28,12 +28,22 @@
 
 #include "stvk/StVKStiffnessMatrix.h"
 #include "volumetricMesh/volumetricMeshENuMaterial.h"
+#include "stvk/StVKElementABCDInline.h"
+#include "volumetricMesh/volumetricMeshThreads.h"
+#include "volumetricMesh/generateStiffnessMatrixTopology.h"
 
-StVKStiffnessMatrix::StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForces)
+struct StVKStiffnessMatrix::AccelerationIndicesData
+{
+  StVKStiffnessMatrix * stVKStiffnessMatrix;
+  SparseMatrix * stiffnessMatrixTopology;
+};
+
+StVKStiffnessMatrix::StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForces_, VolumetricMeshCache * cache_, int numThreads): stVKInternalForces(stVKInternalForces_), cache(cache_)
 {
   precomputedIntegrals = stVKInternalForces->GetPrecomputedIntegrals();
   volumetricMesh = stVKInternalForces->GetVolumetricMesh();
   numElementVertices = volumetricMesh->getNumElementVertices();
+  elementABCDType = precomputedIntegrals->GetType();
   int numElements = volumetricMesh->getNumElements();
 
   lambdaLame = (double*) malloc (sizeof(double) * numElements);
@@ -57,11 +67,27 @@ StVKStiffnessMatrix::StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForce
   SparseMatrix * stiffnessMatrixTopology;
   GetStiffnessMatrixTopology(&stiffnessMatrixTopology);
 
-  // build acceleration indices
+  // build acceleration indices (in parallel; the elements are independent)
   row_ = (int**) malloc (sizeof(int*) * numElements);
   column_ = (int**) malloc (sizeof(int*) * numElements);
+  struct AccelerationIndicesData data = { this, stiffnessMatrixTopology };
+  VolumetricMeshThreads::RunOnElements(numElements, numThreads, BuildAccelerationIndices, &data);
+
+  delete(stiffnessMatrixTopology);
 
-  for (int el=0; el < numElements; el++)
+}
+
+void StVKStiffnessMatrix::BuildAccelerationIndices(void * data_, int startElement, int endElement)
+{
+  struct AccelerationIndicesData * data = (struct AccelerationIndicesData*) data_;
+  StVKStiffnessMatrix * stVKStiffnessMatrix = data->stVKStiffnessMatrix;
+  SparseMatrix * stiffnessMatrixTopology = data->stiffnessMatrixTopology;
+  VolumetricMesh * volumetricMesh = stVKStiffnessMatrix->volumetricMesh;
+  int numElementVertices = stVKStiffnessMatrix->numElementVertices;
+  int ** row_ = stVKStiffnessMatrix->row_;
+  int ** column_ = stVKStiffnessMatrix->column_;
+
+  for (int el=startElement; el < endElement; el++)
   {
     row_[el] = (int*) malloc (sizeof(int) * numElementVertices);
     column_[el] = (int*) malloc (sizeof(int) * numElementVertices * numElementVertices);
@@ -75,45 +101,21 @@ StVKStiffnessMatrix::StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForce
         column_[el][numElementVertices * i + j] =
           stiffnessMatrixTopology->GetInverseIndex(3*row_[el][i],3*row_[el][j]) / 3;
   }
-
-  delete(stiffnessMatrixTopology);
-
 }
 
 void StVKStiffnessMatrix::GetStiffnessMatrixTopology(SparseMatrix ** stiffnessMatrixTopology)
 {
-  int numVertices = volumetricMesh->getNumVertices();
-
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
-
-  // build skeleton of sparseMatrix
-  SparseMatrixOutline * emptyMatrix = new SparseMatrixOutline(3 * numVertices);
-  for (int el=0; el < volumetricMesh->getNumElements(); el++)
+  if (cache != NULL)
   {
-    //if(el % 100 == 1)
-      //printf(".");
-
-    for(int ver=0; ver<numElementVertices; ver++)
-      vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
-
-    for (int i=0; i<numElementVertices; i++)
-      for (int j=0; j<numElementVertices; j++)
-      {
-        for(int k=0; k<3; k++)
-          for(int l=0; l<3; l++)
-          {
-            // only add the entry if both vertices are free (non-fixed)
-            // the corresponding elt is in row 3*i+k, column 3*j+l
-            emptyMatrix->AddEntry( 3*vertices[i]+k, 3*vertices[j]+l, 0.0 );
-          }
-      }
+    *stiffnessMatrixTopology = cache->LoadSparseMatrixTopology("stiffnessMatrixTopology");
+    if (*stiffnessMatrixTopology != NULL)
+      return;
   }
-  //printf("\n");
 
-  *stiffnessMatrixTopology = new SparseMatrix(emptyMatrix);
-  delete(emptyMatrix);
+  *stiffnessMatrixTopology = GenerateStiffnessMatrixTopology::Generate(volumetricMesh);
 
-  free(vertices);
+  if (cache != NULL)
+    cache->SaveSparseMatrixTopology("stiffnessMatrixTopology", *stiffnessMatrixTopology);
 }
 
 StVKStiffnessMatrix::~StVKStiffnessMatrix()
@@ -138,14 +140,227 @@ void StVKStiffnessMatrix::ComputeStiffnessMatrix(double * vertexDisplacements, S
   //PerformanceCounter stiffnessCounter;
   sparseMatrix->ResetToZero();
 
-  AddLinearTermsContribution(vertexDisplacements, sparseMatrix);
-  AddQuadraticTermsContribution(vertexDisplacements, sparseMatrix);
-  AddCubicTermsContribution(vertexDisplacements, sparseMatrix);
+  AddAllTermsContribution(vertexDisplacements, sparseMatrix);
 
   //stiffnessCounter.StopCounter();
   //printf("Stiffness matrix: %G\n", stiffnessCounter.GetElapsedTime());
 }
 
+void StVKStiffnessMatrix::ComputeForceAndStiffnessMatrix(double * vertexDisplacements, double * internalForces, SparseMatrix * sparseMatrix)
+{
+  memset(internalForces, 0, sizeof(double) * 3 * volumetricMesh->getNumVertices());
+  sparseMatrix->ResetToZero();
+
+  AddForceAndStiffnessMatrixContribution(vertexDisplacements, internalForces, sparseMatrix);
+  stVKInternalForces->SubtractGravityForce(internalForces);
+}
+
+void StVKStiffnessMatrix::AddForceAndStiffnessMatrixContribution(double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  if (elementLow < 0)
+    elementLow = 0;
+  if (elementHigh < 0)
+    elementHigh = volumetricMesh->getNumElements();
+
+  StVKBatchedTetKernels * batchedKernels = stVKInternalForces->GetBatchedKernels();
+  if (batchedKernels != NULL)
+  {
+    AddBatchedTermsContribution(batchedKernels, vertexDisplacements, forces, sparseMatrix, elementLow, elementHigh, StVKBatchedTetKernels::ALL);
+    return;
+  }
+
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddForceAndStiffnessMatrixKernel(abcd, vertexDisplacements, forces, sparseMatrix, elementLow, elementHigh));
+}
+
+/*
+  The linear, quadratic and cubic terms of the internal forces are homogeneous polynomials of degree 1, 2, 3 in the displacements,
+  and the corresponding stiffness matrix terms are their gradients. By Euler's theorem on homogeneous functions,
+  f = K_linear * u + 1/2 * K_quadratic(u) * u + 1/3 * K_cubic(u) * u.
+  Therefore, the element forces are obtained from the 3x3 element stiffness blocks, at the cost of a block-vector product.
+  In addition, the dot products and tensor products of the vertex displacements are computed once per element.
+*/
+template<class ABCD>
+void StVKStiffnessMatrix::AddForceAndStiffnessMatrixKernel(ABCD & abcd, double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  double * q = (double*) malloc (sizeof(double) * 3 * numElVertices); // element vertex displacements
+  double * qDot = (double*) malloc (sizeof(double) * numElVertices * numElVertices); // qa dot qb
+  double * qTensor = (double*) malloc (sizeof(double) * 9 * numElVertices * numElVertices); // qa tensor qb
+
+  double ** dataHandle = sparseMatrix->GetDataHandle();
+  const double oneThird = 1.0 / 3;
+
+  for(int el=elementLow; el < elementHigh; el++)
+  {
+    abcd.PrepareElement(el);
+    int * row = row_[el];
+    int * column = column_[el];
+
+    for(int ver=0; ver<numElVertices; ver++)
+    {
+      double * qver = &(vertexDisplacements[3*row[ver]]);
+      q[3*ver+0] = qver[0];
+      q[3*ver+1] = qver[1];
+      q[3*ver+2] = qver[2];
+    }
+
+    for(int a=0; a<numElVertices; a++)
+      for(int b=0; b<numElVertices; b++)
+      {
+        double * qa = &q[3*a];
+        double * qb = &q[3*b];
+        qDot[numElVertices*a+b] = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2];
+        double * tensor = &qTensor[9*(numElVertices*a+b)];
+        for(int k=0; k<3; k++)
+          for(int l=0; l<3; l++)
+            tensor[3*k+l] = qa[k] * qb[l];
+      }
+
+    double lambda = lambdaLame[el]; 
+    double mu = muLame[el];
+
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing row of vertex c, and force on vertex c
+    {
+      int rowc = 3*row[c];
+      int c8 = numElVertices*c;
+      double force[3] = { 0.0, 0.0, 0.0 };
+      for (int e=0; e<numElVertices; e++) // compute contribution to block (c,e) of the stiffness matrix
+      {
+        // linear terms
+        Mat3d linearMatrix(1.0);
+        linearMatrix *= mu * abcd.B(e,c);
+        linearMatrix += lambda * abcd.A(c,e) +
+                        mu * abcd.A(e,c);
+
+        // quadratic terms
+        double quadraticMatrix[9];
+        memset(quadraticMatrix, 0, sizeof(double) * 9);
+        for(int a=0; a<numElVertices; a++)
+        {
+          double * qa = &q[3*a];
+
+          Vec3d C0 = lambda * abcd.C(c,a,e) + mu * (abcd.C(e,a,c) + abcd.C(a,e,c));
+          Vec3d C1 = lambda * abcd.C(e,a,c) + mu * (abcd.C(c,e,a) + abcd.C(a,e,c));
+          Vec3d C2 = lambda * abcd.C(a,e,c) + mu * (abcd.C(c,a,e) + abcd.C(e,a,c));
+
+          // C0 tensor qa + qa tensor C1 + (qa dot C2) * I
+          for(int k=0; k<3; k++)
+            for(int l=0; l<3; l++)
+              quadraticMatrix[3*k+l] += C0[k] * qa[l] + qa[k] * C1[l];
+
+          double dotp = qa[0]*C2[0] + qa[1]*C2[1] + qa[2]*C2[2];
+          quadraticMatrix[0] += dotp; 
+          quadraticMatrix[4] += dotp; 
+          quadraticMatrix[8] += dotp; 
+        }
+
+        // cubic terms
+        double cubicMatrix[9];
+        memset(cubicMatrix, 0, sizeof(double) * 9);
+        for(int a=0; a<numElVertices; a++)
+          for(int b=0; b<numElVertices; b++)
+          {
+            double D0 = lambda * abcd.D(a,c,b,e) +
+                        mu * ( abcd.D(a,e,b,c) + abcd.D(a,b,c,e) );
+
+            double * tensor = &qTensor[9*(numElVertices*a+b)];
+            for(int k=0; k<9; k++)
+              cubicMatrix[k] += D0 * tensor[k];
+
+            double D1 = 0.5 * lambda * abcd.D(a,b,c,e) +
+                        mu * abcd.D(a,c,b,e);
+
+            double dotpD = D1 * qDot[numElVertices*a+b];
+            cubicMatrix[0] += dotpD; 
+            cubicMatrix[4] += dotpD; 
+            cubicMatrix[8] += dotpD; 
+          }
+
+        // add the block into the stiffness matrix, and its contribution into the force on vertex c
+        double * qe = &q[3*e];
+        for(int k=0; k<3; k++)
+        {
+          double * rowData = &dataHandle[rowc+k][3*column[c8+e]];
+          for(int l=0; l<3; l++)
+          {
+            rowData[l] += linearMatrix[k][l] + quadraticMatrix[3*k+l] + cubicMatrix[3*k+l];
+            force[k] += (linearMatrix[k][l] + 0.5 * quadraticMatrix[3*k+l] + oneThird * cubicMatrix[3*k+l]) * qe[l];
+          }
+        }
+      }
+
+      forces[rowc+0] += force[0];
+      forces[rowc+1] += force[1];
+      forces[rowc+2] += force[2];
+    }
+  }
+
+  free(qTensor);
+  free(qDot);
+  free(q);
+}
+
+void StVKStiffnessMatrix::AddAllTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  StVKBatchedTetKernels * batchedKernels = stVKInternalForces->GetBatchedKernels();
+  if (batchedKernels != NULL)
+  {
+    if (elementLow < 0)
+      elementLow = 0;
+    if (elementHigh < 0)
+      elementHigh = volumetricMesh->getNumElements();
+    AddBatchedTermsContribution(batchedKernels, vertexDisplacements, NULL, sparseMatrix, elementLow, elementHigh, StVKBatchedTetKernels::ALL);
+    return;
+  }
+
+  AddLinearTermsContribution(vertexDisplacements, sparseMatrix, elementLow, elementHigh);
+  AddQuadraticTermsContribution(vertexDisplacements, sparseMatrix, elementLow, elementHigh);
+  AddCubicTermsContribution(vertexDisplacements, sparseMatrix, elementLow, elementHigh);
+}
+
+void StVKStiffnessMatrix::AddBatchedTermsContribution(StVKBatchedTetKernels * batchedKernels, double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow, int elementHigh, int terms)
+{
+  double ** dataHandle = sparseMatrix->GetDataHandle();
+  double * blocks = (double*) malloc (sizeof(double) * 144 * STVK_BATCH_WIDTH);
+
+  int batchLow = elementLow / STVK_BATCH_WIDTH;
+  int batchHigh = (elementHigh + STVK_BATCH_WIDTH - 1) / STVK_BATCH_WIDTH;
+  for(int batch=batchLow; batch<batchHigh; batch++)
+  {
+    batchedKernels->ComputeStiffnessBlocks(vertexDisplacements, batch, terms, blocks);
+
+    // scatter the blocks of the elements of this batch that are in the range
+    int elLow = STVK_BATCH_WIDTH * batch;
+    int elHigh = elLow + STVK_BATCH_WIDTH;
+    if (elLow < elementLow)
+      elLow = elementLow;
+    if (elHigh > elementHigh)
+      elHigh = elementHigh;
+    if (forces != NULL)
+      batchedKernels->AddForces(vertexDisplacements, forces, elLow, elHigh, terms);
+    for(int el=elLow; el<elHigh; el++)
+    {
+      int lane = el - STVK_BATCH_WIDTH * batch;
+      int * row = row_[el];
+      int * column = column_[el];
+      for(int c=0; c<4; c++)
+        for(int e=0; e<4; e++)
+        {
+          double * block = &blocks[STVK_BATCH_WIDTH * 9 * (4 * c + e) + lane];
+          int columnStart = 3 * column[4 * c + e];
+          for(int k=0; k<3; k++)
+          {
+            double * rowData = &dataHandle[3 * row[c] + k][columnStart];
+            for(int l=0; l<3; l++)
+              rowData[l] += block[STVK_BATCH_WIDTH * (3 * k + l)];
+          }
+        }
+    }
+  }
+
+  free(blocks);
+}
+
 void StVKStiffnessMatrix::AddLinearTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
 {
   if (elementLow < 0)
@@ -153,29 +368,40 @@ void StVKStiffnessMatrix::AddLinearTermsContribution(double * vertexDisplacement
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  StVKBatchedTetKernels * batchedKernels = stVKInternalForces->GetBatchedKernels();
+  if (batchedKernels != NULL)
+  {
+    AddBatchedTermsContribution(batchedKernels, vertexDisplacements, NULL, sparseMatrix, elementLow, elementHigh, StVKBatchedTetKernels::LINEAR);
+    return;
+  }
+
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddLinearTermsKernel(abcd, vertexDisplacements, sparseMatrix, elementLow, elementHigh));
+}
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+template<class ABCD>
+void StVKStiffnessMatrix::AddLinearTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
-    for(int ver=0; ver<numElementVertices; ver++)
+    abcd.PrepareElement(el);
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing row of vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing row of vertex c
     {
       // linear terms
-      for (int a=0; a<numElementVertices; a++) // over all vertices
+      for (int a=0; a<numElVertices; a++) // over all vertices
       {
         Mat3d matrix(1.0);
-        matrix *= mu * precomputedIntegrals->B(elIter,a,c);
-        matrix += lambda * precomputedIntegrals->A(elIter,c,a) +
-                  mu * precomputedIntegrals->A(elIter,a,c);
+        matrix *= mu * abcd.B(a,c);
+        matrix += lambda * abcd.A(c,a) +
+                  mu * abcd.A(a,c);
 
         AddMatrix3x3Block(c, a, el, matrix, sparseMatrix);
       }
@@ -183,8 +409,6 @@ void StVKStiffnessMatrix::AddLinearTermsContribution(double * vertexDisplacement
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
 #define ADD_MATRIX_BLOCK(where)\
@@ -201,39 +425,50 @@ void StVKStiffnessMatrix::AddQuadraticTermsContribution(double * vertexDisplacem
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  StVKBatchedTetKernels * batchedKernels = stVKInternalForces->GetBatchedKernels();
+  if (batchedKernels != NULL)
+  {
+    AddBatchedTermsContribution(batchedKernels, vertexDisplacements, NULL, sparseMatrix, elementLow, elementHigh, StVKBatchedTetKernels::QUADRATIC);
+    return;
+  }
+
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddQuadraticTermsKernel(abcd, vertexDisplacements, sparseMatrix, elementLow, elementHigh));
+}
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+template<class ABCD>
+void StVKStiffnessMatrix::AddQuadraticTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   double ** dataHandle = sparseMatrix->GetDataHandle();
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
+    abcd.PrepareElement(el);
     int * row = row_[el];
     int * column = column_[el];
 
-    for(int ver=0; ver<numElementVertices; ver++)
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing row of vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing row of vertex c
     {
       int rowc = 3*row[c];
-      int c8 = numElementVertices*c;
+      int c8 = numElVertices*c;
       // quadratic terms
-      for (int e=0; e<numElementVertices; e++) // compute contribution to block (c,e) of the stiffness matrix
+      for (int e=0; e<numElVertices; e++) // compute contribution to block (c,e) of the stiffness matrix
       {
         double matrix[9];
         memset(matrix, 0, sizeof(double) * 9);
-        for(int a=0; a<numElementVertices; a++)
+        for(int a=0; a<numElVertices; a++)
         {
           double qa[3] = { vertexDisplacements[3*vertices[a]+0], vertexDisplacements[3*vertices[a]+1], vertexDisplacements[3*vertices[a]+2] };
 
-          Vec3d C0v = lambda * precomputedIntegrals->C(elIter,c,a,e) + mu * (precomputedIntegrals->C(elIter,e,a,c) + precomputedIntegrals->C(elIter,a,e,c));
+          Vec3d C0v = lambda * abcd.C(c,a,e) + mu * (abcd.C(e,a,c) + abcd.C(a,e,c));
           double C0[3] = {C0v[0], C0v[1], C0v[2]};
 
           // C0 tensor qa
@@ -241,7 +476,7 @@ void StVKStiffnessMatrix::AddQuadraticTermsContribution(double * vertexDisplacem
           matrix[3] += C0[1] * qa[0]; matrix[4] += C0[1] * qa[1]; matrix[5] += C0[1] * qa[2];
           matrix[6] += C0[2] * qa[0]; matrix[7] += C0[2] * qa[1]; matrix[8] += C0[2] * qa[2];
 
-          Vec3d C1v = lambda * precomputedIntegrals->C(elIter,e,a,c) + mu * (precomputedIntegrals->C(elIter,c,e,a) + precomputedIntegrals->C(elIter,a,e,c));
+          Vec3d C1v = lambda * abcd.C(e,a,c) + mu * (abcd.C(c,e,a) + abcd.C(a,e,c));
           double C1[3] = {C1v[0], C1v[1], C1v[2]};
 
           // qa tensor C1
@@ -249,7 +484,7 @@ void StVKStiffnessMatrix::AddQuadraticTermsContribution(double * vertexDisplacem
           matrix[3] += qa[1] * C1[0]; matrix[4] += qa[1] * C1[1]; matrix[5] += qa[1] * C1[2];
           matrix[6] += qa[2] * C1[0]; matrix[7] += qa[2] * C1[1]; matrix[8] += qa[2] * C1[2];
 
-          Vec3d C2v = lambda * precomputedIntegrals->C(elIter,a,e,c) + mu * (precomputedIntegrals->C(elIter,c,a,e) + precomputedIntegrals->C(elIter,e,a,c));
+          Vec3d C2v = lambda * abcd.C(a,e,c) + mu * (abcd.C(c,a,e) + abcd.C(e,a,c));
           double C2[3] = {C2v[0], C2v[1], C2v[2]};
 
           // qa dot C2
@@ -266,8 +501,6 @@ void StVKStiffnessMatrix::AddQuadraticTermsContribution(double * vertexDisplacem
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
 void StVKStiffnessMatrix::AddCubicTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
@@ -277,53 +510,64 @@ void StVKStiffnessMatrix::AddCubicTermsContribution(double * vertexDisplacements
   if (elementHigh < 0)
     elementHigh = volumetricMesh->getNumElements();
 
-  int * vertices = (int*) malloc (sizeof(int) * numElementVertices);
+  StVKBatchedTetKernels * batchedKernels = stVKInternalForces->GetBatchedKernels();
+  if (batchedKernels != NULL)
+  {
+    AddBatchedTermsContribution(batchedKernels, vertexDisplacements, NULL, sparseMatrix, elementLow, elementHigh, StVKBatchedTetKernels::CUBIC);
+    return;
+  }
+
+  STVK_ELEMENTABCD_DISPATCH(elementABCDType, precomputedIntegrals, numElementVertices, AddCubicTermsKernel(abcd, vertexDisplacements, sparseMatrix, elementLow, elementHigh));
+}
 
-  void * elIter;
-  precomputedIntegrals->AllocateElementIterator(&elIter);
+template<class ABCD>
+void StVKStiffnessMatrix::AddCubicTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh)
+{
+  const int numElVertices = abcd.GetNumElementVertices(); // a compile-time constant for the specialized coefficient views
+  int * vertices = (int*) malloc (sizeof(int) * numElVertices);
 
   double ** dataHandle = sparseMatrix->GetDataHandle();
 
   for(int el=elementLow; el < elementHigh; el++)
   {
-    precomputedIntegrals->PrepareElement(el, elIter);
+    abcd.PrepareElement(el);
     int * row = row_[el];
     int * column = column_[el];
 
-    for(int ver=0; ver<numElementVertices; ver++)
+    for(int ver=0; ver<numElVertices; ver++)
       vertices[ver] = volumetricMesh->getVertexIndex(el, ver);
 
     double lambda = lambdaLame[el]; 
     double mu = muLame[el];
 
-    for (int c=0; c<numElementVertices; c++) // over all vertices of the voxel, computing derivative on force on vertex c
+    for (int c=0; c<numElVertices; c++) // over all vertices of the voxel, computing derivative on force on vertex c
     {
       int rowc = 3*row[c];
-      int c8 = numElementVertices*c;
+      int c8 = numElVertices*c;
       // cubic terms
-      for (int e=0; e<numElementVertices; e++) // compute contribution to block (c,e) of the stiffness matrix
+      for (int e=0; e<numElVertices; e++) // compute contribution to block (c,e) of the stiffness matrix
       {
         double matrix[9];
         memset(matrix, 0, sizeof(double) * 9);
-        for(int a=0; a<numElementVertices; a++)
+        for(int a=0; a<numElVertices; a++)
         {
           int va = vertices[a];
           double * qa = &(vertexDisplacements[3*va]);
-          for(int b=0; b<numElementVertices; b++)
+          for(int b=0; b<numElVertices; b++)
           {
             int vb = vertices[b];
 
             double * qb = &(vertexDisplacements[3*vb]);
 
-            double D0 = lambda * precomputedIntegrals->D(elIter,a,c,b,e) +
-                        mu * ( precomputedIntegrals->D(elIter,a,e,b,c) + precomputedIntegrals->D(elIter,a,b,c,e) );
+            double D0 = lambda * abcd.D(a,c,b,e) +
+                        mu * ( abcd.D(a,e,b,c) + abcd.D(a,b,c,e) );
 
             matrix[0] += D0 * qa[0] * qb[0]; matrix[1] += D0 * qa[0] * qb[1]; matrix[2] += D0 * qa[0] * qb[2];
             matrix[3] += D0 * qa[1] * qb[0]; matrix[4] += D0 * qa[1] * qb[1]; matrix[5] += D0 * qa[1] * qb[2];
             matrix[6] += D0 * qa[2] * qb[0]; matrix[7] += D0 * qa[2] * qb[1]; matrix[8] += D0 * qa[2] * qb[2];
 
-            double D1 = 0.5 * lambda * precomputedIntegrals->D(elIter,a,b,c,e) +
-                        mu * precomputedIntegrals->D(elIter,a,c,b,e);
+            double D1 = 0.5 * lambda * abcd.D(a,b,c,e) +
+                        mu * abcd.D(a,c,b,e);
 
             double dotpD = D1 * (qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2]);
 
@@ -339,7 +583,5 @@ void StVKStiffnessMatrix::AddCubicTermsContribution(double * vertexDisplacements
   }
 
   free(vertices);
-
-  precomputedIntegrals->ReleaseElementIterator(elIter);
 }
 
@@ -38,13 +38,16 @@
 
 #include "sparseMatrix/sparseMatrix.h"
 #include "stvk/StVKInternalForces.h"
+#include "volumetricMesh/volumetricMeshCache.h"
 
 class StVKStiffnessMatrix
 {
 public:
 
   // initializes the computation of the tangent stiffness matrix
-  StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForces);
+  // cache: if not NULL, the stiffness matrix topology is loaded from the cache if available, and otherwise computed and stored into the cache (see volumetricMesh/volumetricMeshCache.h)
+  // numThreads: number of threads used to build the acceleration indices
+  StVKStiffnessMatrix(StVKInternalForces *  stVKInternalForces, VolumetricMeshCache * cache=NULL, int numThreads=1);
   virtual ~StVKStiffnessMatrix();
 
   // generates a zero matrix with the same pattern of non-zero entries as the tangent stiffness matrix
@@ -55,6 +58,10 @@ public:
   // "vertexDisplacements" is an array of vertex deformations, of length 3*n, where n is the total number of mesh vertices
   virtual void ComputeStiffnessMatrix(double * vertexDisplacements, SparseMatrix * sparseMatrix);
 
+  // evaluates both the internal forces (the same as StVKInternalForces::ComputeForces, including the gravity) and the tangent stiffness matrix,
+  // in a single pass over the elements; this is faster than calling ComputeForces and ComputeStiffnessMatrix separately
+  virtual void ComputeForceAndStiffnessMatrix(double * vertexDisplacements, double * internalForces, SparseMatrix * sparseMatrix);
+
   inline void ResetStiffnessMatrix(SparseMatrix * sparseMatrix) {sparseMatrix->ResetToZero();}
 
   inline VolumetricMesh * GetVolumetricMesh() { return volumetricMesh; }
@@ -66,6 +73,11 @@ public:
   void AddLinearTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow=-1, int elementHigh=-1);
   void AddQuadraticTermsContribution(double * vertexDisplacements,SparseMatrix * sparseMatrix, int elementLow=-1, int elementHigh=-1);
   void AddCubicTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow=-1, int elementHigh=-1);
+  // adds all three terms (the same as the three routines above; with the batched kernels, in a single pass over the elements)
+  // note: the batched kernels are enabled with StVKInternalForces::UseBatchedKernels
+  void AddAllTermsContribution(double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow=-1, int elementHigh=-1);
+  // adds all three terms of both the internal forces (without gravity) and the stiffness matrix, in a single pass over the elements
+  void AddForceAndStiffnessMatrixContribution(double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow=-1, int elementHigh=-1);
 
   void GetMatrixAccelerationIndices(int *** row__, int *** column__) { *row__ = row_; *column__ = column_;}
 
@@ -76,14 +88,29 @@ protected:
   // acceleration indices
   int ** row_;
   int ** column_;
+  struct AccelerationIndicesData;
+  static void BuildAccelerationIndices(void * data, int startElement, int endElement); // see VolumetricMeshThreads
 
   VolumetricMesh * volumetricMesh;
   StVKInternalForces * stVKInternalForces;
   StVKElementABCD * precomputedIntegrals;
+  VolumetricMeshCache * cache;
 
   double * lambdaLame;
   double * muLame;
 
+  // the element kernels, one instantiation for each coefficient view in StVKElementABCDInline.h;
+  // the Add*TermsContribution routines select the instantiation matching elementABCDType
+  StVKElementABCD::elementABCDType elementABCDType;
+  template<class ABCD> void AddLinearTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh);
+  template<class ABCD> void AddQuadraticTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh);
+  template<class ABCD> void AddCubicTermsKernel(ABCD & abcd, double * vertexDisplacements, SparseMatrix * sparseMatrix, int elementLow, int elementHigh);
+  template<class ABCD> void AddForceAndStiffnessMatrixKernel(ABCD & abcd, double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow, int elementHigh);
+
+  // adds the selected terms (see StVKBatchedTetKernels::termsType) using the batched kernels; 
+  // if forces is not NULL, the forces are added as well, in the same pass over the elements
+  void AddBatchedTermsContribution(StVKBatchedTetKernels * batchedKernels, double * vertexDisplacements, double * forces, SparseMatrix * sparseMatrix, int elementLow, int elementHigh, int terms);
+
   // adds a 3x3 block matrix corresponding to a derivative of force on vertex c wrt to vertex a
   // c is 0..7
   // a is 0..7
@@ -27,9 +27,10 @@
  *************************************************************************/
 
 #include <pthread.h>
+#include <string.h>
 #include "StVKStiffnessMatrixMT.h"
 
-StVKStiffnessMatrixMT::StVKStiffnessMatrixMT(StVKInternalForces *  stVKInternalForces, int numThreads_): StVKStiffnessMatrix(stVKInternalForces), numThreads(numThreads_) 
+StVKStiffnessMatrixMT::StVKStiffnessMatrixMT(StVKInternalForces *  stVKInternalForces, int numThreads_, VolumetricMeshCache * cache): StVKStiffnessMatrix(stVKInternalForces, cache, numThreads_), numThreads(numThreads_) 
 {
   SparseMatrix * stiffnessMatrixSkeleton;
   GetStiffnessMatrixTopology(&stiffnessMatrixSkeleton);
@@ -64,6 +65,8 @@ StVKStiffnessMatrixMT::StVKStiffnessMatrixMT(StVKInternalForces *  stVKInternalF
 
   delete(stiffnessMatrixSkeleton);
 
+  forceBuffer = NULL;
+
   printf("Total elements: %d \n",numElements);
   printf("Num threads: %d \n",numThreads);
   printf("Canonical job size: %d \n",jobSize);
@@ -77,6 +80,7 @@ StVKStiffnessMatrixMT::~StVKStiffnessMatrixMT()
   for(int i=0; i<numThreads; i++)
     delete(sparseMatrixBuffer[i]);
   free(sparseMatrixBuffer);
+  free(forceBuffer);
 }
 
 int StVKStiffnessMatrixMT::GetStartElement(int rank)
@@ -94,6 +98,7 @@ struct StVKStiffnessMatrixMT_threadArg
   StVKStiffnessMatrixMT * stVKStiffnessMatrixMT;
   double * vertexDisplacements;
   SparseMatrix * targetBuffer;
+  double * targetForceBuffer; // NULL if only the stiffness matrix is computed
   int rank;
 };
 
@@ -103,21 +108,29 @@ void * StVKStiffnessMatrixMT_WorkerThread(void * arg)
   StVKStiffnessMatrixMT * stVKStiffnessMatrixMT = threadArgp->stVKStiffnessMatrixMT;
   double * vertexDisplacements = threadArgp->vertexDisplacements;
   SparseMatrix * targetBuffer = threadArgp->targetBuffer;
+  double * targetForceBuffer = threadArgp->targetForceBuffer;
   int rank = threadArgp->rank;
   int startElement = stVKStiffnessMatrixMT->GetStartElement(rank);
   int endElement = stVKStiffnessMatrixMT->GetEndElement(rank);
 
-  stVKStiffnessMatrixMT->AddLinearTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
-  stVKStiffnessMatrixMT->AddQuadraticTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
-  stVKStiffnessMatrixMT->AddCubicTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
+  if (targetForceBuffer != NULL)
+    stVKStiffnessMatrixMT->AddForceAndStiffnessMatrixContribution(vertexDisplacements, targetForceBuffer, targetBuffer, startElement, endElement);
+  else
+    stVKStiffnessMatrixMT->AddAllTermsContribution(vertexDisplacements, targetBuffer, startElement, endElement);
 
   return NULL;
 }
 
-void StVKStiffnessMatrixMT::ComputeStiffnessMatrix(double * vertexDisplacements, SparseMatrix * sparseMatrix)
+void StVKStiffnessMatrixMT::LaunchThreads(double * vertexDisplacements, bool computeForces)
 {
-  //PerformanceCounter stiffnessCounter;
-  // launch the threads
+  int r = 3 * volumetricMesh->getNumVertices();
+  if (computeForces)
+  {
+    if (forceBuffer == NULL)
+      forceBuffer = (double*) malloc (sizeof(double) * numThreads * r);
+    memset(forceBuffer, 0, sizeof(double) * numThreads * r);
+  }
+
   struct StVKStiffnessMatrixMT_threadArg * threadArgv = (struct StVKStiffnessMatrixMT_threadArg*) malloc (sizeof(struct StVKStiffnessMatrixMT_threadArg) * numThreads);
 
   pthread_t * tid = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
@@ -127,6 +140,7 @@ void StVKStiffnessMatrixMT::ComputeStiffnessMatrix(double * vertexDisplacements,
     threadArgv[i].stVKStiffnessMatrixMT = this;
     threadArgv[i].vertexDisplacements = vertexDisplacements;
     threadArgv[i].targetBuffer = sparseMatrixBuffer[i];
+    threadArgv[i].targetForceBuffer = computeForces ? &forceBuffer[i * r] : NULL;
     threadArgv[i].rank = i;
     sparseMatrixBuffer[i]->ResetToZero();
   }
@@ -151,6 +165,12 @@ void StVKStiffnessMatrixMT::ComputeStiffnessMatrix(double * vertexDisplacements,
 
   free(threadArgv);
   free(tid);
+}
+
+void StVKStiffnessMatrixMT::ComputeStiffnessMatrix(double * vertexDisplacements, SparseMatrix * sparseMatrix)
+{
+  //PerformanceCounter stiffnessCounter;
+  LaunchThreads(vertexDisplacements, false);
 
   // assemble results
   sparseMatrix->ResetToZero();
@@ -161,3 +181,24 @@ void StVKStiffnessMatrixMT::ComputeStiffnessMatrix(double * vertexDisplacements,
   //printf("Stiffness matrix: %G\n", stiffnessCounter.GetElapsedTime());
 }
 
+void StVKStiffnessMatrixMT::ComputeForceAndStiffnessMatrix(double * vertexDisplacements, double * internalForces, SparseMatrix * sparseMatrix)
+{
+  LaunchThreads(vertexDisplacements, true);
+
+  // assemble results
+  sparseMatrix->ResetToZero();
+  for(int i=0; i<numThreads; i++)
+    *sparseMatrix += *(sparseMatrixBuffer[i]);
+
+  int r = 3 * volumetricMesh->getNumVertices();
+  memset(internalForces, 0, sizeof(double) * r);
+  for(int i=0; i<numThreads; i++)
+  {
+    double * source = &forceBuffer[i * r];
+    for(int j=0; j<r; j++)
+      internalForces[j] += source[j];
+  }
+
+  stVKInternalForces->SubtractGravityForce(internalForces);
+}
+
@@ -44,11 +44,13 @@ class StVKStiffnessMatrixMT : public StVKStiffnessMatrix
 {
 public:
   // multicore version of StVKStiffnessMatrix
-  StVKStiffnessMatrixMT(StVKInternalForces *  stVKInternalForces, int numThreads);
+  StVKStiffnessMatrixMT(StVKInternalForces *  stVKInternalForces, int numThreads, VolumetricMeshCache * cache=NULL);
   virtual ~StVKStiffnessMatrixMT();
 
   // evaluates the stiffness matrix in the given deformation configuration
   virtual void ComputeStiffnessMatrix(double * vertexDisplacements, SparseMatrix * sparseMatrix);
+  // evaluates both the internal forces and the stiffness matrix (see StVKStiffnessMatrix.h)
+  virtual void ComputeForceAndStiffnessMatrix(double * vertexDisplacements, double * internalForces, SparseMatrix * sparseMatrix);
 
   int GetStartElement(int rank);
   int GetEndElement(int rank);
@@ -57,6 +59,9 @@ protected:
   int numThreads;
   int * startElement, * endElement;
   SparseMatrix ** sparseMatrixBuffer;
+  double * forceBuffer; // internal force buffers of the threads, allocated on the first call to ComputeForceAndStiffnessMatrix
+
+  void LaunchThreads(double * vertexDisplacements, bool computeForces);
 };
 
 #endif
@@ -66,6 +66,9 @@ public:
   void ReleaseElementIterator(void * elementIterator);
   void PrepareElement(int el, void * elementIterator); // must call each time before accessing an element
 
+  virtual elementABCDType GetType() { return TET; }
+  inline elementData * GetElementData(int el) { return &elementsData[el]; }
+
   virtual ~StVKTetABCD();
 
 protected:
@@ -27,54 +27,139 @@
  *************************************************************************/
 
 #include "StVKTetHighMemoryABCD.h"
+#include "volumetricMesh/volumetricMeshThreads.h"
 
-//#define CONTIGUOUSBLOCK
+struct StVKTetHighMemoryABCD::ElementRangeData
+{
+  StVKTetHighMemoryABCD * abcd;
+  TetMesh * tetMesh;
+};
 
-StVKTetHighMemoryABCD::StVKTetHighMemoryABCD(TetMesh * tetMesh)
+StVKTetHighMemoryABCD::StVKTetHighMemoryABCD(TetMesh * tetMesh, bool singlePrecision_, VolumetricMeshCache * cache, int numThreads): singlePrecision(singlePrecision_)
 {
   int numElements = tetMesh->getNumElements();
 
-  // allocate contiguous buffer for coefficients
-  int totalCoefficientSize = (sizeof(Mat3d [4][4]) +
-    sizeof(double [4][4]) +
-    sizeof(Vec3d [4][4][4]) +
-    sizeof(double [4][4][4][4]) ) * numElements;
-
-  #ifdef CONTIGUOUSBLOCK
-    unsigned char * block = (unsigned char*) malloc (sizeof(unsigned char) * totalCoefficientSize);
-    A_ = (Mat3d (*) [4][4]) &block[0];
-    B_ = (double (*) [4][4]) &block[sizeof(Mat3d [4][4]) * numElements];
-    C_ = (Vec3d (*) [4][4][4]) &block[(sizeof(Mat3d [4][4]) + sizeof(double [4][4])) * numElements];
-    D_ = (double (*) [4][4][4][4]) &block[(sizeof(Mat3d [4][4]) + sizeof(double [4][4]) + sizeof(Vec3d [4][4][4])) * numElements];
-  #else
-    A_ = (Mat3d (*) [4][4]) malloc (sizeof(Mat3d [4][4]) * numElements);
-    B_ = (double (*) [4][4]) malloc (sizeof(double [4][4]) * numElements);
-    C_ = (Vec3d (*) [4][4][4]) malloc (sizeof(Vec3d [4][4][4]) * numElements);
-    D_ = (double (*) [4][4][4][4]) malloc (sizeof(double [4][4][4][4]) * numElements);
-  #endif
-
-  for(int el=0; el<numElements; el++)
+  // index tables
+  for(int i=0; i<4; i++)
+    for(int j=0; j<4; j++)
+      for(int k=0; k<4; k++)
+      {
+        cIndex[16 * i + 4 * j + k] = 10 * i + PairIndex(j,k);
+        for(int l=0; l<4; l++)
+          dIndex[64 * i + 16 * j + 4 * k + l] = PairPairIndex(PairIndex(i,j), PairIndex(k,l));
+      }
+
+  // all the coefficients are stored in one contiguous block (in this order: A, B, C, D)
+  size_t elementCoefficientSize = sizeof(Mat3d [10]) + sizeof(double [10]);
+  if (singlePrecision)
+    elementCoefficientSize += sizeof(float [120]) + sizeof(float [55]);
+  else
+    elementCoefficientSize += sizeof(Vec3d [40]) + sizeof(double [55]);
+  size_t totalCoefficientSize = elementCoefficientSize * numElements;
+
+  const char * cacheName = singlePrecision ? "StVKTetHighMemoryABCDSinglePrecision" : "StVKTetHighMemoryABCD";
+  block = NULL;
+  blockFromCache = false;
+  if (cache != NULL)
   {
-    Vec3d vertices[4];
-    for(int i=0; i<4; i++)
-      vertices[i] = *(tetMesh->getVertex(el, i));
-    StVKSingleTetABCD(vertices, A_[el], B_[el], C_[el], D_[el]);
+    block = (char*) cache->LoadWithSize(cacheName, totalCoefficientSize);
+    blockFromCache = (block != NULL);
+  }
+  if (block == NULL)
+    block = (char*) malloc (totalCoefficientSize);
+
+  A_ = (Mat3d (*) [10]) block;
+  B_ = (double (*) [10]) (block + sizeof(Mat3d [10]) * numElements);
+  char * CDBlock = block + (sizeof(Mat3d [10]) + sizeof(double [10])) * numElements;
+  C_ = NULL;
+  D_ = NULL;
+  CSinglePrecision = NULL;
+  DSinglePrecision = NULL;
+  if (singlePrecision)
+  {
+    CSinglePrecision = (float (*) [120]) CDBlock;
+    DSinglePrecision = (float (*) [55]) (CDBlock + sizeof(float [120]) * numElements);
+  }
+  else
+  {
+    C_ = (Vec3d (*) [40]) CDBlock;
+    D_ = (double (*) [55]) (CDBlock + sizeof(Vec3d [40]) * numElements);
   }
 
+  if (blockFromCache)
+  {
+    printf("Loaded tet ABCD coefficients from the cache (%G Mb).\n", 1.0 * totalCoefficientSize / 1024 / 1024);
+    return;
+  }
+
+  // the elements are independent; compute them in parallel
+  struct ElementRangeData data = { this, tetMesh };
+  VolumetricMeshThreads::RunOnElements(numElements, numThreads, ComputeElementRange, &data);
+
   printf("Total tet ABCD coefficient size: %G Mb.\n", 
    1.0 * totalCoefficientSize / 1024 / 1024);
+
+  if (cache != NULL)
+    cache->Save(cacheName, block, totalCoefficientSize);
 }
 
 StVKTetHighMemoryABCD::~StVKTetHighMemoryABCD()
 {
-  #ifdef CONTIGUOUSBLOCK
-    free((unsigned char*)A_);
-  #else
-    free(A_);
-    free(B_);
-    free(C_);
-    free(D_);
-  #endif
+  if (blockFromCache)
+    VolumetricMeshCache::Release(block);
+  else
+    free(block);
+}
+
+void StVKTetHighMemoryABCD::ComputeElementRange(void * data_, int startElement, int endElement)
+{
+  struct ElementRangeData * data = (struct ElementRangeData*) data_;
+  StVKTetHighMemoryABCD * abcd = data->abcd;
+  TetMesh * tetMesh = data->tetMesh;
+
+  for(int el=startElement; el<endElement; el++)
+  {
+    Vec3d vertices[4];
+    for(int i=0; i<4; i++)
+      vertices[i] = *(tetMesh->getVertex(el, i));
+
+    Mat3d A[4][4];
+    double B[4][4];
+    Vec3d C[4][4][4];
+    double D[4][4][4][4];
+    abcd->StVKSingleTetABCD(vertices, A, B, C, D);
+
+    // keep one representative of each symmetry class
+    for(int i=0; i<4; i++)
+      for(int j=i; j<4; j++)
+      {
+        abcd->A_[el][PairIndex(i,j)] = A[i][j];
+        abcd->B_[el][PairIndex(i,j)] = B[i][j];
+        for(int k=0; k<4; k++)
+          for(int l=k; l<4; l++)
+          {
+            int index = PairPairIndex(PairIndex(i,j), PairIndex(k,l));
+            if (abcd->singlePrecision)
+              abcd->DSinglePrecision[el][index] = (float) D[i][j][k][l];
+            else
+              abcd->D_[el][index] = D[i][j][k][l];
+          }
+      }
+
+    for(int i=0; i<4; i++)
+      for(int j=0; j<4; j++)
+        for(int k=j; k<4; k++)
+        {
+          int index = 10 * i + PairIndex(j,k);
+          if (abcd->singlePrecision)
+          {
+            for(int dim=0; dim<3; dim++)
+              abcd->CSinglePrecision[el][3 * index + dim] = (float) C[i][j][k][dim];
+          }
+          else
+            abcd->C_[el][index] = C[i][j][k];
+        }
+  }
 }
 
 void StVKTetHighMemoryABCD::StVKSingleTetABCD(Vec3d vtx[4], Mat3d A[4][4], double B[4][4], Vec3d C[4][4][4], double D[4][4][4][4])
@@ -31,14 +31,24 @@
 
 #include "stvk/StVKElementABCD.h"
 #include "volumetricMesh/tetMesh.h"
+#include "volumetricMesh/volumetricMeshCache.h"
 
 /*
   Class "StVKTetHighMemoryABCD" stores (explicitly) the St.Venant-Kirchhoff 
   A,B,C,D coefficients for a tetrahedron (high-memory version).
   It enables fast coefficient access, but requires more memory than 
-  the "StVKTetABCD" class. The class "StVKTetHighMemoryABCD" is practical 
-  up to a few thousand tetrahedra, depending on the size of your memory. 
-  In our simulations, we usually used "StVKTetABCD" for all the tet meshes.
+  the "StVKTetABCD" class. 
+
+  The coefficients are stored compactly, using their index symmetries:
+    A(j,i) = A(i,j)^T, B(j,i) = B(i,j), C(i,k,j) = C(i,j,k),
+    D(j,i,k,l) = D(i,j,l,k) = D(k,l,i,j) = D(i,j,k,l),
+  i.e., 10 matrices A, 10 scalars B, 40 vectors C and 55 scalars D per tet 
+  (2200 bytes per tet, instead of 4864 bytes for the full coefficient arrays).
+  Optionally, the C and D coefficients (which only enter the quadratic and cubic terms 
+  of the internal forces) can be stored in single precision (1500 bytes per tet). 
+  The A and B coefficients (the linear terms, i.e., the stiffness matrix in the rest configuration) 
+  are always stored in double precision. With single precision, the quadratic and cubic terms 
+  have a relative error of about 1E-7.
 */
 
 class StVKTetHighMemoryABCD : public StVKElementABCD
@@ -46,23 +56,84 @@ class StVKTetHighMemoryABCD : public StVKElementABCD
 public:
 
   // computes the ABCD coefficients 
-  StVKTetHighMemoryABCD(TetMesh * tetMesh);
+  // singlePrecision: if true, the C and D coefficients are stored in single precision (see above)
+  // cache: if not NULL, the coefficients are loaded from the cache if available, and otherwise computed and stored into the cache (see volumetricMesh/volumetricMeshCache.h)
+  // numThreads: number of threads used to compute the coefficients
+  StVKTetHighMemoryABCD(TetMesh * tetMesh, bool singlePrecision=false, VolumetricMeshCache * cache=NULL, int numThreads=1);
 
-  inline virtual Mat3d A(void * elementIterator, int i, int j) { return A_[*(int*)elementIterator][i][j]; }
-  inline virtual double B(void * elementIterator, int i, int j) { return B_[*(int*)elementIterator][i][j]; }
-  inline virtual Vec3d C(void * elementIterator, int i, int j, int k) { return C_[*(int*)elementIterator][i][j][k]; }
-  inline virtual double D(void * elementIterator, int i, int j, int k, int l) { return D_[*(int*)elementIterator][i][j][k][l]; }
+  inline virtual Mat3d A(void * elementIterator, int i, int j);
+  inline virtual double B(void * elementIterator, int i, int j) { return B_[*(int*)elementIterator][PairIndex(i,j)]; }
+  inline virtual Vec3d C(void * elementIterator, int i, int j, int k);
+  inline virtual double D(void * elementIterator, int i, int j, int k, int l);
 
   virtual ~StVKTetHighMemoryABCD();
 
+  virtual elementABCDType GetType() { return TETHIGHMEMORY; }
+  inline bool IsSinglePrecision() { return singlePrecision; }
+
+  // index of the pair i, j in the compact storage (the order is 00,01,02,03,11,12,13,22,23,33)
+  static inline int PairIndex(int i, int j) { return (i <= j) ? (i * (7 - i)) / 2 + j : (j * (7 - j)) / 2 + i; }
+  // index of the pair of pairs (p, q) (each in 0..9), used for D
+  static inline int PairPairIndex(int p, int q) { return (p <= q) ? (p * (19 - p)) / 2 + q : (q * (19 - q)) / 2 + p; }
+  // lookup tables: C(i,j,k) is entry cIndex[16*i+4*j+k] of GetElementC, and D(i,j,k,l) is entry dIndex[64*i+16*j+4*k+l] of GetElementD
+  inline const int * GetCIndex() { return cIndex; }
+  inline const int * GetDIndex() { return dIndex; }
+
+  // coefficients of element "el", in the compact storage: A (10 matrices, pairs i <= j), B (10), C (40 vectors), D (55)
+  inline Mat3d * GetElementA(int el) { return A_[el]; }
+  inline double * GetElementB(int el) { return B_[el]; }
+  // double precision only (NULL otherwise)
+  inline Vec3d * GetElementC(int el) { return (C_ == NULL) ? NULL : C_[el]; }
+  inline double * GetElementD(int el) { return (D_ == NULL) ? NULL : D_[el]; }
+  // single precision only (NULL otherwise); C is given as 3 floats per vector
+  inline float * GetElementCSinglePrecision(int el) { return (CSinglePrecision == NULL) ? NULL : CSinglePrecision[el]; }
+  inline float * GetElementDSinglePrecision(int el) { return (DSinglePrecision == NULL) ? NULL : DSinglePrecision[el]; }
+
 protected:
-  Mat3d (*A_) [4][4];
-  double (*B_) [4][4];
-  Vec3d (*C_) [4][4][4];
-  double (*D_) [4][4][4][4];
+  bool singlePrecision;
+  char * block; // all the coefficients
+  bool blockFromCache;
+  Mat3d (*A_) [10];
+  double (*B_) [10];
+  Vec3d (*C_) [40];
+  double (*D_) [55];
+  float (*CSinglePrecision) [120];
+  float (*DSinglePrecision) [55];
+
+  int cIndex[64];
+  int dIndex[256];
 
   void StVKSingleTetABCD(Vec3d vertices[4], Mat3d A[4][4], double B[4][4], Vec3d C[4][4][4], double D[4][4][4][4]);
+
+  // computes the coefficients of the elements startElement <= el < endElement (see VolumetricMeshThreads)
+  struct ElementRangeData;
+  static void ComputeElementRange(void * data, int startElement, int endElement);
 };
 
-#endif
+inline Mat3d StVKTetHighMemoryABCD::A(void * elementIterator, int i, int j) 
+{ 
+  Mat3d & A = A_[*(int*)elementIterator][PairIndex(i,j)];
+  return (i <= j) ? A : trans(A);
+}
+
+inline Vec3d StVKTetHighMemoryABCD::C(void * elementIterator, int i, int j, int k) 
+{ 
+  int el = *(int*)elementIterator;
+  int index = cIndex[16 * i + 4 * j + k];
+  if (singlePrecision)
+  {
+    float * C = &CSinglePrecision[el][3 * index];
+    return Vec3d(C[0], C[1], C[2]);
+  }
+  else
+    return C_[el][index];
+}
 
+inline double StVKTetHighMemoryABCD::D(void * elementIterator, int i, int j, int k, int l) 
+{ 
+  int el = *(int*)elementIterator;
+  int index = dIndex[64 * i + 16 * j + 4 * k + l];
+  return singlePrecision ? DSinglePrecision[el][index] : D_[el][index];
+}
+
+#endif
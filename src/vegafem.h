@@ -22,8 +22,10 @@
 #include "elasticForceModel/linearFEMForceModel.h"
 #include "elasticForceModel/massSpringSystemForceModel.h"
 #include "elasticForceModel/StVKForceModel.h"
+#include "elasticForceModel/reducedStVKForceModel.h"
 
 #include "forceModel/forceModel.h"
+#include "forceModel/reducedForceModel.h"
 
 #include "getopts/getopts.h"
 
@@ -42,6 +44,7 @@
 #include "isotropicHyperelasticFEM/homogeneousNeoHookeanIsotropicMaterial.h"
 #include "isotropicHyperelasticFEM/isotropicHyperelasticFEM.h"
 #include "isotropicHyperelasticFEM/isotropicHyperelasticFEMMT.h"
+#include "isotropicHyperelasticFEM/svd3x3.h"
 
 #include "lighting/lighting.h"
 
@@ -79,12 +82,15 @@
 
 #include "sparseSolver/sparseSolvers.h"
 
+#include "stvk/StVKBatchedTetKernels.h"
 #include "stvk/StVKCubeABCD.h"
 #include "stvk/StVKElementABCD.h"
+#include "stvk/StVKElementABCDInline.h"
 #include "stvk/StVKElementABCDLoader.h"
 #include "stvk/StVKHessianTensor.h"
 #include "stvk/StVKInternalForces.h"
 #include "stvk/StVKInternalForcesMT.h"
+#include "stvk/StVKReducedInternalForces.h"
 #include "stvk/StVKStiffnessMatrix.h"
 #include "stvk/StVKStiffnessMatrixMT.h"
 #include "stvk/StVKTetABCD.h"
@@ -95,6 +101,7 @@
 #include "volumetricMesh/generateMassMatrix.h"
 #include "volumetricMesh/generateSurfaceMesh.h"
 #include "volumetricMesh/generateMeshGraph.h"
+#include "volumetricMesh/generateStiffnessMatrixTopology.h"
 #include "volumetricMesh/cubicMesh.h"
 #include "volumetricMesh/tetMesh.h"
 #include "volumetricMesh/volumetricMesh.h"
@@ -102,5 +109,7 @@
 #include "volumetricMesh/volumetricMeshENuMaterial.h"
 #include "volumetricMesh/volumetricMeshMooneyRivlinMaterial.h"
 #include "volumetricMesh/volumetricMeshExtensions.h"
+#include "volumetricMesh/volumetricMeshCache.h"
+#include "volumetricMesh/volumetricMeshThreads.h"
 
 #endif
\ No newline at end of file
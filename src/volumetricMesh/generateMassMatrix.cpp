@@ -29,7 +29,7 @@
 #include "generateMassMatrix.h"
 
 void GenerateMassMatrix::computeMassMatrix(
-  VolumetricMesh * volumetricMesh, SparseMatrix ** massMatrix, bool inflate3Dim)
+  VolumetricMesh * volumetricMesh, SparseMatrix ** massMatrix, bool inflate3Dim, bool lumped)
 {
   int n = volumetricMesh->getNumVertices();
   int numElementVertices = volumetricMesh->getNumElementVertices();
@@ -45,7 +45,8 @@ void GenerateMassMatrix::computeMassMatrix(
       for(int i=0; i < numElementVertices; i++)
         for(int j=0; j < numElementVertices; j++)
         {
-          massMatrixOutline->AddEntry(volumetricMesh->getVertexIndex(el,i),volumetricMesh->getVertexIndex(el,j),  buffer[numElementVertices * j + i]);
+          int indexj = lumped ? volumetricMesh->getVertexIndex(el,i) : volumetricMesh->getVertexIndex(el,j);
+          massMatrixOutline->AddEntry(volumetricMesh->getVertexIndex(el,i), indexj, buffer[numElementVertices * j + i]);
         }
     }
   }
@@ -60,7 +61,7 @@ void GenerateMassMatrix::computeMassMatrix(
         {
           double entry = buffer[numElementVertices * j + i];
           int indexi = volumetricMesh->getVertexIndex(el,i);
-          int indexj = volumetricMesh->getVertexIndex(el,j);
+          int indexj = lumped ? indexi : volumetricMesh->getVertexIndex(el,j); // lumping: add the entry to the diagonal of its row
           massMatrixOutline->AddEntry(3*indexi+0, 3*indexj+0, entry);
           massMatrixOutline->AddEntry(3*indexi+1, 3*indexj+1, entry);
           massMatrixOutline->AddEntry(3*indexi+2, 3*indexj+2, entry);
@@ -47,7 +47,10 @@ public:
   // matrix will be 3*numVertices x 3*numVertices).
   // In order to save some space, set it to false (output matrix will be 
   // numVertices x numVertices).
-  static void computeMassMatrix(VolumetricMesh * volumetricMesh, SparseMatrix ** massMatrix, bool inflate3Dim = false);
+  // If lumped is true, the mass matrix is row-sum lumped into a diagonal matrix (each
+  // diagonal entry is the sum of its row in the consistent mass matrix). The explicit integrators 
+  // (CentralDifferencesSparse, EulerSparse) then require no linear system solves.
+  static void computeMassMatrix(VolumetricMesh * volumetricMesh, SparseMatrix ** massMatrix, bool inflate3Dim = false, bool lumped = false);
   // computes the mass belonging to each vertex, by lumping the mass matrix
   static void computeVertexMasses(VolumetricMesh * volumetricMesh, double * masses);
 
@@ -0,0 +1,126 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+using namespace std;
+#include "generateStiffnessMatrixTopology.h"
+#include "volumetricMeshThreads.h"
+
+struct GenerateStiffnessMatrixTopology_data
+{
+  VolumetricMesh * volumetricMesh;
+  int * vertexElementsStart; // elements of vertex v are vertexElements[vertexElementsStart[v]], ..., vertexElements[vertexElementsStart[v+1]-1]
+  int * vertexElements;
+  vector<int> * neighbors; // sorted; includes the vertex itself (unless the vertex is not in any element)
+};
+
+// computes the neighbors of the vertices startVertex <= v < endVertex (see VolumetricMeshThreads)
+static void GenerateStiffnessMatrixTopology_ComputeNeighbors(void * data_, int startVertex, int endVertex)
+{
+  struct GenerateStiffnessMatrixTopology_data * data = (struct GenerateStiffnessMatrixTopology_data*) data_;
+  VolumetricMesh * volumetricMesh = data->volumetricMesh;
+  int numElementVertices = volumetricMesh->getNumElementVertices();
+
+  for(int v=startVertex; v<endVertex; v++)
+  {
+    vector<int> & neighbors = data->neighbors[v];
+    for(int i=data->vertexElementsStart[v]; i<data->vertexElementsStart[v+1]; i++)
+    {
+      int el = data->vertexElements[i];
+      for(int j=0; j<numElementVertices; j++)
+        neighbors.push_back(volumetricMesh->getVertexIndex(el, j));
+    }
+    sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+  }
+}
+
+SparseMatrix * GenerateStiffnessMatrixTopology::Generate(VolumetricMesh * volumetricMesh, int numThreads)
+{
+  int numVertices = volumetricMesh->getNumVertices();
+  int numElements = volumetricMesh->getNumElements();
+  int numElementVertices = volumetricMesh->getNumElementVertices();
+
+  // the elements incident to each vertex
+  int * vertexElementsStart = (int*) calloc (numVertices + 1, sizeof(int));
+  for(int el=0; el<numElements; el++)
+    for(int j=0; j<numElementVertices; j++)
+      vertexElementsStart[volumetricMesh->getVertexIndex(el, j) + 1]++;
+  for(int v=0; v<numVertices; v++)
+    vertexElementsStart[v+1] += vertexElementsStart[v];
+
+  int * vertexElements = (int*) malloc (sizeof(int) * numElements * numElementVertices);
+  int * position = (int*) malloc (sizeof(int) * numVertices);
+  for(int v=0; v<numVertices; v++)
+    position[v] = vertexElementsStart[v];
+  for(int el=0; el<numElements; el++)
+    for(int j=0; j<numElementVertices; j++)
+    {
+      int v = volumetricMesh->getVertexIndex(el, j);
+      vertexElements[position[v]++] = el;
+    }
+  free(position);
+
+  vector<int> * neighbors = new vector<int>[numVertices];
+  struct GenerateStiffnessMatrixTopology_data data = { volumetricMesh, vertexElementsStart, vertexElements, neighbors };
+  VolumetricMeshThreads::RunOnElements(numVertices, numThreads, GenerateStiffnessMatrixTopology_ComputeNeighbors, &data);
+
+  free(vertexElements);
+  free(vertexElementsStart);
+
+  // expand each neighbor into a 3x3 block
+  int * rowLength = (int*) malloc (sizeof(int) * 3 * numVertices);
+  size_t numEntries = 0;
+  for(int v=0; v<numVertices; v++)
+  {
+    for(int k=0; k<3; k++)
+      rowLength[3*v+k] = 3 * neighbors[v].size();
+    numEntries += 9 * neighbors[v].size();
+  }
+
+  int * columnIndices = (int*) malloc (sizeof(int) * numEntries);
+  int * columnIndex = columnIndices;
+  for(int v=0; v<numVertices; v++)
+  {
+    for(int k=0; k<3; k++)
+      for(size_t j=0; j<neighbors[v].size(); j++)
+        for(int l=0; l<3; l++)
+          *(columnIndex++) = 3 * neighbors[v][j] + l;
+  }
+  delete [] neighbors;
+
+  SparseMatrix * stiffnessMatrixTopology = new SparseMatrix(3 * numVertices, rowLength, columnIndices);
+
+  free(columnIndices);
+  free(rowLength);
+
+  return stiffnessMatrixTopology;
+}
+
@@ -0,0 +1,51 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _GENERATESTIFFNESSMATRIXTOPOLOGY_H_
+#define _GENERATESTIFFNESSMATRIXTOPOLOGY_H_
+
+#include "volumetricMesh/volumetricMesh.h"
+#include "sparseMatrix/sparseMatrix.h"
+
+/*
+  Generates the sparsity pattern of the (3n x 3n) stiffness matrix of a volumetric mesh:
+  the 3x3 block (i,j) is non-zero if vertices i and j share an element.
+  The result is a zero sparse matrix; it is the same as the one obtained by adding the 3x3 blocks
+  of all pairs of element vertices to a SparseMatrixOutline, but it is computed much faster
+  (by sorting the vertex neighbors, instead of inserting them into a map). 
+  The rows can be processed in parallel (numThreads > 1).
+*/
+
+class GenerateStiffnessMatrixTopology
+{
+public:
+  static SparseMatrix * Generate(VolumetricMesh * volumetricMesh, int numThreads=1);
+};
+
+#endif
+
@@ -0,0 +1,315 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+#include "volumetricMeshCache.h"
+#include "volumetricMeshENuMaterial.h"
+#include "volumetricMeshMooneyRivlinMaterial.h"
+
+// each entry file starts with a header: tag (8 bytes), version (int), padding (int), mesh hash, key, data size (unsigned 64-bit each);
+// the header is padded to 64 bytes, so that the data is aligned
+#define CACHE_TAG "VEGACACH"
+#define CACHE_VERSION 1
+#define CACHE_HEADER_SIZE 64
+
+VolumetricMeshCache::VolumetricMeshCache(const char * directory_, VolumetricMesh * volumetricMesh)
+{
+  directory = (char*) malloc (sizeof(char) * (strlen(directory_) + 1));
+  strcpy(directory, directory_);
+  meshHash = ComputeMeshHash(volumetricMesh);
+}
+
+VolumetricMeshCache::~VolumetricMeshCache()
+{
+  free(directory);
+}
+
+unsigned long long VolumetricMeshCache::Hash(const void * data, size_t size, unsigned long long hash)
+{
+  const unsigned char * bytes = (const unsigned char*) data;
+  for(size_t i=0; i<size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+unsigned long long VolumetricMeshCache::ComputeMeshHash(VolumetricMesh * volumetricMesh)
+{
+  int sizes[4] = { (int) volumetricMesh->getElementType(), volumetricMesh->getNumVertices(), volumetricMesh->getNumElements(), volumetricMesh->getNumElementVertices() };
+  unsigned long long hash = Hash(sizes, sizeof(sizes));
+
+  for(int i=0; i<volumetricMesh->getNumVertices(); i++)
+  {
+    Vec3d & vertex = *(volumetricMesh->getVertex(i));
+    double position[3] = { vertex[0], vertex[1], vertex[2] };
+    hash = Hash(position, sizeof(position), hash);
+  }
+
+  int numElementVertices = volumetricMesh->getNumElementVertices();
+  for(int el=0; el<volumetricMesh->getNumElements(); el++)
+  {
+    for(int j=0; j<numElementVertices; j++)
+    {
+      int vertex = volumetricMesh->getVertexIndex(el, j);
+      hash = Hash(&vertex, sizeof(int), hash);
+    }
+
+    VolumetricMesh::Material * material = volumetricMesh->getElementMaterial(el);
+    double parameters[4] = { material->getDensity(), 0.0, 0.0, 0.0 };
+    VolumetricMesh::ENuMaterial * eNuMaterial = downcastENuMaterial(material);
+    if (eNuMaterial != NULL)
+    {
+      parameters[1] = eNuMaterial->getE();
+      parameters[2] = eNuMaterial->getNu();
+    }
+    VolumetricMesh::MooneyRivlinMaterial * mooneyRivlinMaterial = downcastMooneyRivlinMaterial(material);
+    if (mooneyRivlinMaterial != NULL)
+    {
+      parameters[1] = mooneyRivlinMaterial->getmu01();
+      parameters[2] = mooneyRivlinMaterial->getmu10();
+      parameters[3] = mooneyRivlinMaterial->getv1();
+    }
+    int type = (int) material->getType();
+    hash = Hash(&type, sizeof(int), hash);
+    hash = Hash(parameters, sizeof(parameters), hash);
+  }
+
+  return hash;
+}
+
+void VolumetricMeshCache::GetFilename(const char * name, unsigned long long key, char * filename)
+{
+  unsigned long long hash = Hash(&key, sizeof(key), meshHash);
+  sprintf(filename, "%s/%s-%016llx.cache", directory, name, hash);
+}
+
+void * VolumetricMeshCache::Load(const char * name, size_t * size, unsigned long long key)
+{
+  char * filename = (char*) malloc (sizeof(char) * (strlen(directory) + strlen(name) + 32));
+  GetFilename(name, key, filename);
+
+  char * block = NULL;
+  size_t fileSize = 0;
+
+  #ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    free(filename);
+    if (fd < 0)
+      return NULL;
+    struct stat fileStat;
+    if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size < CACHE_HEADER_SIZE))
+    {
+      close(fd);
+      return NULL;
+    }
+    fileSize = (size_t) fileStat.st_size;
+    void * mapping = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+      return NULL;
+    block = (char*) mapping;
+  #else
+    FILE * fin = fopen(filename, "rb");
+    free(filename);
+    if (fin == NULL)
+      return NULL;
+    fseek(fin, 0, SEEK_END);
+    long length = ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+    if (length < CACHE_HEADER_SIZE)
+    {
+      fclose(fin);
+      return NULL;
+    }
+    fileSize = (size_t) length;
+    block = (char*) malloc (fileSize);
+    size_t numRead = fread(block, 1, fileSize, fin);
+    fclose(fin);
+    if (numRead != fileSize)
+    {
+      free(block);
+      return NULL;
+    }
+  #endif
+
+  // check the header
+  int version;
+  unsigned long long header[3]; // mesh hash, key, data size
+  memcpy(&version, block + 8, sizeof(int));
+  memcpy(header, block + 16, sizeof(header));
+  if ((memcmp(block, CACHE_TAG, 8) != 0) || (version != CACHE_VERSION) || (header[0] != meshHash) || (header[1] != key) || (header[2] != fileSize - CACHE_HEADER_SIZE))
+  {
+    printf("Warning: ignoring invalid cache entry %s.\n", name);
+    // not Release: the data size in the header cannot be trusted here
+    #ifndef _WIN32
+      munmap(block, fileSize);
+    #else
+      free(block);
+    #endif
+    return NULL;
+  }
+
+  if (size != NULL)
+    *size = fileSize - CACHE_HEADER_SIZE;
+
+  return block + CACHE_HEADER_SIZE;
+}
+
+void * VolumetricMeshCache::LoadWithSize(const char * name, size_t size, unsigned long long key)
+{
+  size_t entrySize;
+  void * data = Load(name, &entrySize, key);
+  if ((data != NULL) && (entrySize != size))
+  {
+    printf("Warning: ignoring cache entry %s of wrong size.\n", name);
+    Release(data);
+    return NULL;
+  }
+  return data;
+}
+
+void VolumetricMeshCache::Release(void * data)
+{
+  if (data == NULL)
+    return;
+
+  char * block = (char*) data - CACHE_HEADER_SIZE;
+  #ifndef _WIN32
+    unsigned long long dataSize;
+    memcpy(&dataSize, block + 32, sizeof(unsigned long long));
+    munmap(block, CACHE_HEADER_SIZE + dataSize);
+  #else
+    free(block);
+  #endif
+}
+
+int VolumetricMeshCache::Save(const char * name, const void * data, size_t size, unsigned long long key)
+{
+  char header[CACHE_HEADER_SIZE];
+  memset(header, 0, CACHE_HEADER_SIZE);
+  int version = CACHE_VERSION;
+  unsigned long long headerData[3] = { meshHash, key, size };
+  memcpy(header, CACHE_TAG, 8);
+  memcpy(header + 8, &version, sizeof(int));
+  memcpy(header + 16, headerData, sizeof(headerData));
+
+  // write into a temporary file, and then rename it, so that other processes never see an incomplete entry
+  char * filename = (char*) malloc (sizeof(char) * (strlen(directory) + strlen(name) + 32));
+  GetFilename(name, key, filename);
+  char * tempFilename = (char*) malloc (sizeof(char) * (strlen(filename) + 8));
+  sprintf(tempFilename, "%s.tmp", filename);
+
+  int code = 0;
+  FILE * fout = fopen(tempFilename, "wb");
+  if (fout == NULL)
+  {
+    printf("Error: could not write cache file %s.\n", tempFilename);
+    code = 1;
+  }
+  else
+  {
+    size_t written = fwrite(header, 1, CACHE_HEADER_SIZE, fout);
+    written += fwrite(data, 1, size, fout);
+    if (fclose(fout) != 0)
+      written = 0;
+
+    #ifdef _WIN32
+      remove(filename); // rename does not overwrite under Windows
+    #endif
+    if ((written != CACHE_HEADER_SIZE + size) || (rename(tempFilename, filename) != 0))
+    {
+      printf("Error: could not write cache file %s.\n", filename);
+      remove(tempFilename);
+      code = 1;
+    }
+  }
+
+  free(tempFilename);
+  free(filename);
+  return code;
+}
+
+// topology entry: number of rows, row lengths, column indices of all the rows
+SparseMatrix * VolumetricMeshCache::LoadSparseMatrixTopology(const char * name, unsigned long long key)
+{
+  size_t size;
+  int * data = (int*) Load(name, &size, key);
+  if (data == NULL)
+    return NULL;
+
+  // check that the entry is consistent
+  int numRows = (size >= sizeof(int)) ? data[0] : -1;
+  bool valid = (numRows >= 0) && (size >= sizeof(int) * (1 + numRows));
+  size_t numEntries = 0;
+  for(int i=0; valid && (i<numRows); i++)
+  {
+    if (data[1 + i] < 0)
+      valid = false;
+    numEntries += data[1 + i];
+  }
+  if (!valid || (size != sizeof(int) * (1 + numRows + numEntries)))
+  {
+    printf("Warning: ignoring invalid cache entry %s.\n", name);
+    Release(data);
+    return NULL;
+  }
+
+  SparseMatrix * sparseMatrix = new SparseMatrix(numRows, &data[1], &data[1 + numRows]);
+  Release(data);
+  return sparseMatrix;
+}
+
+int VolumetricMeshCache::SaveSparseMatrixTopology(const char * name, SparseMatrix * sparseMatrix, unsigned long long key)
+{
+  int numRows = sparseMatrix->GetNumRows();
+  size_t numEntries = sparseMatrix->GetNumEntries();
+  int * data = (int*) malloc (sizeof(int) * (1 + numRows + numEntries));
+  data[0] = numRows;
+  int * columnIndices = &data[1 + numRows];
+  for(int i=0; i<numRows; i++)
+  {
+    int rowLength = sparseMatrix->GetRowLength(i);
+    data[1 + i] = rowLength;
+    memcpy(columnIndices, sparseMatrix->GetColumnIndices()[i], sizeof(int) * rowLength);
+    columnIndices += rowLength;
+  }
+
+  int code = Save(name, data, sizeof(int) * (1 + numRows + numEntries), key);
+  free(data);
+  return code;
+}
+
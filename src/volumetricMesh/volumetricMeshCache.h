@@ -0,0 +1,95 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _VOLUMETRICMESHCACHE_H_
+#define _VOLUMETRICMESHCACHE_H_
+
+/*
+  A disk cache for data precomputed from a volumetric mesh (e.g., per-element coefficients,
+  or the sparsity pattern of the stiffness matrix), to avoid repeating the precomputation
+  each time the same mesh is loaded.
+
+  The cache entries are binary files in a given directory. Each entry is keyed on a hash of 
+  the content of the mesh (vertex positions, elements, and the material parameters of each element),
+  on the name of the entry, and on an optional user key (e.g., a hash of the parameters of the
+  precomputation). If the mesh changes, the old entries are simply not found anymore (and can be deleted).
+
+  Entries are loaded by memory-mapping the files (under Windows, they are read into memory).
+  Loaded data is private to the process: it can be modified (copy-on-write) without changing the file.
+  Data returned by Load must be released with Release (not free).
+
+  The classes that support the cache (StVKTetHighMemoryABCD, StVKStiffnessMatrix, IsotropicHyperelasticFEM, 
+  CorotationalLinearFEM) take an optional VolumetricMeshCache pointer in their constructor; they load 
+  their precomputed data from the cache if present, and otherwise compute it and store it into the cache.
+  The sparsity pattern of the stiffness matrix is the same for all these classes, and is stored as 
+  one shared entry ("stiffnessMatrixTopology").
+*/
+
+#include <stdlib.h>
+#include "volumetricMesh/volumetricMesh.h"
+#include "sparseMatrix/sparseMatrix.h"
+
+class VolumetricMeshCache
+{
+public:
+  // the directory must exist; the mesh must not change for the lifetime of this object
+  VolumetricMeshCache(const char * directory, VolumetricMesh * volumetricMesh);
+  virtual ~VolumetricMeshCache();
+
+  // loads the entry "name"; returns NULL if not in the cache
+  // if size is not NULL, the size of the data (in bytes) is returned in *size
+  void * Load(const char * name, size_t * size=NULL, unsigned long long key=0);
+  // loads the entry "name", and checks that it is exactly "size" bytes long; returns NULL if not in the cache (or of wrong size)
+  void * LoadWithSize(const char * name, size_t size, unsigned long long key=0);
+  // releases the data returned by Load
+  static void Release(void * data);
+
+  // stores "size" bytes of "data" as entry "name"; returns 0 on success
+  int Save(const char * name, const void * data, size_t size, unsigned long long key=0);
+
+  // sparsity pattern of a sparse matrix (the entries are not stored); Load returns a zero matrix with the stored pattern, or NULL
+  SparseMatrix * LoadSparseMatrixTopology(const char * name, unsigned long long key=0);
+  int SaveSparseMatrixTopology(const char * name, SparseMatrix * sparseMatrix, unsigned long long key=0);
+
+  inline unsigned long long GetMeshHash() { return meshHash; }
+  inline const char * GetDirectory() { return directory; }
+
+  // 64-bit FNV-1a hash of the given bytes; pass a previous hash to hash several arrays
+  static unsigned long long Hash(const void * data, size_t size, unsigned long long hash=14695981039346656037ULL);
+  // hash of the mesh vertices, elements, and element materials
+  static unsigned long long ComputeMeshHash(VolumetricMesh * volumetricMesh);
+
+protected:
+  char * directory;
+  unsigned long long meshHash;
+
+  void GetFilename(const char * name, unsigned long long key, char * filename);
+};
+
+#endif
+
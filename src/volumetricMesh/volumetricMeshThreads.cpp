@@ -0,0 +1,109 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "volumetricMeshThreads.h"
+
+void VolumetricMeshThreads::GetElementRange(int numElements, int numThreads, int rank, int * startElement, int * endElement)
+{
+  int remainder = numElements % numThreads;
+  // the first 'remainder' threads will process one element more
+  int jobSize = numElements / numThreads;
+
+  if (rank < remainder)
+  {
+    *startElement = rank * (jobSize+1);
+    *endElement = (rank+1) * (jobSize+1);
+  }
+  else
+  {
+    *startElement = remainder * (jobSize+1) + (rank-remainder) * jobSize;
+    *endElement = remainder * (jobSize+1) + ((rank-remainder)+1) * jobSize;
+  }
+}
+
+struct VolumetricMeshThreads_threadArg
+{
+  VolumetricMeshThreads::ElementRangeFunction function;
+  void * data;
+  int startElement;
+  int endElement;
+};
+
+static void * VolumetricMeshThreads_WorkerThread(void * arg)
+{
+  struct VolumetricMeshThreads_threadArg * threadArgp = (struct VolumetricMeshThreads_threadArg*) arg;
+  threadArgp->function(threadArgp->data, threadArgp->startElement, threadArgp->endElement);
+  return NULL;
+}
+
+void VolumetricMeshThreads::RunOnElements(int numElements, int numThreads, ElementRangeFunction function, void * data)
+{
+  if (numThreads > numElements)
+    numThreads = numElements;
+
+  if (numThreads <= 1)
+  {
+    function(data, 0, numElements);
+    return;
+  }
+
+  struct VolumetricMeshThreads_threadArg * threadArgv = (struct VolumetricMeshThreads_threadArg*) malloc (sizeof(struct VolumetricMeshThreads_threadArg) * numThreads);
+  pthread_t * tid = (pthread_t*) malloc (sizeof(pthread_t) * numThreads);
+
+  for(int i=0; i<numThreads; i++)
+  {
+    threadArgv[i].function = function;
+    threadArgv[i].data = data;
+    GetElementRange(numElements, numThreads, i, &threadArgv[i].startElement, &threadArgv[i].endElement);
+  }
+
+  for(int i=0; i<numThreads; i++)
+  {
+    if (pthread_create(&tid[i], NULL, VolumetricMeshThreads_WorkerThread, &threadArgv[i]) != 0)
+    {
+      printf("Error: unable to launch thread %d.\n", i);
+      exit(1);
+    }
+  }
+
+  for(int i=0; i<numThreads; i++)
+  {
+    if (pthread_join(tid[i], NULL) != 0)
+    {
+      printf("Error: unable to join thread %d.\n", i);
+      exit(1);
+    }
+  }
+
+  free(threadArgv);
+  free(tid);
+}
+
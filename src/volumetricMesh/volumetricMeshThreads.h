@@ -0,0 +1,56 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 1.1                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2012 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/code                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Fun Shing Sin, Daniel Schroeder,             *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC                 *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _VOLUMETRICMESHTHREADS_H_
+#define _VOLUMETRICMESHTHREADS_H_
+
+/*
+  Runs a per-element computation (e.g., the precomputation in the constructor of a force model)
+  in parallel, using pthreads. The elements are split into numThreads contiguous ranges 
+  (of equal size, up to one element), in the same way as in the multi-threaded (MT) force models,
+  and each range is processed by one thread.
+
+  The function must only write data belonging to the elements in its range (or thread-safe data).
+  With numThreads <= 1, the function is called directly on the entire element range, without creating any threads.
+*/
+
+class VolumetricMeshThreads
+{
+public:
+  // processes the elements startElement <= el < endElement
+  typedef void (*ElementRangeFunction)(void * data, int startElement, int endElement);
+
+  // calls function on all the elements 0 <= el < numElements, using numThreads threads
+  static void RunOnElements(int numElements, int numThreads, ElementRangeFunction function, void * data);
+
+  // the element range processed by thread "rank"
+  static void GetElementRange(int numElements, int numThreads, int rank, int * startElement, int * endElement);
+};
+
+#endif
+